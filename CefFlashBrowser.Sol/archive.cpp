@@ -0,0 +1,566 @@
+#include "archive.h"
+#include "codec.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+
+namespace
+{
+    const char ARCHIVE_MAGIC[] = "SOLA";
+    const uint32_t ARCHIVE_FORMAT = 1;
+    const size_t ARCHIVE_HEADER_SIZE = 4 + 4 + 8 + 8 + 32;
+
+    const uint8_t MEMBER_COMPRESSED = 1;
+
+    // a block header is its stored size, with the top bit set if it is stored as it is
+    const size_t BLOCK_SIZE = 64 * 1024;
+    const uint32_t BLOCK_RAW = 0x80000000;
+
+    // matches are found through a table of the last position of each hashed 4 bytes
+    const int MATCH_HASH_BITS = 14;
+    const size_t MATCH_MINLEN = 4;
+    const size_t MATCH_MAXOFFSET = 0xFFFF;
+
+
+    uint32_t Load32(const uint8_t* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    void AppendLength(std::vector<uint8_t>& out, size_t len)
+    {
+        for (; len >= 255; len -= 255) {
+            out.push_back(255);
+        }
+        out.push_back(static_cast<uint8_t>(len));
+    }
+
+    // a token with the literal and match lengths, 15 meaning more follow, the literals,
+    // then the offset and the rest of the match length, the last sequence has no match
+    void AppendSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t litlen, size_t offset, size_t matchlen)
+    {
+        size_t extra = matchlen != 0 ? matchlen - MATCH_MINLEN : 0;
+        out.push_back(static_cast<uint8_t>((litlen < 15 ? litlen : 15) << 4 | (extra < 15 ? extra : 15)));
+        if (litlen >= 15) {
+            AppendLength(out, litlen - 15);
+        }
+        out.insert(out.end(), literals, literals + litlen);
+
+        if (matchlen != 0) {
+            sol::codec::AppendBigEndian(out, static_cast<uint16_t>(offset));
+            if (extra >= 15) {
+                AppendLength(out, extra - 15);
+            }
+        }
+    }
+
+    // returns false, with out as it was, if compressing does not make the block smaller
+    bool CompressBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+    {
+        size_t start = out.size();
+        std::vector<uint32_t> table(size_t(1) << MATCH_HASH_BITS, 0);    // positions + 1
+
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i + MATCH_MINLEN <= size) {
+            uint32_t seq = Load32(data + i);
+            uint32_t& slot = table[(seq * 2654435761u) >> (32 - MATCH_HASH_BITS)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(i + 1);
+
+            if (candidate == 0 || i - (candidate - 1) > MATCH_MAXOFFSET || Load32(data + candidate - 1) != seq) {
+                // the longer nothing matches, the further the next try
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+
+            size_t match = candidate - 1;
+            size_t len = MATCH_MINLEN;
+            while (i + len < size && data[match + len] == data[i + len]) {
+                ++len;
+            }
+
+            AppendSequence(out, data + anchor, i - anchor, i - match, len);
+            i += len;
+            anchor = i;
+
+            if (out.size() - start >= size) {
+                out.resize(start);
+                return false;
+            }
+        }
+
+        AppendSequence(out, data + anchor, size - anchor, 0, 0);
+        if (out.size() - start >= size) {
+            out.resize(start);
+            return false;
+        }
+        return true;
+    }
+
+    bool ReadLength(const uint8_t* data, size_t size, size_t& index, size_t& len, size_t limit)
+    {
+        uint8_t byte;
+        do {
+            if (index >= size) {
+                return false;
+            }
+            byte = data[index++];
+            len += byte;
+            if (len > limit) {
+                return false;
+            }
+        } while (byte == 255);
+        return true;
+    }
+
+    // checks every length and offset, so a damaged block fails instead of reading or
+    // writing out of bounds
+    bool DecompressBlock(const uint8_t* data, size_t size, uint8_t* out, size_t outsize)
+    {
+        size_t index = 0;
+        size_t pos = 0;
+
+        while (index < size) {
+            uint8_t token = data[index++];
+
+            size_t litlen = token >> 4;
+            if (litlen == 15 && !ReadLength(data, size, index, litlen, outsize)) {
+                return false;
+            }
+            if (litlen > size - index || litlen > outsize - pos) {
+                return false;
+            }
+            std::memcpy(out + pos, data + index, litlen);
+            index += litlen;
+            pos += litlen;
+
+            if (index == size) {
+                break;
+            }
+
+            if (size - index < 2) {
+                return false;
+            }
+            size_t offset = sol::codec::LoadBigEndian<uint16_t>(data + index);
+            index += 2;
+            if (offset == 0 || offset > pos) {
+                return false;
+            }
+
+            size_t matchlen = token & 15;
+            if (matchlen == 15 && !ReadLength(data, size, index, matchlen, outsize)) {
+                return false;
+            }
+            matchlen += MATCH_MINLEN;
+            if (matchlen > outsize - pos) {
+                return false;
+            }
+
+            // byte by byte, a match may overlap the bytes it produces
+            for (size_t k = 0; k < matchlen; ++k, ++pos) {
+                out[pos] = out[pos - offset];
+            }
+        }
+        return pos == outsize;
+    }
+
+    void EncodeMember(const uint8_t* data, size_t size, bool compress, std::vector<uint8_t>& out)
+    {
+        if (!compress) {
+            out.assign(data, data + size);
+            return;
+        }
+
+        out.clear();
+        for (size_t begin = 0; begin < size; begin += BLOCK_SIZE) {
+            size_t len = std::min(BLOCK_SIZE, size - begin);
+            size_t header = out.size();
+            sol::codec::AppendBigEndian(out, uint32_t(0));
+
+            uint32_t stored = static_cast<uint32_t>(len) | BLOCK_RAW;
+            if (CompressBlock(data + begin, len, out)) {
+                stored = static_cast<uint32_t>(out.size() - header - 4);
+            }
+            else {
+                out.insert(out.end(), data + begin, data + begin + len);
+            }
+            sol::codec::StoreBigEndian(out.data() + header, stored);
+        }
+    }
+
+    bool DecodeMember(const uint8_t* data, const sol::SolArchiveMember& member, std::vector<uint8_t>& out)
+    {
+        out.resize(static_cast<size_t>(member.size));
+        if (!member.compressed) {
+            if (member.stored != member.size) {
+                return false;
+            }
+            std::memcpy(out.data(), data, out.size());
+            return true;
+        }
+
+        size_t index = 0;
+        for (size_t begin = 0; begin < out.size(); begin += BLOCK_SIZE) {
+            size_t len = std::min(BLOCK_SIZE, out.size() - begin);
+            if (member.stored - index < 4) {
+                return false;
+            }
+            uint32_t header = sol::codec::LoadBigEndian<uint32_t>(data + index);
+            index += 4;
+
+            size_t stored = header & ~BLOCK_RAW;
+            if (stored > member.stored - index) {
+                return false;
+            }
+            if (header & BLOCK_RAW) {
+                if (stored != len) {
+                    return false;
+                }
+                std::memcpy(out.data() + begin, data + index, len);
+            }
+            else if (!DecompressBlock(data + index, stored, out.data() + begin, len)) {
+                return false;
+            }
+            index += stored;
+        }
+        return index == member.stored;
+    }
+
+    // a name is kept only if it cannot lead out of the directory it is extracted to
+    bool IsRelativeName(const std::string& name)
+    {
+        if (name.empty() || name.find_first_of("\\:") != std::string::npos) {
+            return false;
+        }
+
+        size_t begin = 0;
+        while (true) {
+            size_t end = name.find('/', begin);
+            std::string part = name.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+            if (part.empty() || part == "." || part == "..") {
+                return false;
+            }
+            if (end == std::string::npos) {
+                return true;
+            }
+            begin = end + 1;
+        }
+    }
+
+    // runs work(i) for every i below count, stops taking new ones once one fails
+    // and returns the lowest index that failed, or count
+    template <typename TWork>
+    size_t ForEachMember(size_t count, unsigned threads, TWork&& work)
+    {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> failed{ count };
+        auto run = [&]() {
+            for (size_t i; (i = next++) < count && failed.load() == count;) {
+                if (!work(i)) {
+                    size_t current = failed.load();
+                    while (i < current && !failed.compare_exchange_weak(current, i)) {
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; ++i) {
+            workers.emplace_back(run);
+        }
+        run();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        return failed;
+    }
+
+    void AppendIndex(std::vector<uint8_t>& out, const std::vector<sol::SolArchiveMember>& members)
+    {
+        using namespace sol;
+
+        codec::AppendBigEndian(out, static_cast<uint32_t>(members.size()));
+        for (auto& member : members) {
+            codec::AppendBigEndian(out, static_cast<uint32_t>(member.name.size()));
+            out.insert(out.end(), member.name.begin(), member.name.end());
+            codec::AppendBigEndian(out, member.offset);
+            codec::AppendBigEndian(out, member.size);
+            codec::AppendBigEndian(out, member.stored);
+            out.push_back(member.compressed ? MEMBER_COMPRESSED : 0);
+            out.insert(out.end(), member.hash.begin(), member.hash.end());
+        }
+    }
+
+    bool ParseIndex(const uint8_t* data, size_t size, uint64_t datasize, std::vector<sol::SolArchiveMember>& members)
+    {
+        using namespace sol;
+
+        const size_t fixed = 4 + 8 + 8 + 8 + 1 + 32;
+        if (size < 4) {
+            return false;
+        }
+        uint32_t count = codec::LoadBigEndian<uint32_t>(data);
+        if (count > (size - 4) / fixed) {
+            return false;
+        }
+
+        size_t index = 4;
+        members.resize(count);
+        for (auto& member : members) {
+            if (size - index < fixed) {
+                return false;
+            }
+            size_t namelen = codec::LoadBigEndian<uint32_t>(data + index);
+            if (namelen > size - index - fixed) {
+                return false;
+            }
+            member.name.assign(reinterpret_cast<const char*>(data + index + 4), namelen);
+            index += 4 + namelen;
+
+            member.offset = codec::LoadBigEndian<uint64_t>(data + index);
+            member.size = codec::LoadBigEndian<uint64_t>(data + index + 8);
+            member.stored = codec::LoadBigEndian<uint64_t>(data + index + 16);
+            member.compressed = (data[index + 24] & MEMBER_COMPRESSED) != 0;
+            std::memcpy(member.hash.data(), data + index + 25, member.hash.size());
+            index += fixed - 4;
+
+            if (!IsRelativeName(member.name) || member.offset < ARCHIVE_HEADER_SIZE
+                || member.offset > datasize || member.stored > datasize - member.offset) {
+                return false;
+            }
+
+            // a length byte stands for at most 255 bytes, so a damaged size cannot ask
+            // for much more memory than the member takes in the archive
+            if (member.compressed ? member.size > member.stored * 256 + BLOCK_SIZE : member.size != member.stored) {
+                return false;
+            }
+        }
+        return index == size;
+    }
+}
+
+
+bool sol::PackSolArchive(const std::string& path, const std::vector<std::pair<std::string, std::string>>& files,
+    std::string& errmsg, const SolArchiveOptions& options)
+{
+    SOL_TRACE_SCOPE("pack sol archive");
+
+    std::vector<SolArchiveMember> members(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!IsRelativeName(files[i].first)) {
+            errmsg = utils::FormatString("Not a relative name: %s", files[i].first.c_str());
+            return false;
+        }
+        members[i].name = files[i].first;
+    }
+
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return files[a].first < files[b].first; });
+    for (size_t i = 1; i < order.size(); ++i) {
+        if (files[order[i]].first == files[order[i - 1]].first) {
+            errmsg = utils::FormatString("Two files named %s", files[order[i]].first.c_str());
+            return false;
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        errmsg = "Failed to open file";
+        return false;
+    }
+
+    std::vector<uint8_t> header(ARCHIVE_HEADER_SIZE, 0);
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    // members are read and compressed in parallel and written as they are done,
+    // the index says where each one went
+    std::mutex outlock;
+    uint64_t offset = ARCHIVE_HEADER_SIZE;
+    bool writefailed = false;
+
+    size_t failed = ForEachMember(files.size(), options.threads, [&](size_t i) {
+        utils::MappedFile file;
+        if (!file.open(files[i].second)) {
+            return false;
+        }
+
+        std::vector<uint8_t> encoded;
+        EncodeMember(file.data(), file.size(), options.compress, encoded);
+
+        SolArchiveMember& member = members[i];
+        member.size = file.size();
+        member.stored = encoded.size();
+        member.compressed = options.compress;
+        member.hash = utils::Sha256::Hash(file.data(), file.size());
+
+        std::lock_guard<std::mutex> guard(outlock);
+        member.offset = offset;
+        if (!out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size())) {
+            writefailed = true;
+            return false;
+        }
+        offset += encoded.size();
+        return true;
+    });
+
+    bool ok = failed == files.size();
+    if (ok) {
+        std::vector<SolArchiveMember> sorted;
+        sorted.reserve(members.size());
+        for (size_t i : order) {
+            sorted.push_back(std::move(members[i]));
+        }
+
+        std::vector<uint8_t> index;
+        AppendIndex(index, sorted);
+        out.write(reinterpret_cast<const char*>(index.data()), index.size());
+
+        auto hash = utils::Sha256::Hash(index.data(), index.size());
+        header.assign(ARCHIVE_MAGIC, ARCHIVE_MAGIC + 4);
+        codec::AppendBigEndian(header, ARCHIVE_FORMAT);
+        codec::AppendBigEndian(header, offset);
+        codec::AppendBigEndian(header, static_cast<uint64_t>(index.size()));
+        header.insert(header.end(), hash.begin(), hash.end());
+
+        out.seekp(0);
+        ok = out.write(reinterpret_cast<const char*>(header.data()), header.size()) && out.flush();
+        writefailed = !ok;
+    }
+    out.close();
+
+    if (!ok) {
+        errmsg = writefailed ? "Failed to write file" : utils::FormatString("Failed to read %s", files[failed].second.c_str());
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        return false;
+    }
+    errmsg.clear();
+    return true;
+}
+
+bool sol::PackSolDirectory(const std::string& dir, const std::string& path, std::string& errmsg, const SolArchiveOptions& options)
+{
+    std::vector<std::pair<std::string, std::string>> files;
+
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(dir, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        std::string ext = it->path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        if (ext == ".sol" && it->is_regular_file(ec)) {
+            files.emplace_back(it->path().lexically_relative(dir).generic_string(), it->path().string());
+        }
+    }
+    if (ec) {
+        errmsg = "Failed to list directory";
+        return false;
+    }
+    return PackSolArchive(path, files, errmsg, options);
+}
+
+bool sol::SolArchive::open(const std::string& path, std::string& errmsg)
+{
+    _members.clear();
+    _names.clear();
+
+    if (!_file.open(path)) {
+        errmsg = "Failed to read file";
+        return false;
+    }
+
+    const uint8_t* data = _file.data();
+    size_t size = _file.size();
+    if (size < ARCHIVE_HEADER_SIZE || std::memcmp(data, ARCHIVE_MAGIC, 4) != 0) {
+        errmsg = "Not a sol archive";
+        return false;
+    }
+    if (codec::LoadBigEndian<uint32_t>(data + 4) != ARCHIVE_FORMAT) {
+        errmsg = "Unsupported archive format";
+        return false;
+    }
+
+    uint64_t indexoffset = codec::LoadBigEndian<uint64_t>(data + 8);
+    uint64_t indexsize = codec::LoadBigEndian<uint64_t>(data + 16);
+    if (indexoffset < ARCHIVE_HEADER_SIZE || indexoffset > size || indexsize != size - indexoffset
+        || std::memcmp(utils::Sha256::Hash(data + indexoffset, static_cast<size_t>(indexsize)).data(), data + 24, 32) != 0
+        || !ParseIndex(data + indexoffset, static_cast<size_t>(indexsize), indexoffset, _members)) {
+        _members.clear();
+        errmsg = "The archive index is damaged";
+        return false;
+    }
+
+    _names.reserve(_members.size());
+    for (size_t i = 0; i < _members.size(); ++i) {
+        _names.emplace(_members[i].name, i);
+    }
+    errmsg.clear();
+    return true;
+}
+
+const sol::SolArchiveMember* sol::SolArchive::find(const std::string& name) const
+{
+    auto it = _names.find(name);
+    return it != _names.end() ? &_members[it->second] : nullptr;
+}
+
+bool sol::SolArchive::read(const SolArchiveMember& member, std::vector<uint8_t>& data, std::string& errmsg) const
+{
+    if (!DecodeMember(_file.data() + member.offset, member, data)
+        || utils::Sha256::Hash(data.data(), data.size()) != member.hash) {
+        errmsg = utils::FormatString("%s is damaged", member.name.c_str());
+        return false;
+    }
+    errmsg.clear();
+    return true;
+}
+
+bool sol::SolArchive::extract(const std::string& dir, std::string& errmsg, unsigned threads) const
+{
+    SOL_TRACE_SCOPE("extract sol archive");
+
+    std::vector<std::string> errors(_members.size());
+    size_t failed = ForEachMember(_members.size(), threads, [&](size_t i) {
+        std::vector<uint8_t> data;
+        if (!read(_members[i], data, errors[i])) {
+            return false;
+        }
+
+        std::filesystem::path path = std::filesystem::path(dir) / std::filesystem::path(_members[i].name).make_preferred();
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        try {
+            utils::WriteFile(path.string(), data);
+        }
+        catch (const std::exception& e) {
+            errors[i] = utils::FormatString("%s: %s", _members[i].name.c_str(), e.what());
+            return false;
+        }
+        return true;
+    });
+
+    if (failed != _members.size()) {
+        errmsg = errors[failed];
+        return false;
+    }
+    errmsg.clear();
+    return true;
+}
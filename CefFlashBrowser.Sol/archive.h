@@ -0,0 +1,75 @@
+#ifndef __ARCHIVE_H__
+#define __ARCHIVE_H__
+
+#include "utils.h"
+#include <unordered_map>
+
+// many sol files in one file, with the index at the end so that any member can be
+// read without the others, big-endian as sol files are:
+//
+//   "SOLA", format version, offset and size of the index, SHA-256 of the index
+//   the members, in the order they were packed
+//   the index, sorted by name: the name, offset, size, stored size, flags and the
+//   SHA-256 of the member's bytes, checked whenever a member is read
+//
+// a compressed member is a run of blocks of up to 64 KiB each, each one either LZ77
+// compressed or, if that does not make it smaller, stored as it is
+namespace sol
+{
+    struct SolArchiveMember
+    {
+        std::string name;       // relative, with / between directories
+        uint64_t offset;
+        uint64_t size;
+        uint64_t stored;        // bytes in the archive
+        bool compressed;
+        utils::Sha256::Digest hash;
+    };
+
+
+    struct SolArchiveOptions
+    {
+        bool compress = true;
+
+        // threads reading, compressing and checking members, 0 uses one per core
+        unsigned threads = 0;
+    };
+
+
+    // packs each file, a pair of the name to give it and its path, returns false with
+    // errmsg set if a file cannot be read, two share a name, or a name is not relative,
+    // the archive is removed again then
+    bool PackSolArchive(const std::string& path, const std::vector<std::pair<std::string, std::string>>& files,
+        std::string& errmsg, const SolArchiveOptions& options = SolArchiveOptions());
+
+    // packs every .sol file below dir, named by its path relative to dir
+    bool PackSolDirectory(const std::string& dir, const std::string& path, std::string& errmsg,
+        const SolArchiveOptions& options = SolArchiveOptions());
+
+
+    class SolArchive
+    {
+    public:
+        // returns false with errmsg set if the file is not an archive or its index is damaged
+        bool open(const std::string& path, std::string& errmsg);
+
+        const std::vector<SolArchiveMember>& members() const { return _members; }
+
+        // returns nullptr if there is no such member
+        const SolArchiveMember* find(const std::string& name) const;
+
+        // returns false with errmsg set if the member is damaged
+        bool read(const SolArchiveMember& member, std::vector<uint8_t>& data, std::string& errmsg) const;
+
+        // writes every member below dir, directories are created as needed, returns
+        // false with errmsg set for the first member in the index that fails
+        bool extract(const std::string& dir, std::string& errmsg, unsigned threads = 0) const;
+
+    private:
+        utils::MappedFile _file;
+        std::vector<SolArchiveMember> _members;
+        std::unordered_map<std::string, size_t> _names;
+    };
+}
+
+#endif // !__ARCHIVE_H__
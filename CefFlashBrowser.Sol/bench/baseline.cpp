@@ -0,0 +1,568 @@
+#include "baseline.h"
+#include "../codec.h"
+#include "../utils.h"
+#include <cstring>
+
+
+// the functions below are those of the original reader, with only what the types
+// and the warnings of today ask for changed
+namespace
+{
+    using sol::SolType;
+    using sol::AMF0Type;
+    using sol::SolValue;
+    using sol::SolRefTable;
+
+    constexpr uint8_t SOL_MAGIC[] = { 0x00, 0xBF };
+    constexpr uint8_t SOL_CONSTANT[] = { 0x54, 0x43, 0x53, 0x4F, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00 };
+    constexpr uint8_t AMF0_OBJECT_ENDMARK[] = { 0x00, 0x00, 0x09 };
+
+    [[noreturn]] void ThrowFileEndedImproperlyOnReadingType(int type)
+    {
+        throw std::runtime_error(utils::FormatString(
+            "File ended improperly on reading type %d", type));
+    }
+
+    [[noreturn]] void ThrowUnknownType(int type, int index)
+    {
+        throw std::runtime_error(utils::FormatString(
+            "Unknown type %d at index %d", type, index));
+    }
+
+    [[noreturn]] void ThrowBadFormatOfType(AMF0Type type, int index, int read, int desire)
+    {
+        throw std::runtime_error(utils::FormatString(
+            "Bad format of AMF0 type %d at index %d: read %d, desire %d", static_cast<int>(type), index, read, desire));
+    }
+
+    [[noreturn]] void ThrowEndRequired(int index, int read)
+    {
+        throw std::runtime_error(utils::FormatString(
+            "End required at index %d: read %d, desire 0", index, read));
+    }
+
+    template <typename T>
+    void CheckRefIndex(const std::vector<T>& pool, int index)
+    {
+        if (index >= static_cast<int>(pool.size())) {
+            throw std::runtime_error(utils::FormatString(
+                "Reference index %d not found", index));
+        }
+    }
+
+    uint8_t ReadByte(const uint8_t* data, int size, int& index)
+    {
+        return index >= size
+            ? throw std::runtime_error("File ended improperly on reading byte")
+            : data[index++];
+    }
+
+    template <typename T>
+    T ReadBigEndian(const uint8_t* data, int size, int& index)
+    {
+        if (index + static_cast<int>(sizeof(T)) > size) {
+            throw std::runtime_error("File ended improperly on reading an integer");
+        }
+        T result = sol::codec::LoadBigEndian<T>(data + index);
+        index += sizeof(T);
+        return result;
+    }
+
+    double ReadDouble(const uint8_t* data, int size, int& index, int type)
+    {
+        if (index + 8 > size) {
+            ThrowFileEndedImproperlyOnReadingType(type);
+        }
+        uint64_t tmp = ReadBigEndian<uint64_t>(data, size, index);
+        double result;
+        memcpy(&result, &tmp, sizeof(result));
+        return result;
+    }
+
+    SolValue ReadSolValue(const uint8_t* data, int size, int& index, SolRefTable& reftable, SolType type);
+    SolValue ReadAMF0Value(const uint8_t* data, int size, int& index, SolRefTable& reftable, AMF0Type type);
+
+    SolType ReadSolType(const uint8_t* data, int size, int& index)
+    {
+        return static_cast<SolType>(ReadByte(data, size, index));
+    }
+
+    sol::SolInteger ReadSolInteger(const uint8_t* data, int size, int& index, bool unsign = false)
+    {
+        int32_t result = 0;
+
+        int i = 0;
+        for (; i < 3; ++i) {
+            if (index + i >= size) {
+                ThrowFileEndedImproperlyOnReadingType(static_cast<int>(SolType::Integer));
+            }
+            result = result << 7 | (data[index + i] & 0x7F);
+            if (!(data[index + i] & 0x80)) break;
+        }
+
+        if (i == 3) {
+            if (index + i >= size) {
+                ThrowFileEndedImproperlyOnReadingType(static_cast<int>(SolType::Integer));
+            }
+            result = result << 8 | data[index + i];
+        }
+
+        if (result >= 0x10000000 && !unsign) {
+            result -= 0x20000000;
+        }
+
+        index += i + 1;
+        return result;
+    }
+
+    sol::SolString ReadSolString(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        int ref = ReadSolInteger(data, size, index, true);
+
+        if ((ref & 1) == 0) {
+            CheckRefIndex(reftable.strpool, ref >> 1);
+            return reftable.strpool[ref >> 1];
+        }
+
+        int len = ref >> 1;
+
+        if (index + len > size) {
+            ThrowFileEndedImproperlyOnReadingType(static_cast<int>(SolType::String));
+        }
+
+        if (len == 0) {
+            return std::string();
+        }
+
+        std::string result(data + index, data + index + len);
+        index += len;
+
+        reftable.strpool.push_back(result);
+        return result;
+    }
+
+    SolValue ReadSolXml(const uint8_t* data, int size, int& index, SolRefTable& reftable, SolType xmltype)
+    {
+        int ref = ReadSolInteger(data, size, index, true);
+
+        if ((ref & 1) == 0) {
+            CheckRefIndex(reftable.objpool, ref >> 1);
+            return reftable.objpool[ref >> 1];
+        }
+
+        int len = ref >> 1;
+
+        if (index + len > size) {
+            ThrowFileEndedImproperlyOnReadingType(static_cast<int>(xmltype));
+        }
+
+        SolValue result(xmltype, std::string(data + index, data + index + len));
+        index += len;
+
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    sol::SolBinary ReadSolBinary(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        int ref = ReadSolInteger(data, size, index, true);
+
+        if ((ref & 1) == 0) {
+            CheckRefIndex(reftable.objpool, ref >> 1);
+            return reftable.objpool[ref >> 1].get<sol::SolBinary>();
+        }
+
+        int len = ref >> 1;
+
+        if (index + len > size) {
+            ThrowFileEndedImproperlyOnReadingType(static_cast<int>(SolType::Binary));
+        }
+
+        std::vector<uint8_t> result(data + index, data + index + len);
+        index += len;
+
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    SolValue ReadSolDate(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        int ref = ReadSolInteger(data, size, index, true);
+
+        if ((ref & 1) == 0) {
+            CheckRefIndex(reftable.objpool, ref >> 1);
+            return reftable.objpool[ref >> 1];
+        }
+
+        SolValue result(SolType::Date, ReadDouble(data, size, index, static_cast<int>(SolType::Double)));
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    sol::SolArray ReadSolArray(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        int ref = ReadSolInteger(data, size, index, true);
+
+        if ((ref & 1) == 0) {
+            CheckRefIndex(reftable.objpool, ref >> 1);
+            return reftable.objpool[ref >> 1].get<sol::SolArray>();
+        }
+
+        int len = ref >> 1;
+
+        sol::SolArray result;
+        result.dense.reserve(len);
+
+        std::string name;
+        while (!(name = ReadSolString(data, size, index, reftable)).empty()) {
+            SolType type = ReadSolType(data, size, index);
+            result.assoc[name] = ReadSolValue(data, size, index, reftable, type);
+        }
+
+        for (int i = 0; i < len; ++i) {
+            SolType type = ReadSolType(data, size, index);
+            result.dense.push_back(ReadSolValue(data, size, index, reftable, type));
+        }
+
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    sol::SolObject ReadSolObject(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        int ref = ReadSolInteger(data, size, index, true);
+
+        if ((ref & 1) == 0) {
+            CheckRefIndex(reftable.objpool, ref >> 1);
+            return reftable.objpool[ref >> 1].get<sol::SolObject>();
+        }
+
+        sol::SolObject result;
+        int classref = ref >> 1;
+
+        if ((classref & 1) == 0) {
+            int classindex = classref >> 1;
+            CheckRefIndex(reftable.classpool, classindex);
+            result.classdef = reftable.classpool[classindex];
+        }
+        else {
+            result.classdef.externalizable = (classref >> 1) & 1;
+            result.classdef.dynamic = (classref >> 2) & 1;
+
+            int membernum = classref >> 3;
+            result.classdef.members.reserve(membernum);
+
+            if (result.classdef.externalizable) {
+                throw std::runtime_error("Externalizable class is not supported");
+            }
+
+            result.classdef.name = ReadSolString(data, size, index, reftable);
+
+            for (int i = 0; i < membernum; ++i) {
+                result.classdef.members.push_back(ReadSolString(data, size, index, reftable));
+            }
+
+            reftable.classpool.push_back(result.classdef);
+        }
+
+        for (auto& member : result.classdef.members) {
+            SolType type = ReadSolType(data, size, index);
+            result.props[member] = ReadSolValue(data, size, index, reftable, type);
+        }
+
+        if (result.classdef.dynamic) {
+            std::string key;
+            while (!(key = ReadSolString(data, size, index, reftable)).empty()) {
+                SolType type = ReadSolType(data, size, index);
+                result.props[key] = ReadSolValue(data, size, index, reftable, type);
+            }
+        }
+
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    SolValue ReadSolValue(const uint8_t* data, int size, int& index, SolRefTable& reftable, SolType type)
+    {
+        switch (type)
+        {
+        case SolType::Undefined:
+            return SolValue(SolType::Undefined, nullptr);
+
+        case SolType::Null:
+            return nullptr;
+
+        case SolType::BooleanFalse:
+            return false;
+
+        case SolType::BooleanTrue:
+            return true;
+
+        case SolType::Integer:
+            return ReadSolInteger(data, size, index);
+
+        case SolType::Double:
+            return ReadDouble(data, size, index, static_cast<int>(SolType::Double));
+
+        case SolType::String:
+            return ReadSolString(data, size, index, reftable);
+
+        case SolType::XmlDoc:
+            return ReadSolXml(data, size, index, reftable, SolType::XmlDoc);
+
+        case SolType::Date:
+            return ReadSolDate(data, size, index, reftable);
+
+        case SolType::Array:
+            return ReadSolArray(data, size, index, reftable);
+
+        case SolType::Object:
+            return ReadSolObject(data, size, index, reftable);
+
+        case SolType::Xml:
+            return ReadSolXml(data, size, index, reftable, SolType::Xml);
+
+        case SolType::Binary:
+            return ReadSolBinary(data, size, index, reftable);
+
+        default:
+            ThrowUnknownType(static_cast<int>(type), index - 1);
+        }
+    }
+
+    sol::SolString ReadAMF0ShortString(const uint8_t* data, int size, int& index)
+    {
+        uint16_t len = ReadBigEndian<uint16_t>(data, size, index);
+
+        if (index + len > size) {
+            ThrowFileEndedImproperlyOnReadingType(static_cast<int>(AMF0Type::String));
+        }
+        if (len == 0) {
+            return std::string();
+        }
+
+        std::string result(data + index, data + index + len);
+        index += len;
+        return result;
+    }
+
+    sol::SolString ReadAMF0LongString(const uint8_t* data, int size, int& index)
+    {
+        int len = (int)ReadBigEndian<uint32_t>(data, size, index);
+
+        if (index + len > size) {
+            ThrowFileEndedImproperlyOnReadingType(static_cast<int>(AMF0Type::LongString));
+        }
+        if (len == 0) {
+            return std::string();
+        }
+
+        std::string result(data + index, data + index + len);
+        index += len;
+        return result;
+    }
+
+    SolValue ReadAMF0Date(const uint8_t* data, int size, int& index)
+    {
+        ReadBigEndian<int16_t>(data, size, index); // the time zone, unused
+        return SolValue(SolType::Date, ReadDouble(data, size, index, static_cast<int>(AMF0Type::Number)));
+    }
+
+    SolValue ReadAMF0Reference(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        uint16_t ref = ReadBigEndian<uint16_t>(data, size, index);
+        CheckRefIndex(reftable.objpool, ref);
+        return reftable.objpool[ref];
+    }
+
+    sol::SolArray ReadAMF0EcmaArray(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        uint32_t len = ReadBigEndian<uint32_t>(data, size, index);
+
+        sol::SolArray result;
+        std::string key;
+
+        for (uint32_t i = 0; i < len; ++i) {
+            key = ReadAMF0ShortString(data, size, index);
+            AMF0Type type = static_cast<AMF0Type>(ReadByte(data, size, index));
+            result.assoc[key] = ReadAMF0Value(data, size, index, reftable, type);
+        }
+
+        for (uint8_t mark : AMF0_OBJECT_ENDMARK) {
+            if (ReadByte(data, size, index) != mark) {
+                ThrowBadFormatOfType(AMF0Type::EcmaArray, index - 1, data[index - 1], mark);
+            }
+        }
+
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    sol::SolArray ReadAMF0StrictArray(const uint8_t* data, int size, int& index, SolRefTable& reftable)
+    {
+        uint32_t len = ReadBigEndian<uint32_t>(data, size, index);
+
+        sol::SolArray result;
+        result.dense.reserve(len);
+
+        for (uint32_t i = 0; i < len; ++i) {
+            AMF0Type type = static_cast<AMF0Type>(ReadByte(data, size, index));
+            result.dense.push_back(ReadAMF0Value(data, size, index, reftable, type));
+        }
+
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    sol::SolObject ReadAMF0Object(const uint8_t* data, int size, int& index, SolRefTable& reftable, AMF0Type objtype)
+    {
+        sol::SolObject result;
+        std::string key;
+
+        if (objtype == AMF0Type::TypedObject) {
+            result.classdef.name = ReadAMF0ShortString(data, size, index);
+        }
+
+        while (!(key = ReadAMF0ShortString(data, size, index)).empty()) {
+            AMF0Type type = static_cast<AMF0Type>(ReadByte(data, size, index));
+            result.props[key] = ReadAMF0Value(data, size, index, reftable, type);
+        }
+
+        if (static_cast<AMF0Type>(ReadByte(data, size, index)) != AMF0Type::ObjectEnd) {
+            ThrowBadFormatOfType(objtype, index - 1, data[index - 1], static_cast<int>(AMF0Type::ObjectEnd));
+        }
+
+        reftable.objpool.push_back(result);
+        return result;
+    }
+
+    SolValue ReadAMF0Value(const uint8_t* data, int size, int& index, SolRefTable& reftable, AMF0Type type)
+    {
+        switch (type)
+        {
+        case AMF0Type::Number:
+            return ReadDouble(data, size, index, static_cast<int>(AMF0Type::Number));
+
+        case AMF0Type::Boolean:
+            return ReadByte(data, size, index) != 0x00;
+
+        case AMF0Type::String:
+            return ReadAMF0ShortString(data, size, index);
+
+        case AMF0Type::Object:
+        case AMF0Type::TypedObject:
+            return ReadAMF0Object(data, size, index, reftable, type);
+
+        case AMF0Type::Null:
+            return nullptr;
+
+        case AMF0Type::Undefined:
+            return SolValue(SolType::Undefined, nullptr);
+
+        case AMF0Type::Reference:
+            return ReadAMF0Reference(data, size, index, reftable);
+
+        case AMF0Type::EcmaArray:
+            return ReadAMF0EcmaArray(data, size, index, reftable);
+
+        case AMF0Type::StrictArray:
+            return ReadAMF0StrictArray(data, size, index, reftable);
+
+        case AMF0Type::Date:
+            return ReadAMF0Date(data, size, index);
+
+        case AMF0Type::LongString:
+            return ReadAMF0LongString(data, size, index);
+
+        case AMF0Type::XMLDoc:
+            return SolValue(SolType::XmlDoc, ReadAMF0LongString(data, size, index));
+
+        default:
+            ThrowUnknownType(static_cast<int>(type), index - 1);
+        }
+    }
+
+    bool ReadWholeFile(const std::vector<uint8_t>& filecontent, sol::SolFile& file)
+    {
+        using sol::SolVersion;
+
+        try {
+            const uint8_t* data = filecontent.data();
+            int size = (int)filecontent.size();
+            int index = 0;
+
+            if (size < 18) {
+                file.errmsg = "File too small";
+                return false;
+            }
+
+            if (memcmp(data, SOL_MAGIC, 2) != 0) {
+                file.errmsg = "File magic mismatch";
+                return false;
+            }
+            index += 2;
+
+            uint32_t chunksize = ReadBigEndian<uint32_t>(data, size, index);
+
+            if (chunksize != static_cast<uint32_t>(size - 6)) {
+                file.errmsg = "Chunk size mismatch";
+                return false;
+            }
+
+            if (memcmp(data + index, SOL_CONSTANT, 10) != 0) {
+                file.errmsg = "File constant mismatch";
+                return false;
+            }
+            index += 10;
+
+            file.solname = ReadAMF0ShortString(data, size, index);
+            file.version = static_cast<SolVersion>(ReadBigEndian<uint32_t>(data, size, index));
+
+            std::string key;
+            SolRefTable reftable;
+
+            switch (file.version)
+            {
+            case SolVersion::AMF0:
+                while (index < size) {
+                    key = ReadAMF0ShortString(data, size, index);
+
+                    AMF0Type type = static_cast<AMF0Type>(ReadByte(data, size, index));
+                    file.data[key] = ReadAMF0Value(data, size, index, reftable, type);
+
+                    if (ReadByte(data, size, index) != 0x00) {
+                        ThrowEndRequired(index, data[index - 1]);
+                    }
+                }
+                return true;
+
+            case SolVersion::AMF3:
+                while (index < size) {
+                    key = ReadSolString(data, size, index, reftable);
+
+                    SolType type = ReadSolType(data, size, index);
+                    file.data[key] = ReadSolValue(data, size, index, reftable, type);
+
+                    if (ReadByte(data, size, index) != 0x00) {
+                        ThrowEndRequired(index, data[index - 1]);
+                    }
+                }
+                return true;
+
+            default:
+                file.errmsg = utils::FormatString("Unsupported version: %d", static_cast<int>(file.version));
+                return false;
+            }
+        }
+        catch (const std::exception& e) {
+            file.errmsg = e.what();
+            return false;
+        }
+    }
+}
+
+
+bool sol::bench::ReadSolDataBaseline(const std::vector<uint8_t>& filecontent, SolFile& file)
+{
+    return ReadWholeFile(filecontent, file);
+}
@@ -0,0 +1,15 @@
+#ifndef __BASELINE_H__
+#define __BASELINE_H__
+
+#include "../sol.h"
+
+namespace sol::bench
+{
+    // the reader the decoder replaced, kept as it was to measure against, it recurses
+    // once for each level of nesting, copies every container to the reference table
+    // with everything below it, and numbers a container as it ends rather than as it
+    // begins, so files with references can read differently, sets errmsg on failure
+    bool ReadSolDataBaseline(const std::vector<uint8_t>& filecontent, SolFile& file);
+}
+
+#endif // !__BASELINE_H__
@@ -0,0 +1,483 @@
+#include "generator.h"
+#include "../codec.h"
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+
+
+namespace
+{
+    using sol::bench::SolCorpusShape;
+
+    // xorshift64*, the standard engines are portable but their distributions are not
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) : _state(seed * 0x9E3779B97F4A7C15ull | 1) {}
+
+        uint64_t Next()
+        {
+            _state ^= _state >> 12;
+            _state ^= _state << 25;
+            _state ^= _state >> 27;
+            return _state * 0x2545F4914F6CDD1Dull;
+        }
+
+        uint32_t Below(uint32_t n)
+        {
+            return n ? static_cast<uint32_t>(Next() % n) : 0;
+        }
+
+        double Real()
+        {
+            return (Next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        bool Chance(double p)
+        {
+            return Real() < p;
+        }
+
+    private:
+        uint64_t _state;
+    };
+
+    struct CompletedObject
+    {
+        uint32_t index;
+        uint8_t marker;
+    };
+
+    class Generator
+    {
+    public:
+        explicit Generator(const SolCorpusShape& shape)
+            : _shape(shape), _random(shape.seed), _amf3(shape.version == sol::SolVersion::AMF3)
+        {
+        }
+
+        std::vector<uint8_t> Run()
+        {
+            _out.reserve(64 * 1024);
+            _out.insert(_out.end(), std::begin(sol::codec::SOL_MAGIC), std::end(sol::codec::SOL_MAGIC));
+            _out.insert(_out.end(), 4, 0);
+            _out.insert(_out.end(), std::begin(sol::codec::SOL_CONSTANT), std::end(sol::codec::SOL_CONSTANT));
+            AMF0String("bench");
+            sol::codec::AppendBigEndian(_out, static_cast<uint32_t>(_shape.version));
+
+            for (uint32_t i = 0; i < _shape.classes; ++i) {
+                NewClass();
+            }
+
+            std::vector<const std::string*> keys;
+            for (uint32_t i = 0; i < _shape.entries; ++i) {
+                const std::string& key = PickKey(keys);
+                if (_amf3) {
+                    AMF3String(key);
+                    AMF3Value(0, true);
+                }
+                else {
+                    AMF0String(key);
+                    AMF0Value(0, true);
+                }
+                _out.push_back(0x00);
+            }
+
+            sol::codec::StoreBigEndian(_out.data() + 2, static_cast<uint32_t>(_out.size() - 6));
+            return std::move(_out);
+        }
+
+    private:
+        struct ClassDef
+        {
+            std::string name;
+            std::vector<std::string> members;
+            int traitref = -1;  // AMF3 trait table index once written
+        };
+
+        const SolCorpusShape& _shape;
+        Random _random;
+        bool _amf3;
+        std::vector<uint8_t> _out;
+
+        std::deque<std::string> _strings;   // stable, keys in use are held by address
+        std::unordered_map<std::string, uint32_t> _strrefs;
+        std::vector<ClassDef> _classes;
+        uint32_t _traitcount = 0;
+        uint32_t _objcount = 0;
+        std::vector<CompletedObject> _completed;
+        uint64_t _unique = 0;
+
+        std::string UniqueString()
+        {
+            static const char letters[] = "abcdefghijklmnopqrstuvwxyz";
+            std::string result;
+            for (uint32_t i = 0, n = 2 + _random.Below(12); i < n; ++i) {
+                result.push_back(letters[_random.Below(26)]);
+            }
+            result.append(std::to_string(_unique++));
+            return result;
+        }
+
+        const std::string& NewString()
+        {
+            if (!_strings.empty() && _random.Chance(_shape.stringreuse)) {
+                return _strings[_random.Below(static_cast<uint32_t>(_strings.size()))];
+            }
+            _strings.push_back(UniqueString());
+            return _strings.back();
+        }
+
+        // a key not used yet by the container being written
+        const std::string& PickKey(std::vector<const std::string*>& used)
+        {
+            const std::string* key = &NewString();
+            auto taken = [&](const std::string* k) {
+                return std::any_of(used.begin(), used.end(), [&](const std::string* u) { return *u == *k; });
+            };
+            if (taken(key)) {
+                _strings.push_back(UniqueString());
+                key = &_strings.back();
+            }
+            used.push_back(key);
+            return *key;
+        }
+
+        void NewClass()
+        {
+            ClassDef classdef;
+            classdef.name = "bench.Class" + std::to_string(_classes.size());
+            std::vector<const std::string*> used;
+            for (uint32_t i = 0; i < _shape.fanout; ++i) {
+                classdef.members.push_back(PickKey(used));
+            }
+            _classes.push_back(std::move(classdef));
+        }
+
+        // picks a container completed earlier, if one should be referenced here
+        const CompletedObject* PickReference(uint32_t maxindex)
+        {
+            if (_completed.empty() || !_random.Chance(_shape.refdensity)) {
+                return nullptr;
+            }
+            const CompletedObject& obj = _completed[_random.Below(static_cast<uint32_t>(_completed.size()))];
+            return obj.index <= maxindex ? &obj : nullptr;
+        }
+
+        enum class Leaf
+        {
+            Integer,
+            Double,
+            String,
+            Boolean,
+            Null,
+            Date,
+            Numbers,
+            Binary,
+        };
+
+        Leaf PickLeaf()
+        {
+            if (_shape.arraylength && _random.Below(8) == 0) {
+                return Leaf::Numbers;
+            }
+            if (_shape.blobsize && _amf3 && _random.Below(8) == 0) {
+                return Leaf::Binary;
+            }
+            return static_cast<Leaf>(_random.Below(6));
+        }
+
+        // last tells whether the value is the last child of its container
+        bool IsContainer(uint32_t level, bool last)
+        {
+            if (level >= _shape.depth) {
+                return false;
+            }
+            if (level == 0) {
+                return true;
+            }
+            return _shape.chain ? last : _random.Below(2) == 0;
+        }
+
+        void Complete(uint32_t index, uint8_t marker)
+        {
+            _completed.push_back({ index, marker });
+        }
+
+        // AMF3
+
+        void AMF3String(const std::string& value)
+        {
+            if (value.empty()) {
+                sol::codec::AppendU29(_out, 1);
+                return;
+            }
+            auto [it, added] = _strrefs.emplace(value, static_cast<uint32_t>(_strrefs.size()));
+            if (!added) {
+                sol::codec::AppendU29(_out, it->second << 1);
+                return;
+            }
+            sol::codec::AppendU29Bytes(_out, static_cast<uint32_t>(value.size() << 1) | 1, value.data(), value.size());
+        }
+
+        void AMF3Integer(int32_t value)
+        {
+            _out.push_back(static_cast<uint8_t>(sol::SolType::Integer));
+            sol::codec::AppendU29(_out, static_cast<uint32_t>(value) & 0x1FFFFFFF);
+        }
+
+        void AMF3Value(uint32_t level, bool last)
+        {
+            if (IsContainer(level, last)) {
+                if (auto ref = PickReference(UINT32_MAX)) {
+                    _out.push_back(ref->marker);
+                    sol::codec::AppendU29(_out, ref->index << 1);
+                }
+                else if (_random.Below(5) < 3) {
+                    AMF3Object(level);
+                }
+                else {
+                    AMF3Array(level);
+                }
+                return;
+            }
+
+            switch (PickLeaf())
+            {
+            case Leaf::Integer:
+                AMF3Integer(static_cast<int32_t>(_random.Below(0x20000000)) - 0x10000000);
+                break;
+
+            case Leaf::Double:
+                _out.push_back(static_cast<uint8_t>(sol::SolType::Double));
+                sol::codec::AppendDouble(_out, _random.Real() * 1e6);
+                break;
+
+            case Leaf::String:
+                _out.push_back(static_cast<uint8_t>(sol::SolType::String));
+                AMF3String(NewString());
+                break;
+
+            case Leaf::Boolean:
+                _out.push_back(static_cast<uint8_t>(_random.Below(2) ? sol::SolType::BooleanTrue : sol::SolType::BooleanFalse));
+                break;
+
+            case Leaf::Null:
+                _out.push_back(static_cast<uint8_t>(sol::SolType::Null));
+                break;
+
+            case Leaf::Date:
+                _out.push_back(static_cast<uint8_t>(sol::SolType::Date));
+                sol::codec::AppendU29(_out, 1);
+                sol::codec::AppendDouble(_out, 1.5e12 + _random.Below(1000000000));
+                ++_objcount;
+                break;
+
+            case Leaf::Numbers: {
+                uint32_t index = _objcount++;
+                _out.push_back(static_cast<uint8_t>(sol::SolType::Array));
+                sol::codec::AppendU29(_out, (_shape.arraylength << 1) | 1);
+                AMF3String(std::string());
+                for (uint32_t i = 0; i < _shape.arraylength; ++i) {
+                    if (_random.Below(2)) {
+                        AMF3Integer(static_cast<int32_t>(_random.Below(100000)));
+                    }
+                    else {
+                        _out.push_back(static_cast<uint8_t>(sol::SolType::Double));
+                        sol::codec::AppendDouble(_out, _random.Real());
+                    }
+                }
+                Complete(index, static_cast<uint8_t>(sol::SolType::Array));
+                break;
+            }
+
+            case Leaf::Binary: {
+                std::vector<uint8_t> blob(_shape.blobsize);
+                for (auto& b : blob) {
+                    b = static_cast<uint8_t>(_random.Next());
+                }
+                _out.push_back(static_cast<uint8_t>(sol::SolType::Binary));
+                sol::codec::AppendU29Bytes(_out, (_shape.blobsize << 1) | 1, blob.data(), blob.size());
+                ++_objcount;
+                break;
+            }
+            }
+        }
+
+        void AMF3Object(uint32_t level)
+        {
+            uint32_t index = _objcount++;
+            _out.push_back(static_cast<uint8_t>(sol::SolType::Object));
+
+            // a quarter of the objects are anonymous and dynamic even with classes
+            ClassDef* classdef = _classes.empty() || _random.Below(4) == 0
+                ? nullptr : &_classes[_random.Below(static_cast<uint32_t>(_classes.size()))];
+
+            if (classdef && classdef->traitref >= 0) {
+                sol::codec::AppendU29(_out, (static_cast<uint32_t>(classdef->traitref) << 2) | 1);
+            }
+            else if (classdef) {
+                classdef->traitref = static_cast<int>(_traitcount++);
+                sol::codec::AppendU29(_out, (static_cast<uint32_t>(classdef->members.size()) << 4) | 0x03);
+                AMF3String(classdef->name);
+                for (auto& member : classdef->members) {
+                    AMF3String(member);
+                }
+            }
+            else {
+                // anonymous traits are written inline every time
+                ++_traitcount;
+                sol::codec::AppendU29(_out, 0x0B);
+                AMF3String(std::string());
+            }
+
+            if (classdef) {
+                for (size_t i = 0; i < classdef->members.size(); ++i) {
+                    AMF3Value(level + 1, i + 1 == classdef->members.size());
+                }
+            }
+            else {
+                std::vector<const std::string*> used;
+                for (uint32_t i = 0; i < _shape.fanout; ++i) {
+                    AMF3String(PickKey(used));
+                    AMF3Value(level + 1, i + 1 == _shape.fanout);
+                }
+                AMF3String(std::string());
+            }
+            Complete(index, static_cast<uint8_t>(sol::SolType::Object));
+        }
+
+        void AMF3Array(uint32_t level)
+        {
+            uint32_t index = _objcount++;
+            _out.push_back(static_cast<uint8_t>(sol::SolType::Array));
+            sol::codec::AppendU29(_out, (_shape.fanout << 1) | 1);
+            AMF3String(std::string());
+            for (uint32_t i = 0; i < _shape.fanout; ++i) {
+                AMF3Value(level + 1, i + 1 == _shape.fanout);
+            }
+            Complete(index, static_cast<uint8_t>(sol::SolType::Array));
+        }
+
+        // AMF0
+
+        void AMF0String(const std::string& value)
+        {
+            sol::codec::AppendBigEndianBytes(_out, static_cast<uint16_t>(value.size()), value.data(), value.size());
+        }
+
+        void AMF0Number(double value)
+        {
+            _out.push_back(static_cast<uint8_t>(sol::AMF0Type::Number));
+            sol::codec::AppendDouble(_out, value);
+        }
+
+        void AMF0Value(uint32_t level, bool last)
+        {
+            if (IsContainer(level, last)) {
+                if (auto ref = PickReference(UINT16_MAX)) {
+                    _out.push_back(static_cast<uint8_t>(sol::AMF0Type::Reference));
+                    sol::codec::AppendBigEndian(_out, static_cast<uint16_t>(ref->index));
+                }
+                else if (_random.Below(5) < 3) {
+                    AMF0Object(level);
+                }
+                else {
+                    AMF0Array(level);
+                }
+                return;
+            }
+
+            switch (PickLeaf())
+            {
+            case Leaf::Integer:
+                AMF0Number(static_cast<double>(_random.Below(1000000)));
+                break;
+
+            case Leaf::Double:
+                AMF0Number(_random.Real() * 1e6);
+                break;
+
+            case Leaf::String:
+                _out.push_back(static_cast<uint8_t>(sol::AMF0Type::String));
+                AMF0String(NewString());
+                break;
+
+            case Leaf::Boolean:
+                _out.push_back(static_cast<uint8_t>(sol::AMF0Type::Boolean));
+                _out.push_back(static_cast<uint8_t>(_random.Below(2)));
+                break;
+
+            case Leaf::Null:
+                _out.push_back(static_cast<uint8_t>(sol::AMF0Type::Null));
+                break;
+
+            case Leaf::Date:
+                // the timezone first, as the reader and writer have it
+                _out.push_back(static_cast<uint8_t>(sol::AMF0Type::Date));
+                sol::codec::AppendBigEndian(_out, static_cast<int16_t>(0));
+                sol::codec::AppendDouble(_out, 1.5e12 + _random.Below(1000000000));
+                break;
+
+            case Leaf::Numbers:
+            case Leaf::Binary: {
+                // binary is never picked for AMF0
+                uint32_t index = _objcount++;
+                _out.push_back(static_cast<uint8_t>(sol::AMF0Type::StrictArray));
+                sol::codec::AppendBigEndian(_out, _shape.arraylength);
+                for (uint32_t i = 0; i < _shape.arraylength; ++i) {
+                    AMF0Number(_random.Real());
+                }
+                Complete(index, static_cast<uint8_t>(sol::AMF0Type::StrictArray));
+                break;
+            }
+            }
+        }
+
+        void AMF0Object(uint32_t level)
+        {
+            uint32_t index = _objcount++;
+            const ClassDef* classdef = _classes.empty() || _random.Below(4) == 0
+                ? nullptr : &_classes[_random.Below(static_cast<uint32_t>(_classes.size()))];
+
+            std::vector<const std::string*> used;
+            if (classdef) {
+                _out.push_back(static_cast<uint8_t>(sol::AMF0Type::TypedObject));
+                AMF0String(classdef->name);
+                for (auto& member : classdef->members) {
+                    used.push_back(&member);
+                }
+            }
+            else {
+                _out.push_back(static_cast<uint8_t>(sol::AMF0Type::Object));
+                for (uint32_t i = 0; i < _shape.fanout; ++i) {
+                    PickKey(used);
+                }
+            }
+
+            for (size_t i = 0; i < used.size(); ++i) {
+                AMF0String(*used[i]);
+                AMF0Value(level + 1, i + 1 == used.size());
+            }
+            _out.insert(_out.end(), std::begin(sol::codec::AMF0_OBJECT_ENDMARK), std::end(sol::codec::AMF0_OBJECT_ENDMARK));
+            Complete(index, static_cast<uint8_t>(sol::AMF0Type::Object));
+        }
+
+        void AMF0Array(uint32_t level)
+        {
+            uint32_t index = _objcount++;
+            _out.push_back(static_cast<uint8_t>(sol::AMF0Type::StrictArray));
+            sol::codec::AppendBigEndian(_out, _shape.fanout);
+            for (uint32_t i = 0; i < _shape.fanout; ++i) {
+                AMF0Value(level + 1, i + 1 == _shape.fanout);
+            }
+            Complete(index, static_cast<uint8_t>(sol::AMF0Type::StrictArray));
+        }
+    };
+}
+
+
+std::vector<uint8_t> sol::bench::GenerateSolData(const SolCorpusShape& shape)
+{
+    return Generator(shape).Run();
+}
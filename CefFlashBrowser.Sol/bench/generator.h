@@ -0,0 +1,42 @@
+#ifndef __GENERATOR_H__
+#define __GENERATOR_H__
+
+#include "../sol.h"
+
+namespace sol::bench
+{
+    // the shape of a generated file, the same shape and seed always give the same bytes
+    struct SolCorpusShape
+    {
+        SolVersion version = SolVersion::AMF3;
+        uint64_t seed = 1;
+
+        // top level entries
+        uint32_t entries = 8;
+        // containers nested below each entry, and the children of each container
+        uint32_t depth = 4;
+        uint32_t fanout = 8;
+        // below the entry each container holds one container, its last child, and
+        // leaves otherwise, so that depth can be large without the size growing
+        // as fanout to the depth
+        bool chain = false;
+        // chance that a key or string value repeats one used before, which AMF3
+        // writes as a string reference
+        double stringreuse = 0.5;
+        // sealed classes objects are taken from, AMF3 writes each later use as a
+        // trait reference, 0 makes every object anonymous and dynamic
+        uint32_t classes = 8;
+        // chance that a container is a reference to one completed earlier
+        double refdensity = 0.05;
+        // bytes of each binary value, 0 for none, AMF0 has no binary type
+        uint32_t blobsize = 0;
+        // elements of each numeric array, 0 for none
+        uint32_t arraylength = 0;
+    };
+
+    // encodes a file of the given shape directly, references included,
+    // which WriteSolFile never produces
+    std::vector<uint8_t> GenerateSolData(const SolCorpusShape& shape);
+}
+
+#endif // !__GENERATOR_H__
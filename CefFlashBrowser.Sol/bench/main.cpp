@@ -0,0 +1,166 @@
+#include "suite.h"
+#include "../utils.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+
+// every allocation is counted for the allocations per node of each result
+static std::atomic<uint64_t> allocations{ 0 };
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+
+namespace
+{
+    void Usage()
+    {
+        std::cerr <<
+            "usage: solbench [--filter TEXT] [--mintime SECONDS] [--dir PATH] [--out FILE]\n"
+            "       solbench generate [--amf0] [--seed N] [--entries N] [--depth N] [--fanout N] [--chain]\n"
+            "                [--stringreuse P] [--classes N] [--refdensity P] [--blobsize N]\n"
+            "                [--arraylength N] FILE\n"
+            "\n"
+            "benchmarks are named BENCHMARK/SHAPE, or codec/PRIMITIVE for the microbenchmarks\n"
+            "of the byte level primitives, --filter runs those whose name contains TEXT, such\n"
+            "as codec/, read/ or /amf3-deep, a whole run takes a few minutes\n";
+    }
+
+    int Generate(int argc, char* argv[])
+    {
+        sol::bench::SolCorpusShape shape;
+        const char* path = nullptr;
+
+        for (int i = 2; i < argc; ++i) {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            if (std::strcmp(arg, "--amf0") == 0) {
+                shape.version = sol::SolVersion::AMF0;
+                continue;
+            }
+            if (std::strcmp(arg, "--chain") == 0) {
+                shape.chain = true;
+                continue;
+            }
+            if (arg[0] != '-') {
+                path = arg;
+                continue;
+            }
+            if (value == nullptr) {
+                Usage();
+                return 2;
+            }
+            ++i;
+
+            if (std::strcmp(arg, "--seed") == 0) shape.seed = std::strtoull(value, nullptr, 10);
+            else if (std::strcmp(arg, "--entries") == 0) shape.entries = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--depth") == 0) shape.depth = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--fanout") == 0) shape.fanout = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--stringreuse") == 0) shape.stringreuse = std::strtod(value, nullptr);
+            else if (std::strcmp(arg, "--classes") == 0) shape.classes = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--refdensity") == 0) shape.refdensity = std::strtod(value, nullptr);
+            else if (std::strcmp(arg, "--blobsize") == 0) shape.blobsize = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--arraylength") == 0) shape.arraylength = std::strtoul(value, nullptr, 10);
+            else {
+                Usage();
+                return 2;
+            }
+        }
+
+        if (path == nullptr) {
+            Usage();
+            return 2;
+        }
+        utils::WriteFile(path, sol::bench::GenerateSolData(shape));
+        return 0;
+    }
+
+    int Run(int argc, char* argv[])
+    {
+        sol::bench::SolBenchOptions options;
+        options.allocations = []() { return allocations.load(std::memory_order_relaxed); };
+        const char* out = nullptr;
+
+        for (int i = 1; i < argc; ++i) {
+            const char* arg = argv[i];
+            if (i + 1 >= argc) {
+                Usage();
+                return 2;
+            }
+            const char* value = argv[++i];
+
+            if (std::strcmp(arg, "--filter") == 0) options.filter = value;
+            else if (std::strcmp(arg, "--mintime") == 0) options.mintime = std::strtod(value, nullptr);
+            else if (std::strcmp(arg, "--dir") == 0) options.dir = value;
+            else if (std::strcmp(arg, "--out") == 0) out = value;
+            else {
+                Usage();
+                return 2;
+            }
+        }
+
+        std::ofstream file;
+        if (out) {
+            file.open(out, std::ios::app);
+            if (!file.is_open()) {
+                std::cerr << "Failed to open " << out << "\n";
+                return 1;
+            }
+        }
+
+        // json lines go to the file if there is one, a readable summary to the console
+        sol::bench::RunBenchmarks(options, [&](const sol::bench::SolBenchResult& result) {
+            std::string json = sol::bench::ToJson(result);
+            if (file.is_open()) {
+                file << json << "\n";
+                std::cout << utils::FormatString("%-32s %10.3f ms %9.1f MB/s %12.0f nodes/s %8.3f allocs/node\n",
+                    result.name.c_str(), result.seconds * 1e3, result.mbps(), result.nodesps(), result.allocs);
+            }
+            else {
+                std::cout << json << "\n";
+            }
+            std::cout.flush();
+        });
+        return 0;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    try {
+        if (argc > 1 && std::strcmp(argv[1], "generate") == 0) {
+            return Generate(argc, argv);
+        }
+        if (argc > 1 && (std::strcmp(argv[1], "--help") == 0 || std::strcmp(argv[1], "-h") == 0)) {
+            Usage();
+            return 0;
+        }
+        return Run(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,466 @@
+#include "suite.h"
+#include "baseline.h"
+#include "../codec.h"
+#include "../context.h"
+#include "../decoder.h"
+#include "../json.h"
+#include "../utils.h"
+#include "../validate.h"
+#include "../visit.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
+
+namespace
+{
+    using sol::bench::SolBenchOptions;
+    using sol::bench::SolBenchResult;
+
+    uint64_t CountNodes(const sol::SolFile& file)
+    {
+        uint64_t nodes = 0;
+        for (auto& [key, value] : file.data) {
+            sol::WalkSolValue(value, [&](const sol::SolValue&) { ++nodes; });
+        }
+        return nodes;
+    }
+
+    // runs one benchmark, bytes and nodes are those of the file it works on
+    template <typename TRun>
+    void Measure(const SolBenchOptions& options, const std::function<void(const SolBenchResult&)>& report,
+        const std::string& name, uint64_t bytes, uint64_t nodes, TRun&& run)
+    {
+        using clock = std::chrono::steady_clock;
+
+        if (name.find(options.filter) == std::string::npos) {
+            return;
+        }
+
+        // the first run warms the caches and the allocator, it is not counted
+        run();
+
+        std::vector<double> times;
+        uint64_t allocs = options.allocations ? options.allocations() : 0;
+        double total = 0;
+
+        while (times.size() < 3 || total < options.mintime) {
+            auto start = clock::now();
+            run();
+            times.push_back(std::chrono::duration<double>(clock::now() - start).count());
+            total += times.back();
+        }
+
+        SolBenchResult result;
+        result.name = name;
+        result.bytes = bytes;
+        result.nodes = nodes;
+        result.iterations = static_cast<uint32_t>(times.size());
+
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        result.seconds = times[times.size() / 2];
+
+        if (options.allocations && nodes) {
+            result.allocs = static_cast<double>(options.allocations() - allocs) / times.size() / nodes;
+        }
+        report(result);
+    }
+
+    void Check(bool ok, const std::string& what, const std::string& errmsg)
+    {
+        if (!ok) {
+            throw std::runtime_error(what + " failed: " + errmsg);
+        }
+    }
+
+    // values are counted per iteration of a microbenchmark, enough to hide the loop
+    constexpr size_t CODEC_VALUES = 64 * 1024;
+
+    // the results of the microbenchmarks go here so that their loops are kept
+    volatile uint64_t sink;
+
+    // values whose U29 encodings take 1 to 4 bytes, in random order
+    std::vector<uint32_t> U29Values(size_t count)
+    {
+        static const uint32_t masks[] = { 0x7F, 0x3FFF, 0x1FFFFF, 0x1FFFFFFF };
+        std::vector<uint32_t> values(count);
+        uint32_t x = 0x12345678;
+
+        for (auto& value : values) {
+            x = x * 1664525 + 1013904223;
+            value = (x >> 3) & masks[x >> 30];
+        }
+        return values;
+    }
+
+    template <typename T>
+    void RunBigEndian(const SolBenchOptions& options, const std::function<void(const SolBenchResult&)>& report,
+        const std::vector<uint32_t>& values)
+    {
+        std::string bits = std::to_string(sizeof(T) * 8);
+        std::vector<uint8_t> data(values.size() * sizeof(T));
+        for (size_t i = 0; i < values.size(); ++i) {
+            sol::codec::StoreBigEndian(data.data() + i * sizeof(T), static_cast<T>(values[i]));
+        }
+        std::vector<uint8_t> out(data.size());
+        std::vector<uint8_t> buffer;
+
+        Measure(options, report, "codec/load-be" + bits, data.size(), values.size(), [&]() {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < values.size(); ++i) {
+                sum += sol::codec::LoadBigEndian<T>(data.data() + i * sizeof(T));
+            }
+            sink = sum;
+        });
+
+        Measure(options, report, "codec/store-be" + bits, data.size(), values.size(), [&]() {
+            for (size_t i = 0; i < values.size(); ++i) {
+                sol::codec::StoreBigEndian(out.data() + i * sizeof(T), static_cast<T>(values[i]));
+            }
+            sink = out[out.size() / 2];
+        });
+
+        Measure(options, report, "codec/append-be" + bits, data.size(), values.size(), [&]() {
+            buffer.clear();
+            for (uint32_t value : values) {
+                sol::codec::AppendBigEndian(buffer, static_cast<T>(value));
+            }
+            sink = buffer.size();
+        });
+    }
+
+    // each primitive of codec.h and the checked reads of decoder.h on its own
+    void RunCodec(const SolBenchOptions& options, const std::function<void(const SolBenchResult&)>& report)
+    {
+        std::vector<uint32_t> values = U29Values(CODEC_VALUES);
+        std::vector<uint8_t> u29;
+        for (uint32_t value : values) {
+            sol::codec::AppendU29(u29, value);
+        }
+        std::vector<uint8_t> doubles(values.size() * 8);
+        for (size_t i = 0; i < values.size(); ++i) {
+            sol::codec::StoreDouble(doubles.data() + i * 8, values[i] * 0.37);
+        }
+
+        std::vector<uint8_t> out(values.size() * 8);
+        std::vector<uint8_t> buffer;
+        uint64_t count = values.size();
+
+        Measure(options, report, "codec/decode-u29", u29.size(), count, [&]() {
+            const uint8_t* p = u29.data();
+            const uint8_t* end = p + u29.size();
+            uint64_t sum = 0;
+            uint32_t value = 0;
+            while (p < end) {
+                p += sol::codec::DecodeU29(p, end - p, value);
+                sum += value;
+            }
+            sink = sum;
+        });
+
+        Measure(options, report, "codec/encode-u29", u29.size(), count, [&]() {
+            uint8_t* p = out.data();
+            for (uint32_t value : values) {
+                p += sol::codec::EncodeU29(p, value);
+            }
+            sink = p - out.data();
+        });
+
+        Measure(options, report, "codec/append-u29", u29.size(), count, [&]() {
+            buffer.clear();
+            for (uint32_t value : values) {
+                sol::codec::AppendU29(buffer, value);
+            }
+            sink = buffer.size();
+        });
+
+        RunBigEndian<uint16_t>(options, report, values);
+        RunBigEndian<uint32_t>(options, report, values);
+
+        Measure(options, report, "codec/load-double", doubles.size(), count, [&]() {
+            double sum = 0;
+            for (size_t i = 0; i < values.size(); ++i) {
+                sum += sol::codec::LoadDouble(doubles.data() + i * 8);
+            }
+            sink = static_cast<uint64_t>(sum);
+        });
+
+        Measure(options, report, "codec/store-double", doubles.size(), count, [&]() {
+            for (size_t i = 0; i < values.size(); ++i) {
+                sol::codec::StoreDouble(out.data() + i * 8, values[i] * 0.37);
+            }
+            sink = out[out.size() / 2];
+        });
+
+        Measure(options, report, "codec/append-double", doubles.size(), count, [&]() {
+            buffer.clear();
+            for (uint32_t value : values) {
+                sol::codec::AppendDouble(buffer, value * 0.37);
+            }
+            sink = buffer.size();
+        });
+
+        // short strings as keys mostly are, with their length headers
+        static const char text[] = "abcdefghijklmnop";
+        Measure(options, report, "codec/append-u29-bytes", values.size() * 9, count, [&]() {
+            buffer.clear();
+            for (uint32_t value : values) {
+                size_t len = value & 15;
+                sol::codec::AppendU29Bytes(buffer, static_cast<uint32_t>(len << 1 | 1), text, len);
+            }
+            sink = buffer.size();
+        });
+
+        Measure(options, report, "codec/append-be16-bytes", values.size() * 10, count, [&]() {
+            buffer.clear();
+            for (uint32_t value : values) {
+                size_t len = value & 15;
+                sol::codec::AppendBigEndianBytes(buffer, static_cast<uint16_t>(len), text, len);
+            }
+            sink = buffer.size();
+        });
+
+        // the decoder's reads, which check the remaining size once per value
+        sol::SolError error;
+        sol::SolReadOptions readoptions;
+
+        Measure(options, report, "codec/read-byte", u29.size(), u29.size(), [&]() {
+            sol::detail::Reader r(u29.data(), u29.size(), 0, error, readoptions);
+            uint64_t sum = 0;
+            uint8_t value;
+            while (sol::detail::DecodeByte(r, value)) {
+                sum += value;
+            }
+            sink = sum;
+        });
+
+        Measure(options, report, "codec/read-integer", u29.size(), count, [&]() {
+            sol::detail::Reader r(u29.data(), u29.size(), 0, error, readoptions);
+            uint64_t sum = 0;
+            sol::SolInteger value;
+            while (r.index < r.size && sol::detail::DecodeInteger(r, value)) {
+                sum += value;
+            }
+            sink = sum;
+        });
+
+        Measure(options, report, "codec/read-be32", doubles.size(), doubles.size() / 4, [&]() {
+            sol::detail::Reader r(doubles.data(), doubles.size(), 0, error, readoptions);
+            uint64_t sum = 0;
+            uint32_t value;
+            while (sol::detail::DecodeBigEndian(r, value)) {
+                sum += value;
+            }
+            sink = sum;
+        });
+
+        Measure(options, report, "codec/read-double", doubles.size(), count, [&]() {
+            sol::detail::Reader r(doubles.data(), doubles.size(), 0, error, readoptions);
+            double sum = 0;
+            double value;
+            while (sol::detail::DecodeDouble(r, value, sol::SolType::Double)) {
+                sum += value;
+            }
+            sink = static_cast<uint64_t>(sum);
+        });
+    }
+
+    void RunShape(const SolBenchOptions& options, const std::function<void(const SolBenchResult&)>& report,
+        const std::string& shapename, const sol::bench::SolCorpusShape& shape, const std::filesystem::path& dir)
+    {
+        std::vector<uint8_t> data = sol::bench::GenerateSolData(shape);
+        std::string path = (dir / (shapename + ".sol")).string();
+        std::string outpath = (dir / (shapename + ".out.sol")).string();
+        utils::WriteFile(path, data);
+
+        sol::SolError error;
+        sol::SolFile file;
+        file.path = outpath;
+        Check(sol::TryReadSolData(data.data(), data.size(), file, error), "Reading " + shapename, error.message());
+
+        uint64_t bytes = data.size();
+        uint64_t nodes = CountNodes(file);
+
+        Measure(options, report, "probe/" + shapename, bytes, nodes, [&]() {
+            sol::ValidateSolData(data.data(), data.size(), error);
+        });
+
+        Measure(options, report, "read/" + shapename, bytes, nodes, [&]() {
+            sol::SolFile result;
+            sol::TryReadSolData(data.data(), data.size(), result, error);
+        });
+
+        // the old reader numbers references as containers end, so it reads only the
+        // shapes without them as they were written
+        sol::SolFile baseline;
+        if (sol::bench::ReadSolDataBaseline(data, baseline) && baseline.data == file.data) {
+            Measure(options, report, "read-baseline/" + shapename, bytes, nodes, [&]() {
+                sol::SolFile result;
+                sol::bench::ReadSolDataBaseline(data, result);
+            });
+        }
+
+        sol::SolReaderContext reader;
+        Measure(options, report, "read-context/" + shapename, bytes, nodes, [&]() {
+            sol::SolFile result;
+            result.path = path;
+            reader.tryread(result, error);
+        });
+
+        Measure(options, report, "write/" + shapename, bytes, nodes, [&]() {
+            Check(sol::WriteSolFile(file), "Writing " + shapename, file.errmsg);
+        });
+
+        sol::SolWriterContext writer;
+        Measure(options, report, "write-context/" + shapename, bytes, nodes, [&]() {
+            Check(writer.write(file), "Writing " + shapename, file.errmsg);
+        });
+
+        // 1, 2, 4 and one thread per core, to show how the parallel writer scales
+        std::vector<unsigned> sweep{ 1, 2, 4 };
+        unsigned cores = std::thread::hardware_concurrency();
+        if (cores > 4) {
+            sweep.push_back(cores);
+        }
+        for (unsigned threads : sweep) {
+            sol::SolWriteOptions parallel;
+            parallel.threads = threads;
+            auto reportthreads = [&](const SolBenchResult& result) {
+                SolBenchResult copy = result;
+                copy.threads = threads;
+                report(copy);
+            };
+            Measure(options, reportthreads, "write-parallel-" + std::to_string(threads) + "/" + shapename, bytes, nodes, [&]() {
+                Check(sol::WriteSolFile(file, parallel), "Writing " + shapename, file.errmsg);
+            });
+        }
+
+        Measure(options, report, "roundtrip/" + shapename, bytes, nodes, [&]() {
+            sol::SolFile result;
+            result.path = outpath;
+            sol::TryReadSolData(data.data(), data.size(), result, error);
+            Check(sol::WriteSolFile(result), "Writing " + shapename, result.errmsg);
+        });
+
+        sol::SolReadOptions keepraw;
+        keepraw.keepraw = true;
+        Measure(options, report, "roundtrip-raw/" + shapename, bytes, nodes, [&]() {
+            sol::SolFile result;
+            result.path = outpath;
+            sol::TryReadSolData(data.data(), data.size(), result, error, keepraw);
+            Check(sol::WriteSolFile(result), "Writing " + shapename, result.errmsg);
+        });
+
+        // AMF0 has no binary, so files with binary values are only converted to AMF3
+        sol::SolFile converted = file;
+        converted.version = shape.version == sol::SolVersion::AMF0 ? sol::SolVersion::AMF3 : sol::SolVersion::AMF0;
+        if (sol::WriteSolFile(converted)) {
+            Measure(options, report, "convert/" + shapename, bytes, nodes, [&]() {
+                sol::SolFile result;
+                result.path = outpath;
+                sol::TryReadSolData(data.data(), data.size(), result, error);
+                result.version = converted.version;
+                Check(sol::WriteSolFile(result), "Converting " + shapename, result.errmsg);
+            });
+        }
+
+        // both ways through memory, bytes and nodes are still those of the sol file
+        std::ostringstream json;
+        Check(sol::TranscodeSolToJson(data.data(), data.size(), json, error), "Transcoding " + shapename, error.message());
+        std::string text = json.str();
+
+        Measure(options, report, "to-json/" + shapename, bytes, nodes, [&]() {
+            std::ostringstream out;
+            sol::TranscodeSolToJson(data.data(), data.size(), out, error);
+        });
+
+        std::string errmsg;
+        Measure(options, report, "from-json/" + shapename, bytes, nodes, [&]() {
+            std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+            Check(sol::TranscodeJsonToSol(text.data(), text.size(), out, errmsg), "Transcoding " + shapename, errmsg);
+        });
+
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::filesystem::remove(outpath, ec);
+    }
+}
+
+
+std::vector<std::pair<std::string, sol::bench::SolCorpusShape>> sol::bench::DefaultShapes()
+{
+    std::vector<std::pair<std::string, SolCorpusShape>> shapes;
+
+    auto add = [&](const std::string& name, SolVersion version, uint32_t entries, uint32_t depth) -> SolCorpusShape& {
+        SolCorpusShape shape;
+        shape.version = version;
+        shape.entries = entries;
+        shape.depth = depth;
+        shapes.emplace_back(name, shape);
+        return shapes.back().second;
+    };
+
+    add("amf0-small", SolVersion::AMF0, 8, 2);
+    add("amf0-medium", SolVersion::AMF0, 16, 4);
+    add("amf0-numeric", SolVersion::AMF0, 16, 2).arraylength = 1024;
+    add("amf3-small", SolVersion::AMF3, 8, 2);
+    add("amf3-medium", SolVersion::AMF3, 16, 4);
+    add("amf3-large", SolVersion::AMF3, 32, 6);
+    add("amf3-numeric", SolVersion::AMF3, 16, 2).arraylength = 1024;
+    add("amf3-blobs", SolVersion::AMF3, 16, 3).blobsize = 4096;
+
+    // many large entries, what the parallel writer is for
+    add("amf0-wide", SolVersion::AMF0, 128, 4);
+    add("amf3-wide", SolVersion::AMF3, 128, 4);
+
+    SolCorpusShape& shared = add("amf3-shared", SolVersion::AMF3, 16, 4);
+    shared.stringreuse = 0.9;
+    shared.refdensity = 0.3;
+
+    SolCorpusShape& unique = add("amf3-unique", SolVersion::AMF3, 16, 4);
+    unique.stringreuse = 0;
+    unique.classes = 0;
+    unique.refdensity = 0;
+
+    // chains of containers 128 deep, read-baseline copies each container to the
+    // reference table with everything below it, which grows as depth squared
+    for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+        SolCorpusShape& deep = add(version == SolVersion::AMF0 ? "amf0-deep" : "amf3-deep", version, 16, 128);
+        deep.fanout = 4;
+        deep.chain = true;
+        deep.refdensity = 0;
+    }
+
+    return shapes;
+}
+
+void sol::bench::RunBenchmarks(const SolBenchOptions& options, const std::function<void(const SolBenchResult&)>& report)
+{
+    std::filesystem::path dir = options.dir.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path(options.dir);
+
+    RunCodec(options, report);
+
+    for (auto& [name, shape] : DefaultShapes()) {
+        RunShape(options, report, name, shape, dir);
+    }
+}
+
+std::string sol::bench::ToJson(const SolBenchResult& result)
+{
+    std::string name;
+    for (char c : result.name) {
+        if (c == '"' || c == '\\') {
+            name.push_back('\\');
+        }
+        name.push_back(c);
+    }
+    std::string allocs = result.allocs < 0 ? "null" : utils::FormatString("%.4f", result.allocs);
+
+    return utils::FormatString(
+        "{\"name\":\"%s\",\"bytes\":%llu,\"nodes\":%llu,\"iterations\":%u,\"seconds\":%.9g,"
+        "\"mb_per_s\":%.3f,\"nodes_per_s\":%.0f,\"allocs_per_node\":%s,\"threads\":%u}",
+        name.c_str(), static_cast<unsigned long long>(result.bytes), static_cast<unsigned long long>(result.nodes),
+        result.iterations, result.seconds, result.mbps(), result.nodesps(), allocs.c_str(), result.threads);
+}
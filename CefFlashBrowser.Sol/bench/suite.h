@@ -0,0 +1,52 @@
+#ifndef __SUITE_H__
+#define __SUITE_H__
+
+#include "generator.h"
+#include <functional>
+#include <utility>
+
+namespace sol::bench
+{
+    struct SolBenchResult
+    {
+        std::string name;       // benchmark/shape, e.g. read/amf3-medium, or codec/primitive
+        uint64_t bytes = 0;     // size of the encoded file
+        uint64_t nodes = 0;     // values in the decoded file
+        uint32_t iterations = 0;
+        double seconds = 0;     // median time of one iteration
+        double allocs = -1;     // allocations per node, -1 if they are not counted
+        unsigned threads = 1;   // threads the benchmark ran on
+
+        double mbps() const { return bytes / seconds / 1e6; }
+        double nodesps() const { return nodes / seconds; }
+    };
+
+
+    struct SolBenchOptions
+    {
+        // each benchmark runs at least this long and at least three times
+        double mintime = 0.5;
+        // only benchmarks whose name contains this are run
+        std::string filter;
+        // where the files read and written go, the temp directory if empty
+        std::string dir;
+        // returns the allocations made so far, set by a runner that counts them
+        uint64_t(*allocations)() = nullptr;
+    };
+
+
+    // the shapes the suite runs on, by name
+    std::vector<std::pair<std::string, SolCorpusShape>> DefaultShapes();
+
+    // runs a microbenchmark of each codec primitive, named codec/..., then on every
+    // shape probe, read, read-baseline, read-context, write, write-context,
+    // write-parallel-N for each thread count, roundtrip, roundtrip-raw, convert,
+    // to-json and from-json, read-baseline only on the shapes without references,
+    // report is called as each result is ready
+    void RunBenchmarks(const SolBenchOptions& options, const std::function<void(const SolBenchResult&)>& report);
+
+    // the result as one line of JSON, so that runs can be appended to one file
+    std::string ToJson(const SolBenchResult& result);
+}
+
+#endif // !__SUITE_H__
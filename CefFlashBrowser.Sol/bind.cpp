@@ -0,0 +1,1207 @@
+#include "bind.h"
+#include "encoder.h"
+#include "utils.h"
+#include <algorithm>
+
+
+namespace
+{
+    using sol::detail::ReadFrameState;
+
+    bool IsObjectMarker(uint8_t marker, bool amf0)
+    {
+        if (amf0) {
+            auto type = static_cast<sol::AMF0Type>(marker);
+            return type == sol::AMF0Type::Object || type == sol::AMF0Type::TypedObject || type == sol::AMF0Type::EcmaArray;
+        }
+        auto type = static_cast<sol::SolType>(marker);
+        return type == sol::SolType::Object || type == sol::SolType::Array;
+    }
+
+    bool IsArrayMarker(uint8_t marker, bool amf0)
+    {
+        if (amf0) {
+            auto type = static_cast<sol::AMF0Type>(marker);
+            return type == sol::AMF0Type::StrictArray || type == sol::AMF0Type::EcmaArray;
+        }
+        return static_cast<sol::SolType>(marker) == sol::SolType::Array;
+    }
+
+    // the key of an ecma array entry as a dense index, flash writes arrays that way in AMF0
+    bool ParseIndex(std::string_view key, size_t& index)
+    {
+        if (key.empty() || key.size() > 9 || (key[0] == '0' && key.size() > 1)) {
+            return false;
+        }
+
+        index = 0;
+        for (char c : key) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            index = index * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    std::string_view ViewOf(const uint8_t* data, size_t index, size_t len)
+    {
+        return std::string_view(reinterpret_cast<const char*>(data + index - len), len);
+    }
+}
+
+
+sol::detail::BindReader::BindReader(Reader& r)
+    : _r(r), _skipper{ r }
+{
+    _skipper.table.record = true;
+}
+
+bool sol::detail::BindReader::ReadHeader(std::string_view& solname, SolVersion& version)
+{
+    if (!_skipper.SkipSolHeader(solname, version)) {
+        return false;
+    }
+    _amf0 = version == SolVersion::AMF0;
+    return true;
+}
+
+bool sol::detail::BindReader::NextEntry(std::string_view& key, uint8_t& marker, bool& more)
+{
+    more = false;
+    if (_r.index >= _r.size) {
+        return true;
+    }
+
+    if (_amf0) {
+        size_t len;
+        if (!_skipper.SkipAMF0ShortString(len)) {
+            return false;
+        }
+        key = ViewOf(_r.data, _r.index, len);
+    }
+    else {
+        bool empty;
+        if (!_skipper.SkipString(empty, &key)) {
+            return false;
+        }
+    }
+
+    if (!DecodeByte(_r, marker)) {
+        return false;
+    }
+    more = true;
+    return true;
+}
+
+bool sol::detail::BindReader::EndEntry()
+{
+    uint8_t marker;
+    if (!DecodeByte(_r, marker)) {
+        return false;
+    }
+    if (marker != 0x00) {
+        return _r.Fail(SolErrorCode::EndRequired, _r.index - 1, -1, false, marker, 0);
+    }
+    return true;
+}
+
+size_t sol::detail::BindReader::offset() const
+{
+    return _r.index - 1;
+}
+
+bool sol::detail::BindReader::IsNull(uint8_t marker) const
+{
+    if (_amf0) {
+        return marker == static_cast<uint8_t>(AMF0Type::Null) || marker == static_cast<uint8_t>(AMF0Type::Undefined);
+    }
+    return marker == static_cast<uint8_t>(SolType::Null) || marker == static_cast<uint8_t>(SolType::Undefined);
+}
+
+bool sol::detail::BindReader::Mismatch(uint8_t marker, size_t offset)
+{
+    return _r.Fail(SolErrorCode::TypeMismatch, offset, marker, _amf0);
+}
+
+bool sol::detail::BindReader::Skip(uint8_t marker)
+{
+    return _amf0
+        ? _skipper.SkipAMF0Value(static_cast<AMF0Type>(marker))
+        : _skipper.SkipValue(static_cast<SolType>(marker));
+}
+
+bool sol::detail::BindReader::ReadBoolean(uint8_t marker, bool& out)
+{
+    if (_amf0) {
+        if (marker != static_cast<uint8_t>(AMF0Type::Boolean)) {
+            return Mismatch(marker, offset());
+        }
+        uint8_t value;
+        if (!DecodeByte(_r, value)) {
+            return false;
+        }
+        out = value != 0;
+        return true;
+    }
+
+    switch (static_cast<SolType>(marker))
+    {
+    case SolType::BooleanFalse:
+        out = false;
+        return true;
+
+    case SolType::BooleanTrue:
+        out = true;
+        return true;
+
+    default:
+        return Mismatch(marker, offset());
+    }
+}
+
+bool sol::detail::BindReader::ReadNumber(uint8_t marker, double& out)
+{
+    if (_amf0) {
+        if (marker != static_cast<uint8_t>(AMF0Type::Number)) {
+            return Mismatch(marker, offset());
+        }
+        return DecodeDouble(_r, out, AMF0Type::Number);
+    }
+
+    switch (static_cast<SolType>(marker))
+    {
+    case SolType::Integer: {
+        SolInteger value;
+        if (!DecodeInteger(_r, value)) {
+            return false;
+        }
+        out = value;
+        return true;
+    }
+
+    case SolType::Double:
+        return DecodeDouble(_r, out, SolType::Double);
+
+    default:
+        return Mismatch(marker, offset());
+    }
+}
+
+bool sol::detail::BindReader::ReadString(uint8_t marker, std::string_view& out)
+{
+    if (!_amf0) {
+        if (marker != static_cast<uint8_t>(SolType::String)) {
+            return Mismatch(marker, offset());
+        }
+        bool empty;
+        return _skipper.SkipString(empty, &out);
+    }
+
+    size_t len;
+
+    switch (static_cast<AMF0Type>(marker))
+    {
+    case AMF0Type::String:
+        if (!_skipper.SkipAMF0ShortString(len)) {
+            return false;
+        }
+        break;
+
+    case AMF0Type::LongString: {
+        uint32_t value;
+        if (!DecodeBigEndian(_r, value) || !_skipper.SkipPayload(value, AMF0Type::LongString)) {
+            return false;
+        }
+        len = value;
+        break;
+    }
+
+    default:
+        return Mismatch(marker, offset());
+    }
+
+    out = ViewOf(_r.data, _r.index, len);
+    return true;
+}
+
+bool sol::detail::BindReader::ReadBinary(uint8_t marker, std::string_view& out)
+{
+    if (_amf0 || marker != static_cast<uint8_t>(SolType::Binary)) {
+        return Mismatch(marker, offset());
+    }
+
+    size_t at = offset();
+    size_t start = _r.index;
+    SolInteger ref;
+    if (!DecodeInteger(_r, ref, true)) {
+        return false;
+    }
+
+    if ((ref & 1) == 0) {
+        // the referenced binary was checked when it was read, only its header is decoded again
+        auto& table = _skipper.table;
+        if (!_skipper.CheckRef(ref >> 1, table.objects, start)) {
+            return false;
+        }
+
+        size_t resume = _r.index;
+        _r.index = table.objpool[ref >> 1];
+        if (_r.data[_r.index] != marker) {
+            return Mismatch(_r.data[_r.index], _r.index);
+        }
+        ++_r.index;
+        DecodeInteger(_r, ref, true);
+
+        out = ViewOf(_r.data, _r.index + (ref >> 1), ref >> 1);
+        _r.index = resume;
+        return true;
+    }
+
+    size_t len = ref >> 1;
+    if (!_skipper.SkipPayload(len, SolType::Binary)) {
+        return false;
+    }
+    _skipper.AddObject(at);
+    out = ViewOf(_r.data, _r.index, len);
+    return true;
+}
+
+bool sol::detail::BindReader::Enter(BindFrame& frame)
+{
+    if (_skipper.depth >= _r.options.maxdepth) {
+        return _r.Fail(SolErrorCode::MaxDepthExceeded, _r.index, -1, false, 0, _r.options.maxdepth);
+    }
+    ++_skipper.depth;
+    frame.resume = SIZE_MAX;
+    return true;
+}
+
+bool sol::detail::BindReader::Leave(BindFrame& frame, bool& more)
+{
+    --_skipper.depth;
+    more = false;
+
+    if (frame.resume != SIZE_MAX) {
+        Rewind({ frame.resume, frame.strings, frame.objects, frame.classes });
+    }
+    return true;
+}
+
+bool sol::detail::BindReader::Replay(BindFrame& frame, size_t ref, size_t start)
+{
+    auto& table = _skipper.table;
+    if (!_skipper.CheckRef(ref, table.objects, start)) {
+        return false;
+    }
+
+    // a container referring to itself is read again until maxdepth stops it
+    frame.resume = _r.index;
+    frame.strings = table.strings;
+    frame.objects = table.objects;
+    frame.classes = table.classes.size();
+    _r.index = table.objpool[ref] + 1;
+    return true;
+}
+
+bool sol::detail::BindReader::BeginContainer(uint8_t& marker, BindFrame& frame, uint32_t& header, size_t& start, size_t& at)
+{
+    at = offset();
+    start = _r.index;
+
+    if (_amf0) {
+        if (marker == static_cast<uint8_t>(AMF0Type::Reference)) {
+            uint16_t ref;
+            if (!DecodeBigEndian(_r, ref) || !Replay(frame, ref, start)) {
+                return false;
+            }
+            at = offset();
+            start = _r.index;
+            marker = _r.data[at];
+        }
+        return true;
+    }
+
+    SolInteger ref;
+    if (!DecodeInteger(_r, ref, true)) {
+        return false;
+    }
+    if ((ref & 1) == 0) {
+        if (!Replay(frame, ref >> 1, start)) {
+            return false;
+        }
+        at = offset();
+        start = _r.index;
+        marker = _r.data[at];
+        // only inline containers are in the table, the header was read before
+        DecodeInteger(_r, ref, true);
+    }
+    header = ref >> 1;
+    return true;
+}
+
+bool sol::detail::BindReader::BeginObject(uint8_t marker, BindFrame& frame)
+{
+    bool reference = _amf0 && marker == static_cast<uint8_t>(AMF0Type::Reference);
+    if (!reference && !IsObjectMarker(marker, _amf0)) {
+        return Mismatch(marker, offset());
+    }
+
+    uint32_t header;
+    size_t start;
+    size_t at;
+    if (!Enter(frame) || !BeginContainer(marker, frame, header, start, at)) {
+        return false;
+    }
+    if (!IsObjectMarker(marker, _amf0)) {
+        return Mismatch(marker, at);
+    }
+    return BeginObjectFrame(marker, frame, header, start, at);
+}
+
+bool sol::detail::BindReader::BeginObjectFrame(uint8_t marker, BindFrame& frame, uint32_t header, size_t start, size_t at)
+{
+    frame.at = at;
+    frame.flag = false;
+    frame.remaining = 0;
+    frame.count = 0;
+
+    if (_amf0) {
+        size_t len;
+
+        switch (static_cast<AMF0Type>(marker))
+        {
+        case AMF0Type::TypedObject:
+            if (!_skipper.SkipAMF0ShortString(len)) {
+                return false;
+            }
+            [[fallthrough]];
+
+        case AMF0Type::Object:
+            frame.state = ReadFrameState::AMF0Object;
+            break;
+
+        default: {
+            uint32_t count;
+            if (!DecodeBigEndian(_r, count) || !_skipper.CheckCount(count, 3, AMF0Type::EcmaArray)) {
+                return false;
+            }
+            frame.state = ReadFrameState::AMF0EcmaArray;
+            frame.remaining = count;
+            break;
+        }
+        }
+
+        _skipper.AddObject(at);
+        return true;
+    }
+
+    if (marker == static_cast<uint8_t>(SolType::Array)) {
+        if (!_skipper.CheckCount(header, 1, SolType::Array)) {
+            return false;
+        }
+        _skipper.AddObject(at);
+        frame.state = ReadFrameState::ArrayAssoc;
+        frame.remaining = header;
+        return true;
+    }
+
+    if (!_skipper.SkipTraits(header, start, frame.classindex)) {
+        return false;
+    }
+    auto& traits = _skipper.table.classes[frame.classindex];
+
+    _skipper.AddObject(at);
+    frame.state = ReadFrameState::ObjectSealed;
+    frame.flag = traits.dynamic;
+    frame.count = traits.members;
+    return true;
+}
+
+bool sol::detail::BindReader::NextMember(BindFrame& frame, std::string_view& key, uint8_t& marker, bool& more)
+{
+    bool empty;
+    size_t len;
+
+    switch (frame.state)
+    {
+    case ReadFrameState::ArrayAssoc:
+        if (!_skipper.SkipString(empty, &key)) {
+            return false;
+        }
+        if (!empty) {
+            break;
+        }
+        // dense elements have no key to bind to
+        for (; frame.remaining > 0; --frame.remaining) {
+            if (!DecodeByte(_r, marker) || !Skip(marker)) {
+                return false;
+            }
+        }
+        return Leave(frame, more);
+
+    case ReadFrameState::ObjectSealed:
+        if (frame.remaining < frame.count) {
+            key = _skipper.table.MemberName(_skipper.table.classes[frame.classindex], frame.remaining++);
+            break;
+        }
+        if (!frame.flag) {
+            return Leave(frame, more);
+        }
+        frame.state = ReadFrameState::ObjectDynamic;
+        [[fallthrough]];
+
+    case ReadFrameState::ObjectDynamic:
+        if (!_skipper.SkipString(empty, &key)) {
+            return false;
+        }
+        if (empty) {
+            return Leave(frame, more);
+        }
+        break;
+
+    case ReadFrameState::AMF0Object: {
+        if (!_skipper.SkipAMF0ShortString(len)) {
+            return false;
+        }
+        if (len != 0) {
+            key = ViewOf(_r.data, _r.index, len);
+            break;
+        }
+        uint8_t end;
+        if (!DecodeByte(_r, end)) {
+            return false;
+        }
+        if (end != static_cast<uint8_t>(AMF0Type::ObjectEnd)) {
+            return _r.Fail(SolErrorCode::BadFormat, _r.index - 1, static_cast<int>(AMF0Type::Object), true,
+                end, static_cast<int>(AMF0Type::ObjectEnd));
+        }
+        return Leave(frame, more);
+    }
+
+    case ReadFrameState::AMF0EcmaArray:
+        if (frame.remaining > 0) {
+            --frame.remaining;
+            if (!_skipper.SkipAMF0ShortString(len)) {
+                return false;
+            }
+            key = ViewOf(_r.data, _r.index, len);
+            break;
+        }
+        return ReadEcmaEnd() && Leave(frame, more);
+
+    default:
+        return Leave(frame, more);
+    }
+
+    return ReadMarker(marker, more);
+}
+
+bool sol::detail::BindReader::BeginArray(uint8_t marker, BindFrame& frame)
+{
+    bool reference = _amf0 && marker == static_cast<uint8_t>(AMF0Type::Reference);
+    if (!reference && !IsArrayMarker(marker, _amf0)) {
+        return Mismatch(marker, offset());
+    }
+
+    uint32_t header;
+    size_t start;
+    size_t at;
+    if (!Enter(frame) || !BeginContainer(marker, frame, header, start, at)) {
+        return false;
+    }
+    if (!IsArrayMarker(marker, _amf0)) {
+        return Mismatch(marker, at);
+    }
+
+    frame.at = at;
+    if (_amf0) {
+        bool ecma = marker == static_cast<uint8_t>(AMF0Type::EcmaArray);
+        uint32_t count;
+        if (!DecodeBigEndian(_r, count) || !_skipper.CheckCount(count, ecma ? 3 : 1, static_cast<AMF0Type>(marker))) {
+            return false;
+        }
+        _skipper.AddObject(at);
+        frame.state = ecma ? ReadFrameState::AMF0EcmaArray : ReadFrameState::AMF0StrictArray;
+        frame.remaining = count;
+        frame.count = count;
+        return true;
+    }
+
+    if (!_skipper.CheckCount(header, 1, SolType::Array)) {
+        return false;
+    }
+    _skipper.AddObject(at);
+
+    // assoc entries have no index to bind to
+    for (;;) {
+        bool empty;
+        std::string_view key;
+        if (!_skipper.SkipString(empty, &key)) {
+            return false;
+        }
+        if (empty) {
+            break;
+        }
+        if (!DecodeByte(_r, marker) || !Skip(marker)) {
+            return false;
+        }
+    }
+
+    frame.state = ReadFrameState::ArrayDense;
+    frame.remaining = header;
+    frame.count = header;
+    return true;
+}
+
+bool sol::detail::BindReader::NextElement(BindFrame& frame, size_t& index, uint8_t& marker, bool& more)
+{
+    if (frame.state != ReadFrameState::AMF0EcmaArray) {
+        if (frame.remaining == 0) {
+            return Leave(frame, more);
+        }
+        index = frame.count - frame.remaining--;
+        return ReadMarker(marker, more);
+    }
+
+    // keys that are not indices below the length, such as "length", are skipped
+    for (; frame.remaining > 0; ) {
+        --frame.remaining;
+
+        size_t len;
+        if (!_skipper.SkipAMF0ShortString(len) || !ReadMarker(marker, more)) {
+            return false;
+        }
+        if (ParseIndex(ViewOf(_r.data, _r.index - 1, len), index) && index < frame.count) {
+            return true;
+        }
+        if (!Skip(marker)) {
+            return false;
+        }
+    }
+
+    return ReadEcmaEnd() && Leave(frame, more);
+}
+
+bool sol::detail::BindReader::IsContainer(uint8_t marker) const
+{
+    return IsObjectMarker(marker, _amf0) || IsArrayMarker(marker, _amf0)
+        || (_amf0 && marker == static_cast<uint8_t>(AMF0Type::Reference));
+}
+
+bool sol::detail::BindReader::BeginChildren(uint8_t marker, BindFrame& frame)
+{
+    if (!IsContainer(marker)) {
+        return Mismatch(marker, offset());
+    }
+
+    uint32_t header;
+    size_t start;
+    size_t at;
+    if (!Enter(frame) || !BeginContainer(marker, frame, header, start, at)) {
+        return false;
+    }
+    if (!IsObjectMarker(marker, _amf0) && !IsArrayMarker(marker, _amf0)) {
+        return Mismatch(marker, at);
+    }
+
+    bool indexed = _amf0 ? marker == static_cast<uint8_t>(AMF0Type::StrictArray) : marker == static_cast<uint8_t>(SolType::Array);
+    if (!indexed) {
+        return BeginObjectFrame(marker, frame, header, start, at);
+    }
+
+    frame.at = at;
+    frame.flag = false;
+
+    if (_amf0) {
+        uint32_t count;
+        if (!DecodeBigEndian(_r, count) || !_skipper.CheckCount(count, 1, AMF0Type::StrictArray)) {
+            return false;
+        }
+        frame.state = ReadFrameState::AMF0StrictArray;
+        frame.remaining = count;
+        frame.count = count;
+    }
+    else {
+        if (!_skipper.CheckCount(header, 1, SolType::Array)) {
+            return false;
+        }
+        frame.state = ReadFrameState::ArrayAssoc;
+        frame.remaining = header;
+        frame.count = header;
+    }
+
+    _skipper.AddObject(at);
+    return true;
+}
+
+bool sol::detail::BindReader::NextChild(BindFrame& frame, std::string_view& key, size_t& index, bool& dense, uint8_t& marker, bool& more)
+{
+    dense = false;
+
+    switch (frame.state)
+    {
+    case ReadFrameState::ArrayAssoc: {
+        bool empty;
+        if (!_skipper.SkipString(empty, &key)) {
+            return false;
+        }
+        if (!empty) {
+            return ReadMarker(marker, more);
+        }
+        frame.state = ReadFrameState::ArrayDense;
+        [[fallthrough]];
+    }
+
+    case ReadFrameState::ArrayDense:
+    case ReadFrameState::AMF0StrictArray:
+        dense = true;
+        return NextElement(frame, index, marker, more);
+
+    default:
+        return NextMember(frame, key, marker, more);
+    }
+}
+
+bool sol::detail::BindReader::ReadValue(uint8_t marker, SolValue& out)
+{
+    if (!_r.Charge(1, 0)) {
+        return false;
+    }
+
+    size_t at = offset();
+    std::string_view text;
+
+    if (_amf0) {
+        switch (static_cast<AMF0Type>(marker))
+        {
+        case AMF0Type::Number: {
+            double value;
+            if (!DecodeDouble(_r, value, AMF0Type::Number)) {
+                return false;
+            }
+            out = value;
+            return true;
+        }
+
+        case AMF0Type::Boolean: {
+            bool value;
+            if (!ReadBoolean(marker, value)) {
+                return false;
+            }
+            out = value;
+            return true;
+        }
+
+        case AMF0Type::String:
+        case AMF0Type::LongString:
+            if (!ReadString(marker, text) || !_r.Charge(0, text.size())) {
+                return false;
+            }
+            out = std::string(text);
+            return true;
+
+        case AMF0Type::XMLDoc: {
+            uint32_t len;
+            if (!DecodeBigEndian(_r, len) || !_skipper.SkipPayload(len, AMF0Type::XMLDoc) || !_r.Charge(0, len)) {
+                return false;
+            }
+            out = SolValue(SolType::XmlDoc, std::string(ViewOf(_r.data, _r.index, len)));
+            return true;
+        }
+
+        case AMF0Type::Null:
+            out = nullptr;
+            return true;
+
+        case AMF0Type::Undefined:
+            out = SolValue(SolType::Undefined, nullptr);
+            return true;
+
+        case AMF0Type::Date:
+            // 16 bit timezone, unused, then the timestamp
+            if (10 > _r.size - _r.index) {
+                return _r.Truncated(AMF0Type::Date);
+            }
+            out = SolValue(SolType::Date, codec::LoadDouble(_r.data + _r.index + 2));
+            _r.index += 10;
+            return true;
+
+        case AMF0Type::Reference: {
+            size_t start = _r.index;
+            uint16_t ref;
+            return DecodeBigEndian(_r, ref) && ReadReference(ref, start, out);
+        }
+
+        case AMF0Type::Object:
+        case AMF0Type::TypedObject:
+        case AMF0Type::EcmaArray:
+        case AMF0Type::StrictArray:
+            return ReadContainer(marker, out);
+
+        default:
+            // fails as the skipper does on the types there is nothing to read for
+            return Skip(marker);
+        }
+    }
+
+    auto type = static_cast<SolType>(marker);
+
+    switch (type)
+    {
+    case SolType::Undefined:
+        out = SolValue(SolType::Undefined, nullptr);
+        return true;
+
+    case SolType::Null:
+        out = nullptr;
+        return true;
+
+    case SolType::BooleanFalse:
+    case SolType::BooleanTrue:
+        out = type == SolType::BooleanTrue;
+        return true;
+
+    case SolType::Integer: {
+        SolInteger value;
+        if (!DecodeInteger(_r, value)) {
+            return false;
+        }
+        out = value;
+        return true;
+    }
+
+    case SolType::Double: {
+        double value;
+        if (!DecodeDouble(_r, value, SolType::Double)) {
+            return false;
+        }
+        out = value;
+        return true;
+    }
+
+    case SolType::String:
+        if (!ReadString(marker, text) || !_r.Charge(0, text.size())) {
+            return false;
+        }
+        out = std::string(text);
+        return true;
+
+    case SolType::XmlDoc:
+    case SolType::Xml:
+    case SolType::Date:
+    case SolType::Binary: {
+        size_t start = _r.index;
+        SolInteger ref;
+        if (!DecodeInteger(_r, ref, true)) {
+            return false;
+        }
+        if ((ref & 1) == 0) {
+            return ReadReference(ref >> 1, start, out);
+        }
+
+        if (type == SolType::Date) {
+            double value;
+            if (!DecodeDouble(_r, value, SolType::Double)) {
+                return false;
+            }
+            out = SolValue(SolType::Date, value);
+        }
+        else {
+            size_t len = ref >> 1;
+            if (!_skipper.SkipPayload(len, type) || !_r.Charge(0, len)) {
+                return false;
+            }
+            if (type == SolType::Binary) {
+                out = SolBinary(_r.data + _r.index - len, _r.data + _r.index);
+            }
+            else {
+                out = SolValue(type, std::string(ViewOf(_r.data, _r.index, len)));
+            }
+        }
+        _skipper.AddObject(at);
+        return true;
+    }
+
+    case SolType::Array:
+    case SolType::Object:
+    case SolType::Dictionary: {
+        size_t start = _r.index;
+        SolInteger ref;
+        if (!DecodeInteger(_r, ref, true)) {
+            return false;
+        }
+        if ((ref & 1) == 0) {
+            return ReadReference(ref >> 1, start, out);
+        }
+        _r.index = start;
+        return type == SolType::Dictionary ? ReadDictionary(marker, out) : ReadContainer(marker, out);
+    }
+
+    default:
+        return Skip(marker);
+    }
+}
+
+// the referenced value is read again where it was encoded
+bool sol::detail::BindReader::ReadReference(size_t ref, size_t start, SolValue& out)
+{
+    auto& table = _skipper.table;
+    if (!_skipper.CheckRef(ref, table.objects, start)) {
+        return false;
+    }
+
+    size_t at = table.objpool[ref];
+    if (std::find(_open.begin(), _open.end(), at) != _open.end()) {
+        out = SolValue();
+        return true;
+    }
+
+    BindMark mark = Mark();
+    _r.index = at + 1;
+    bool result = ReadValue(_r.data[at], out);
+    Rewind(mark);
+    return result;
+}
+
+bool sol::detail::BindReader::ReadContainer(uint8_t marker, SolValue& out)
+{
+    BindFrame frame;
+    if (!BeginChildren(marker, frame)) {
+        return false;
+    }
+
+    bool array;
+    if (_amf0) {
+        array = marker != static_cast<uint8_t>(AMF0Type::Object) && marker != static_cast<uint8_t>(AMF0Type::TypedObject);
+    }
+    else {
+        array = marker == static_cast<uint8_t>(SolType::Array);
+    }
+
+    if (array) {
+        out = SolArray();
+    }
+    else {
+        SolObject result;
+        if (!_amf0) {
+            auto& table = _skipper.table;
+            auto& traits = table.classes[frame.classindex];
+            auto names = table.names.begin() + traits.names;
+            result.classdef.dynamic = traits.dynamic;
+            result.classdef.name.assign(*names);
+            result.classdef.members.assign(names + 1, names + 1 + traits.members);
+        }
+        else if (marker == static_cast<uint8_t>(AMF0Type::TypedObject)) {
+            uint16_t len = codec::LoadBigEndian<uint16_t>(_r.data + frame.at + 1);
+            result.classdef.name.assign(ViewOf(_r.data, frame.at + 3 + len, len));
+        }
+        out = std::move(result);
+    }
+
+    _open.push_back(frame.at);
+
+    bool result = true;
+    for (;;) {
+        std::string_view key;
+        size_t index;
+        bool dense;
+        bool more;
+        SolValue child;
+        if (!NextChild(frame, key, index, dense, marker, more) || (more && !ReadValue(marker, child))) {
+            result = false;
+            break;
+        }
+        if (!more) {
+            break;
+        }
+
+        if (dense) {
+            out.get<SolArray>().dense.push_back(std::move(child));
+        }
+        else if (array) {
+            out.get<SolArray>().assoc[std::string(key)] = std::move(child);
+        }
+        else {
+            out.get<SolObject>().props[std::string(key)] = std::move(child);
+        }
+    }
+
+    _open.pop_back();
+    return result;
+}
+
+bool sol::detail::BindReader::ReadDictionary(uint8_t marker, SolValue& out)
+{
+    BindFrame frame;
+    if (!Enter(frame)) {
+        return false;
+    }
+
+    // the header was checked to be inline by the caller
+    size_t at = offset();
+    SolInteger ref;
+    if (!DecodeInteger(_r, ref, true)) {
+        return false;
+    }
+
+    uint32_t count = ref >> 1;
+    uint8_t weakkeys;
+    if (!DecodeByte(_r, weakkeys) || !_skipper.CheckCount(count, 2, SolType::Dictionary)) {
+        return false;
+    }
+    _skipper.AddObject(at);
+
+    SolDictionary result;
+    result.weakkeys = weakkeys != 0x00;
+    result.reserve(count);
+
+    _open.push_back(at);
+    for (uint32_t i = 0; i < count; ++i) {
+        SolValue key;
+        SolValue value;
+        if (!DecodeByte(_r, marker) || !ReadValue(marker, key) || !DecodeByte(_r, marker) || !ReadValue(marker, value)) {
+            _open.pop_back();
+            return false;
+        }
+        result[key] = std::move(value);
+    }
+    _open.pop_back();
+
+    out = std::move(result);
+    bool more;
+    return Leave(frame, more);
+}
+
+sol::detail::BindMark sol::detail::BindReader::Mark() const
+{
+    auto& table = _skipper.table;
+    return { _r.index, table.strings, table.objects, table.classes.size() };
+}
+
+void sol::detail::BindReader::Rewind(const BindMark& mark)
+{
+    auto& table = _skipper.table;
+    table.strings = mark.strings;
+    table.objects = mark.objects;
+    table.strpool.resize(mark.strings);
+    table.objpool.resize(mark.objects);
+    table.DropClasses(mark.classes);
+    _r.index = mark.index;
+}
+
+bool sol::detail::BindReader::ReadEcmaEnd()
+{
+    for (uint8_t mark : codec::AMF0_OBJECT_ENDMARK) {
+        uint8_t read;
+        if (!DecodeByte(_r, read)) {
+            return false;
+        }
+        if (read != mark) {
+            return _r.Fail(SolErrorCode::BadFormat, _r.index - 1, static_cast<int>(AMF0Type::EcmaArray), true, read, mark);
+        }
+    }
+    return true;
+}
+
+bool sol::detail::BindReader::ReadMarker(uint8_t& marker, bool& more)
+{
+    if (!DecodeByte(_r, marker)) {
+        return false;
+    }
+    more = true;
+    return true;
+}
+
+sol::detail::BindWriter::BindWriter(std::vector<uint8_t>& buffer, SolVersion version)
+    : _buffer(buffer), _version(version)
+{
+}
+
+bool sol::detail::BindWriter::amf0() const
+{
+    return _version == SolVersion::AMF0;
+}
+
+void sol::detail::BindWriter::Entry(const std::string& key)
+{
+    if (amf0()) {
+        WriteAMF0ShortString(_buffer, key);
+    }
+    else {
+        WriteSolString(_buffer, key, _reftable);
+    }
+}
+
+void sol::detail::BindWriter::EndEntry()
+{
+    _buffer.push_back(0x00);
+}
+
+void sol::detail::BindWriter::Null()
+{
+    if (amf0()) {
+        WriteAMF0Type(_buffer, AMF0Type::Null);
+    }
+    else {
+        WriteSolType(_buffer, SolType::Null);
+    }
+}
+
+void sol::detail::BindWriter::Boolean(bool value)
+{
+    if (amf0()) {
+        WriteAMF0Type(_buffer, AMF0Type::Boolean);
+        WriteAMF0Boolean(_buffer, value);
+    }
+    else {
+        WriteSolType(_buffer, value ? SolType::BooleanTrue : SolType::BooleanFalse);
+    }
+}
+
+void sol::detail::BindWriter::Number(double value)
+{
+    if (amf0()) {
+        WriteAMF0Type(_buffer, AMF0Type::Number);
+        WriteAMF0Number(_buffer, value);
+    }
+    else {
+        WriteSolType(_buffer, SolType::Double);
+        WriteSolDouble(_buffer, value);
+    }
+}
+
+void sol::detail::BindWriter::Integer(int64_t value)
+{
+    // AMF3 integers are 29 bits, larger ones are written as doubles as flash does
+    if (amf0() || value < -0x10000000 || value >= 0x10000000) {
+        Number(static_cast<double>(value));
+        return;
+    }
+    WriteSolType(_buffer, SolType::Integer);
+    WriteSolInteger(_buffer, static_cast<SolInteger>(value));
+}
+
+void sol::detail::BindWriter::String(const std::string& value)
+{
+    if (!amf0()) {
+        WriteSolType(_buffer, SolType::String);
+        WriteSolString(_buffer, value, _reftable);
+    }
+    else if (value.size() > codec::AMF0_SHORTSTRING_MAXLEN) {
+        WriteAMF0Type(_buffer, AMF0Type::LongString);
+        WriteAMF0LongString(_buffer, value);
+    }
+    else {
+        WriteAMF0Type(_buffer, AMF0Type::String);
+        WriteAMF0ShortString(_buffer, value);
+    }
+}
+
+void sol::detail::BindWriter::Binary(const SolBinary& value)
+{
+    if (amf0()) {
+        throw std::runtime_error("Binary is not supported by AMF0");
+    }
+    WriteSolType(_buffer, SolType::Binary);
+    WriteSolBinary(_buffer, value, _reftable);
+}
+
+void sol::detail::BindWriter::BeginArray(size_t count)
+{
+    if (count > UINT32_MAX) {
+        throw std::runtime_error("Array too long");
+    }
+    ++_reftable.objcount;
+
+    if (amf0()) {
+        WriteAMF0Type(_buffer, AMF0Type::StrictArray);
+        codec::AppendBigEndian(_buffer, static_cast<uint32_t>(count));
+    }
+    else {
+        WriteSolType(_buffer, SolType::Array);
+        codec::AppendU29(_buffer, static_cast<uint32_t>(count << 1) | 1);
+        WriteSolString(_buffer, std::string(), _reftable);
+    }
+}
+
+void sol::detail::BindWriter::BeginObject(const SolClassDef& classdef)
+{
+    ++_reftable.objcount;
+
+    if (!amf0()) {
+        WriteSolType(_buffer, SolType::Object);
+        WriteSolTraits(_buffer, classdef, _reftable);
+    }
+    else if (classdef.name.empty()) {
+        WriteAMF0Type(_buffer, AMF0Type::Object);
+    }
+    else {
+        WriteAMF0Type(_buffer, AMF0Type::TypedObject);
+        WriteAMF0ShortString(_buffer, classdef.name);
+    }
+}
+
+void sol::detail::BindWriter::Key(const std::string& key)
+{
+    Entry(key);
+}
+
+void sol::detail::BindWriter::EndObject(const SolClassDef& classdef)
+{
+    if (amf0()) {
+        _buffer.insert(_buffer.end(), std::begin(codec::AMF0_OBJECT_ENDMARK), std::end(codec::AMF0_OBJECT_ENDMARK));
+    }
+    else if (classdef.dynamic) {
+        WriteSolString(_buffer, std::string(), _reftable);
+    }
+}
+
+bool sol::detail::ReadBoundData(const uint8_t* data, size_t size, SolFile& file, SolError& error,
+    const SolReadOptions& options, const std::function<bool(BindReader&)>& read)
+{
+    error = SolError();
+
+    Reader r{ data, size, 0, error, options };
+    BindReader br(r);
+
+    std::string_view solname;
+    SolVersion version;
+    if (!br.ReadHeader(solname, version)) {
+        return false;
+    }
+    file.solname.assign(solname);
+    file.version = version;
+    return read(br);
+}
+
+bool sol::detail::ReadBoundFile(SolFile& file, SolError& error,
+    const SolReadOptions& options, const std::function<bool(BindReader&)>& read)
+{
+    error = SolError();
+
+    utils::MappedFile filecontent;
+    if (!filecontent.open(file.path)) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
+    }
+    return ReadBoundData(filecontent.data(), filecontent.size(), file, error, options, read);
+}
+
+bool sol::detail::WriteBoundFile(SolFile& file, const std::function<void(BindWriter&)>& write)
+{
+    try {
+        std::vector<uint8_t> buffer;
+        WriteSolHeader(buffer, file.solname, file.version);
+
+        BindWriter bw(buffer, file.version);
+        write(bw);
+
+        FinishSolFile(buffer, file.path);
+        return true;
+    }
+    catch (const std::exception& e) {
+        file.errmsg = e.what();
+        return false;
+    }
+}
@@ -0,0 +1,607 @@
+#ifndef __BIND_H__
+#define __BIND_H__
+
+#include "sol.h"
+#include "skipper.h"
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <tuple>
+
+namespace sol
+{
+    // the fields of a struct bound to AMF objects, specialized for each struct as
+    //
+    //     template <>
+    //     struct sol::SolFields<Player>
+    //     {
+    //         static constexpr std::string_view classname = "Player";     // optional
+    //         static constexpr auto fields = std::make_tuple(
+    //             sol::SolField("name", &Player::name),
+    //             sol::SolField("level", &Player::level));
+    //     };
+    //
+    // a field is a bool, a number, a std::string, a SolBinary, a std::vector, a
+    // std::map<std::string, T>, a std::optional or another bound struct, keys are
+    // matched by name, so sealed members, dynamic properties and AMF0 keys bind the
+    // same way, keys without a field are skipped and fields without a key, or with
+    // a null value, keep what they had
+    template <typename T>
+    struct SolFields;
+
+    template <typename TClass, typename TMember>
+    struct SolFieldDef
+    {
+        std::string_view name;
+        TMember TClass::* member;
+    };
+
+    template <typename TClass, typename TMember>
+    constexpr SolFieldDef<TClass, TMember> SolField(std::string_view name, TMember TClass::* member)
+    {
+        return { name, member };
+    }
+}
+
+
+namespace sol::detail
+{
+    // a container being bound, objects and maps give keys, arrays give indices
+    struct BindFrame
+    {
+        ReadFrameState state;
+        bool flag;              // dynamic class for AMF3 objects
+        uint32_t remaining;
+        uint32_t count;         // sealed members, or array length
+        size_t classindex;
+        size_t at;              // the marker of the container, where it was encoded for a reference
+
+        // a referenced container is read again where it was encoded, reading goes on
+        // at resume afterwards and the tables are cut back to the sizes they had
+        size_t resume;
+        size_t strings;
+        size_t objects;
+        size_t classes;
+    };
+
+
+    // where a reader was, to read a value again from there
+    struct BindMark
+    {
+        size_t index;
+        size_t strings;
+        size_t objects;
+        size_t classes;
+    };
+
+
+    // reads values straight from the encoded bytes into bound fields, the reference
+    // tables hold views of the input, so the input has to outlive the reader
+    class BindReader
+    {
+    public:
+        explicit BindReader(Reader& r);
+
+        BindReader(const BindReader&) = delete;
+        BindReader& operator=(const BindReader&) = delete;
+
+        bool ReadHeader(std::string_view& solname, sol::SolVersion& version);
+
+        // more is false at the end of the file
+        bool NextEntry(std::string_view& key, uint8_t& marker, bool& more);
+        bool EndEntry();
+
+        // the offset of the marker of the value about to be read
+        size_t offset() const;
+
+        bool IsNull(uint8_t marker) const;
+        bool Mismatch(uint8_t marker, size_t offset);
+        bool Skip(uint8_t marker);
+
+        bool ReadBoolean(uint8_t marker, bool& out);
+        bool ReadNumber(uint8_t marker, double& out);
+        bool ReadString(uint8_t marker, std::string_view& out);
+        bool ReadBinary(uint8_t marker, std::string_view& out);
+
+        // more is false once the container is done
+        bool BeginObject(uint8_t marker, BindFrame& frame);
+        bool NextMember(BindFrame& frame, std::string_view& key, uint8_t& marker, bool& more);
+
+        bool BeginArray(uint8_t marker, BindFrame& frame);
+        bool NextElement(BindFrame& frame, size_t& index, uint8_t& marker, bool& more);
+
+        // objects and arrays alike, an array gives its keys and then its dense elements,
+        // with dense set, a dictionary is keyed by values and gives no children
+        bool IsContainer(uint8_t marker) const;
+        bool BeginChildren(uint8_t marker, BindFrame& frame);
+        bool NextChild(BindFrame& frame, std::string_view& key, size_t& index, bool& dense, uint8_t& marker, bool& more);
+
+        // reads the value as TryReadSolData would, charged against maxnodes and maxbytes,
+        // a reference to a container still being read is null, as the decoder leaves it
+        bool ReadValue(uint8_t marker, sol::SolValue& out);
+
+        // the reader as it is after a marker, rewinding reads the value after it again
+        BindMark Mark() const;
+        void Rewind(const BindMark& mark);
+
+    private:
+        bool Enter(BindFrame& frame);
+        bool Leave(BindFrame& frame, bool& more);
+        bool Replay(BindFrame& frame, size_t ref, size_t start);
+        bool BeginContainer(uint8_t& marker, BindFrame& frame, uint32_t& header, size_t& start, size_t& at);
+        bool BeginObjectFrame(uint8_t marker, BindFrame& frame, uint32_t header, size_t start, size_t at);
+        bool ReadReference(size_t ref, size_t start, sol::SolValue& out);
+        bool ReadContainer(uint8_t marker, sol::SolValue& out);
+        bool ReadDictionary(uint8_t marker, sol::SolValue& out);
+        bool ReadMarker(uint8_t& marker, bool& more);
+        bool ReadEcmaEnd();
+
+        Reader& _r;
+        Skipper _skipper;
+        bool _amf0 = false;
+        std::vector<size_t> _open;  // containers ReadValue is in the middle of
+    };
+
+
+    // writes bound fields with the writer primitives, without building values
+    class BindWriter
+    {
+    public:
+        BindWriter(std::vector<uint8_t>& buffer, sol::SolVersion version);
+
+        BindWriter(const BindWriter&) = delete;
+        BindWriter& operator=(const BindWriter&) = delete;
+
+        bool amf0() const;
+
+        void Entry(const std::string& key);
+        void EndEntry();
+
+        void Null();
+        void Boolean(bool value);
+        void Number(double value);
+        void Integer(int64_t value);
+        void String(const std::string& value);
+        void Binary(const sol::SolBinary& value);
+
+        void BeginArray(size_t count);
+
+        // an AMF3 class without a name is written as a dynamic Object, as the
+        // flash player does, a key is written before each value unless sealed
+        void BeginObject(const sol::SolClassDef& classdef);
+        void Key(const std::string& key);
+        void EndObject(const sol::SolClassDef& classdef);
+
+    private:
+        std::vector<uint8_t>& _buffer;
+        sol::SolVersion _version;
+        sol::SolWriteRefTable _reftable;
+    };
+
+
+    bool ReadBoundData(const uint8_t* data, size_t size, sol::SolFile& file, sol::SolError& error,
+        const sol::SolReadOptions& options, const std::function<bool(BindReader&)>& read);
+
+    bool ReadBoundFile(sol::SolFile& file, sol::SolError& error,
+        const sol::SolReadOptions& options, const std::function<bool(BindReader&)>& read);
+
+    // sets file.errmsg if write throws
+    bool WriteBoundFile(sol::SolFile& file, const std::function<void(BindWriter&)>& write);
+
+
+    template <typename T, typename = void>
+    struct IsBound : std::false_type {};
+
+    template <typename T>
+    struct IsBound<T, std::void_t<decltype(sol::SolFields<T>::fields)>> : std::true_type {};
+
+    template <typename T, typename = void>
+    struct HasClassName : std::false_type {};
+
+    template <typename T>
+    struct HasClassName<T, std::void_t<decltype(sol::SolFields<T>::classname)>> : std::true_type {};
+
+    template <typename T>
+    struct IsOptional : std::false_type {};
+
+    template <typename T>
+    struct IsOptional<std::optional<T>> : std::true_type {};
+
+    template <typename T, typename = void>
+    struct SolBinder
+    {
+        static_assert(IsBound<T>::value, "No binding for this type, specialize sol::SolFields for it");
+    };
+
+    template <typename T>
+    bool ReadBound(BindReader& br, uint8_t marker, T& out)
+    {
+        if (br.IsNull(marker)) {
+            if constexpr (IsOptional<T>::value) {
+                out.reset();
+            }
+            return true;
+        }
+        return SolBinder<T>::Read(br, marker, out);
+    }
+
+    template <typename T>
+    void WriteBound(BindWriter& bw, const T& value)
+    {
+        SolBinder<T>::Write(bw, value);
+    }
+
+    // the class a bound struct is written with, and the names of its fields in order
+    struct BoundClass
+    {
+        sol::SolClassDef classdef;
+        std::vector<std::string> names;
+    };
+
+    template <typename T>
+    const BoundClass& GetBoundClass()
+    {
+        static const BoundClass bound = [] {
+            BoundClass result;
+            std::apply([&](auto&... fields) { (result.names.emplace_back(fields.name), ...); }, sol::SolFields<T>::fields);
+
+            if constexpr (HasClassName<T>::value) {
+                result.classdef.name = sol::SolFields<T>::classname;
+            }
+            if (result.classdef.name.empty()) {
+                result.classdef.dynamic = true;
+            }
+            else {
+                result.classdef.members = result.names;
+            }
+            return result;
+        }();
+        return bound;
+    }
+
+    // reads the value of key into the field of that name, or skips it
+    template <typename T>
+    bool ReadBoundField(BindReader& br, std::string_view key, uint8_t marker, T& out)
+    {
+        bool found = false;
+        bool ok = true;
+
+        auto match = [&](auto& field) {
+            if (!found && field.name == key) {
+                found = true;
+                ok = ReadBound(br, marker, out.*field.member);
+            }
+        };
+        std::apply([&](auto&... fields) { (match(fields), ...); }, sol::SolFields<T>::fields);
+
+        return found ? ok : br.Skip(marker);
+    }
+
+    template <typename T>
+    bool ReadBoundEntries(BindReader& br, T& out)
+    {
+        std::string_view key;
+        uint8_t marker;
+        bool more;
+
+        for (;;) {
+            if (!br.NextEntry(key, marker, more)) {
+                return false;
+            }
+            if (!more) {
+                return true;
+            }
+            if (!ReadBoundField(br, key, marker, out) || !br.EndEntry()) {
+                return false;
+            }
+        }
+    }
+
+    template <typename T>
+    void WriteBoundEntries(BindWriter& bw, const T& value)
+    {
+        auto& names = GetBoundClass<T>().names;
+        size_t index = 0;
+
+        auto write = [&](auto& field) {
+            bw.Entry(names[index++]);
+            WriteBound(bw, value.*field.member);
+            bw.EndEntry();
+        };
+        std::apply([&](auto&... fields) { (write(fields), ...); }, sol::SolFields<T>::fields);
+    }
+
+
+    template <>
+    struct SolBinder<bool>
+    {
+        static bool Read(BindReader& br, uint8_t marker, bool& out)
+        {
+            return br.ReadBoolean(marker, out);
+        }
+
+        static void Write(BindWriter& bw, bool value)
+        {
+            bw.Boolean(value);
+        }
+    };
+
+    template <typename T>
+    struct SolBinder<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+    {
+        static bool Read(BindReader& br, uint8_t marker, T& out)
+        {
+            size_t offset = br.offset();
+            double value;
+            if (!br.ReadNumber(marker, value)) {
+                return false;
+            }
+
+            if constexpr (std::is_integral_v<T>) {
+                // only numbers the field holds exactly
+                double limit = std::ldexp(1.0, std::numeric_limits<T>::digits);
+                double lowest = std::is_signed_v<T> ? -limit : 0.0;
+
+                if (!(value >= lowest && value < limit) || static_cast<double>(static_cast<T>(value)) != value) {
+                    return br.Mismatch(marker, offset);
+                }
+            }
+            out = static_cast<T>(value);
+            return true;
+        }
+
+        static void Write(BindWriter& bw, T value)
+        {
+            if constexpr (std::is_integral_v<T> && (std::is_signed_v<T> || sizeof(T) < sizeof(int64_t))) {
+                bw.Integer(static_cast<int64_t>(value));
+            }
+            else {
+                bw.Number(static_cast<double>(value));
+            }
+        }
+    };
+
+    template <>
+    struct SolBinder<std::string>
+    {
+        static bool Read(BindReader& br, uint8_t marker, std::string& out)
+        {
+            std::string_view value;
+            if (!br.ReadString(marker, value)) {
+                return false;
+            }
+            out.assign(value);
+            return true;
+        }
+
+        static void Write(BindWriter& bw, const std::string& value)
+        {
+            bw.String(value);
+        }
+    };
+
+    template <>
+    struct SolBinder<sol::SolBinary>
+    {
+        static bool Read(BindReader& br, uint8_t marker, sol::SolBinary& out)
+        {
+            std::string_view value;
+            if (!br.ReadBinary(marker, value)) {
+                return false;
+            }
+            out.assign(value.begin(), value.end());
+            return true;
+        }
+
+        static void Write(BindWriter& bw, const sol::SolBinary& value)
+        {
+            bw.Binary(value);
+        }
+    };
+
+    template <typename T>
+    struct SolBinder<std::optional<T>>
+    {
+        static bool Read(BindReader& br, uint8_t marker, std::optional<T>& out)
+        {
+            if (!out) {
+                out.emplace();
+            }
+            return ReadBound(br, marker, *out);
+        }
+
+        static void Write(BindWriter& bw, const std::optional<T>& value)
+        {
+            if (value) {
+                WriteBound(bw, *value);
+            }
+            else {
+                bw.Null();
+            }
+        }
+    };
+
+    template <typename T, typename TAlloc>
+    struct SolBinder<std::vector<T, TAlloc>, std::enable_if_t<!std::is_same_v<std::vector<T, TAlloc>, sol::SolBinary>>>
+    {
+        static bool Read(BindReader& br, uint8_t marker, std::vector<T, TAlloc>& out)
+        {
+            BindFrame frame;
+            size_t index;
+            bool more;
+
+            if (!br.BeginArray(marker, frame)) {
+                return false;
+            }
+            out.clear();
+
+            for (;;) {
+                if (!br.NextElement(frame, index, marker, more)) {
+                    return false;
+                }
+                if (!more) {
+                    return true;
+                }
+                if (index >= out.size()) {
+                    out.resize(index + 1);
+                }
+
+                if constexpr (std::is_same_v<T, bool>) {
+                    bool value = out[index];
+                    if (!ReadBound(br, marker, value)) {
+                        return false;
+                    }
+                    out[index] = value;
+                }
+                else if (!ReadBound(br, marker, out[index])) {
+                    return false;
+                }
+            }
+        }
+
+        static void Write(BindWriter& bw, const std::vector<T, TAlloc>& value)
+        {
+            bw.BeginArray(value.size());
+            for (auto&& item : value) {
+                WriteBound(bw, static_cast<const T&>(item));
+            }
+        }
+    };
+
+    template <typename T, typename TCompare, typename TAlloc>
+    struct SolBinder<std::map<std::string, T, TCompare, TAlloc>>
+    {
+        static bool Read(BindReader& br, uint8_t marker, std::map<std::string, T, TCompare, TAlloc>& out)
+        {
+            BindFrame frame;
+            std::string_view key;
+            bool more;
+
+            if (!br.BeginObject(marker, frame)) {
+                return false;
+            }
+            out.clear();
+
+            for (;;) {
+                if (!br.NextMember(frame, key, marker, more)) {
+                    return false;
+                }
+                if (!more) {
+                    return true;
+                }
+                if (!ReadBound(br, marker, out[std::string(key)])) {
+                    return false;
+                }
+            }
+        }
+
+        static void Write(BindWriter& bw, const std::map<std::string, T, TCompare, TAlloc>& value)
+        {
+            static const sol::SolClassDef classdef = [] {
+                sol::SolClassDef result;
+                result.dynamic = true;
+                return result;
+            }();
+
+            bw.BeginObject(classdef);
+            for (auto& [key, val] : value) {
+                bw.Key(key);
+                WriteBound(bw, val);
+            }
+            bw.EndObject(classdef);
+        }
+    };
+
+    template <typename T>
+    struct SolBinder<T, std::enable_if_t<IsBound<T>::value>>
+    {
+        static bool Read(BindReader& br, uint8_t marker, T& out)
+        {
+            BindFrame frame;
+            std::string_view key;
+            bool more;
+
+            if (!br.BeginObject(marker, frame)) {
+                return false;
+            }
+
+            for (;;) {
+                if (!br.NextMember(frame, key, marker, more)) {
+                    return false;
+                }
+                if (!more) {
+                    return true;
+                }
+                if (!ReadBoundField(br, key, marker, out)) {
+                    return false;
+                }
+            }
+        }
+
+        static void Write(BindWriter& bw, const T& value)
+        {
+            auto& bound = GetBoundClass<T>();
+            bool keyed = bw.amf0() || bound.classdef.dynamic;
+            size_t index = 0;
+
+            auto write = [&](auto& field) {
+                if (keyed) {
+                    bw.Key(bound.names[index]);
+                }
+                ++index;
+                WriteBound(bw, value.*field.member);
+            };
+
+            bw.BeginObject(bound.classdef);
+            std::apply([&](auto&... fields) { (write(fields), ...); }, sol::SolFields<T>::fields);
+            bw.EndObject(bound.classdef);
+        }
+    };
+}
+
+
+namespace sol
+{
+    // decodes the top level entries of a sol file into the fields of out, as
+    // TryReadSolFile does but without building values, file.solname and
+    // file.version are set and file.data is left as it is, maxnodes and maxbytes
+    // are not applied, only what the fields hold is allocated
+    template <typename T>
+    bool TryReadSolDataAs(const uint8_t* data, size_t size, SolFile& file, T& out, SolError& error, const SolReadOptions& options = SolReadOptions())
+    {
+        return detail::ReadBoundData(data, size, file, error, options,
+            [&](detail::BindReader& br) { return detail::ReadBoundEntries(br, out); });
+    }
+
+    template <typename T>
+    bool TryReadSolFileAs(SolFile& file, T& out, SolError& error, const SolReadOptions& options = SolReadOptions())
+    {
+        return detail::ReadBoundFile(file, error, options,
+            [&](detail::BindReader& br) { return detail::ReadBoundEntries(br, out); });
+    }
+
+    // as TryReadSolFileAs, the error message goes to file.errmsg
+    template <typename T>
+    bool ReadSolFileAs(SolFile& file, T& out, const SolReadOptions& options = SolReadOptions())
+    {
+        SolError error;
+        if (TryReadSolFileAs(file, out, error, options)) {
+            return true;
+        }
+        file.errmsg = error.message();
+        return false;
+    }
+
+    // writes the fields of value as the top level entries of file.path, with the
+    // name and version of file, file.data is not used
+    template <typename T>
+    bool WriteSolFileAs(SolFile& file, const T& value)
+    {
+        return detail::WriteBoundFile(file,
+            [&](detail::BindWriter& bw) { detail::WriteBoundEntries(bw, value); });
+    }
+}
+
+#endif // !__BIND_H__
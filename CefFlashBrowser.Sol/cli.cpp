@@ -1,10 +1,145 @@
 #include "cli.h"
+#include "archive.h"
+#include "cliutils.h"
+#include "diff.h"
+#include "json.h"
+#include "stats.h"
+#include "tree.h"
+#include "trace.h"
 #include "utils.h"
+#include "validate.h"
+#include "visit.h"
+#include <fstream>
+#include <sstream>
 
 
 using namespace sol;
 
 
+namespace
+{
+    sol::SolValue ToSolValue(System::Object^ value)
+    {
+        auto pwrapper = dynamic_cast<CefFlashBrowser::Sol::SolValueWrapper^>(value);
+        if (pwrapper != nullptr) {
+            return *pwrapper->_pval;
+        }
+
+        CefFlashBrowser::Sol::SolValueWrapper wrapper;
+        wrapper.SetValue(value);
+        return *wrapper._pval;
+    }
+
+    // the managed type each SolType is presented as, lambdas are not allowed in the
+    // members of the wrappers so the visitors are written out here
+    struct TypeVisitor
+    {
+        template <typename TDef>
+        System::Type^ operator()(TDef) const
+        {
+            using namespace CefFlashBrowser::Sol;
+            using namespace System;
+
+            if constexpr (TDef::type == SolType::Null) {
+                return nullptr;
+            }
+            else if constexpr (TDef::type == SolType::Undefined) {
+                return SolUndefined::typeid;
+            }
+            else if constexpr (std::is_same_v<typename TDef::storage, SolBoolean>) {
+                return Boolean::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Integer) {
+                return Int32::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Double) {
+                return Double::typeid;
+            }
+            else if constexpr (TDef::type == SolType::String) {
+                return String::typeid;
+            }
+            else if constexpr (TDef::type == SolType::XmlDoc) {
+                return SolXmlDoc::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Date) {
+                return DateTime::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Array) {
+                return SolArrayWrapper::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Object) {
+                return SolObjectWrapper::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Xml) {
+                return SolXml::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Binary) {
+                return array<Byte>::typeid;
+            }
+            else if constexpr (TDef::type == SolType::Dictionary) {
+                return SolDictionaryWrapper::typeid;
+            }
+            else {
+                static_assert(sol::detail::DependentFalse<TDef>, "TypeVisitor does not handle this type");
+            }
+        }
+    };
+
+    struct ValueVisitor
+    {
+        template <typename TDef, typename TStorage>
+        System::Object^ operator()(TDef, const TStorage& v) const
+        {
+            using namespace CefFlashBrowser::Sol;
+            using namespace System;
+
+            if constexpr (TDef::type == SolType::Null) {
+                return nullptr;
+            }
+            else if constexpr (TDef::type == SolType::Undefined) {
+                return SolUndefined::Value;
+            }
+            else if constexpr (std::is_same_v<TStorage, SolBoolean>) {
+                return gcnew Boolean(v);
+            }
+            else if constexpr (TDef::type == SolType::Integer) {
+                return gcnew Int32(v);
+            }
+            else if constexpr (TDef::type == SolType::Double) {
+                return gcnew Double(v);
+            }
+            else if constexpr (TDef::type == SolType::String) {
+                return utils::ToSystemString(v);
+            }
+            else if constexpr (TDef::type == SolType::XmlDoc) {
+                return gcnew SolXmlDoc(utils::ToSystemString(v));
+            }
+            else if constexpr (TDef::type == SolType::Date) {
+                return utils::ToSystemDateTime(v);
+            }
+            else if constexpr (TDef::type == SolType::Array) {
+                return gcnew SolArrayWrapper(new SolArray(v));
+            }
+            else if constexpr (TDef::type == SolType::Object) {
+                return gcnew SolObjectWrapper(new SolObject(v));
+            }
+            else if constexpr (TDef::type == SolType::Xml) {
+                return gcnew SolXml(utils::ToSystemString(v));
+            }
+            else if constexpr (TDef::type == SolType::Binary) {
+                return utils::ToByteArray(v);
+            }
+            else if constexpr (TDef::type == SolType::Dictionary) {
+                return gcnew SolDictionaryWrapper(new SolDictionary(v));
+            }
+            else {
+                static_assert(sol::detail::DependentFalse<TDef>, "ValueVisitor does not handle this type");
+            }
+        }
+    };
+}
+
+
 CefFlashBrowser::Sol::SolValueWrapper::SolValueWrapper(sol::SolValue* pval)
     : _pval(pval)
 {
@@ -22,46 +157,7 @@ CefFlashBrowser::Sol::SolValueWrapper::~SolValueWrapper()
 
 System::Type^ CefFlashBrowser::Sol::SolValueWrapper::Type::get()
 {
-    switch (_pval->type)
-    {
-    case SolType::Undefined:
-        return SolUndefined::typeid;
-
-    case SolType::BooleanFalse:
-    case SolType::BooleanTrue:
-        return Boolean::typeid;
-
-    case SolType::Integer:
-        return Int32::typeid;
-
-    case SolType::Double:
-        return Double::typeid;
-
-    case SolType::String:
-        return String::typeid;
-
-    case SolType::XmlDoc:
-        return SolXmlDoc::typeid;
-
-    case SolType::Date:
-        return DateTime::typeid;
-
-    case SolType::Array:
-        return SolArrayWrapper::typeid;
-
-    case SolType::Object:
-        return SolObjectWrapper::typeid;
-
-    case SolType::Xml:
-        return SolXml::typeid;
-
-    case SolType::Binary:
-        return array<Byte>::typeid;
-
-    case SolType::Null:
-    default:
-        return nullptr;
-    }
+    return IsKnownType(_pval->type) ? VisitSolType(_pval->type, TypeVisitor()) : nullptr;
 }
 
 bool CefFlashBrowser::Sol::SolValueWrapper::IsUndefined::get()
@@ -76,46 +172,7 @@ bool CefFlashBrowser::Sol::SolValueWrapper::IsNull::get()
 
 System::Object^ CefFlashBrowser::Sol::SolValueWrapper::GetValue()
 {
-    switch (_pval->type)
-    {
-    case SolType::Undefined:
-        return SolUndefined::Value;
-
-    case SolType::BooleanFalse:
-    case SolType::BooleanTrue:
-        return gcnew Boolean(_pval->get<SolBoolean>());
-
-    case SolType::Integer:
-        return gcnew Int32(_pval->get<SolInteger>());
-
-    case SolType::Double:
-        return gcnew Double(_pval->get<SolDouble>());
-
-    case SolType::String:
-        return utils::ToSystemString(_pval->get<SolString>());
-
-    case SolType::XmlDoc:
-        return gcnew SolXmlDoc(utils::ToSystemString(_pval->get<SolString>()));
-
-    case SolType::Date:
-        return utils::ToSystemDateTime(_pval->get<SolDouble>());
-
-    case SolType::Array:
-        return gcnew SolArrayWrapper(new SolArray(_pval->get<SolArray>()));
-
-    case SolType::Object:
-        return gcnew SolObjectWrapper(new SolObject(_pval->get<SolObject>()));
-
-    case SolType::Xml:
-        return gcnew SolXml(utils::ToSystemString(_pval->get<SolString>()));
-
-    case SolType::Binary:
-        return utils::ToByteArray(_pval->get<SolBinary>());
-
-    case SolType::Null:
-    default:
-        return nullptr;
-    }
+    return IsKnownType(_pval->type) ? VisitSolValue(*_pval, ValueVisitor()) : nullptr;
 }
 
 CefFlashBrowser::Sol::SolValueWrapper^ CefFlashBrowser::Sol::SolValueWrapper::SetValue(Object^ value)
@@ -177,6 +234,10 @@ CefFlashBrowser::Sol::SolValueWrapper^ CefFlashBrowser::Sol::SolValueWrapper::Se
         _pval->type = SolType::Binary;
         _pval->value = utils::ToByteVector((array<Byte>^)value);
     }
+    else if (type == SolDictionaryWrapper::typeid) {
+        _pval->type = SolType::Dictionary;
+        _pval->value = *((SolDictionaryWrapper^)value)->_pdict;
+    }
     else {
         throw gcnew ArgumentException("Unsupported type");
     }
@@ -184,8 +245,152 @@ CefFlashBrowser::Sol::SolValueWrapper^ CefFlashBrowser::Sol::SolValueWrapper::Se
     return this;
 }
 
+CefFlashBrowser::Sol::SolStatsWrapper::SolStatsWrapper()
+    : _pstats(new SolStats())
+{
+}
+
+CefFlashBrowser::Sol::SolStatsWrapper::~SolStatsWrapper()
+{
+    delete _pstats;
+}
+
+CefFlashBrowser::Sol::SolVersion CefFlashBrowser::Sol::SolStatsWrapper::Version::get()
+{
+    return (SolVersion)_pstats->version;
+}
+
+long long CefFlashBrowser::Sol::SolStatsWrapper::Bytes::get()
+{
+    return (long long)_pstats->bytes;
+}
+
+long long CefFlashBrowser::Sol::SolStatsWrapper::StringRefs::get()
+{
+    return (long long)_pstats->strrefs;
+}
+
+long long CefFlashBrowser::Sol::SolStatsWrapper::ClassRefs::get()
+{
+    return (long long)_pstats->classrefs;
+}
+
+long long CefFlashBrowser::Sol::SolStatsWrapper::ObjectRefs::get()
+{
+    return (long long)_pstats->objrefs;
+}
+
+long long CefFlashBrowser::Sol::SolStatsWrapper::CopiedBytes::get()
+{
+    return (long long)_pstats->copied;
+}
+
+long long CefFlashBrowser::Sol::SolStatsWrapper::Allocations::get()
+{
+    return (long long)_pstats->allocations;
+}
+
+int CefFlashBrowser::Sol::SolStatsWrapper::MaxDepth::get()
+{
+    return (int)_pstats->maxdepth;
+}
+
+// TimeSpan::FromSeconds rounds to milliseconds
+System::TimeSpan CefFlashBrowser::Sol::SolStatsWrapper::IOTime::get()
+{
+    return TimeSpan::FromTicks((long long)(_pstats->iotime * TimeSpan::TicksPerSecond));
+}
+
+System::TimeSpan CefFlashBrowser::Sol::SolStatsWrapper::DecodeTime::get()
+{
+    return TimeSpan::FromTicks((long long)(_pstats->decodetime * TimeSpan::TicksPerSecond));
+}
+
+System::TimeSpan CefFlashBrowser::Sol::SolStatsWrapper::EncodeTime::get()
+{
+    return TimeSpan::FromTicks((long long)(_pstats->encodetime * TimeSpan::TicksPerSecond));
+}
+
+System::TimeSpan CefFlashBrowser::Sol::SolStatsWrapper::MarshalTime::get()
+{
+    return TimeSpan::FromTicks((long long)(_pstats->marshaltime * TimeSpan::TicksPerSecond));
+}
+
+System::Collections::Generic::Dictionary<System::String^, long long>^
+CefFlashBrowser::Sol::SolStatsWrapper::Nodes::get()
+{
+    auto result = gcnew Dictionary<String^, long long>();
+    for (size_t i = 0; i < _pstats->types.size(); ++i) {
+        if (_pstats->types[i].nodes != 0) {
+            auto name = _pstats->version == sol::SolVersion::AMF0
+                ? GetTypeName((AMF0Type)i) : GetTypeName((SolType)i);
+            result[utils::ToSystemString(name)] = (long long)_pstats->types[i].nodes;
+        }
+    }
+    return result;
+}
+
+System::Collections::Generic::Dictionary<System::String^, long long>^
+CefFlashBrowser::Sol::SolStatsWrapper::TypeBytes::get()
+{
+    auto result = gcnew Dictionary<String^, long long>();
+    for (size_t i = 0; i < _pstats->types.size(); ++i) {
+        if (_pstats->types[i].nodes != 0) {
+            auto name = _pstats->version == sol::SolVersion::AMF0
+                ? GetTypeName((AMF0Type)i) : GetTypeName((SolType)i);
+            result[utils::ToSystemString(name)] = (long long)_pstats->types[i].bytes;
+        }
+    }
+    return result;
+}
+
+void CefFlashBrowser::Sol::SolStatsWrapper::Reset()
+{
+    _pstats->clear();
+}
+
+System::String^ CefFlashBrowser::Sol::SolStatsWrapper::ToString()
+{
+    return utils::ToSystemString(_pstats->report());
+}
+
+CefFlashBrowser::Sol::SolValueFootprint::SolValueFootprint(const sol::SolValueFootprint& footprint)
+{
+    _path = utils::ToSystemString(FormatSolPath(footprint.key, footprint.path));
+    _type = utils::ToSystemString(GetTypeName(footprint.type));
+    _retained = (long long)footprint.retained;
+    _overhead = (long long)footprint.overhead;
+    _strings = (long long)footprint.strings;
+    _binaries = (long long)footprint.binaries;
+    _duplicated = (long long)footprint.duplicated;
+    _encoded = (long long)footprint.encoded;
+    _nodes = (long long)footprint.nodes;
+    _duplicate = footprint.duplicate;
+}
+
+CefFlashBrowser::Sol::SolFootprintWrapper::SolFootprintWrapper(const sol::SolFootprint& footprint)
+{
+    _retained = (long long)footprint.retained;
+    _duplicated = (long long)footprint.duplicated;
+    _encoded = (long long)footprint.encoded;
+    _nodes = (long long)footprint.nodes;
+    _report = utils::ToSystemString(footprint.report());
+
+    _values = gcnew List<SolValueFootprint^>((int)footprint.values.size());
+    for (auto& value : footprint.values) {
+        _values->Add(gcnew SolValueFootprint(value));
+    }
+}
+
+CefFlashBrowser::Sol::SolQueryMatch::SolQueryMatch(const sol::SolQueryMatch& match, SolValueWrapper^ value)
+    : _path(utils::ToSystemString(sol::FormatSolPath(match.key, match.path)))
+    , _offset((long long)match.offset)
+    , _value(value)
+{
+}
+
 CefFlashBrowser::Sol::SolFileWrapper::SolFileWrapper(SolFile* pfile)
-    : _pfile(pfile)
+    : _phistory(nullptr), _pfile(pfile)
 {
     if (pfile->data.empty())
     {
@@ -211,45 +416,172 @@ void CefFlashBrowser::Sol::SolFileWrapper::UpdateUnmanagedData()
     }
 }
 
+void CefFlashBrowser::Sol::SolFileWrapper::UpdateManagedData()
+{
+    _data->Clear();
+
+    for (auto& [key, val] : _pfile->data) {
+        _data->Add(utils::ToSystemString(key), gcnew SolValueWrapper(new SolValue(val)));
+    }
+}
+
 CefFlashBrowser::Sol::SolFileWrapper::SolFileWrapper(String^ path)
-    : _pfile(new SolFile())
+    : SolFileWrapper(path, false)
+{
+}
+
+CefFlashBrowser::Sol::SolFileWrapper::SolFileWrapper(String^ path, bool collectStats)
+    : SolFileWrapper(path, collectStats, false)
 {
+}
+
+CefFlashBrowser::Sol::SolFileWrapper::SolFileWrapper(String^ path, bool collectStats, bool keepRaw)
+    : _phistory(nullptr), _pfile(new SolFile())
+{
+    SOL_TRACE_SCOPE("SolFileWrapper.ReadFile");
     _pfile->path = utils::ToStdString(path, false);
+    CollectStats = collectStats;
+
+    SolReadOptions options;
+    options.keepraw = keepRaw;
+    options.stats = collectStats ? _readstats->_pstats : nullptr;
 
-    if (!sol::ReadSolFile(*_pfile)) {
+    if (!sol::ReadSolFile(*_pfile, options)) {
         auto errmsg = utils::ToSystemString(_pfile->errmsg);
         delete _pfile;
         _pfile = nullptr;
+        CollectStats = false;
         throw gcnew Exception(errmsg);
     }
 
+    SOL_TRACE_SCOPE("wrap values");
+    auto watch = Diagnostics::Stopwatch::StartNew();
     auto& data = _pfile->data;
     _data = gcnew Dictionary<String^, SolValueWrapper^>((int)data.size());
 
     for (auto& [key, val] : data) {
         _data->Add(utils::ToSystemString(key), gcnew SolValueWrapper(new SolValue(data[key])));
     }
+
+    if (collectStats) {
+        _readstats->_pstats->marshaltime += watch->Elapsed.TotalSeconds;
+    }
 }
 
 CefFlashBrowser::Sol::SolFileWrapper::~SolFileWrapper()
 {
     delete _pfile;
+    delete _phistory;
+    delete _readstats;
+    delete _savestats;
 }
 
 void CefFlashBrowser::Sol::SolFileWrapper::Save()
 {
-    UpdateUnmanagedData();
+    SOL_TRACE_SCOPE("SolFileWrapper.Save");
+    SolWriteOptions options;
+    if (_savestats != nullptr) {
+        _savestats->Reset();
+        options.stats = _savestats->_pstats;
+    }
+
+    {
+        SOL_TRACE_SCOPE("unwrap values");
+        auto watch = Diagnostics::Stopwatch::StartNew();
+        UpdateUnmanagedData();
+        if (options.stats) {
+            options.stats->marshaltime += watch->Elapsed.TotalSeconds;
+        }
+    }
 
-    if (!sol::WriteSolFile(*_pfile)) {
+    if (!sol::WriteSolFile(*_pfile, options)) {
         throw gcnew Exception(utils::ToSystemString(_pfile->errmsg));
     }
 }
 
+bool CefFlashBrowser::Sol::SolFileWrapper::CanUndo::get()
+{
+    return _phistory != nullptr && _phistory->canundo();
+}
+
+bool CefFlashBrowser::Sol::SolFileWrapper::CanRedo::get()
+{
+    return _phistory != nullptr && _phistory->canredo();
+}
+
+void CefFlashBrowser::Sol::SolFileWrapper::Commit()
+{
+    SOL_TRACE_SCOPE("SolFileWrapper.Commit");
+
+    // the file holds the values as of the last Save or snapshot until it is updated,
+    // so the first snapshot is of those
+    if (_phistory == nullptr) {
+        _phistory = new SolHistory(SolTree(*_pfile));
+    }
+
+    // an entry that still holds the value it had keeps its nodes, the wrapped values
+    // are compared where they are, so only the changed entries are copied or hashed
+    auto& current = _phistory->current();
+    SolTree tree = current;
+    bool changed = false;
+
+    for each (auto pair in _data) {
+        auto key = utils::ToStdString(pair.Key);
+        auto& val = *pair.Value->_pval;
+        auto node = current.get(key);
+
+        if (!node || !EqualsSolValue(*node, val)) {
+            tree = tree.set(key, MakeSolNode(val));
+            changed = true;
+        }
+    }
+    for (auto& [key, node] : current.entries()) {
+        if (!_data->ContainsKey(utils::ToSystemString(key))) {
+            tree = tree.erase(key);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        _phistory->commit(std::move(tree));
+    }
+}
+
+bool CefFlashBrowser::Sol::SolFileWrapper::Undo()
+{
+    if (_phistory == nullptr || !_phistory->undo()) {
+        return false;
+    }
+    _phistory->current().store(*_pfile);
+    UpdateManagedData();
+    return true;
+}
+
+bool CefFlashBrowser::Sol::SolFileWrapper::Redo()
+{
+    if (_phistory == nullptr || !_phistory->redo()) {
+        return false;
+    }
+    _phistory->current().store(*_pfile);
+    UpdateManagedData();
+    return true;
+}
+
 CefFlashBrowser::Sol::SolFileWrapper^ CefFlashBrowser::Sol::SolFileWrapper::ReadFile(String^ path)
 {
     return gcnew SolFileWrapper(path);
 }
 
+CefFlashBrowser::Sol::SolFileWrapper^ CefFlashBrowser::Sol::SolFileWrapper::ReadFile(String^ path, bool collectStats)
+{
+    return gcnew SolFileWrapper(path, collectStats);
+}
+
+CefFlashBrowser::Sol::SolFileWrapper^ CefFlashBrowser::Sol::SolFileWrapper::ReadFile(String^ path, bool collectStats, bool keepRaw)
+{
+    return gcnew SolFileWrapper(path, collectStats, keepRaw);
+}
+
 CefFlashBrowser::Sol::SolFileWrapper^ CefFlashBrowser::Sol::SolFileWrapper::CreateEmpty(String^ path)
 {
     auto pfile = new SolFile;
@@ -259,6 +591,55 @@ CefFlashBrowser::Sol::SolFileWrapper^ CefFlashBrowser::Sol::SolFileWrapper::Crea
     return gcnew SolFileWrapper(pfile);
 }
 
+CefFlashBrowser::Sol::SolFootprintWrapper^ CefFlashBrowser::Sol::SolFileWrapper::GetFootprint(SolFootprintOrder order, int limit)
+{
+    UpdateUnmanagedData();
+
+    sol::SolFootprintOptions options;
+    options.order = (sol::SolFootprintOrder)order;
+    options.limit = limit > 0 ? (size_t)limit : SIZE_MAX;
+
+    try {
+        return gcnew SolFootprintWrapper(sol::GetSolFootprint(*_pfile, options));
+    }
+    catch (const std::exception& e) {
+        throw gcnew Exception(utils::ToSystemString(e.what()));
+    }
+}
+
+void CefFlashBrowser::Sol::SolFileWrapper::Validate(String^ path)
+{
+    sol::SolError error;
+    if (!sol::ValidateSolFile(utils::ToStdString(path, false), error, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(error.message()));
+    }
+}
+
+System::Collections::Generic::List<CefFlashBrowser::Sol::SolQueryMatch^>^
+CefFlashBrowser::Sol::SolFileWrapper::Query(String^ path, String^ query)
+{
+    std::vector<sol::SolQueryMatch> matches;
+    sol::SolError error;
+    bool queried;
+
+    try {
+        sol::SolQuery compiled(utils::ToStdString(query));
+        queried = sol::QuerySolFile(utils::ToStdString(path, false), compiled, true, matches, error, sol::SolReadOptions::Untrusted());
+    }
+    catch (const std::exception& e) {
+        throw gcnew Exception(utils::ToSystemString(e.what()));
+    }
+    if (!queried) {
+        throw gcnew Exception(utils::ToSystemString(error.message()));
+    }
+
+    auto result = gcnew List<SolQueryMatch^>((int)matches.size());
+    for (auto& match : matches) {
+        result->Add(gcnew SolQueryMatch(match, gcnew SolValueWrapper(new SolValue(std::move(match.value)))));
+    }
+    return result;
+}
+
 System::String^ CefFlashBrowser::Sol::SolFileWrapper::Path::get()
 {
     return utils::ToSystemString(_pfile->path, false);
@@ -295,6 +676,35 @@ CefFlashBrowser::Sol::SolFileWrapper::Data::get()
     return _data;
 }
 
+bool CefFlashBrowser::Sol::SolFileWrapper::CollectStats::get()
+{
+    return _readstats != nullptr;
+}
+
+void CefFlashBrowser::Sol::SolFileWrapper::CollectStats::set(bool value)
+{
+    if (value && _readstats == nullptr) {
+        _readstats = gcnew SolStatsWrapper();
+        _savestats = gcnew SolStatsWrapper();
+    }
+    else if (!value && _readstats != nullptr) {
+        delete _readstats;
+        delete _savestats;
+        _readstats = nullptr;
+        _savestats = nullptr;
+    }
+}
+
+CefFlashBrowser::Sol::SolStatsWrapper^ CefFlashBrowser::Sol::SolFileWrapper::ReadStats::get()
+{
+    return _readstats;
+}
+
+CefFlashBrowser::Sol::SolStatsWrapper^ CefFlashBrowser::Sol::SolFileWrapper::SaveStats::get()
+{
+    return _savestats;
+}
+
 CefFlashBrowser::Sol::SolArrayWrapper::SolArrayWrapper(SolArray* parr)
     : _parr(parr)
 {
@@ -400,3 +810,400 @@ CefFlashBrowser::Sol::SolObjectWrapper::Props::get()
 {
     return _props;
 }
+
+CefFlashBrowser::Sol::SolDictionaryWrapper::SolDictionaryWrapper(SolDictionary* pdict)
+    : _pdict(pdict)
+{
+}
+
+CefFlashBrowser::Sol::SolDictionaryWrapper::SolDictionaryWrapper()
+    : _pdict(new SolDictionary())
+{
+}
+
+CefFlashBrowser::Sol::SolDictionaryWrapper::~SolDictionaryWrapper()
+{
+    delete _pdict;
+}
+
+int CefFlashBrowser::Sol::SolDictionaryWrapper::Count::get()
+{
+    return (int)_pdict->size();
+}
+
+bool CefFlashBrowser::Sol::SolDictionaryWrapper::WeakKeys::get()
+{
+    return _pdict->weakkeys;
+}
+
+void CefFlashBrowser::Sol::SolDictionaryWrapper::WeakKeys::set(bool value)
+{
+    _pdict->weakkeys = value;
+}
+
+System::Collections::Generic::List<CefFlashBrowser::Sol::SolValueWrapper^>^
+CefFlashBrowser::Sol::SolDictionaryWrapper::Keys::get()
+{
+    auto keys = gcnew List<SolValueWrapper^>((int)_pdict->size());
+
+    for (auto& [key, val] : _pdict->entries()) {
+        keys->Add(gcnew SolValueWrapper(new SolValue(key)));
+    }
+    return keys;
+}
+
+bool CefFlashBrowser::Sol::SolDictionaryWrapper::ContainsKey(Object^ key)
+{
+    return _pdict->find(ToSolValue(key)) != nullptr;
+}
+
+bool CefFlashBrowser::Sol::SolDictionaryWrapper::TryGetValue(Object^ key, SolValueWrapper^% value)
+{
+    auto found = _pdict->find(ToSolValue(key));
+
+    if (found == nullptr) {
+        value = nullptr;
+        return false;
+    }
+
+    value = gcnew SolValueWrapper(new SolValue(*found));
+    return true;
+}
+
+void CefFlashBrowser::Sol::SolDictionaryWrapper::Set(Object^ key, Object^ value)
+{
+    (*_pdict)[ToSolValue(key)] = ToSolValue(value);
+}
+
+bool CefFlashBrowser::Sol::SolDictionaryWrapper::Remove(Object^ key)
+{
+    return _pdict->erase(ToSolValue(key));
+}
+
+bool CefFlashBrowser::Sol::SolTrace::Enabled::get()
+{
+    return sol::trace::enabled;
+}
+
+System::String^ CefFlashBrowser::Sol::SolTrace::ToJson()
+{
+    return utils::ToSystemString(sol::trace::ToJson());
+}
+
+void CefFlashBrowser::Sol::SolTrace::Save(String^ path)
+{
+    try {
+        sol::trace::Save(utils::ToStdString(path, false));
+    }
+    catch (const std::exception& e) {
+        throw gcnew Exception(utils::ToSystemString(e.what()));
+    }
+}
+
+void CefFlashBrowser::Sol::SolTrace::Clear()
+{
+    sol::trace::Clear();
+}
+
+System::String^ CefFlashBrowser::Sol::SolJson::ToJson(String^ solPath)
+{
+    std::ostringstream json;
+    sol::SolError error;
+    if (!sol::TranscodeSolFileToJson(utils::ToStdString(solPath, false), json, error, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(error.message()));
+    }
+    return utils::ToSystemString(json.str());
+}
+
+void CefFlashBrowser::Sol::SolJson::ExportFile(String^ solPath, String^ jsonPath)
+{
+    std::ofstream json(utils::ToStdString(jsonPath, false), std::ios::binary);
+    if (!json.is_open()) {
+        throw gcnew Exception("Failed to open file");
+    }
+
+    sol::SolError error;
+    if (!sol::TranscodeSolFileToJson(utils::ToStdString(solPath, false), json, error, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(error.message()));
+    }
+}
+
+void CefFlashBrowser::Sol::SolJson::ImportFile(String^ jsonPath, String^ solPath)
+{
+    std::string errmsg;
+    if (!sol::TranscodeJsonFileToSol(utils::ToStdString(jsonPath, false), utils::ToStdString(solPath, false), errmsg, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+}
+
+System::String^ CefFlashBrowser::Sol::SolDiff::Compare(String^ fromPath, String^ toPath)
+{
+    sol::SolPatch patch;
+    sol::SolError error;
+    if (!sol::DiffSolFilePaths(utils::ToStdString(fromPath, false), utils::ToStdString(toPath, false), patch, error, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(error.message()));
+    }
+    return utils::ToSystemString(patch.report());
+}
+
+bool CefFlashBrowser::Sol::SolDiff::CreatePatch(String^ fromPath, String^ toPath, String^ patchPath)
+{
+    sol::SolPatch patch;
+    sol::SolError error;
+    if (!sol::DiffSolFilePaths(utils::ToStdString(fromPath, false), utils::ToStdString(toPath, false), patch, error, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(error.message()));
+    }
+
+    std::string errmsg;
+    if (!sol::SaveSolPatch(patch, utils::ToStdString(patchPath, false), errmsg)) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+    return !patch.empty();
+}
+
+void CefFlashBrowser::Sol::SolDiff::ApplyPatch(String^ solPath, String^ patchPath, String^ outPath)
+{
+    sol::SolPatch patch;
+    std::string errmsg;
+    if (!sol::LoadSolPatch(utils::ToStdString(patchPath, false), patch, errmsg)
+        || !sol::PatchSolFile(utils::ToStdString(solPath, false), patch, utils::ToStdString(outPath, false), errmsg, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+}
+
+CefFlashBrowser::Sol::SolSnapshotEntry::SolSnapshotEntry(const sol::SolSnapshot& snapshot)
+    : _id((long long)snapshot.id)
+    , _time(utils::ToSystemDateTime((double)snapshot.time))
+    , _size((long long)snapshot.size)
+    , _chunks((int)snapshot.chunks.size())
+{
+}
+
+CefFlashBrowser::Sol::SolSnapshotStoreWrapper::SolSnapshotStoreWrapper(String^ root)
+{
+    try {
+        _pstore = new sol::SolSnapshotStore(utils::ToStdString(root, false));
+    }
+    catch (const std::exception& e) {
+        throw gcnew Exception(utils::ToSystemString(e.what()));
+    }
+}
+
+CefFlashBrowser::Sol::SolSnapshotStoreWrapper::~SolSnapshotStoreWrapper()
+{
+    delete _pstore;
+}
+
+long long CefFlashBrowser::Sol::SolSnapshotStoreWrapper::Take(String^ name, String^ solPath)
+{
+    sol::SolSnapshotInfo info;
+    std::string errmsg;
+    if (!_pstore->take(utils::ToStdString(name), utils::ToStdString(solPath, false), info, errmsg, sol::SolReadOptions::Untrusted())) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+    return (long long)info.id;
+}
+
+void CefFlashBrowser::Sol::SolSnapshotStoreWrapper::Restore(String^ name, long long id, String^ outPath)
+{
+    std::string errmsg;
+    if (id <= 0 || !_pstore->restore(utils::ToStdString(name), (uint64_t)id, utils::ToStdString(outPath, false), errmsg)) {
+        throw gcnew Exception(id <= 0 ? "No such snapshot" : utils::ToSystemString(errmsg));
+    }
+}
+
+System::Collections::Generic::List<System::String^>^
+CefFlashBrowser::Sol::SolSnapshotStoreWrapper::GetNames()
+{
+    auto names = _pstore->names();
+    auto result = gcnew List<String^>((int)names.size());
+    for (auto& name : names) {
+        result->Add(utils::ToSystemString(name));
+    }
+    return result;
+}
+
+System::Collections::Generic::List<CefFlashBrowser::Sol::SolSnapshotEntry^>^
+CefFlashBrowser::Sol::SolSnapshotStoreWrapper::GetHistory(String^ name)
+{
+    auto history = _pstore->history(utils::ToStdString(name));
+    auto result = gcnew List<SolSnapshotEntry^>((int)history.size());
+    for (auto& snapshot : history) {
+        result->Add(gcnew SolSnapshotEntry(snapshot));
+    }
+    return result;
+}
+
+void CefFlashBrowser::Sol::SolArchive::Pack(String^ dir, String^ archivePath, bool compress)
+{
+    sol::SolArchiveOptions options;
+    options.compress = compress;
+
+    std::string errmsg;
+    if (!sol::PackSolDirectory(utils::ToStdString(dir, false), utils::ToStdString(archivePath, false), errmsg, options)) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+}
+
+void CefFlashBrowser::Sol::SolArchive::Unpack(String^ archivePath, String^ dir)
+{
+    sol::SolArchive archive;
+    std::string errmsg;
+    if (!archive.open(utils::ToStdString(archivePath, false), errmsg) || !archive.extract(utils::ToStdString(dir, false), errmsg)) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+}
+
+System::Collections::Generic::List<System::String^>^
+CefFlashBrowser::Sol::SolArchive::GetMembers(String^ archivePath)
+{
+    sol::SolArchive archive;
+    std::string errmsg;
+    if (!archive.open(utils::ToStdString(archivePath, false), errmsg)) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+
+    auto result = gcnew List<String^>((int)archive.members().size());
+    for (auto& member : archive.members()) {
+        result->Add(utils::ToSystemString(member.name, false));
+    }
+    return result;
+}
+
+void CefFlashBrowser::Sol::SolArchive::ExtractMember(String^ archivePath, String^ name, String^ outPath)
+{
+    sol::SolArchive archive;
+    std::string errmsg;
+    if (!archive.open(utils::ToStdString(archivePath, false), errmsg)) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+
+    auto member = archive.find(utils::ToStdString(name, false));
+    if (member == nullptr) {
+        throw gcnew Exception("No such member");
+    }
+
+    std::vector<uint8_t> data;
+    if (!archive.read(*member, data, errmsg)) {
+        throw gcnew Exception(utils::ToSystemString(errmsg));
+    }
+
+    try {
+        utils::WriteFile(utils::ToStdString(outPath, false), data);
+    }
+    catch (const std::exception& e) {
+        throw gcnew Exception(utils::ToSystemString(e.what()));
+    }
+}
+
+CefFlashBrowser::Sol::SolFileChange::SolFileChange(const sol::SolFileChange& change)
+    : _kind((SolFileChangeKind)change.kind)
+    , _path(utils::ToSystemString(change.path, false))
+    , _size((long long)change.size)
+    , _valid(change.valid)
+    , _solname(utils::ToSystemString(change.solname))
+    , _version((SolVersion)change.version)
+    , _errmsg(utils::ToSystemString(change.errmsg))
+{
+    // file_time_type counts in FILETIME ticks with msvc
+    if (change.kind != sol::SolFileChangeKind::Removed) {
+        _time = DateTime::FromFileTime(change.mtime.time_since_epoch().count());
+    }
+    if (change.file) {
+        _file = gcnew SolFileWrapper(new SolFile(*change.file));
+    }
+}
+
+CefFlashBrowser::Sol::SolChangeTrackerWrapper::SolChangeTrackerWrapper(String^ root)
+    : SolChangeTrackerWrapper(root, false, 300)
+{
+}
+
+CefFlashBrowser::Sol::SolChangeTrackerWrapper::SolChangeTrackerWrapper(String^ root, bool parse, int debounceMilliseconds)
+{
+    sol::SolTrackerOptions options;
+    options.parse = parse;
+    options.debounce = std::chrono::milliseconds(debounceMilliseconds < 0 ? 0 : debounceMilliseconds);
+    if (options.maxdelay < options.debounce) {
+        options.maxdelay = options.debounce;
+    }
+    _ptracker = new sol::SolChangeTracker(utils::ToStdString(root, false), options);
+
+    try {
+        _watcher = gcnew IO::FileSystemWatcher(root);
+        _watcher->IncludeSubdirectories = true;
+        _watcher->NotifyFilter = IO::NotifyFilters::FileName | IO::NotifyFilters::DirectoryName
+            | IO::NotifyFilters::LastWrite | IO::NotifyFilters::Size;
+        _watcher->InternalBufferSize = 64 * 1024;
+
+        auto onchanged = gcnew IO::FileSystemEventHandler(this, &SolChangeTrackerWrapper::OnChanged);
+        _watcher->Changed += onchanged;
+        _watcher->Created += onchanged;
+        _watcher->Deleted += onchanged;
+        _watcher->Renamed += gcnew IO::RenamedEventHandler(this, &SolChangeTrackerWrapper::OnRenamed);
+        _watcher->Error += gcnew IO::ErrorEventHandler(this, &SolChangeTrackerWrapper::OnError);
+        _watcher->EnableRaisingEvents = true;
+    }
+    catch (Exception^) {
+        delete _ptracker;
+        _ptracker = nullptr;
+        throw;
+    }
+}
+
+CefFlashBrowser::Sol::SolChangeTrackerWrapper::~SolChangeTrackerWrapper()
+{
+    delete _watcher;
+    delete _ptracker;
+}
+
+void CefFlashBrowser::Sol::SolChangeTrackerWrapper::OnChanged(Object^ sender, IO::FileSystemEventArgs^ e)
+{
+    _ptracker->notify(utils::ToStdString(e->FullPath, false));
+}
+
+void CefFlashBrowser::Sol::SolChangeTrackerWrapper::OnRenamed(Object^ sender, IO::RenamedEventArgs^ e)
+{
+    _ptracker->notify(utils::ToStdString(e->OldFullPath, false));
+    _ptracker->notify(utils::ToStdString(e->FullPath, false));
+}
+
+void CefFlashBrowser::Sol::SolChangeTrackerWrapper::OnError(Object^ sender, IO::ErrorEventArgs^ e)
+{
+    _overflowed = true;
+}
+
+int CefFlashBrowser::Sol::SolChangeTrackerWrapper::Pending::get()
+{
+    return (int)_ptracker->pending();
+}
+
+System::Collections::Generic::List<CefFlashBrowser::Sol::SolFileChange^>^
+CefFlashBrowser::Sol::SolChangeTrackerWrapper::Poll()
+{
+    std::vector<sol::SolFileChange> changes;
+    if (_overflowed) {
+        _overflowed = false;
+        changes = _ptracker->scan();
+    }
+    else {
+        changes = _ptracker->poll();
+    }
+
+    auto result = gcnew List<SolFileChange^>((int)changes.size());
+    for (auto& change : changes) {
+        result->Add(gcnew SolFileChange(change));
+    }
+    return result;
+}
+
+System::Collections::Generic::List<CefFlashBrowser::Sol::SolFileChange^>^
+CefFlashBrowser::Sol::SolChangeTrackerWrapper::Scan()
+{
+    auto changes = _ptracker->scan();
+    auto result = gcnew List<SolFileChange^>((int)changes.size());
+    for (auto& change : changes) {
+        result->Add(gcnew SolFileChange(change));
+    }
+    return result;
+}
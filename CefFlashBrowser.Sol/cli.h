@@ -2,6 +2,11 @@
 #define __CLI_H__
 
 #include "sol.h"
+#include "footprint.h"
+#include "query.h"
+#include "snapshot.h"
+#include "tracker.h"
+#include "tree.h"
 
 namespace CefFlashBrowser::Sol
 {
@@ -16,6 +21,14 @@ namespace CefFlashBrowser::Sol
     };
 
 
+    public enum class SolFootprintOrder
+    {
+        Retained = (int)sol::SolFootprintOrder::Retained,
+        Encoded = (int)sol::SolFootprintOrder::Encoded,
+        Duplicated = (int)sol::SolFootprintOrder::Duplicated
+    };
+
+
     public ref class SolUndefined sealed
     {
     private:
@@ -88,19 +101,136 @@ namespace CefFlashBrowser::Sol
     };
 
 
+    public ref class SolStatsWrapper sealed
+    {
+    internal:
+        sol::SolStats* _pstats;
+        SolStatsWrapper();
+
+    public:
+        ~SolStatsWrapper();
+
+    public:
+        property SolVersion Version { SolVersion get(); }
+        property long long Bytes { long long get(); }
+        property long long StringRefs { long long get(); }
+        property long long ClassRefs { long long get(); }
+        property long long ObjectRefs { long long get(); }
+        property long long CopiedBytes { long long get(); }
+        property long long Allocations { long long get(); }
+        property int MaxDepth { int get(); }
+        property TimeSpan IOTime { TimeSpan get(); }
+        property TimeSpan DecodeTime { TimeSpan get(); }
+        property TimeSpan EncodeTime { TimeSpan get(); }
+        property TimeSpan MarshalTime { TimeSpan get(); }
+
+        // by type name, the AMF0 type names for AMF0 files
+        property Dictionary<String^, long long>^ Nodes { Dictionary<String^, long long>^ get(); }
+        property Dictionary<String^, long long>^ TypeBytes { Dictionary<String^, long long>^ get(); }
+
+        void Reset();
+        virtual String^ ToString() override;
+    };
+
+
+    // a value listed by SolFootprintWrapper, see footprint.h for what is counted
+    public ref class SolValueFootprint sealed
+    {
+    private:
+        String^ _path;
+        String^ _type;
+        long long _retained;
+        long long _overhead;
+        long long _strings;
+        long long _binaries;
+        long long _duplicated;
+        long long _encoded;
+        long long _nodes;
+        bool _duplicate;
+
+    internal:
+        SolValueFootprint(const sol::SolValueFootprint& footprint);
+
+    public:
+        property String^ Path { String^ get() { return _path; } }
+        property String^ Type { String^ get() { return _type; } }
+        property long long Retained { long long get() { return _retained; } }
+        property long long Overhead { long long get() { return _overhead; } }
+        property long long Strings { long long get() { return _strings; } }
+        property long long Binaries { long long get() { return _binaries; } }
+        property long long Duplicated { long long get() { return _duplicated; } }
+        property long long Encoded { long long get() { return _encoded; } }
+        property long long Nodes { long long get() { return _nodes; } }
+        property bool IsDuplicate { bool get() { return _duplicate; } }
+    };
+
+
+    public ref class SolFootprintWrapper sealed
+    {
+    private:
+        long long _retained;
+        long long _duplicated;
+        long long _encoded;
+        long long _nodes;
+        List<SolValueFootprint^>^ _values;
+        String^ _report;
+
+    internal:
+        SolFootprintWrapper(const sol::SolFootprint& footprint);
+
+    public:
+        property long long Retained { long long get() { return _retained; } }
+        property long long Duplicated { long long get() { return _duplicated; } }
+        property long long Encoded { long long get() { return _encoded; } }
+        property long long Nodes { long long get() { return _nodes; } }
+        property List<SolValueFootprint^>^ Values { List<SolValueFootprint^>^ get() { return _values; } }
+
+        virtual String^ ToString() override { return _report; }
+    };
+
+
+    // a value found by SolFileWrapper.Query, with its path as key.name[2]
+    public ref class SolQueryMatch sealed
+    {
+    private:
+        String^ _path;
+        long long _offset;
+        SolValueWrapper^ _value;
+
+    internal:
+        SolQueryMatch(const sol::SolQueryMatch& match, SolValueWrapper^ value);
+
+    public:
+        property String^ Path { String^ get() { return _path; } }
+        property long long Offset { long long get() { return _offset; } }
+        property SolValueWrapper^ Value { SolValueWrapper^ get() { return _value; } }
+    };
+
+
     public ref class SolFileWrapper sealed
     {
     private:
         Dictionary<String^, SolValueWrapper^>^ _data;
+        SolStatsWrapper^ _readstats;
+        SolStatsWrapper^ _savestats;
+
+        // the snapshots for Undo and Redo, made on the first Commit
+        sol::SolHistory* _phistory;
 
     internal:
         sol::SolFile* _pfile;
         SolFileWrapper(sol::SolFile* pfile);
 
         void UpdateUnmanagedData();
+        void UpdateManagedData();
 
     public:
+        // keepRaw keeps the bytes read so that Save copies the entries left unchanged
+        // back as they were, it costs a copy of the file and a digest of each entry,
+        // so it is off unless the file is opened to be edited and saved
         SolFileWrapper(String^ path);
+        SolFileWrapper(String^ path, bool collectStats);
+        SolFileWrapper(String^ path, bool collectStats, bool keepRaw);
         ~SolFileWrapper();
 
     public:
@@ -109,9 +239,38 @@ namespace CefFlashBrowser::Sol
         property SolVersion Version { SolVersion get(); void set(SolVersion value); }
         property Dictionary<String^, SolValueWrapper^>^ Data { Dictionary<String^, SolValueWrapper^>^ get(); }
 
+        // what the last read and save did, null unless stats are collected,
+        // collecting costs little but is off unless asked for
+        property bool CollectStats { bool get(); void set(bool value); }
+        property SolStatsWrapper^ ReadStats { SolStatsWrapper^ get(); }
+        property SolStatsWrapper^ SaveStats { SolStatsWrapper^ get(); }
+
         void Save();
+
+        // Commit takes a snapshot of Data if it changed since the last one, Undo and
+        // Redo put Data back as it was at a snapshot and replace its wrappers, the
+        // snapshots share the entries they did not change with each other
+        property bool CanUndo { bool get(); }
+        property bool CanRedo { bool get(); }
+        void Commit();
+        bool Undo();
+        bool Redo();
+
         static SolFileWrapper^ ReadFile(String^ path);
+        static SolFileWrapper^ ReadFile(String^ path, bool collectStats);
+        static SolFileWrapper^ ReadFile(String^ path, bool collectStats, bool keepRaw);
         static SolFileWrapper^ CreateEmpty(String^ path);
+
+        // where the memory of the values and the bytes of the file go, the values
+        // are measured as Save would write them, limit 0 lists all of them
+        SolFootprintWrapper^ GetFootprint(SolFootprintOrder order, int limit);
+
+        // throws if the file would not decode, without reading it into memory
+        static void Validate(String^ path);
+
+        // the values at the paths the query matches, see query.h, read from the file
+        // without the values beside them, throws if the query or the file is malformed
+        static List<SolQueryMatch^>^ Query(String^ path, String^ query);
     };
 
 
@@ -157,6 +316,196 @@ namespace CefFlashBrowser::Sol
         property String^ Class { String^ get(); void set(String^ value); }
         property Dictionary<String^, SolValueWrapper^>^ Props { Dictionary<String^, SolValueWrapper^>^ get(); }
     };
+
+
+    public ref class SolDictionaryWrapper sealed
+    {
+    internal:
+        sol::SolDictionary* _pdict;
+        SolDictionaryWrapper(sol::SolDictionary* pdict);
+
+    public:
+        SolDictionaryWrapper();
+        ~SolDictionaryWrapper();
+
+    public:
+        property int Count { int get(); }
+        property bool WeakKeys { bool get(); void set(bool value); }
+        property List<SolValueWrapper^>^ Keys { List<SolValueWrapper^>^ get(); }
+
+        bool ContainsKey(Object^ key);
+        bool TryGetValue(Object^ key, [Runtime::InteropServices::Out] SolValueWrapper^% value);
+        void Set(Object^ key, Object^ value);
+        bool Remove(Object^ key);
+    };
+
+
+    // spans of where reading and saving spend their time, recorded in debug builds
+    // and in release builds compiled with SOL_TRACE=1, see trace.h
+    public ref class SolTrace abstract sealed
+    {
+    public:
+        static property bool Enabled { bool get(); }
+
+        // Chrome trace-event JSON, for chrome://tracing or Perfetto
+        static String^ ToJson();
+        static void Save(String^ path);
+        static void Clear();
+    };
+
+
+    // sol files as JSON and back without reading them into values, the layout
+    // is described in json.h, failures throw with the reason
+    public ref class SolJson abstract sealed
+    {
+    public:
+        static String^ ToJson(String^ solPath);
+        static void ExportFile(String^ solPath, String^ jsonPath);
+
+        // solPath is left out if the JSON cannot be written as a sol file
+        static void ImportFile(String^ jsonPath, String^ solPath);
+    };
+
+
+    // structural differences between sol files, see diff.h, failures throw with the reason
+    public ref class SolDiff abstract sealed
+    {
+    public:
+        // a line per change, empty if the files hold the same values
+        static String^ Compare(String^ fromPath, String^ toPath);
+
+        // returns whether the files differ, the patch is saved either way
+        static bool CreatePatch(String^ fromPath, String^ toPath, String^ patchPath);
+
+        static void ApplyPatch(String^ solPath, String^ patchPath, String^ outPath);
+    };
+
+
+    // a snapshot listed by SolSnapshotStoreWrapper
+    public ref class SolSnapshotEntry sealed
+    {
+    private:
+        long long _id;
+        DateTime _time;
+        long long _size;
+        int _chunks;
+
+    internal:
+        SolSnapshotEntry(const sol::SolSnapshot& snapshot);
+
+    public:
+        property long long Id { long long get() { return _id; } }
+        property DateTime Time { DateTime get() { return _time; } }
+        property long long Size { long long get() { return _size; } }
+        property int Chunks { int get() { return _chunks; } }
+    };
+
+
+    // the history of sol files, see snapshot.h, failures throw with the reason
+    public ref class SolSnapshotStoreWrapper sealed
+    {
+    internal:
+        sol::SolSnapshotStore* _pstore;
+
+    public:
+        SolSnapshotStoreWrapper(String^ root);
+        ~SolSnapshotStoreWrapper();
+
+    public:
+        // returns the id of the snapshot taken
+        long long Take(String^ name, String^ solPath);
+        void Restore(String^ name, long long id, String^ outPath);
+
+        List<String^>^ GetNames();
+        List<SolSnapshotEntry^>^ GetHistory(String^ name);
+    };
+
+
+    // many sol files in one archive, see archive.h, failures throw with the reason
+    public ref class SolArchive abstract sealed
+    {
+    public:
+        // packs every .sol file below dir, on one thread per core
+        static void Pack(String^ dir, String^ archivePath, bool compress);
+        static void Unpack(String^ archivePath, String^ dir);
+
+        // the names of the members, their paths relative to the packed directory
+        static List<String^>^ GetMembers(String^ archivePath);
+
+        // reads one member without the others
+        static void ExtractMember(String^ archivePath, String^ name, String^ outPath);
+    };
+
+
+    public enum class SolFileChangeKind
+    {
+        Added = (int)sol::SolFileChangeKind::Added,
+        Modified = (int)sol::SolFileChangeKind::Modified,
+        Removed = (int)sol::SolFileChangeKind::Removed
+    };
+
+
+    // a change reported by SolChangeTrackerWrapper, a removed file has only the path
+    public ref class SolFileChange sealed
+    {
+    private:
+        SolFileChangeKind _kind;
+        String^ _path;
+        long long _size;
+        DateTime _time;
+        bool _valid;
+        String^ _solname;
+        SolVersion _version;
+        String^ _errmsg;
+        SolFileWrapper^ _file;
+
+    internal:
+        SolFileChange(const sol::SolFileChange& change);
+
+    public:
+        property SolFileChangeKind Kind { SolFileChangeKind get() { return _kind; } }
+        property String^ Path { String^ get() { return _path; } }
+        property long long Size { long long get() { return _size; } }
+        property DateTime LastWriteTime { DateTime get() { return _time; } }
+        property bool IsValid { bool get() { return _valid; } }
+        property String^ SolName { String^ get() { return _solname; } }
+        property SolVersion Version { SolVersion get() { return _version; } }
+        property String^ ErrorMessage { String^ get() { return _errmsg; } }
+
+        // the file as read, null unless the tracker parses and the file is valid
+        property SolFileWrapper^ File { SolFileWrapper^ get() { return _file; } }
+    };
+
+
+    // the .sol files below a directory, see tracker.h, a FileSystemWatcher tells the
+    // tracker which paths to look at, Poll and Scan are to be called from one thread
+    public ref class SolChangeTrackerWrapper sealed
+    {
+    internal:
+        sol::SolChangeTracker* _ptracker;
+        IO::FileSystemWatcher^ _watcher;
+        bool _overflowed;
+
+        void OnChanged(Object^ sender, IO::FileSystemEventArgs^ e);
+        void OnRenamed(Object^ sender, IO::RenamedEventArgs^ e);
+        void OnError(Object^ sender, IO::ErrorEventArgs^ e);
+
+    public:
+        SolChangeTrackerWrapper(String^ root);
+        SolChangeTrackerWrapper(String^ root, bool parse, int debounceMilliseconds);
+        ~SolChangeTrackerWrapper();
+
+    public:
+        // the number of paths waiting for their writes to settle
+        property int Pending { int get(); }
+
+        // the changes to the files whose writes have settled, or to every file if the
+        // watcher lost events, as it does when they come faster than it can buffer them
+        List<SolFileChange^>^ Poll();
+
+        // looks at every file, the first scan lists all of them as added
+        List<SolFileChange^>^ Scan();
+    };
 }
 
 #endif // !__CLI_H__
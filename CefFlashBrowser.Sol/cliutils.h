@@ -0,0 +1,24 @@
+#ifndef __CLIUTILS_H__
+#define __CLIUTILS_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// conversions between the native core and .NET, only built into the C++/CLI wrappers
+namespace utils
+{
+    System::String^ ToSystemString(const std::string& str, bool utf8 = true);
+
+    std::string ToStdString(System::String^ str, bool utf8 = true);
+
+    array<System::Byte>^ ToByteArray(const std::vector<uint8_t>& vec);
+
+    std::vector<uint8_t> ToByteVector(array<System::Byte>^ arr);
+
+    System::DateTime ToSystemDateTime(double timestamp);
+
+    double ToTimestamp(System::DateTime datetime);
+}
+
+#endif // !__CLIUTILS_H__
@@ -0,0 +1,230 @@
+#ifndef __CODEC_H__
+#define __CODEC_H__
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <type_traits>
+
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
+
+// byte level primitives shared by the AMF readers and writers, loads and stores
+// are unchecked, callers check the remaining size once per value instead
+namespace sol::codec
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    constexpr bool NATIVE_BIG_ENDIAN = true;
+#else
+    constexpr bool NATIVE_BIG_ENDIAN = false; // msvc only targets little endian
+#endif
+
+    constexpr size_t U29_MAXSIZE = 4;
+
+    constexpr uint8_t SOL_MAGIC[] = { 0x00, 0xBF };
+    constexpr uint8_t SOL_CONSTANT[] = { 0x54, 0x43, 0x53, 0x4F, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00 };
+    constexpr size_t SOL_HEADER_MINSIZE = 18;
+
+    constexpr uint16_t AMF0_SHORTSTRING_MAXLEN = 0xFFFF;
+    constexpr uint32_t AMF0_LONGSTRING_MAXLEN = 0xFFFFFFFF;
+    constexpr uint32_t AMF3_INLINE_MAXLEN = 0x0FFFFFFF;
+    constexpr uint8_t AMF0_OBJECT_ENDMARK[] = { 0x00, 0x00, 0x09 };
+
+
+    template <typename T>
+    inline std::enable_if_t<std::is_integral_v<T>, T> ByteSwap(T value)
+    {
+        using U = std::make_unsigned_t<T>;
+        U v = static_cast<U>(value);
+
+        if constexpr (sizeof(T) == 1) {
+            return value;
+        }
+        else if constexpr (sizeof(T) == 2) {
+#ifdef _MSC_VER
+            return static_cast<T>(_byteswap_ushort(v));
+#else
+            return static_cast<T>(__builtin_bswap16(v));
+#endif
+        }
+        else if constexpr (sizeof(T) == 4) {
+#ifdef _MSC_VER
+            return static_cast<T>(_byteswap_ulong(v));
+#else
+            return static_cast<T>(__builtin_bswap32(v));
+#endif
+        }
+        else {
+            static_assert(sizeof(T) == 8, "unsupported integer size");
+#ifdef _MSC_VER
+            return static_cast<T>(_byteswap_uint64(v));
+#else
+            return static_cast<T>(__builtin_bswap64(v));
+#endif
+        }
+    }
+
+    template <typename T>
+    inline std::enable_if_t<std::is_integral_v<T>, T> FromBigEndian(T value)
+    {
+        if constexpr (NATIVE_BIG_ENDIAN) {
+            return value;
+        }
+        else {
+            return ByteSwap(value);
+        }
+    }
+
+    template <typename T>
+    inline std::enable_if_t<std::is_integral_v<T>, T> ToBigEndian(T value)
+    {
+        return FromBigEndian(value);
+    }
+
+
+    template <typename T>
+    inline T LoadBigEndian(const uint8_t* p)
+    {
+        T value;
+        memcpy(&value, p, sizeof(T));
+        return FromBigEndian(value);
+    }
+
+    inline double LoadDouble(const uint8_t* p)
+    {
+        uint64_t bits = LoadBigEndian<uint64_t>(p);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    template <typename T>
+    inline void StoreBigEndian(uint8_t* p, T value)
+    {
+        value = ToBigEndian(value);
+        memcpy(p, &value, sizeof(T));
+    }
+
+    inline void StoreDouble(uint8_t* p, double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        StoreBigEndian(p, bits);
+    }
+
+
+    // decodes an unsigned U29 and returns the number of bytes used, or 0 if
+    // avail is too short, with 4 bytes at hand no per-byte checks are needed
+    inline size_t DecodeU29(const uint8_t* p, size_t avail, uint32_t& out)
+    {
+        if (avail >= U29_MAXSIZE) {
+            uint32_t b0 = p[0];
+            if (b0 < 0x80) {
+                out = b0;
+                return 1;
+            }
+            uint32_t b1 = p[1];
+            if (b1 < 0x80) {
+                out = (b0 & 0x7F) << 7 | b1;
+                return 2;
+            }
+            uint32_t b2 = p[2];
+            if (b2 < 0x80) {
+                out = (b0 & 0x7F) << 14 | (b1 & 0x7F) << 7 | b2;
+                return 3;
+            }
+            out = (b0 & 0x7F) << 22 | (b1 & 0x7F) << 15 | (b2 & 0x7F) << 8 | p[3];
+            return 4;
+        }
+
+        // near the end of the input, a value here has at most 3 bytes
+        uint32_t result = 0;
+        for (size_t i = 0; i < avail; ++i) {
+            result = result << 7 | (p[i] & 0x7F);
+            if (!(p[i] & 0x80)) {
+                out = result;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    // encodes the low 29 bits of value and returns the number of bytes written
+    inline size_t EncodeU29(uint8_t* p, uint32_t value)
+    {
+        if (value < 0x80) {
+            p[0] = static_cast<uint8_t>(value);
+            return 1;
+        }
+        if (value < 0x4000) {
+            p[0] = static_cast<uint8_t>(value >> 7 | 0x80);
+            p[1] = static_cast<uint8_t>(value & 0x7F);
+            return 2;
+        }
+        if (value < 0x200000) {
+            p[0] = static_cast<uint8_t>(value >> 14 | 0x80);
+            p[1] = static_cast<uint8_t>(value >> 7 | 0x80);
+            p[2] = static_cast<uint8_t>(value & 0x7F);
+            return 3;
+        }
+        p[0] = static_cast<uint8_t>(value >> 22 | 0x80);
+        p[1] = static_cast<uint8_t>(value >> 15 | 0x80);
+        p[2] = static_cast<uint8_t>(value >> 8 | 0x80);
+        p[3] = static_cast<uint8_t>(value);
+        return 4;
+    }
+
+
+    template <typename T>
+    inline void AppendBigEndian(std::vector<uint8_t>& buffer, T value)
+    {
+        uint8_t tmp[sizeof(T)];
+        StoreBigEndian(tmp, value);
+        buffer.insert(buffer.end(), tmp, tmp + sizeof(T));
+    }
+
+    inline void AppendDouble(std::vector<uint8_t>& buffer, double value)
+    {
+        uint8_t tmp[sizeof(double)];
+        StoreDouble(tmp, value);
+        buffer.insert(buffer.end(), tmp, tmp + sizeof(double));
+    }
+
+    inline void AppendU29(std::vector<uint8_t>& buffer, uint32_t value)
+    {
+        if (value < 0x80) {
+            buffer.push_back(static_cast<uint8_t>(value));
+            return;
+        }
+        uint8_t tmp[U29_MAXSIZE];
+        size_t len = EncodeU29(tmp, value);
+        buffer.insert(buffer.end(), tmp, tmp + len);
+    }
+
+    // a length header followed by the payload, grown in one step
+    inline void AppendU29Bytes(std::vector<uint8_t>& buffer, uint32_t header, const void* data, size_t len)
+    {
+        uint8_t tmp[U29_MAXSIZE];
+        size_t headerlen = EncodeU29(tmp, header);
+        size_t pos = buffer.size();
+        buffer.resize(pos + headerlen + len);
+        memcpy(buffer.data() + pos, tmp, headerlen);
+        if (len != 0) {
+            memcpy(buffer.data() + pos + headerlen, data, len);
+        }
+    }
+
+    template <typename T>
+    inline void AppendBigEndianBytes(std::vector<uint8_t>& buffer, T header, const void* data, size_t len)
+    {
+        size_t pos = buffer.size();
+        buffer.resize(pos + sizeof(T) + len);
+        StoreBigEndian(buffer.data() + pos, header);
+        if (len != 0) {
+            memcpy(buffer.data() + pos + sizeof(T), data, len);
+        }
+    }
+}
+
+#endif // !__CODEC_H__
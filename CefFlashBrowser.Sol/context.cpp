@@ -0,0 +1,125 @@
+#include "context.h"
+#include "decoder.h"
+#include "encoder.h"
+#include "stats.h"
+#include "trace.h"
+#include "utils.h"
+
+
+struct sol::SolReaderContext::State
+{
+    utils::MappedFile file;
+    SolRefTable reftable;
+    std::vector<detail::ReadCost> objcost;
+    std::vector<bool> referenced;
+    detail::ReadStack frames;
+
+    void Clear()
+    {
+        // clear keeps the capacity, only what the values themselves hold is freed
+        file.close();
+        reftable.strpool.clear();
+        reftable.objpool.clear();
+        reftable.classpool.clear();
+        objcost.clear();
+        referenced.clear();
+        frames.clear();
+    }
+};
+
+struct sol::SolWriterContext::State
+{
+    std::vector<uint8_t> buffer;
+    SolWriteRefTable reftable;
+};
+
+
+sol::SolReaderContext::SolReaderContext()
+    : _state(std::make_unique<State>())
+{
+}
+
+sol::SolReaderContext::~SolReaderContext() = default;
+
+bool sol::SolReaderContext::tryread(SolFile& file, SolError& error, const SolReadOptions& options)
+{
+    SOL_TRACE_SCOPE("read sol file");
+    State& s = *_state;
+    error = SolError();
+
+    bool opened;
+    {
+        SOL_TRACE_SCOPE("read file");
+        detail::StatTimer timer(options.stats, &SolStats::iotime);
+        opened = s.file.open(file.path);
+    }
+    if (!opened) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
+    }
+
+    SOL_TRACE_SCOPE("decode file");
+    detail::StatTimer timer(options.stats, &SolStats::decodetime);
+    detail::Reader r{ s.file.data(), s.file.size(), 0, error, options };
+    r.objcost = std::move(s.objcost);
+    r.referenced = std::move(s.referenced);
+    r.frames = &s.frames;
+
+    bool result = detail::DecodeSolFile(r, file, s.reftable);
+
+    s.objcost = std::move(r.objcost);
+    s.referenced = std::move(r.referenced);
+    s.Clear();
+    return result;
+}
+
+bool sol::SolReaderContext::read(SolFile& file, const SolReadOptions& options)
+{
+    try {
+        SolError error;
+        if (tryread(file, error, options)) {
+            return true;
+        }
+        file.errmsg = error.message();
+        return false;
+    }
+    catch (const std::exception& e) {
+        _state->Clear();
+        file.errmsg = e.what();
+        return false;
+    }
+}
+
+void sol::SolReaderContext::release()
+{
+    _state = std::make_unique<State>();
+}
+
+
+sol::SolWriterContext::SolWriterContext()
+    : _state(std::make_unique<State>())
+{
+}
+
+sol::SolWriterContext::~SolWriterContext() = default;
+
+bool sol::SolWriterContext::write(SolFile& file, const SolWriteOptions& options)
+{
+    State& s = *_state;
+    s.buffer.clear();
+    s.reftable.clear();
+
+    try {
+        detail::WriteSolFile(s.buffer, s.reftable, file, options);
+        return true;
+    }
+    catch (const std::exception& e) {
+        file.errmsg = e.what();
+        return false;
+    }
+}
+
+void sol::SolWriterContext::release()
+{
+    _state = std::make_unique<State>();
+}
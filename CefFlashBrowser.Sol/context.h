@@ -0,0 +1,57 @@
+#ifndef __CONTEXT_H__
+#define __CONTEXT_H__
+
+#include "sol.h"
+#include <memory>
+
+namespace sol
+{
+    // reads files one after another with the same file buffer, reference tables and
+    // decoder stack, which are cleared between files but not freed, so that a batch
+    // settles into allocating only the values it returns, a context is meant to be
+    // kept by one worker thread and must not be used by two threads at once
+    class SolReaderContext
+    {
+    public:
+        SolReaderContext();
+        ~SolReaderContext();
+
+        SolReaderContext(const SolReaderContext&) = delete;
+        SolReaderContext& operator=(const SolReaderContext&) = delete;
+
+        // as ReadSolFile and TryReadSolFile
+        bool read(SolFile& file, const SolReadOptions& options = SolReadOptions());
+        bool tryread(SolFile& file, SolError& error, const SolReadOptions& options = SolReadOptions());
+
+        // frees what the context has kept, for after an unusually large file
+        void release();
+
+    private:
+        struct State;
+        std::unique_ptr<State> _state;
+    };
+
+
+    // writes files one after another with the same output buffer and reference
+    // tables, see SolReaderContext
+    class SolWriterContext
+    {
+    public:
+        SolWriterContext();
+        ~SolWriterContext();
+
+        SolWriterContext(const SolWriterContext&) = delete;
+        SolWriterContext& operator=(const SolWriterContext&) = delete;
+
+        // as WriteSolFile, entries encoded on other threads still use buffers of their own
+        bool write(SolFile& file, const SolWriteOptions& options = SolWriteOptions());
+
+        void release();
+
+    private:
+        struct State;
+        std::unique_ptr<State> _state;
+    };
+}
+
+#endif // !__CONTEXT_H__
@@ -0,0 +1,1062 @@
+#include "decoder.h"
+#include "skipper.h"
+#include "stats.h"
+#include "trace.h"
+#include "visit.h"
+#include <algorithm>
+
+
+namespace
+{
+    using sol::detail::RawMark;
+    using sol::detail::Reader;
+    using sol::detail::ReadCost;
+    using sol::detail::ReadFrame;
+    using sol::detail::ReadFrameState;
+    using sol::detail::ReadStack;
+
+    // every element of a container takes at least minsize bytes of input, so a count
+    // the rest of the input cannot hold is rejected before anything is reserved
+    template <typename TType>
+    bool CheckCount(Reader& r, uint64_t count, size_t minsize, TType type)
+    {
+        if (count > (r.size - r.index) / minsize) {
+            return r.Fail(sol::SolErrorCode::CountTooLarge, r.index, static_cast<int>(type),
+                std::is_same_v<TType, sol::AMF0Type>, static_cast<int64_t>(count));
+        }
+        return r.Charge(0, count * sizeof(sol::SolValue));
+    }
+
+    template <typename TType>
+    bool CheckStringLength(Reader& r, size_t len, TType type)
+    {
+        if (len > r.options.maxstring) {
+            return r.Fail(sol::SolErrorCode::StringTooLong, r.index, static_cast<int>(type),
+                std::is_same_v<TType, sol::AMF0Type>, static_cast<int64_t>(len), r.options.maxstring);
+        }
+        return r.Charge(0, len);
+    }
+
+    void SetObjCost(Reader& r, size_t objref, ReadCost cost)
+    {
+        if (r.objcost.size() <= objref) {
+            r.objcost.resize(objref + 1);
+        }
+        r.objcost[objref] = cost;
+    }
+
+    // copies an objpool entry, charging what the entry cost when it was decoded
+    bool CopyObjRef(Reader& r, sol::SolRefTable& reftable, size_t ref, size_t offset, sol::SolValue& out)
+    {
+        if (!CheckRefIndex(r, reftable.objpool, ref, offset)) {
+            return false;
+        }
+        ++r.refs;
+        r.minobjref = std::min(r.minobjref, ref);
+        if (r.options.stats) {
+            ++r.options.stats->objrefs;
+        }
+        if (ref < r.objcost.size() && !r.Charge(r.objcost[ref].nodes, r.objcost[ref].bytes)) {
+            return false;
+        }
+        out = reftable.objpool[ref];
+        return true;
+    }
+
+    uint64_t ClassDefBytes(const sol::SolClassDef& classdef)
+    {
+        uint64_t bytes = classdef.name.size() + classdef.members.size() * sizeof(std::string);
+        for (auto& member : classdef.members) {
+            bytes += member.size();
+        }
+        return bytes;
+    }
+
+    // xml, binary and date share the object reference table
+    bool DecodeObjRef(Reader& r, sol::SolRefTable& reftable, sol::SolValue& out, size_t& len, bool& inlined)
+    {
+        size_t start = r.index;
+        sol::SolInteger ref;
+        if (!DecodeInteger(r, ref, true)) {
+            return false;
+        }
+
+        inlined = (ref & 1) != 0;
+        len = ref >> 1;
+
+        if (!inlined) {
+            return CopyObjRef(r, reftable, len, start, out);
+        }
+        return true;
+    }
+
+    size_t NewObjRef(sol::SolRefTable& reftable)
+    {
+        // the reference index is taken before the members are read, as flash player does
+        reftable.objpool.emplace_back();
+        return reftable.objpool.size() - 1;
+    }
+
+    bool PushReadFrame(Reader& r, ReadStack& stack, ReadFrameState state,
+        sol::SolValue&& value, size_t objref, uint32_t remaining)
+    {
+        if (stack.size() >= r.options.maxdepth) {
+            return r.Fail(sol::SolErrorCode::MaxDepthExceeded, r.index, -1, false, 0, r.options.maxdepth);
+        }
+        stack.emplace_back(state, std::move(value), objref, remaining, r.spent);
+
+        // references inside the container are told apart from those outside it
+        if (r.subtrees) {
+            RawMark& raw = stack.back().raw;
+            raw = r.mark;
+            raw.minobjref = r.minobjref;
+            raw.depth = static_cast<uint32_t>(stack.size() - 1);
+            r.minobjref = SIZE_MAX;
+        }
+        return true;
+    }
+
+    void MarkRawValue(Reader& r, const sol::SolRefTable& reftable)
+    {
+        r.mark.begin = r.index;
+        r.mark.strs = reftable.strpool.size();
+        r.mark.classes = reftable.classpool.size();
+        r.mark.refs = r.refs;
+    }
+
+    // the marker a container was read with, AMF0 has several for the same storage
+    uint8_t FrameMarker(const ReadFrame& frame)
+    {
+        switch (frame.state)
+        {
+        case ReadFrameState::AMF0Object:
+            return static_cast<uint8_t>(frame.value.get<sol::SolObject>().classdef.name.empty()
+                ? sol::AMF0Type::Object : sol::AMF0Type::TypedObject);
+        case ReadFrameState::AMF0EcmaArray:
+            return static_cast<uint8_t>(sol::AMF0Type::EcmaArray);
+        case ReadFrameState::AMF0StrictArray:
+            return static_cast<uint8_t>(sol::AMF0Type::StrictArray);
+        default:
+            return static_cast<uint8_t>(frame.value.type);
+        }
+    }
+
+    // counts a value begun at start, with its marker, a container is counted as it is
+    // pushed and its storage once it is complete, anything else as a whole
+    template <typename TType>
+    void CountValue(Reader& r, TType type, size_t start, const sol::SolValue& value, size_t depth, bool pushed)
+    {
+        sol::SolStats& stats = *r.options.stats;
+        sol::SolTypeStats& counted = stats.types[static_cast<uint8_t>(type)];
+
+        ++counted.nodes;
+        counted.bytes += r.index - start + 1;
+        stats.maxdepth = std::max(stats.maxdepth, static_cast<uint32_t>(pushed ? depth : depth + 1));
+
+        if (pushed) {
+            return;
+        }
+        if (value.type == sol::SolType::Array || value.type == sol::SolType::Object || value.type == sol::SolType::Dictionary) {
+            // a reference copies the whole container
+            sol::WalkSolValue(value, [&](const sol::SolValue& item) { stats.allocations += sol::detail::HeapBlocks(item); });
+        }
+        else {
+            stats.allocations += sol::detail::HeapBlocks(value);
+        }
+    }
+
+    // the keys and end marks of a container are counted as its bytes
+    void CountMembers(Reader& r, const ReadFrame& frame, size_t bytes)
+    {
+        r.options.stats->types[FrameMarker(frame)].bytes += bytes;
+    }
+
+    template <typename TType, typename TBegin, typename TNext>
+    bool DecodeWithStack(Reader& r, sol::SolRefTable& reftable, TType type, sol::SolValue& result, TBegin&& begin, TNext&& next)
+    {
+        ReadStack local;
+        ReadStack& stack = r.frames ? *r.frames : local;
+        sol::SolValue value;
+        bool more;
+
+        stack.clear();
+
+        size_t start = r.index;
+        if (!begin(type, value, stack)) {
+            return false;
+        }
+        if (r.options.stats) {
+            CountValue(r, type, start, value, stack.size(), !stack.empty());
+        }
+        if (stack.empty()) {
+            result = std::move(value);
+            return true;
+        }
+
+        while (true) {
+            size_t depth = stack.size();
+
+            start = r.index;
+            if (!next(stack.back(), type, more)) {
+                return false;
+            }
+            if (r.options.stats) {
+                // the marker of the next child is its own
+                CountMembers(r, stack.back(), r.index - start - (more ? 1 : 0));
+            }
+            if (more) {
+                start = r.index;
+                if (!begin(type, value, stack)) {
+                    return false;
+                }
+                if (r.options.stats) {
+                    CountValue(r, type, start, value, stack.size(), stack.size() != depth);
+                }
+                if (stack.size() == depth) {
+                    AttachChild(stack.back(), std::move(value));
+                }
+                continue;
+            }
+
+            // the container on top of the stack is complete
+            CompleteFrame(r, reftable, stack.back());
+            value = std::move(stack.back().value);
+            stack.pop_back();
+
+            if (r.options.stats) {
+                r.options.stats->allocations += sol::detail::HeapBlocks(value);
+            }
+
+            if (stack.empty()) {
+                result = std::move(value);
+                return true;
+            }
+            AttachChild(stack.back(), std::move(value));
+        }
+    }
+}
+
+
+bool sol::detail::DecodeString(Reader& r, sol::SolRefTable& reftable, std::string& out)
+{
+    size_t start = r.index;
+    sol::SolInteger ref;
+    if (!DecodeInteger(r, ref, true)) {
+        return false;
+    }
+
+    if ((ref & 1) == 0) {
+        if (!CheckRefIndex(r, reftable.strpool, ref >> 1, start)
+            || !r.Charge(0, reftable.strpool[ref >> 1].size())) {
+            return false;
+        }
+        ++r.refs;
+        if (r.options.stats) {
+            ++r.options.stats->strrefs;
+        }
+        out = reftable.strpool[ref >> 1];
+        return true;
+    }
+
+    size_t len = ref >> 1;
+
+    if (len > r.size - r.index) {
+        return r.Truncated(sol::SolType::String);
+    }
+    if (!CheckStringLength(r, len, sol::SolType::String)) {
+        return false;
+    }
+
+    out.assign(reinterpret_cast<const char*>(r.data + r.index), len);
+    r.index += len;
+
+    if (len != 0) {
+        reftable.strpool.push_back(out);
+    }
+    return true;
+}
+
+bool sol::detail::DecodeXml(Reader& r, sol::SolRefTable& reftable, sol::SolType xmltype, sol::SolValue& out)
+{
+    size_t len;
+    bool inlined;
+    if (!DecodeObjRef(r, reftable, out, len, inlined)) {
+        return false;
+    }
+    if (!inlined) {
+        return true;
+    }
+
+    if (len > r.size - r.index) {
+        return r.Truncated(xmltype);
+    }
+    if (!CheckStringLength(r, len, xmltype)) {
+        return false;
+    }
+
+    out = sol::SolValue(xmltype, std::string(r.data + r.index, r.data + r.index + len));
+    r.index += len;
+
+    reftable.objpool.push_back(r.Referenced(reftable.objpool.size()) ? out : sol::SolValue());
+    SetObjCost(r, reftable.objpool.size() - 1, { 1, len });
+    return true;
+}
+
+bool sol::detail::DecodeBinary(Reader& r, sol::SolRefTable& reftable, sol::SolValue& out)
+{
+    size_t len;
+    bool inlined;
+    if (!DecodeObjRef(r, reftable, out, len, inlined)) {
+        return false;
+    }
+    if (!inlined) {
+        return true;
+    }
+
+    if (len > r.size - r.index) {
+        return r.Truncated(sol::SolType::Binary);
+    }
+    if (!CheckStringLength(r, len, sol::SolType::Binary)) {
+        return false;
+    }
+
+    out = sol::SolBinary(r.data + r.index, r.data + r.index + len);
+    r.index += len;
+
+    reftable.objpool.push_back(r.Referenced(reftable.objpool.size()) ? out : sol::SolValue());
+    SetObjCost(r, reftable.objpool.size() - 1, { 1, len });
+    return true;
+}
+
+bool sol::detail::DecodeDate(Reader& r, sol::SolRefTable& reftable, sol::SolValue& out)
+{
+    size_t len;
+    bool inlined;
+    if (!DecodeObjRef(r, reftable, out, len, inlined)) {
+        return false;
+    }
+    if (!inlined) {
+        return true;
+    }
+
+    double timestamp;
+    if (!DecodeDouble(r, timestamp, sol::SolType::Double)) {
+        return false;
+    }
+
+    out = sol::SolValue(sol::SolType::Date, timestamp);
+    reftable.objpool.push_back(r.Referenced(reftable.objpool.size()) ? out : sol::SolValue());
+    SetObjCost(r, reftable.objpool.size() - 1, { 1, 0 });
+    return true;
+}
+
+bool sol::detail::DecodeAMF0Boolean(Reader& r, bool& out)
+{
+    if (r.index >= r.size) {
+        return r.Truncated(sol::AMF0Type::Boolean);
+    }
+    out = r.data[r.index++] != 0x00;
+    return true;
+}
+
+bool sol::detail::DecodeAMF0ShortString(Reader& r, std::string& out)
+{
+    uint16_t len;
+    if (!DecodeBigEndian(r, len)) {
+        return false;
+    }
+
+    if (len > r.size - r.index) {
+        return r.Truncated(sol::AMF0Type::String);
+    }
+    if (!CheckStringLength(r, len, sol::AMF0Type::String)) {
+        return false;
+    }
+
+    out.assign(reinterpret_cast<const char*>(r.data + r.index), len);
+    r.index += len;
+    return true;
+}
+
+bool sol::detail::DecodeAMF0LongString(Reader& r, std::string& out)
+{
+    uint32_t len;
+    if (!DecodeBigEndian(r, len)) {
+        return false;
+    }
+
+    if (len > r.size - r.index) {
+        return r.Truncated(sol::AMF0Type::LongString);
+    }
+    if (!CheckStringLength(r, len, sol::AMF0Type::LongString)) {
+        return false;
+    }
+
+    out.assign(reinterpret_cast<const char*>(r.data + r.index), len);
+    r.index += len;
+    return true;
+}
+
+bool sol::detail::DecodeAMF0Date(Reader& r, sol::SolValue& out)
+{
+    // 16 bit timezone, unused, then the timestamp
+    if (10 > r.size - r.index) {
+        return r.Truncated(sol::AMF0Type::Date);
+    }
+    out = sol::SolValue(sol::SolType::Date, sol::codec::LoadDouble(r.data + r.index + 2));
+    r.index += 10;
+    return true;
+}
+
+bool sol::detail::DecodeAMF0Reference(Reader& r, sol::SolRefTable& reftable, sol::SolValue& out)
+{
+    size_t start = r.index;
+    uint16_t ref;
+    if (!DecodeBigEndian(r, ref)) {
+        return false;
+    }
+    return CopyObjRef(r, reftable, ref, start, out);
+}
+
+void sol::detail::AttachChild(ReadFrame& frame, sol::SolValue&& child)
+{
+    switch (frame.state)
+    {
+    case ReadFrameState::ArrayAssoc:
+    case ReadFrameState::AMF0EcmaArray:
+        frame.value.get<sol::SolArray>().assoc[frame.key] = std::move(child);
+        break;
+
+    case ReadFrameState::ArrayDense:
+    case ReadFrameState::AMF0StrictArray:
+        frame.value.get<sol::SolArray>().dense.push_back(std::move(child));
+        break;
+
+    case ReadFrameState::ObjectSealed:
+    case ReadFrameState::ObjectDynamic:
+    case ReadFrameState::AMF0Object:
+        frame.value.get<sol::SolObject>().props[frame.key] = std::move(child);
+        break;
+
+    case ReadFrameState::DictionaryKey:
+        frame.dictkey = std::move(child);
+        frame.state = ReadFrameState::DictionaryValue;
+        break;
+
+    case ReadFrameState::DictionaryValue:
+        frame.value.get<sol::SolDictionary>()[frame.dictkey] = std::move(child);
+        frame.state = ReadFrameState::DictionaryKey;
+        break;
+    }
+}
+
+void sol::detail::CompleteFrame(Reader& r, sol::SolRefTable& reftable, ReadFrame& frame)
+{
+    // a copy of every container would copy each one again for every container
+    // around it, so only the ones a reference is followed to are kept
+    if (r.Referenced(frame.objref)) {
+        reftable.objpool[frame.objref] = frame.value;
+    }
+    SetObjCost(r, frame.objref, { r.spent.nodes - frame.start.nodes, r.spent.bytes - frame.start.bytes });
+
+    if (r.subtrees) {
+        size_t minobjref = r.minobjref;
+        r.minobjref = std::min(frame.raw.minobjref, minobjref);
+
+        if (frame.raw.depth >= 1 && frame.raw.depth <= RAW_SUBTREE_DEPTH && r.index - frame.raw.begin >= RAW_SUBTREE_MINSIZE) {
+            SolRawSubtree subtree{};
+            subtree.begin = frame.raw.begin;
+            subtree.end = r.index;
+            subtree.strbegin = frame.raw.strs;
+            subtree.strend = reftable.strpool.size();
+            subtree.classbegin = frame.raw.classes;
+            subtree.classend = reftable.classpool.size();
+            subtree.objbegin = frame.objref;
+            subtree.objend = reftable.objpool.size();
+            subtree.hash = SolValueHash()(frame.value);
+            subtree.digest = SolValueDigest()(frame.value);
+            subtree.refs = r.refs != frame.raw.refs;
+            subtree.external = minobjref < frame.objref;
+            subtree.marker = FrameMarker(frame);
+            r.subtrees->push_back(subtree);
+        }
+    }
+}
+
+// reads a value of the given type into out, or, if the value is a container,
+// pushes a frame for it, returns false on error
+bool sol::detail::BeginSolValue(Reader& r, sol::SolRefTable& reftable, sol::SolType type, sol::SolValue& out, ReadStack& stack)
+{
+    using namespace sol;
+
+    if (!r.Charge(1, 0)) {
+        return false;
+    }
+    if (r.subtrees) {
+        MarkRawValue(r, reftable);
+    }
+
+    if (!IsKnownType(type)) {
+        return r.Fail(SolErrorCode::UnknownType, r.index - 1, static_cast<int>(type));
+    }
+
+    bool container = false;
+
+    bool ok = VisitSolType(type, [&](auto def) {
+        using TStorage = typename decltype(def)::storage;
+        constexpr SolType t = decltype(def)::type;
+
+        if constexpr (std::is_same_v<TStorage, SolNull>) {
+            out = SolValue(t, nullptr);
+            return true;
+        }
+        else if constexpr (std::is_same_v<TStorage, SolBoolean>) {
+            out = t == SolType::BooleanTrue;
+            return true;
+        }
+        else if constexpr (std::is_same_v<TStorage, SolInteger>) {
+            SolInteger result;
+            if (!DecodeInteger(r, result)) {
+                return false;
+            }
+            out = result;
+            return true;
+        }
+        else if constexpr (t == SolType::Double) {
+            SolDouble result;
+            if (!DecodeDouble(r, result, SolType::Double)) {
+                return false;
+            }
+            out = result;
+            return true;
+        }
+        else if constexpr (t == SolType::Date) {
+            return DecodeDate(r, reftable, out);
+        }
+        else if constexpr (t == SolType::String) {
+            std::string result;
+            if (!DecodeString(r, reftable, result)) {
+                return false;
+            }
+            out = std::move(result);
+            return true;
+        }
+        else if constexpr (t == SolType::XmlDoc || t == SolType::Xml) {
+            return DecodeXml(r, reftable, t, out);
+        }
+        else if constexpr (std::is_same_v<TStorage, SolBinary>) {
+            return DecodeBinary(r, reftable, out);
+        }
+        else if constexpr (std::is_same_v<TStorage, SolArray>
+            || std::is_same_v<TStorage, SolObject>
+            || std::is_same_v<TStorage, SolDictionary>) {
+            // read below, they share the reference header
+            container = true;
+            return true;
+        }
+        else {
+            static_assert(DependentFalse<decltype(def)>, "BeginSolValue does not handle this type");
+        }
+    });
+
+    if (!ok || !container) {
+        return ok;
+    }
+
+    size_t start = r.index;
+    SolInteger ref;
+    if (!DecodeInteger(r, ref, true)) {
+        return false;
+    }
+
+    if ((ref & 1) == 0) {
+        return CopyObjRef(r, reftable, ref >> 1, start, out);
+    }
+
+    if (type == SolType::Array) {
+        uint32_t len = ref >> 1;
+        if (!CheckCount(r, len, 1, type)) {
+            return false;
+        }
+        SolArray result;
+        result.dense.reserve(len);
+        return PushReadFrame(r, stack, ReadFrameState::ArrayAssoc, std::move(result), NewObjRef(reftable), len);
+    }
+    else if (type == SolType::Object) {
+        SolObject result;
+        int classref = ref >> 1;
+
+        if ((classref & 1) == 0) {
+            int classindex = classref >> 1;
+            if (!CheckRefIndex(r, reftable.classpool, classindex, start)
+                || !r.Charge(0, ClassDefBytes(reftable.classpool[classindex]))) {
+                return false;
+            }
+            result.classdef = reftable.classpool[classindex];
+            ++r.refs;
+            if (r.options.stats) {
+                ++r.options.stats->classrefs;
+            }
+        }
+        else {
+            result.classdef.externalizable = (classref >> 1) & 1;
+            result.classdef.dynamic = (classref >> 2) & 1;
+
+            int membernum = classref >> 3;
+
+            if (result.classdef.externalizable) {
+                return r.Fail(SolErrorCode::Externalizable, start, static_cast<int>(type));
+            }
+
+            if (!DecodeString(r, reftable, result.classdef.name)) {
+                return false;
+            }
+
+            if (!CheckCount(r, membernum, 1, type)) {
+                return false;
+            }
+            result.classdef.members.reserve(membernum);
+            for (int i = 0; i < membernum; ++i) {
+                std::string member;
+                if (!DecodeString(r, reftable, member)) {
+                    return false;
+                }
+                result.classdef.members.push_back(std::move(member));
+            }
+
+            if (reftable.classpool.size() >= r.options.maxclasses) {
+                return r.Fail(SolErrorCode::TooManyClasses, start, static_cast<int>(type), false,
+                    static_cast<int64_t>(reftable.classpool.size() + 1), r.options.maxclasses);
+            }
+            reftable.classpool.push_back(result.classdef);
+        }
+
+        return PushReadFrame(r, stack, ReadFrameState::ObjectSealed, std::move(result), NewObjRef(reftable), 0);
+    }
+    else {
+        uint32_t len = ref >> 1;
+        uint8_t weakkeys;
+        if (!DecodeByte(r, weakkeys)) {
+            return false;
+        }
+        if (!CheckCount(r, len, 2, type)) {
+            return false;
+        }
+        SolDictionary result;
+        result.weakkeys = weakkeys != 0x00;
+        result.reserve(len);
+        return PushReadFrame(r, stack, ReadFrameState::DictionaryKey, std::move(result), NewObjRef(reftable), len);
+    }
+}
+
+// reads the key and type of the next child of an AMF3 container,
+// more is set to false if the container is complete, returns false on error
+bool sol::detail::NextSolChild(Reader& r, sol::SolRefTable& reftable, ReadFrame& frame, sol::SolType& type, bool& more)
+{
+    using namespace sol;
+
+    more = false;
+
+    switch (frame.state)
+    {
+    case ReadFrameState::ArrayAssoc:
+        if (!DecodeString(r, reftable, frame.key)) {
+            return false;
+        }
+        if (!frame.key.empty()) {
+            break;
+        }
+        frame.state = ReadFrameState::ArrayDense;
+        [[fallthrough]];
+
+    case ReadFrameState::ArrayDense:
+        if (frame.remaining == 0) {
+            return true;
+        }
+        --frame.remaining;
+        break;
+
+    case ReadFrameState::ObjectSealed: {
+        auto& classdef = frame.value.get<SolObject>().classdef;
+        if (frame.remaining < classdef.members.size()) {
+            frame.key = classdef.members[frame.remaining++];
+            break;
+        }
+        if (!classdef.dynamic) {
+            return true;
+        }
+        frame.state = ReadFrameState::ObjectDynamic;
+        [[fallthrough]];
+    }
+
+    case ReadFrameState::ObjectDynamic:
+        if (!DecodeString(r, reftable, frame.key)) {
+            return false;
+        }
+        if (frame.key.empty()) {
+            return true;
+        }
+        break;
+
+    case ReadFrameState::DictionaryKey:
+        if (frame.remaining == 0) {
+            return true;
+        }
+        --frame.remaining;
+        break;
+
+    case ReadFrameState::DictionaryValue:
+        break;
+
+    default:
+        return true;
+    }
+
+    uint8_t marker;
+    if (!DecodeByte(r, marker)) {
+        return false;
+    }
+    type = static_cast<SolType>(marker);
+    more = true;
+    return true;
+}
+
+bool sol::detail::BeginAMF0Value(Reader& r, sol::SolRefTable& reftable, sol::AMF0Type type, sol::SolValue& out, ReadStack& stack)
+{
+    using namespace sol;
+
+    if (!r.Charge(1, 0)) {
+        return false;
+    }
+    if (r.subtrees) {
+        MarkRawValue(r, reftable);
+    }
+
+    if (!IsKnownAMF0Type(type)) {
+        return r.Fail(SolErrorCode::UnknownType, r.index - 1, static_cast<int>(type), true);
+    }
+
+    return VisitAMF0Type(type, [&](auto def) {
+        using TStorage = typename decltype(def)::storage;
+        constexpr AMF0Type amf0 = decltype(def)::amf0;
+
+        if constexpr (amf0 == AMF0Type::Reference) {
+            return DecodeAMF0Reference(r, reftable, out);
+        }
+        else if constexpr (std::is_void_v<TStorage>) {
+            return r.Fail(SolErrorCode::UnsupportedType, r.index - 1, static_cast<int>(type), true);
+        }
+        else if constexpr (amf0 == AMF0Type::Number) {
+            SolDouble result;
+            if (!DecodeDouble(r, result, AMF0Type::Number)) {
+                return false;
+            }
+            out = result;
+            return true;
+        }
+        else if constexpr (amf0 == AMF0Type::Boolean) {
+            SolBoolean result;
+            if (!DecodeAMF0Boolean(r, result)) {
+                return false;
+            }
+            out = result;
+            return true;
+        }
+        else if constexpr (amf0 == AMF0Type::Null) {
+            out = nullptr;
+            return true;
+        }
+        else if constexpr (amf0 == AMF0Type::Undefined) {
+            out = SolValue(SolType::Undefined, nullptr);
+            return true;
+        }
+        else if constexpr (amf0 == AMF0Type::Date) {
+            return DecodeAMF0Date(r, out);
+        }
+        else if constexpr (amf0 == AMF0Type::String) {
+            std::string result;
+            if (!DecodeAMF0ShortString(r, result)) {
+                return false;
+            }
+            out = std::move(result);
+            return true;
+        }
+        else if constexpr (amf0 == AMF0Type::LongString || amf0 == AMF0Type::XMLDoc) {
+            std::string result;
+            if (!DecodeAMF0LongString(r, result)) {
+                return false;
+            }
+            out = SolValue(amf0 == AMF0Type::XMLDoc ? SolType::XmlDoc : SolType::String, std::move(result));
+            return true;
+        }
+        else if constexpr (amf0 == AMF0Type::Object) {
+            return PushReadFrame(r, stack, ReadFrameState::AMF0Object, SolObject(), NewObjRef(reftable), 0);
+        }
+        else if constexpr (amf0 == AMF0Type::TypedObject) {
+            SolObject result;
+            if (!DecodeAMF0ShortString(r, result.classdef.name)) {
+                return false;
+            }
+            return PushReadFrame(r, stack, ReadFrameState::AMF0Object, std::move(result), NewObjRef(reftable), 0);
+        }
+        else if constexpr (amf0 == AMF0Type::EcmaArray) {
+            // each entry takes at least a key length and a type marker
+            uint32_t len;
+            if (!DecodeBigEndian(r, len) || !CheckCount(r, len, 3, type)) {
+                return false;
+            }
+            return PushReadFrame(r, stack, ReadFrameState::AMF0EcmaArray, SolArray(), NewObjRef(reftable), len);
+        }
+        else if constexpr (amf0 == AMF0Type::StrictArray) {
+            uint32_t len;
+            if (!DecodeBigEndian(r, len) || !CheckCount(r, len, 1, type)) {
+                return false;
+            }
+            SolArray result;
+            result.dense.reserve(len);
+            return PushReadFrame(r, stack, ReadFrameState::AMF0StrictArray, std::move(result), NewObjRef(reftable), len);
+        }
+        else {
+            static_assert(DependentFalse<decltype(def)>, "BeginAMF0Value does not handle this type");
+        }
+    });
+}
+
+// reads the key and type of the next child of an AMF0 container,
+// more is set to false if the container is complete, returns false on error
+bool sol::detail::NextAMF0Child(Reader& r, ReadFrame& frame, sol::AMF0Type& type, bool& more)
+{
+    using namespace sol;
+
+    more = false;
+
+    switch (frame.state)
+    {
+    case ReadFrameState::AMF0Object: {
+        if (!DecodeAMF0ShortString(r, frame.key)) {
+            return false;
+        }
+        if (!frame.key.empty()) {
+            break;
+        }
+        uint8_t marker;
+        if (!DecodeByte(r, marker)) {
+            return false;
+        }
+        if (marker != static_cast<uint8_t>(AMF0Type::ObjectEnd)) {
+            auto objtype = frame.value.get<SolObject>().classdef.name.empty() ? AMF0Type::Object : AMF0Type::TypedObject;
+            return r.Fail(SolErrorCode::BadFormat, r.index - 1, static_cast<int>(objtype), true,
+                marker, static_cast<int>(AMF0Type::ObjectEnd));
+        }
+        return true;
+    }
+
+    case ReadFrameState::AMF0EcmaArray:
+        if (frame.remaining > 0) {
+            --frame.remaining;
+            if (!DecodeAMF0ShortString(r, frame.key)) {
+                return false;
+            }
+            break;
+        }
+        for (uint8_t mark : codec::AMF0_OBJECT_ENDMARK) {
+            uint8_t read;
+            if (!DecodeByte(r, read)) {
+                return false;
+            }
+            if (read != mark) {
+                return r.Fail(SolErrorCode::BadFormat, r.index - 1, static_cast<int>(AMF0Type::EcmaArray), true, read, mark);
+            }
+        }
+        return true;
+
+    case ReadFrameState::AMF0StrictArray:
+        if (frame.remaining == 0) {
+            return true;
+        }
+        --frame.remaining;
+        break;
+
+    default:
+        return true;
+    }
+
+    uint8_t marker;
+    if (!DecodeByte(r, marker)) {
+        return false;
+    }
+    type = static_cast<AMF0Type>(marker);
+    more = true;
+    return true;
+}
+
+bool sol::detail::DecodeValue(Reader& r, sol::SolRefTable& reftable, sol::SolType type, sol::SolValue& result)
+{
+    return DecodeWithStack(r, reftable, type, result,
+        [&](sol::SolType type, sol::SolValue& out, ReadStack& stack) {
+            return BeginSolValue(r, reftable, type, out, stack);
+        },
+        [&](ReadFrame& frame, sol::SolType& type, bool& more) {
+            return NextSolChild(r, reftable, frame, type, more);
+        });
+}
+
+bool sol::detail::DecodeAMF0Value(Reader& r, sol::SolRefTable& reftable, sol::AMF0Type type, sol::SolValue& result)
+{
+    return DecodeWithStack(r, reftable, type, result,
+        [&](sol::AMF0Type type, sol::SolValue& out, ReadStack& stack) {
+            return BeginAMF0Value(r, reftable, type, out, stack);
+        },
+        [&](ReadFrame& frame, sol::AMF0Type& type, bool& more) {
+            return NextAMF0Child(r, frame, type, more);
+        });
+}
+
+bool sol::detail::DecodeSolHeader(Reader& r, sol::SolFile& file, uint32_t& chunksize, bool wholefile)
+{
+    using namespace sol;
+
+    if (memcmp(r.data + r.index, codec::SOL_MAGIC, 2) != 0) {
+        return r.Fail(SolErrorCode::MagicMismatch, r.index);
+    }
+    r.index += 2;
+
+    if (!DecodeBigEndian(r, chunksize)) {
+        return false;
+    }
+    if (wholefile && chunksize != r.size - 6) {
+        return r.Fail(SolErrorCode::ChunkSizeMismatch, 2, -1, false, chunksize, static_cast<int64_t>(r.size - 6));
+    }
+
+    if (memcmp(r.data + r.index, codec::SOL_CONSTANT, 10) != 0) {
+        return r.Fail(SolErrorCode::ConstantMismatch, r.index);
+    }
+    r.index += 10;
+
+    uint32_t version;
+    if (!DecodeAMF0ShortString(r, file.solname) || !DecodeBigEndian(r, version)) {
+        return false;
+    }
+    file.version = static_cast<SolVersion>(version);
+
+    if (file.version != SolVersion::AMF0 && file.version != SolVersion::AMF3) {
+        return r.Fail(SolErrorCode::UnsupportedVersion, r.index - 4, -1, false, version);
+    }
+    return true;
+}
+
+bool sol::detail::DecodeSolFile(Reader& r, sol::SolFile& file, sol::SolRefTable& reftable)
+{
+    using namespace sol;
+
+    if (r.size < codec::SOL_HEADER_MINSIZE) {
+        return r.Fail(SolErrorCode::FileTooSmall, 0);
+    }
+
+    // the skipper finds the objects that are referenced without building anything,
+    // if it fails the decode fails as well and reports where
+    {
+        SOL_TRACE_SCOPE("find references");
+        SolError error;
+        Reader scan{ r.data, r.size, r.index, error, r.options };
+        Skipper skipper{ scan };
+        r.referenced.clear();
+        skipper.referenced = &r.referenced;
+        r.copyall = !skipper.SkipSolFile();
+    }
+
+    uint32_t chunksize;
+    {
+        SOL_TRACE_SCOPE("check header");
+        if (!DecodeSolHeader(r, file, chunksize, true)) {
+            return false;
+        }
+    }
+
+    SolStats* stats = r.options.stats;
+    if (stats) {
+        stats->version = file.version;
+        stats->bytes += r.size;
+    }
+
+    std::string key;
+    SolValue value;
+    uint8_t marker;
+
+    std::shared_ptr<SolRawFile> raw;
+    if (r.options.keepraw) {
+        raw = std::make_shared<SolRawFile>();
+        raw->version = file.version;
+        raw->bytes.assign(r.data, r.data + r.size);
+        r.subtrees = &raw->subtrees;
+    }
+
+    while (r.index < r.size) {
+        SOL_TRACE_SPAN(span, "decode entry");
+        SolRawEntry entry{};
+        if (raw) {
+            entry.begin = r.index;
+            entry.strbegin = reftable.strpool.size();
+            entry.classbegin = reftable.classpool.size();
+            entry.objbegin = reftable.objpool.size();
+            r.refs = 0;
+            r.minobjref = SIZE_MAX;
+        }
+
+        if (file.version == SolVersion::AMF0) {
+            if (!DecodeAMF0ShortString(r, key)) {
+                return false;
+            }
+            SOL_TRACE_NOTE(span, key);
+            if (!DecodeByte(r, marker) || !DecodeAMF0Value(r, reftable, static_cast<AMF0Type>(marker), value)) {
+                return false;
+            }
+        }
+        else {
+            if (!DecodeString(r, reftable, key)) {
+                return false;
+            }
+            SOL_TRACE_NOTE(span, key);
+            if (!DecodeByte(r, marker) || !DecodeValue(r, reftable, static_cast<SolType>(marker), value)) {
+                return false;
+            }
+        }
+
+        if (raw) {
+            entry.key = key;
+            entry.hash = SolValueHash()(value);
+            entry.digest = SolValueDigest()(value);
+        }
+        if (stats) {
+            stats->allocations += 1 + detail::HeapBlocks(key);
+        }
+        file.data[key] = std::move(value);
+
+        if (!DecodeByte(r, marker)) {
+            return false;
+        }
+        if (marker != 0x00) {
+            return r.Fail(SolErrorCode::EndRequired, r.index - 1, -1, false, marker, 0);
+        }
+
+        if (raw) {
+            entry.end = r.index;
+            entry.strend = reftable.strpool.size();
+            entry.classend = reftable.classpool.size();
+            entry.objend = reftable.objpool.size();
+            entry.refs = r.refs != 0;
+            entry.external = r.minobjref < entry.objbegin;
+            raw->entries.push_back(std::move(entry));
+        }
+    }
+
+    if (raw) {
+        r.subtrees = nullptr;
+        std::sort(raw->subtrees.begin(), raw->subtrees.end(),
+            [](const SolRawSubtree& left, const SolRawSubtree& right) { return left.hash < right.hash; });
+        raw->strings = std::move(reftable.strpool);
+        raw->classes = std::move(reftable.classpool);
+        file.raw = std::move(raw);
+    }
+    return true;
+}
@@ -0,0 +1,253 @@
+#ifndef __DECODER_H__
+#define __DECODER_H__
+
+#include "sol.h"
+#include "codec.h"
+
+// decoder internals shared by the whole file readers and the push parser, every
+// decoder records a failure in the reader and returns false instead of throwing
+namespace sol::detail
+{
+    struct ReadCost
+    {
+        uint64_t nodes = 0;
+        uint64_t bytes = 0;
+    };
+
+    struct ReadFrame;
+
+    // the containers within an entry are kept in SolRawFile::subtrees down to this
+    // depth, the entry's own value being at depth 0 and hashed as the entry, so that
+    // reading and writing hash each value at most this many times more, and only if
+    // they take at least this many bytes, smaller ones are as quick to encode again
+    constexpr uint32_t RAW_SUBTREE_DEPTH = 4;
+    constexpr size_t RAW_SUBTREE_MINSIZE = 256;
+
+    // where the value being begun starts, for keepraw
+    struct RawMark
+    {
+        size_t begin = 0;
+        size_t strs = 0;
+        size_t classes = 0;
+        size_t refs = 0;
+        size_t minobjref = SIZE_MAX;
+        uint32_t depth = 0;
+    };
+
+    // decoding state shared by the non-throwing readers, a failed read records
+    // the error and returns false, the message is only formatted on request
+    struct Reader
+    {
+        const uint8_t* data;
+        size_t size;
+        size_t index;
+        sol::SolError& error;
+        const sol::SolReadOptions& options;
+
+        // resources spent so far, checked against the limits in options
+        ReadCost spent;
+        // what each objpool entry cost to decode, a reference copies it and pays again
+        std::vector<ReadCost> objcost;
+
+        // the objects some reference is followed to, found by skipping the whole file
+        // first, only those are copied to the objpool, every one is if copyall is set
+        bool copyall = true;
+        std::vector<bool> referenced;
+
+        // references followed and the lowest object index referenced, for keepraw
+        size_t refs = 0;
+        size_t minobjref = SIZE_MAX;
+
+        // the containers kept for keepraw, with where the value being begun starts
+        std::vector<sol::SolRawSubtree>* subtrees = nullptr;
+        RawMark mark;
+
+        // the frames of the value being decoded, kept by a SolReaderContext between
+        // files, each value uses a stack of its own if this is not set
+        std::vector<ReadFrame>* frames = nullptr;
+
+        Reader(const uint8_t* data, size_t size, size_t index, sol::SolError& error, const sol::SolReadOptions& options)
+            : data(data), size(size), index(index), error(error), options(options)
+        {
+        }
+
+        bool Fail(sol::SolErrorCode code, size_t offset, int type = -1, bool amf0 = false, int64_t read = 0, int64_t desire = 0)
+        {
+            error.code = code;
+            error.offset = offset;
+            error.type = type;
+            error.amf0 = amf0;
+            error.read = read;
+            error.desire = desire;
+            return false;
+        }
+
+        bool Referenced(size_t objref) const
+        {
+            return copyall || (objref < referenced.size() && referenced[objref]);
+        }
+
+        bool Charge(uint64_t nodes, uint64_t bytes)
+        {
+            spent.nodes += nodes;
+            spent.bytes += bytes;
+
+            if (spent.nodes > options.maxnodes) {
+                return Fail(sol::SolErrorCode::TooManyNodes, index, -1, false,
+                    static_cast<int64_t>(spent.nodes), static_cast<int64_t>(options.maxnodes));
+            }
+            if (spent.bytes > options.maxbytes) {
+                return Fail(sol::SolErrorCode::TooManyBytes, index, -1, false,
+                    static_cast<int64_t>(spent.bytes), static_cast<int64_t>(options.maxbytes));
+            }
+            return true;
+        }
+
+        bool Truncated()
+        {
+            return Fail(sol::SolErrorCode::EndedImproperly, index);
+        }
+
+        bool Truncated(sol::SolType type)
+        {
+            return Fail(sol::SolErrorCode::EndedImproperly, index, static_cast<int>(type));
+        }
+
+        bool Truncated(sol::AMF0Type type)
+        {
+            return Fail(sol::SolErrorCode::EndedImproperly, index, static_cast<int>(type), true);
+        }
+    };
+
+    template <typename T>
+    bool CheckRefIndex(Reader& r, const std::vector<T>& pool, size_t ref, size_t offset)
+    {
+        return ref < pool.size()
+            || r.Fail(sol::SolErrorCode::BadReference, offset, -1, false, static_cast<int64_t>(ref));
+    }
+
+    inline bool DecodeByte(Reader& r, uint8_t& out)
+    {
+        if (r.index >= r.size) {
+            return r.Truncated();
+        }
+        out = r.data[r.index++];
+        return true;
+    }
+
+    template <typename T>
+    std::enable_if_t<std::is_integral_v<T>, bool> DecodeBigEndian(Reader& r, T& out)
+    {
+        if (sizeof(T) > r.size - r.index) {
+            return r.Truncated();
+        }
+        out = sol::codec::LoadBigEndian<T>(r.data + r.index);
+        r.index += sizeof(T);
+        return true;
+    }
+
+    inline bool DecodeInteger(Reader& r, sol::SolInteger& out, bool unsign = false)
+    {
+        uint32_t value;
+        size_t len = sol::codec::DecodeU29(r.data + r.index, r.size - r.index, value);
+
+        if (len == 0) {
+            return r.Truncated(sol::SolType::Integer);
+        }
+        r.index += len;
+
+        int32_t result = static_cast<int32_t>(value);
+        if (result >= 0x10000000 && !unsign) {
+            result -= 0x20000000;
+        }
+
+        out = result;
+        return true;
+    }
+
+    template <typename TType>
+    bool DecodeDouble(Reader& r, double& out, TType type)
+    {
+        if (8 > r.size - r.index) {
+            return r.Truncated(type);
+        }
+        out = sol::codec::LoadDouble(r.data + r.index);
+        r.index += 8;
+        return true;
+    }
+
+    enum class ReadFrameState : uint8_t
+    {
+        ArrayAssoc,
+        ArrayDense,
+        ObjectSealed,
+        ObjectDynamic,
+        DictionaryKey,
+        DictionaryValue,
+        AMF0Object,
+        AMF0EcmaArray,
+        AMF0StrictArray,
+    };
+
+    // a container being decoded, containers are kept on an explicit stack
+    // instead of the call stack so that nesting depth costs heap, not stack
+    struct ReadFrame
+    {
+        ReadFrameState state;
+        sol::SolValue value;
+        size_t objref;
+        uint32_t remaining;
+        ReadCost start;
+        std::string key;
+        sol::SolValue dictkey;
+        RawMark raw;
+
+        ReadFrame(ReadFrameState state, sol::SolValue&& value, size_t objref, uint32_t remaining, ReadCost start)
+            : state(state), value(std::move(value)), objref(objref), remaining(remaining), start(start)
+        {
+        }
+    };
+
+    using ReadStack = std::vector<ReadFrame>;
+
+
+    bool DecodeString(Reader& r, sol::SolRefTable& reftable, std::string& out);
+    bool DecodeXml(Reader& r, sol::SolRefTable& reftable, sol::SolType xmltype, sol::SolValue& out);
+    bool DecodeBinary(Reader& r, sol::SolRefTable& reftable, sol::SolValue& out);
+    bool DecodeDate(Reader& r, sol::SolRefTable& reftable, sol::SolValue& out);
+
+    bool DecodeAMF0Boolean(Reader& r, bool& out);
+    bool DecodeAMF0ShortString(Reader& r, std::string& out);
+    bool DecodeAMF0LongString(Reader& r, std::string& out);
+    bool DecodeAMF0Date(Reader& r, sol::SolValue& out);
+    bool DecodeAMF0Reference(Reader& r, sol::SolRefTable& reftable, sol::SolValue& out);
+
+    // stores a decoded child into its container, or the key of a dictionary entry
+    void AttachChild(ReadFrame& frame, sol::SolValue&& child);
+
+    // publishes the container on top of the stack to the reference table once all
+    // its children are read, the value is left in the frame for the caller to move
+    void CompleteFrame(Reader& r, sol::SolRefTable& reftable, ReadFrame& frame);
+
+    // reads a value of the given type into out, or, if the value is a container,
+    // pushes a frame for it, returns false on error
+    bool BeginSolValue(Reader& r, sol::SolRefTable& reftable, sol::SolType type, sol::SolValue& out, ReadStack& stack);
+    bool BeginAMF0Value(Reader& r, sol::SolRefTable& reftable, sol::AMF0Type type, sol::SolValue& out, ReadStack& stack);
+
+    // reads the key and type of the next child of a container,
+    // more is set to false if the container is complete, returns false on error
+    bool NextSolChild(Reader& r, sol::SolRefTable& reftable, ReadFrame& frame, sol::SolType& type, bool& more);
+    bool NextAMF0Child(Reader& r, ReadFrame& frame, sol::AMF0Type& type, bool& more);
+
+    bool DecodeValue(Reader& r, sol::SolRefTable& reftable, sol::SolType type, sol::SolValue& result);
+    bool DecodeAMF0Value(Reader& r, sol::SolRefTable& reftable, sol::AMF0Type type, sol::SolValue& result);
+
+    // reads the file header up to the version, the caller makes sure that
+    // at least SOL_HEADER_MINSIZE bytes are available, if r holds the whole file
+    // the chunk size is checked before the constant, otherwise the caller checks
+    // it once the size is known
+    bool DecodeSolHeader(Reader& r, sol::SolFile& file, uint32_t& chunksize, bool wholefile);
+    bool DecodeSolFile(Reader& r, sol::SolFile& file, sol::SolRefTable& reftable);
+}
+
+#endif // !__DECODER_H__
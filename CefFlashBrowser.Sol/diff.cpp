@@ -0,0 +1,707 @@
+#include "diff.h"
+#include "stats.h"
+#include "trace.h"
+#include "utils.h"
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace
+{
+    // the solname that marks a sol file as a saved patch
+    const char PATCH_SOLNAME[] = "solpatch";
+
+    // strings longer than this are cut short in reports
+    const size_t PREVIEW_LENGTH = 40;
+
+    template <typename TValue>
+    struct DiffTypes;
+
+    template <>
+    struct DiffTypes<sol::SolValue>
+    {
+        using Array = sol::SolArray;
+        using Object = sol::SolObject;
+    };
+
+    template <>
+    struct DiffTypes<sol::SolNode>
+    {
+        using Array = sol::SolNodeArray;
+        using Object = sol::SolNodeObject;
+    };
+
+    const sol::SolValue& Deref(const sol::SolValue& value) { return value; }
+    const sol::SolNode& Deref(const sol::SolNodePtr& node) { return *node; }
+
+    // only tree nodes are shared, and a shared node is the same on both sides
+    bool Shared(const sol::SolValue&, const sol::SolValue&) { return false; }
+    bool Shared(const sol::SolNodePtr& left, const sol::SolNodePtr& right) { return left == right; }
+
+    sol::SolValue ToValue(const sol::SolValue& value) { return value; }
+    sol::SolValue ToValue(const sol::SolNodePtr& node) { return sol::ToSolValue(*node); }
+
+    bool SameDouble(double left, double right)
+    {
+        return std::memcmp(&left, &right, sizeof(double)) == 0;
+    }
+
+    // values of the same type that hold no children
+    template <typename TValue>
+    bool SameScalar(const TValue& left, const TValue& right)
+    {
+        using namespace sol;
+
+        switch (left.type)
+        {
+        case SolType::Integer:
+            return left.template get<SolInteger>() == right.template get<SolInteger>();
+
+        case SolType::Double:
+        case SolType::Date:
+            return SameDouble(left.template get<SolDouble>(), right.template get<SolDouble>());
+
+        case SolType::String:
+        case SolType::XmlDoc:
+        case SolType::Xml:
+            return left.template get<SolString>() == right.template get<SolString>();
+
+        case SolType::Binary:
+            return left.template get<SolBinary>() == right.template get<SolBinary>();
+
+        default:
+            // undefined, null and the booleans are told apart by their type alone
+            return true;
+        }
+    }
+
+
+    // walks both sides in step and records what differs, TChild is what containers
+    // hold, a SolValue for files and a SolNodePtr for trees
+    template <typename TChild>
+    class SolDiffer
+    {
+    public:
+        using TValue = std::decay_t<decltype(Deref(std::declval<const TChild&>()))>;
+
+        explicit SolDiffer(sol::SolPatch& patch) : _patch(patch) {}
+
+        // the entries of a file, or the named members of a container if top is not set
+        template <typename TMap>
+        void DiffMap(const TMap& from, const TMap& to, bool top)
+        {
+            auto l = from.begin();
+            auto r = to.begin();
+
+            while (l != from.end() || r != to.end()) {
+                if (r == to.end() || (l != from.end() && l->first < r->first)) {
+                    Enter(l->first, top);
+                    Record(sol::SolChangeKind::Remove, sol::SolValue());
+                    Leave(top);
+                    ++l;
+                }
+                else if (l == from.end() || r->first < l->first) {
+                    Enter(r->first, top);
+                    Record(sol::SolChangeKind::Add, ToValue(r->second));
+                    Leave(top);
+                    ++r;
+                }
+                else {
+                    Enter(l->first, top);
+                    DiffChild(l->second, r->second);
+                    Leave(top);
+                    ++l;
+                    ++r;
+                }
+            }
+        }
+
+    private:
+        void Enter(const std::string& name, bool top)
+        {
+            if (top) {
+                _key = &name;
+            }
+            else {
+                _path.push_back(name);
+            }
+        }
+
+        void Leave(bool top)
+        {
+            if (!top) {
+                _path.pop_back();
+            }
+        }
+
+        void Record(sol::SolChangeKind kind, sol::SolValue value)
+        {
+            _patch.changes.push_back({ kind, *_key, _path, std::move(value) });
+        }
+
+        void DiffChild(const TChild& from, const TChild& to)
+        {
+            using namespace sol;
+
+            if (Shared(from, to)) {
+                return;
+            }
+
+            const TValue& l = Deref(from);
+            const TValue& r = Deref(to);
+            if (l.type != r.type) {
+                Record(SolChangeKind::Change, ToValue(to));
+                return;
+            }
+
+            switch (l.type)
+            {
+            case SolType::Array: {
+                auto& la = l.template get<typename DiffTypes<TValue>::Array>();
+                auto& ra = r.template get<typename DiffTypes<TValue>::Array>();
+                DiffMap(la.assoc, ra.assoc, false);
+
+                size_t common = std::min(la.dense.size(), ra.dense.size());
+                for (size_t i = 0; i < common; ++i) {
+                    _path.push_back(i);
+                    DiffChild(la.dense[i], ra.dense[i]);
+                    _path.pop_back();
+                }
+                // removed from the last one down, so that each index is still there
+                for (size_t i = la.dense.size(); i-- > common;) {
+                    _path.push_back(i);
+                    Record(SolChangeKind::Remove, SolValue());
+                    _path.pop_back();
+                }
+                for (size_t i = common; i < ra.dense.size(); ++i) {
+                    _path.push_back(i);
+                    Record(SolChangeKind::Add, ToValue(ra.dense[i]));
+                    _path.pop_back();
+                }
+                break;
+            }
+
+            case SolType::Object: {
+                auto& lo = l.template get<typename DiffTypes<TValue>::Object>();
+                auto& ro = r.template get<typename DiffTypes<TValue>::Object>();
+                if (lo.classdef != ro.classdef) {
+                    Record(SolChangeKind::Change, ToValue(to));
+                }
+                else {
+                    DiffMap(lo.props, ro.props, false);
+                }
+                break;
+            }
+
+            case SolType::Dictionary:
+                if (l != r) {
+                    Record(SolChangeKind::Change, ToValue(to));
+                }
+                break;
+
+            default:
+                if (!SameScalar(l, r)) {
+                    Record(SolChangeKind::Change, ToValue(to));
+                }
+                break;
+            }
+        }
+
+        sol::SolPatch& _patch;
+        const std::string* _key = nullptr;
+        sol::SolPath _path;
+    };
+
+
+    void DiffHeader(const sol::SolFile& from, const sol::SolFile& to, sol::SolPatch& patch)
+    {
+        if (from.solname != to.solname) {
+            patch.hasname = true;
+            patch.solname = to.solname;
+        }
+        patch.hasversion = from.version != to.version;
+        patch.version = to.version;
+    }
+
+    [[noreturn]] void ThrowNotApplies(const sol::SolChange& change)
+    {
+        throw std::runtime_error(utils::FormatString("Patch does not apply at %s",
+            sol::FormatSolPath(change.key, change.path).c_str()));
+    }
+
+    // an added value must not be there yet, a changed or removed one must be
+    void CheckApplies(const sol::SolChange& change, bool exists)
+    {
+        if (exists != (change.kind != sol::SolChangeKind::Add)) {
+            ThrowNotApplies(change);
+        }
+    }
+
+    sol::SolValue* FindChild(sol::SolValue& value, const sol::SolPathKey& key)
+    {
+        using namespace sol;
+
+        std::map<std::string, SolValue>* children = nullptr;
+        if (value.type == SolType::Array) {
+            auto& arr = value.get<SolArray>();
+            if (auto index = std::get_if<size_t>(&key)) {
+                return *index < arr.dense.size() ? &arr.dense[*index] : nullptr;
+            }
+            children = &arr.assoc;
+        }
+        else if (value.type == SolType::Object && std::holds_alternative<std::string>(key)) {
+            children = &value.get<SolObject>().props;
+        }
+        else {
+            return nullptr;
+        }
+
+        auto it = children->find(std::get<std::string>(key));
+        return it != children->end() ? &it->second : nullptr;
+    }
+
+    void ApplyChange(std::map<std::string, sol::SolValue>& children, const std::string& name, const sol::SolChange& change)
+    {
+        auto it = children.find(name);
+        CheckApplies(change, it != children.end());
+
+        if (change.kind == sol::SolChangeKind::Remove) {
+            children.erase(it);
+        }
+        else {
+            children.insert_or_assign(name, change.value);
+        }
+    }
+
+    void ApplyChange(sol::SolValue& parent, const sol::SolChange& change)
+    {
+        using namespace sol;
+
+        auto& key = change.path.back();
+        if (parent.type == SolType::Array) {
+            auto& arr = parent.get<SolArray>();
+            if (auto index = std::get_if<size_t>(&key)) {
+                // dense values are added at the end only
+                if (change.kind == SolChangeKind::Add ? *index != arr.dense.size() : *index >= arr.dense.size()) {
+                    ThrowNotApplies(change);
+                }
+                if (change.kind == SolChangeKind::Add) {
+                    arr.dense.push_back(change.value);
+                }
+                else if (change.kind == SolChangeKind::Change) {
+                    arr.dense[*index] = change.value;
+                }
+                else {
+                    arr.dense.erase(arr.dense.begin() + *index);
+                }
+                return;
+            }
+            ApplyChange(arr.assoc, std::get<std::string>(key), change);
+        }
+        else if (parent.type == SolType::Object && std::holds_alternative<std::string>(key)) {
+            ApplyChange(parent.get<SolObject>().props, std::get<std::string>(key), change);
+        }
+        else {
+            ThrowNotApplies(change);
+        }
+    }
+
+    std::string Preview(const sol::SolValue& value)
+    {
+        using namespace sol;
+
+        switch (value.type)
+        {
+        case SolType::Integer:
+            return std::to_string(value.get<SolInteger>());
+
+        case SolType::Double:
+            return utils::FormatString("%.17g", value.get<SolDouble>());
+
+        case SolType::BooleanFalse:
+            return "false";
+
+        case SolType::BooleanTrue:
+            return "true";
+
+        case SolType::String: {
+            auto& str = value.get<SolString>();
+            if (str.size() <= PREVIEW_LENGTH) {
+                return "\"" + str + "\"";
+            }
+            size_t len = PREVIEW_LENGTH;
+            while (len > 0 && (static_cast<unsigned char>(str[len]) & 0xC0) == 0x80) {
+                --len;
+            }
+            return "\"" + str.substr(0, len) + "\"...";
+        }
+
+        default:
+            return GetTypeName(value.type);
+        }
+    }
+
+    sol::SolValue PathToValue(const sol::SolPath& path)
+    {
+        sol::SolArray result;
+        result.dense.reserve(path.size());
+
+        for (auto& key : path) {
+            if (auto index = std::get_if<size_t>(&key)) {
+                // indices past the AMF3 integer range are kept as doubles
+                if (*index <= 0x0FFFFFFF) {
+                    result.dense.emplace_back(static_cast<sol::SolInteger>(*index));
+                }
+                else {
+                    result.dense.emplace_back(static_cast<sol::SolDouble>(*index));
+                }
+            }
+            else {
+                result.dense.emplace_back(std::get<std::string>(key));
+            }
+        }
+        return result;
+    }
+
+    [[noreturn]] void ThrowNotPatch()
+    {
+        throw std::runtime_error("Not a patch file");
+    }
+
+    // integers are read back from AMF0 as doubles
+    bool ToIndex(const sol::SolValue& value, uint64_t& index)
+    {
+        using namespace sol;
+
+        if (value.type == SolType::Integer && value.get<SolInteger>() >= 0) {
+            index = static_cast<uint64_t>(value.get<SolInteger>());
+            return true;
+        }
+        if (value.type == SolType::Double && value.get<SolDouble>() >= 0 && value.get<SolDouble>() < 0x1p64
+            && value.get<SolDouble>() == static_cast<SolDouble>(static_cast<uint64_t>(value.get<SolDouble>()))) {
+            index = static_cast<uint64_t>(value.get<SolDouble>());
+            return true;
+        }
+        return false;
+    }
+
+    sol::SolPath ValueToPath(const sol::SolValue& value)
+    {
+        using namespace sol;
+
+        if (value.type != SolType::Array || !value.get<SolArray>().assoc.empty()) {
+            ThrowNotPatch();
+        }
+
+        SolPath result;
+        uint64_t index;
+        for (auto& key : value.get<SolArray>().dense) {
+            if (key.type == SolType::String) {
+                result.emplace_back(key.get<SolString>());
+            }
+            else if (ToIndex(key, index) && index <= SIZE_MAX) {
+                result.emplace_back(static_cast<size_t>(index));
+            }
+            else {
+                ThrowNotPatch();
+            }
+        }
+        return result;
+    }
+
+    void ParsePatch(const sol::SolFile& file, sol::SolPatch& patch)
+    {
+        using namespace sol;
+
+        if (file.solname != PATCH_SOLNAME) {
+            ThrowNotPatch();
+        }
+
+        patch = SolPatch();
+        patch.version = file.version;
+
+        uint64_t number;
+        for (auto& [key, value] : file.data) {
+            if (key == "solname" && value.type == SolType::String) {
+                patch.hasname = true;
+                patch.solname = value.get<SolString>();
+            }
+            else if (key == "version" && ToIndex(value, number) && number == static_cast<uint64_t>(file.version)) {
+                patch.hasversion = true;
+            }
+            else if (key == "changes" && value.type == SolType::Array) {
+                for (auto& item : value.get<SolArray>().dense) {
+                    if (item.type != SolType::Array) {
+                        ThrowNotPatch();
+                    }
+
+                    // [kind, key, path] and the value unless it is a removal
+                    auto& fields = item.get<SolArray>().dense;
+                    if (fields.size() < 3 || !ToIndex(fields[0], number) || fields[1].type != SolType::String
+                        || number > static_cast<uint64_t>(SolChangeKind::Change)
+                        || fields.size() != (number == static_cast<uint64_t>(SolChangeKind::Remove) ? 3u : 4u)) {
+                        ThrowNotPatch();
+                    }
+
+                    patch.changes.push_back({ static_cast<SolChangeKind>(number), fields[1].get<SolString>(),
+                        ValueToPath(fields[2]), fields.size() == 4 ? fields[3] : SolValue() });
+                }
+            }
+            else {
+                ThrowNotPatch();
+            }
+        }
+    }
+}
+
+
+std::string sol::SolPatch::report() const
+{
+    std::string result;
+
+    if (hasname) {
+        result += utils::FormatString("name: %s\n", solname.c_str());
+    }
+    if (hasversion) {
+        result += utils::FormatString("version: %s\n", version == SolVersion::AMF0 ? "AMF0" : "AMF3");
+    }
+
+    for (auto& change : changes) {
+        const char* mark = change.kind == SolChangeKind::Add ? "+" : change.kind == SolChangeKind::Remove ? "-" : "~";
+        result += utils::FormatString("%s %s", mark, FormatSolPath(change.key, change.path).c_str());
+        if (change.kind != SolChangeKind::Remove) {
+            result += ": " + Preview(change.value);
+        }
+        result += "\n";
+    }
+    return result;
+}
+
+sol::SolPatch sol::DiffSolFiles(const SolFile& from, const SolFile& to)
+{
+    SOL_TRACE_SCOPE("diff sol files");
+    SolPatch patch;
+    DiffHeader(from, to, patch);
+    SolDiffer<SolValue>(patch).DiffMap(from.data, to.data, true);
+    return patch;
+}
+
+sol::SolPatch sol::DiffSolTrees(const SolTree& from, const SolTree& to)
+{
+    SOL_TRACE_SCOPE("diff sol trees");
+    SolPatch patch;
+    if (&from.entries() != &to.entries()) {
+        SolDiffer<SolNodePtr>(patch).DiffMap(from.entries(), to.entries(), true);
+    }
+    return patch;
+}
+
+bool sol::DiffSolData(const uint8_t* from, size_t fromsize, const uint8_t* to, size_t tosize,
+    SolPatch& patch, SolError& error, const SolReadOptions& options)
+{
+    SOL_TRACE_SCOPE("diff sol data");
+
+    SolReadOptions rawoptions = options;
+    rawoptions.keepraw = true;
+
+    SolFile left;
+    SolFile right;
+    if (!TryReadSolData(from, fromsize, left, error, rawoptions) || !TryReadSolData(to, tosize, right, error, rawoptions)) {
+        return false;
+    }
+
+    patch = SolPatch();
+    DiffHeader(left, right, patch);
+
+    // an entry that follows no reference reads the same wherever it is, so the same
+    // bytes are the same value, a key read twice keeps the last one as the reader does
+    if (left.version == right.version) {
+        std::unordered_map<std::string_view, const SolRawEntry*> leftentries;
+        std::unordered_map<std::string_view, const SolRawEntry*> rightentries;
+        for (auto& entry : left.raw->entries) {
+            leftentries[entry.key] = &entry;
+        }
+        for (auto& entry : right.raw->entries) {
+            rightentries[entry.key] = &entry;
+        }
+
+        for (auto& [key, r] : rightentries) {
+            auto l = leftentries.find(key);
+            if (l == leftentries.end() || l->second->refs || r->refs) {
+                continue;
+            }
+
+            size_t len = r->end - r->begin;
+            if (l->second->end - l->second->begin == len
+                && std::memcmp(left.raw->bytes.data() + l->second->begin, right.raw->bytes.data() + r->begin, len) == 0) {
+                std::string name(key);
+                left.data.erase(name);
+                right.data.erase(name);
+            }
+        }
+    }
+
+    SolDiffer<SolValue>(patch).DiffMap(left.data, right.data, true);
+    return true;
+}
+
+bool sol::DiffSolFilePaths(const std::string& from, const std::string& to, SolPatch& patch,
+    SolError& error, const SolReadOptions& options)
+{
+    error = SolError();
+
+    utils::MappedFile left;
+    utils::MappedFile right;
+    if (!left.open(from) || !right.open(to)) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
+    }
+    return DiffSolData(left.data(), left.size(), right.data(), right.size(), patch, error, options);
+}
+
+void sol::ApplySolPatch(SolFile& file, const SolPatch& patch)
+{
+    SOL_TRACE_SCOPE("apply sol patch");
+
+    if (patch.hasname) {
+        file.solname = patch.solname;
+    }
+    if (patch.hasversion) {
+        file.version = patch.version;
+    }
+
+    for (auto& change : patch.changes) {
+        if (change.path.empty()) {
+            ApplyChange(file.data, change.key, change);
+            continue;
+        }
+
+        auto it = file.data.find(change.key);
+        if (it == file.data.end()) {
+            ThrowNotApplies(change);
+        }
+
+        SolValue* parent = &it->second;
+        for (size_t i = 0; i + 1 < change.path.size(); ++i) {
+            parent = FindChild(*parent, change.path[i]);
+            if (!parent) {
+                ThrowNotApplies(change);
+            }
+        }
+        ApplyChange(*parent, change);
+    }
+}
+
+sol::SolTree sol::ApplySolPatch(const SolTree& tree, const SolPatch& patch)
+{
+    SOL_TRACE_SCOPE("apply sol patch");
+
+    SolTree result = tree;
+    for (auto& change : patch.changes) {
+        CheckApplies(change, result.get(change.key, change.path) != nullptr);
+
+        SolNodePtr node = change.kind != SolChangeKind::Remove ? MakeSolNode(change.value) : nullptr;
+        if (change.path.empty()) {
+            result = node ? result.set(change.key, std::move(node)) : result.erase(change.key);
+            continue;
+        }
+
+        try {
+            result = result.set(change.key, change.path, std::move(node));
+        }
+        catch (const std::runtime_error&) {
+            ThrowNotApplies(change);
+        }
+    }
+    return result;
+}
+
+bool sol::PatchSolFile(const std::string& path, const SolPatch& patch, const std::string& outpath,
+    std::string& errmsg, const SolReadOptions& options)
+{
+    SolReadOptions rawoptions = options;
+    rawoptions.keepraw = true;
+
+    SolFile file;
+    SolError error;
+    file.path = path;
+    if (!TryReadSolFile(file, error, rawoptions)) {
+        errmsg = error.message();
+        return false;
+    }
+
+    try {
+        ApplySolPatch(file, patch);
+    }
+    catch (const std::exception& e) {
+        errmsg = e.what();
+        return false;
+    }
+
+    file.path = outpath;
+    if (!WriteSolFile(file)) {
+        errmsg = file.errmsg;
+        return false;
+    }
+    errmsg.clear();
+    return true;
+}
+
+bool sol::SaveSolPatch(const SolPatch& patch, const std::string& path, std::string& errmsg)
+{
+    SolFile file;
+    file.path = path;
+    file.solname = PATCH_SOLNAME;
+    file.version = patch.version;
+
+    if (patch.hasname) {
+        file.data["solname"] = patch.solname;
+    }
+    if (patch.hasversion) {
+        file.data["version"] = static_cast<SolInteger>(patch.version);
+    }
+
+    SolArray changes;
+    changes.dense.reserve(patch.changes.size());
+    for (auto& change : patch.changes) {
+        SolArray item;
+        item.dense.reserve(4);
+        item.dense.emplace_back(static_cast<SolInteger>(change.kind));
+        item.dense.emplace_back(change.key);
+        item.dense.push_back(PathToValue(change.path));
+        if (change.kind != SolChangeKind::Remove) {
+            item.dense.push_back(change.value);
+        }
+        changes.dense.emplace_back(std::move(item));
+    }
+    file.data["changes"] = std::move(changes);
+
+    if (!WriteSolFile(file)) {
+        errmsg = file.errmsg;
+        return false;
+    }
+    errmsg.clear();
+    return true;
+}
+
+bool sol::LoadSolPatch(const std::string& path, SolPatch& patch, std::string& errmsg)
+{
+    SolFile file;
+    SolError error;
+    file.path = path;
+    if (!TryReadSolFile(file, error)) {
+        errmsg = error.message();
+        return false;
+    }
+
+    try {
+        ParsePatch(file, patch);
+    }
+    catch (const std::exception& e) {
+        errmsg = e.what();
+        return false;
+    }
+    errmsg.clear();
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef __DIFF_H__
+#define __DIFF_H__
+
+#include "sol.h"
+#include "tree.h"
+
+namespace sol
+{
+    enum class SolChangeKind
+    {
+        Add,
+        Remove,
+        Change,
+    };
+
+
+    // one value added, removed or replaced, path is empty for a top level entry,
+    // dictionaries cannot be reached by a path, so a changed one is replaced whole
+    struct SolChange
+    {
+        SolChangeKind kind;
+        std::string key;
+        SolPath path;
+        SolValue value;     // the new value, null for a removal
+    };
+
+
+    struct SolPatch
+    {
+        // set if the header changes, version is that of the file the patch leads
+        // to either way, its values are in that version
+        bool hasname = false;
+        std::string solname;
+        bool hasversion = false;
+        SolVersion version = SolVersion::AMF3;
+
+        // in the order they are applied, dense values past the end of the new array
+        // are removed from the last one down and added from the first one up
+        std::vector<SolChange> changes;
+
+        bool empty() const { return !hasname && !hasversion && changes.empty(); }
+
+        // a line per change
+        std::string report() const;
+    };
+
+
+    // the changes that turn from into to, doubles are compared by their bits so
+    // that NaN is not a change and -0 is one
+    SolPatch DiffSolFiles(const SolFile& from, const SolFile& to);
+
+    // as above, on trees children shared by both sides are skipped without being
+    // visited, so a tree against an edited copy of it takes time in the edits,
+    // trees have no header, so version is left as AMF3
+    SolPatch DiffSolTrees(const SolTree& from, const SolTree& to);
+
+    // reads both files and skips the entries whose encoded bytes are the same and
+    // hold no references, which read the same wherever they are, returns false with
+    // error set if either file cannot be read
+    bool DiffSolData(const uint8_t* from, size_t fromsize, const uint8_t* to, size_t tosize,
+        SolPatch& patch, SolError& error, const SolReadOptions& options = SolReadOptions());
+
+    bool DiffSolFilePaths(const std::string& from, const std::string& to, SolPatch& patch,
+        SolError& error, const SolReadOptions& options = SolReadOptions());
+
+
+    // throw if a change does not apply, an added value that is there already, or a
+    // changed or removed one that is not, the file or tree is left partly patched then
+    void ApplySolPatch(SolFile& file, const SolPatch& patch);
+    SolTree ApplySolPatch(const SolTree& tree, const SolPatch& patch);
+
+    // reads path with keepraw, applies the patch and writes outpath, the entries and
+    // the larger containers the patch leaves alone are copied from the input as they
+    // were encoded
+    bool PatchSolFile(const std::string& path, const SolPatch& patch, const std::string& outpath,
+        std::string& errmsg, const SolReadOptions& options = SolReadOptions());
+
+
+    // a patch is kept as a sol file of the patch's version, since values of one
+    // version do not all have a place in the other
+    bool SaveSolPatch(const SolPatch& patch, const std::string& path, std::string& errmsg);
+    bool LoadSolPatch(const std::string& path, SolPatch& patch, std::string& errmsg);
+}
+
+#endif // !__DIFF_H__
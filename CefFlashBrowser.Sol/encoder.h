@@ -0,0 +1,160 @@
+#ifndef __ENCODER_H__
+#define __ENCODER_H__
+
+#include "sol.h"
+#include "stats.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+// encoder internals shared by the writers in sol.cpp and the raw entry copy
+namespace sol::detail
+{
+    std::string GetClassDefUniqueStr(const sol::SolClassDef& classdef);
+
+    // as above, into id, so that a reused string keeps its capacity
+    void GetClassDefUniqueStr(const sol::SolClassDef& classdef, std::string& id);
+
+    // returns the index of id in the pool, or adds it as index count and returns -1,
+    // a node is taken from spare for it if there is one
+    int GetRefIndex(std::map<std::string, int>& pool, int& count, const std::string& id,
+        std::vector<std::map<std::string, int>::node_type>& spare);
+
+    // string and class indices of a whole file, worked out before its entries are
+    // encoded in parallel, entry is the first top level entry that adds each one
+    struct WritePlan
+    {
+        struct Ref
+        {
+            int index;
+            size_t entry;
+        };
+
+        std::unordered_map<std::string, Ref> strings;
+        std::unordered_map<std::string, Ref> classes;
+    };
+
+    // returns the index of id if an entry before this one added it, -1 otherwise
+    inline int GetPlannedRef(const std::unordered_map<std::string, WritePlan::Ref>& pool, const std::string& id, size_t entry)
+    {
+        auto it = pool.find(id);
+        return it != pool.end() && it->second.entry < entry ? it->second.index : -1;
+    }
+
+    // counts the value written between construction and destruction into reftable.stats,
+    // its marker was written just before, the members it writes are counted by scopes
+    // of their own and taken off its bytes
+    class WriteStatScope
+    {
+    public:
+        WriteStatScope(const std::vector<uint8_t>& buffer, sol::SolWriteRefTable& reftable, uint8_t marker, const sol::SolValue& value)
+            : _buffer(buffer), _reftable(reftable), _marker(marker), _value(value)
+        {
+            if (reftable.stats) {
+                _start = buffer.size();
+                _counted = reftable.statbytes;
+                reftable.stats->maxdepth = std::max(reftable.stats->maxdepth, ++reftable.statdepth);
+            }
+        }
+
+        ~WriteStatScope()
+        {
+            if (sol::SolStats* stats = _reftable.stats) {
+                uint64_t bytes = _buffer.size() - _start + 1 - (_reftable.statbytes - _counted);
+                ++stats->types[_marker].nodes;
+                stats->types[_marker].bytes += bytes;
+                _reftable.statbytes += bytes;
+                --_reftable.statdepth;
+
+                if (_reftable.statsizes) {
+                    (*_reftable.statsizes)[&_value] = _buffer.size() - _start + 1;
+                }
+
+                // growing the buffer is counted once however often it grew within the scope
+                if (_buffer.capacity() != _reftable.statcapacity) {
+                    _reftable.statcapacity = _buffer.capacity();
+                    ++stats->allocations;
+                }
+            }
+        }
+
+        WriteStatScope(const WriteStatScope&) = delete;
+        WriteStatScope& operator=(const WriteStatScope&) = delete;
+
+    private:
+        const std::vector<uint8_t>& _buffer;
+        sol::SolWriteRefTable& _reftable;
+        uint8_t _marker;
+        const sol::SolValue& _value;
+        size_t _start = 0;
+        uint64_t _counted = 0;
+    };
+
+    // set in the reftable while WriteRawEntries encodes an entry that changed, with
+    // the depth below the entry of the value being written
+    struct RawSubtreeCopy
+    {
+        const sol::SolRawFile& raw;
+        uint32_t depth = 0;
+    };
+
+    // copies value, whose marker was written just before, from file.raw if it is a
+    // container kept there with the same value, returns false if it has to be encoded
+    bool CopyRawSubtree(std::vector<uint8_t>& buffer, const sol::SolValue& value, uint8_t marker, sol::SolWriteRefTable& reftable);
+
+    // copies the value written between construction and destruction if it can, and
+    // keeps the depth of reftable.raw, the value is only encoded if copied() is false
+    class RawSubtreeScope
+    {
+    public:
+        RawSubtreeScope(std::vector<uint8_t>& buffer, sol::SolWriteRefTable& reftable, uint8_t marker, const sol::SolValue& value)
+            : _reftable(reftable)
+        {
+            if (reftable.raw) {
+                _copied = CopyRawSubtree(buffer, value, marker, reftable);
+                ++reftable.raw->depth;
+            }
+        }
+
+        ~RawSubtreeScope()
+        {
+            if (_reftable.raw) {
+                --_reftable.raw->depth;
+            }
+        }
+
+        RawSubtreeScope(const RawSubtreeScope&) = delete;
+        RawSubtreeScope& operator=(const RawSubtreeScope&) = delete;
+
+        bool copied() const { return _copied; }
+
+    private:
+        sol::SolWriteRefTable& _reftable;
+        bool _copied = false;
+    };
+
+    // writes the header up to the first entry, throws if version is not supported
+    void WriteSolHeader(std::vector<uint8_t>& buffer, const std::string& solname, sol::SolVersion version);
+
+    // fills in the chunk size of the header and writes buffer to path
+    void FinishSolFile(std::vector<uint8_t>& buffer, const std::string& path);
+
+    // writes the whole file into buffer and then to file.path, buffer and reftable
+    // are expected to be empty
+    void WriteSolFile(std::vector<uint8_t>& buffer, sol::SolWriteRefTable& reftable, const sol::SolFile& file, const sol::SolWriteOptions& options);
+
+    // writes a top level entry, the key, the value and the end mark
+    void WriteSolEntry(std::vector<uint8_t>& buffer, sol::SolVersion version, const std::string& key, const sol::SolValue& value, sol::SolWriteRefTable& reftable);
+
+    // writes the entries not in written on up to threads threads, the result is the
+    // same as writing them one after another with WriteSolEntry
+    void WriteSolEntriesParallel(std::vector<uint8_t>& buffer, const sol::SolFile& file,
+        const std::unordered_set<const sol::SolValue*>& written, sol::SolWriteRefTable& reftable, unsigned threads);
+
+    // writes the entries of file.raw still in file.data, in file order, those whose value
+    // is unchanged are copied and the rest encoded, returns the values written, the rest
+    // is left for the caller to encode
+    std::unordered_set<const sol::SolValue*> WriteRawEntries(std::vector<uint8_t>& buffer, const sol::SolFile& file, sol::SolWriteRefTable& reftable);
+}
+
+#endif // !__ENCODER_H__
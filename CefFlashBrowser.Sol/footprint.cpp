@@ -0,0 +1,339 @@
+#include "footprint.h"
+#include "encoder.h"
+#include "stats.h"
+#include "utils.h"
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace
+{
+    // a red-black tree node holds its colour, parent and two children before the pair
+    const size_t MAP_NODE_SIZE = 4 * sizeof(void*) + sizeof(std::pair<const std::string, sol::SolValue>);
+
+    // a node of the dictionary index with its cached hash and a bucket pointer for it
+    const size_t INDEX_NODE_SIZE = 3 * sizeof(void*) + sizeof(std::pair<const size_t, size_t>);
+
+    // strings this short are kept inside the string object
+    const size_t SSO_CAPACITY = std::string().capacity();
+
+    uint64_t StringBytes(const std::string& str)
+    {
+        return str.capacity() > SSO_CAPACITY ? str.capacity() + 1 : 0;
+    }
+
+    void HashCombine(size_t& seed, size_t hash)
+    {
+        seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    bool IsContainer(sol::SolType type)
+    {
+        return type == sol::SolType::Array || type == sol::SolType::Object || type == sol::SolType::Dictionary;
+    }
+
+    void AddMember(sol::SolValueFootprint& footprint, const sol::SolValueFootprint& member)
+    {
+        footprint.overhead += member.overhead;
+        footprint.strings += member.strings;
+        footprint.binaries += member.binaries;
+        footprint.duplicated += member.duplicated;
+        footprint.nodes += member.nodes;
+    }
+
+    uint64_t GetMeasure(const sol::SolValueFootprint& footprint, sol::SolFootprintOrder order)
+    {
+        switch (order)
+        {
+        case sol::SolFootprintOrder::Encoded: return footprint.encoded;
+        case sol::SolFootprintOrder::Duplicated: return footprint.duplicated;
+        default: return footprint.retained;
+        }
+    }
+
+
+    // measures a value and everything below it, containers are hashed from the hashes
+    // of their members so that finding the copies is linear in the size of the file
+    class FootprintWalker
+    {
+    public:
+        FootprintWalker(const std::unordered_map<const sol::SolValue*, uint64_t>& sizes, const sol::SolFootprintOptions& options)
+            : _sizes(sizes), _options(options)
+        {
+        }
+
+        sol::SolValueFootprint walk(const std::string& key, const sol::SolValue& value)
+        {
+            _key = &key;
+            size_t hash;
+            return walk(value, true, hash);
+        }
+
+        // the listed values in file order, with their position in it
+        std::vector<std::pair<size_t, sol::SolValueFootprint>>& listed() { return _listed; }
+
+    private:
+        sol::SolValueFootprint walk(const sol::SolValue& value, bool reachable, size_t& hash)
+        {
+            size_t order = _count++;
+
+            sol::SolValueFootprint footprint;
+            footprint.type = value.type;
+            footprint.nodes = 1;
+
+            auto size = _sizes.find(&value);
+            if (size != _sizes.end()) {
+                footprint.encoded = size->second;
+            }
+
+            hash = IsContainer(value.type) ? static_cast<size_t>(value.type) : sol::SolValueHash()(value);
+
+            auto member = [&](const sol::SolValue& val, bool listed) {
+                size_t memberhash;
+                AddMember(footprint, walk(val, reachable && listed, memberhash));
+                HashCombine(hash, memberhash);
+            };
+
+            auto property = [&](const std::string& name, const sol::SolValue& val) {
+                footprint.overhead += MAP_NODE_SIZE;
+                footprint.strings += StringBytes(name);
+                HashCombine(hash, std::hash<std::string>()(name));
+
+                _path.push_back(name);
+                member(val, true);
+                _path.pop_back();
+            };
+
+            switch (value.type)
+            {
+            case sol::SolType::String:
+            case sol::SolType::XmlDoc:
+            case sol::SolType::Xml:
+                footprint.strings = StringBytes(value.get<sol::SolString>());
+                break;
+
+            case sol::SolType::Binary:
+                footprint.binaries = value.get<sol::SolBinary>().capacity();
+                break;
+
+            case sol::SolType::Array: {
+                auto& arr = value.get<sol::SolArray>();
+                footprint.overhead += arr.dense.capacity() * sizeof(sol::SolValue);
+
+                for (auto& [name, val] : arr.assoc) {
+                    property(name, val);
+                }
+                for (size_t i = 0; i < arr.dense.size(); ++i) {
+                    _path.emplace_back(i);
+                    member(arr.dense[i], true);
+                    _path.pop_back();
+                }
+                break;
+            }
+
+            case sol::SolType::Object: {
+                auto& obj = value.get<sol::SolObject>();
+                footprint.overhead += obj.classdef.members.capacity() * sizeof(std::string);
+                footprint.strings += StringBytes(obj.classdef.name);
+                HashCombine(hash, std::hash<std::string>()(obj.classdef.name));
+
+                for (auto& name : obj.classdef.members) {
+                    footprint.strings += StringBytes(name);
+                }
+                for (auto& [name, val] : obj.props) {
+                    property(name, val);
+                }
+                break;
+            }
+
+            case sol::SolType::Dictionary: {
+                auto& dict = value.get<sol::SolDictionary>();
+                footprint.overhead += dict.entries().capacity() * sizeof(std::pair<sol::SolValue, sol::SolValue>)
+                    + dict.size() * INDEX_NODE_SIZE;
+
+                for (auto& [key, val] : dict.entries()) {
+                    member(key, false);
+                    member(val, false);
+                }
+                break;
+            }
+
+            default:
+                break;
+            }
+
+            footprint.retained = footprint.overhead + footprint.strings + footprint.binaries;
+
+            if (IsContainer(value.type) && (footprint.duplicate = IsCopy(value, hash))) {
+                footprint.duplicated = footprint.retained;
+            }
+
+            if (reachable && GetMeasure(footprint, _options.order) >= _options.minbytes) {
+                _listed.emplace_back(order, footprint);
+                _listed.back().second.key = *_key;
+                _listed.back().second.path = _path;
+            }
+            return footprint;
+        }
+
+        // whether value equals a container walked before, its members have been
+        // walked already, so comparing their originals is enough
+        bool IsCopy(const sol::SolValue& value, size_t hash)
+        {
+            auto range = _containers.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (SameMembers(*it->second, value)) {
+                    _originals[&value] = it->second;
+                    return true;
+                }
+            }
+
+            _containers.emplace(hash, &value);
+            _originals[&value] = &value;
+            return false;
+        }
+
+        bool Same(const sol::SolValue& left, const sol::SolValue& right) const
+        {
+            if (IsContainer(left.type) && left.type == right.type) {
+                return _originals.at(&left) == _originals.at(&right);
+            }
+            return left == right;
+        }
+
+        bool SameMap(const std::map<std::string, sol::SolValue>& left, const std::map<std::string, sol::SolValue>& right) const
+        {
+            if (left.size() != right.size()) {
+                return false;
+            }
+            for (auto l = left.begin(), r = right.begin(); l != left.end(); ++l, ++r) {
+                if (l->first != r->first || !Same(l->second, r->second)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool SameMembers(const sol::SolValue& left, const sol::SolValue& right) const
+        {
+            if (left.type != right.type) {
+                return false;
+            }
+
+            switch (left.type)
+            {
+            case sol::SolType::Array: {
+                auto& l = left.get<sol::SolArray>();
+                auto& r = right.get<sol::SolArray>();
+                if (l.dense.size() != r.dense.size() || !SameMap(l.assoc, r.assoc)) {
+                    return false;
+                }
+                for (size_t i = 0; i < l.dense.size(); ++i) {
+                    if (!Same(l.dense[i], r.dense[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            case sol::SolType::Object: {
+                auto& l = left.get<sol::SolObject>();
+                auto& r = right.get<sol::SolObject>();
+                return l.classdef == r.classdef && SameMap(l.props, r.props);
+            }
+
+            case sol::SolType::Dictionary: {
+                auto& l = left.get<sol::SolDictionary>();
+                auto& r = right.get<sol::SolDictionary>();
+                if (l.weakkeys != r.weakkeys || l.size() != r.size()) {
+                    return false;
+                }
+                for (size_t i = 0; i < l.size(); ++i) {
+                    if (!Same(l.entries()[i].first, r.entries()[i].first) || !Same(l.entries()[i].second, r.entries()[i].second)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            default:
+                return left == right;
+            }
+        }
+
+        const std::unordered_map<const sol::SolValue*, uint64_t>& _sizes;
+        const sol::SolFootprintOptions& _options;
+
+        const std::string* _key = nullptr;
+        sol::SolPath _path;
+        size_t _count = 0;
+        std::vector<std::pair<size_t, sol::SolValueFootprint>> _listed;
+
+        // containers that are not copies by hash, and the first of the equal ones for every container
+        std::unordered_multimap<size_t, const sol::SolValue*> _containers;
+        std::unordered_map<const sol::SolValue*, const sol::SolValue*> _originals;
+    };
+}
+
+
+std::string sol::SolFootprint::report() const
+{
+    std::string result = utils::FormatString("retained %llu bytes, %llu duplicated, encoded %llu bytes, %llu values\n",
+        (unsigned long long)retained, (unsigned long long)duplicated, (unsigned long long)encoded, (unsigned long long)nodes);
+
+    if (!values.empty()) {
+        result += utils::FormatString("  %12s %12s %12s  %-10s %s\n", "retained", "encoded", "duplicated", "type", "path");
+    }
+    for (auto& value : values) {
+        result += utils::FormatString("  %12llu %12llu %12llu  %-10s %s%s\n",
+            (unsigned long long)value.retained, (unsigned long long)value.encoded, (unsigned long long)value.duplicated,
+            GetTypeName(value.type), FormatSolPath(value.key, value.path).c_str(), value.duplicate ? " (copy)" : "");
+    }
+    return result;
+}
+
+sol::SolFootprint sol::GetSolFootprint(const SolFile& file, const SolFootprintOptions& options)
+{
+    SolFootprint result;
+
+    // the entries are written one after another as WriteSolFile writes them,
+    // so that the strings and classes they share are counted once
+    std::unordered_map<const SolValue*, uint64_t> sizes;
+    {
+        SolStats stats;
+        SolWriteRefTable reftable;
+        reftable.stats = &stats;
+        reftable.statsizes = &sizes;
+
+        std::vector<uint8_t> buffer;
+        detail::WriteSolHeader(buffer, file.solname, file.version);
+        for (auto& [key, value] : file.data) {
+            detail::WriteSolEntry(buffer, file.version, key, value, reftable);
+        }
+        result.encoded = buffer.size();
+    }
+
+    FootprintWalker walker(sizes, options);
+    for (auto& [key, value] : file.data) {
+        SolValueFootprint entry = walker.walk(key, value);
+        result.retained += MAP_NODE_SIZE + StringBytes(key) + entry.retained;
+        result.duplicated += entry.duplicated;
+        result.nodes += entry.nodes;
+    }
+
+    auto& listed = walker.listed();
+    auto larger = [&options](const std::pair<size_t, SolValueFootprint>& left, const std::pair<size_t, SolValueFootprint>& right) {
+        uint64_t l = GetMeasure(left.second, options.order);
+        uint64_t r = GetMeasure(right.second, options.order);
+        return l != r ? l > r : left.first < right.first;
+    };
+
+    size_t count = std::min(options.limit, listed.size());
+    std::partial_sort(listed.begin(), listed.begin() + count, listed.end(), larger);
+
+    result.values.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.values.push_back(std::move(listed[i].second));
+    }
+    return result;
+}
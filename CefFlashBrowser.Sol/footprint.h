@@ -0,0 +1,83 @@
+#ifndef __FOOTPRINT_H__
+#define __FOOTPRINT_H__
+
+#include "sol.h"
+#include "tree.h"
+
+namespace sol
+{
+    // what a value costs in memory once read and in the file once written, the
+    // native bytes leave out the allocator's own overhead and are approximate
+    struct SolValueFootprint
+    {
+        std::string key;    // the top level entry
+        SolPath path;       // from the entry down, empty for the entry itself
+        SolType type;
+
+        // every byte the value holds on the heap, with the values below it
+        uint64_t retained = 0;
+        // of that, map nodes and vector storage, string capacity with the keys
+        // and class names, and binaries
+        uint64_t overhead = 0;
+        uint64_t strings = 0;
+        uint64_t binaries = 0;
+
+        // retained bytes of the containers at or below the value that are equal to
+        // one before them in the file as it is written, with the entries in key order,
+        // which is what an object reference read from the file is turned into, each
+        // copy is also written out in full
+        uint64_t duplicated = 0;
+        bool duplicate = false;
+
+        // bytes the value takes when the file is written, its marker included,
+        // strings and classes written earlier in the file are references
+        uint64_t encoded = 0;
+
+        // values at or below this one, dictionary keys included
+        uint64_t nodes = 0;
+    };
+
+
+    enum class SolFootprintOrder
+    {
+        Retained,
+        Encoded,
+        Duplicated,
+    };
+
+
+    struct SolFootprintOptions
+    {
+        // largest first, ties are kept in file order
+        SolFootprintOrder order = SolFootprintOrder::Retained;
+        // values under this many bytes by order are left out of the list,
+        // they are still counted toward their containers
+        uint64_t minbytes = 0;
+        // at most this many values are listed
+        size_t limit = SIZE_MAX;
+    };
+
+
+    struct SolFootprint
+    {
+        // of the whole file, the top level map included
+        uint64_t retained = 0;
+        uint64_t duplicated = 0;
+        uint64_t encoded = 0;
+        uint64_t nodes = 0;
+
+        // the values by options.order, the members of dictionaries are counted
+        // toward the dictionary since a path cannot reach them
+        std::vector<SolValueFootprint> values;
+
+        // the totals and a line per value listed
+        std::string report() const;
+    };
+
+
+    // walks the values of file and writes them in file.version to measure them,
+    // throws if a value cannot be written as WriteSolFile would fail
+    SolFootprint GetSolFootprint(const SolFile& file, const SolFootprintOptions& options = SolFootprintOptions());
+}
+
+#endif // !__FOOTPRINT_H__
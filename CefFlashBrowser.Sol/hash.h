@@ -0,0 +1,110 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include "sol.h"
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+// hashing shared by SolValueHash and the nodes of tree.h, a node is hashed from the
+// hashes its children keep, so the two have to take the same steps to agree
+namespace sol::detail
+{
+    inline void HashCombine(size_t& seed, size_t hash)
+    {
+        seed ^= hash + 0x9E3779B9 + (seed << 6) + (seed >> 2);
+    }
+
+    inline size_t HashDouble(double value)
+    {
+        // +0.0 and -0.0 compare equal, so they have to hash equal as well
+        return std::hash<double>()(value == 0 ? 0.0 : value);
+    }
+
+    // the hash of a SolValue or a SolNode, TArray, TObject and TDictionary are its
+    // container storages, and childhash gives the hash of a child as they hold it
+    template <typename TArray, typename TObject, typename TDictionary, typename TValue, typename TChildHash>
+    size_t HashSolValue(const TValue& value, TChildHash&& childhash)
+    {
+        size_t seed = static_cast<size_t>(value.type);
+
+        if (!IsKnownType(value.type)) {
+            return seed;
+        }
+
+        std::visit([&](auto& v) {
+            using T = std::decay_t<decltype(v)>;
+
+            if constexpr (std::is_same_v<T, SolNull> || std::is_same_v<T, SolBoolean>) {
+                // the type alone tells the value
+            }
+            else if constexpr (std::is_same_v<T, SolInteger>) {
+                HashCombine(seed, std::hash<SolInteger>()(v));
+            }
+            else if constexpr (std::is_same_v<T, SolDouble>) {
+                HashCombine(seed, HashDouble(v));
+            }
+            else if constexpr (std::is_same_v<T, SolString>) {
+                HashCombine(seed, std::hash<SolString>()(v));
+            }
+            else if constexpr (std::is_same_v<T, SolBinary>) {
+                HashCombine(seed, std::hash<std::string_view>()(
+                    std::string_view(reinterpret_cast<const char*>(v.data()), v.size())));
+            }
+            else if constexpr (std::is_same_v<T, TArray>) {
+                for (auto& [key, val] : v.assoc) {
+                    HashCombine(seed, std::hash<std::string>()(key));
+                    HashCombine(seed, childhash(val));
+                }
+                for (auto& val : v.dense) {
+                    HashCombine(seed, childhash(val));
+                }
+            }
+            else if constexpr (std::is_same_v<T, TObject>) {
+                // the traits as well, keepraw tells an unchanged object by its hash
+                HashCombine(seed, std::hash<std::string>()(v.classdef.name));
+                HashCombine(seed, (v.classdef.dynamic ? 1 : 0) | (v.classdef.externalizable ? 2 : 0));
+                for (auto& member : v.classdef.members) {
+                    HashCombine(seed, std::hash<std::string>()(member));
+                }
+                for (auto& [key, val] : v.props) {
+                    HashCombine(seed, std::hash<std::string>()(key));
+                    HashCombine(seed, childhash(val));
+                }
+            }
+            else if constexpr (std::is_same_v<T, TDictionary>) {
+                // entry order does not take part in equality, so combine commutatively
+                size_t sum = 0;
+                for (auto& [key, val] : v.entries()) {
+                    size_t entry = childhash(key);
+                    HashCombine(entry, childhash(val));
+                    sum += entry;
+                }
+                HashCombine(seed, sum);
+            }
+            else {
+                static_assert(DependentFalse<T>, "HashSolValue does not handle this storage");
+            }
+        }, value.value);
+
+        return seed;
+    }
+
+    // dictionary keys compare as values do, except that a NaN key is the same key as
+    // a NaN with the same bits, so that it can be found again, a NaN nested in a
+    // compound key still compares unequal, equal compares the keys otherwise
+    template <typename TLeft, typename TRight, typename TEqual>
+    bool SameKey(const TLeft& left, const TRight& right, TEqual&& equal)
+    {
+        if (left.type == SolType::Double && right.type == SolType::Double) {
+            double l = left.template get<SolDouble>(), r = right.template get<SolDouble>();
+            if (std::isnan(l) || std::isnan(r)) {
+                return std::memcmp(&l, &r, sizeof(double)) == 0;
+            }
+        }
+        return equal(left, right);
+    }
+}
+
+#endif // !__HASH_H__
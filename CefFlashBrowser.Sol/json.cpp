@@ -0,0 +1,2012 @@
+#include "json.h"
+#include "encoder.h"
+#include "skipper.h"
+#include "trace.h"
+#include "utils.h"
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+
+namespace
+{
+    // output is handed to the stream in pieces of about this size
+    constexpr size_t FLUSH_SIZE = 64 * 1024;
+
+    const char HEX_DIGITS[] = "0123456789abcdef";
+    const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    // the length of the UTF-8 sequence at p, 0 if it is not a valid one
+    size_t Utf8Length(const uint8_t* p, const uint8_t* end)
+    {
+        uint8_t c = p[0];
+        size_t len;
+
+        if (c < 0x80) {
+            return 1;
+        }
+        else if (c < 0xC2) {
+            return 0; // a continuation byte, or an overlong two byte sequence
+        }
+        else if (c < 0xE0) {
+            len = 2;
+        }
+        else if (c < 0xF0) {
+            len = 3;
+        }
+        else if (c < 0xF5) {
+            len = 4;
+        }
+        else {
+            return 0;
+        }
+
+        if (static_cast<size_t>(end - p) < len) {
+            return 0;
+        }
+        for (size_t i = 1; i < len; ++i) {
+            if ((p[i] & 0xC0) != 0x80) {
+                return 0;
+            }
+        }
+
+        // overlong forms, surrogates and code points past U+10FFFF
+        if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] >= 0xA0)
+            || (c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] >= 0x90)) {
+            return 0;
+        }
+        return len;
+    }
+
+    void AppendEscape(std::string& out, uint16_t unit)
+    {
+        char tmp[6] = { '\\', 'u', HEX_DIGITS[unit >> 12], HEX_DIGITS[(unit >> 8) & 0xF],
+            HEX_DIGITS[(unit >> 4) & 0xF], HEX_DIGITS[unit & 0xF] };
+        out.append(tmp, sizeof(tmp));
+    }
+
+    // a JSON string, names get another $ in front if dollar is set
+    void AppendJsonString(std::string& out, std::string_view str, bool dollar = false)
+    {
+        out.push_back('"');
+        if (dollar && !str.empty() && str[0] == '$') {
+            out.push_back('$');
+        }
+
+        auto p = reinterpret_cast<const uint8_t*>(str.data());
+        auto end = p + str.size();
+        auto run = p;
+
+        while (p < end) {
+            uint8_t c = *p;
+            if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+                ++p;
+                continue;
+            }
+            if (c >= 0x80) {
+                size_t len = Utf8Length(p, end);
+                if (len != 0) {
+                    p += len;
+                    continue;
+                }
+            }
+
+            out.append(reinterpret_cast<const char*>(run), p - run);
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                // bytes that are not UTF-8 become lone low surrogates, which no
+                // valid text escapes to, so that they are read back as the byte
+                AppendEscape(out, c < 0x80 ? c : 0xDC00 | c);
+                break;
+            }
+            run = ++p;
+        }
+
+        out.append(reinterpret_cast<const char*>(run), p - run);
+        out.push_back('"');
+    }
+
+    template <typename T>
+    void AppendInteger(std::string& out, T value)
+    {
+        char tmp[24];
+        auto result = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        out.append(tmp, result.ptr - tmp);
+    }
+
+    // the shortest form that reads back as the same double, with a fraction or an
+    // exponent so that it is not taken for an integer
+    void AppendDouble(std::string& out, double value)
+    {
+        if (!std::isfinite(value)) {
+            out += "{\"$double\":\"";
+            out += std::isnan(value) ? "NaN" : value > 0 ? "Infinity" : "-Infinity";
+            out += "\"}";
+            return;
+        }
+
+        char tmp[32];
+        auto result = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        size_t len = result.ptr - tmp;
+        out.append(tmp, len);
+        if (std::string_view(tmp, len).find_first_of(".e") == std::string_view::npos) {
+            out += ".0";
+        }
+    }
+
+    void AppendBase64(std::string& out, const uint8_t* data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3) {
+            uint32_t n = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+            char tmp[4] = { BASE64_CHARS[n >> 18], BASE64_CHARS[(n >> 12) & 0x3F],
+                BASE64_CHARS[(n >> 6) & 0x3F], BASE64_CHARS[n & 0x3F] };
+            out.append(tmp, sizeof(tmp));
+        }
+        if (i < size) {
+            uint32_t n = data[i] << 16;
+            if (i + 1 < size) {
+                n |= data[i + 1] << 8;
+            }
+            char tmp[4] = { BASE64_CHARS[n >> 18], BASE64_CHARS[(n >> 12) & 0x3F],
+                i + 1 < size ? BASE64_CHARS[(n >> 6) & 0x3F] : '=', '=' };
+            out.append(tmp, sizeof(tmp));
+        }
+    }
+
+
+    // a container of the AMF side being written out, the JSON text that closes
+    // it is kept with it since arrays and dictionaries close with more than one
+    struct JsonFrame
+    {
+        sol::detail::ReadFrameState state;
+        bool flag;          // dynamic class for AMF3 objects, typed object for AMF0
+        bool first;         // nothing written into the innermost JSON container yet
+        bool haskey;        // key holds the first associative key of an array
+        uint32_t remaining;
+        uint32_t members;
+        size_t classindex;
+        std::string_view key;
+        const char* close;
+    };
+
+    // walks the file as the validator does and writes each value as it is read
+    class JsonEmitter
+    {
+    public:
+        JsonEmitter(sol::detail::Reader& r, std::ostream& out)
+            : _r(r), _skipper{ r }, _out(out)
+        {
+            _skipper.table.record = true;
+        }
+
+        bool EmitFile()
+        {
+            using namespace sol;
+
+            std::string_view solname;
+            SolVersion version;
+            if (!_skipper.SkipSolHeader(solname, version)) {
+                return false;
+            }
+
+            bool amf0 = version == SolVersion::AMF0;
+            _json += "{\"name\":";
+            AppendJsonString(_json, solname);
+            _json += amf0 ? ",\"version\":0,\"data\":{" : ",\"version\":3,\"data\":{";
+
+            bool first = true;
+            while (_r.index < _r.size) {
+                std::string_view key;
+                if (amf0) {
+                    size_t len;
+                    if (!_skipper.SkipAMF0ShortString(len)) {
+                        return false;
+                    }
+                    key = std::string_view(reinterpret_cast<const char*>(_r.data + _r.index - len), len);
+                }
+                else {
+                    bool empty;
+                    if (!_skipper.SkipString(empty, &key)) {
+                        return false;
+                    }
+                }
+
+                _json += first ? "\n" : ",\n";
+                first = false;
+                AppendJsonString(_json, key);
+                _json.push_back(':');
+
+                uint8_t marker;
+                if (!detail::DecodeByte(_r, marker)) {
+                    return false;
+                }
+                if (amf0 ? !EmitAMF0Value(static_cast<AMF0Type>(marker)) : !EmitValue(static_cast<SolType>(marker))) {
+                    return false;
+                }
+
+                if (!detail::DecodeByte(_r, marker)) {
+                    return false;
+                }
+                if (marker != 0x00) {
+                    return _r.Fail(SolErrorCode::EndRequired, _r.index - 1, -1, false, marker, 0);
+                }
+            }
+
+            _json += "\n}}\n";
+            return true;
+        }
+
+        void Flush(bool force)
+        {
+            if (force || _json.size() >= FLUSH_SIZE) {
+                _out.write(_json.data(), _json.size());
+                _json.clear();
+            }
+        }
+
+    private:
+        bool EmitValue(sol::SolType type)
+        {
+            return EmitWithStack(type,
+                [this](sol::SolType type) { return BeginSolValue(type); },
+                [this](JsonFrame& frame, sol::SolType& type, bool& more) { return NextSolChild(frame, type, more); });
+        }
+
+        bool EmitAMF0Value(sol::AMF0Type type)
+        {
+            return EmitWithStack(type,
+                [this](sol::AMF0Type type) { return BeginAMF0Value(type); },
+                [this](JsonFrame& frame, sol::AMF0Type& type, bool& more) { return NextAMF0Child(frame, type, more); });
+        }
+
+        template <typename TType, typename TBegin, typename TNext>
+        bool EmitWithStack(TType type, TBegin&& begin, TNext&& next)
+        {
+            bool more;
+
+            if (!begin(type)) {
+                return false;
+            }
+
+            while (!_stack.empty()) {
+                if (!next(_stack.back(), type, more)) {
+                    return false;
+                }
+                if (more) {
+                    if (!begin(type)) {
+                        return false;
+                    }
+                    Flush(false);
+                    continue;
+                }
+
+                _json += _stack.back().close;
+                _stack.pop_back();
+            }
+
+            Flush(false);
+            return true;
+        }
+
+        bool Push(sol::detail::ReadFrameState state, bool flag, uint32_t remaining, uint32_t members, const char* close)
+        {
+            if (_stack.size() >= _r.options.maxdepth) {
+                return _r.Fail(sol::SolErrorCode::MaxDepthExceeded, _r.index, -1, false, 0, _r.options.maxdepth);
+            }
+            _stack.push_back({ state, flag, true, false, remaining, members, 0, std::string_view(), close });
+            return true;
+        }
+
+        void Separate(JsonFrame& frame)
+        {
+            if (!frame.first) {
+                _json.push_back(',');
+            }
+            frame.first = false;
+        }
+
+        void Member(JsonFrame& frame, std::string_view name, bool dollar)
+        {
+            Separate(frame);
+            AppendJsonString(_json, name, dollar);
+            _json.push_back(':');
+        }
+
+        bool Ref(size_t index)
+        {
+            _json += "{\"$ref\":";
+            AppendInteger(_json, index);
+            _json.push_back('}');
+            return true;
+        }
+
+        bool BeginSolValue(sol::SolType type)
+        {
+            using namespace sol;
+
+            size_t marker = _r.index - 1;
+            size_t len;
+            bool inlined;
+
+            switch (type)
+            {
+            case SolType::Undefined:
+                _json += "{\"$undefined\":true}";
+                return true;
+
+            case SolType::Null:
+                _json += "null";
+                return true;
+
+            case SolType::BooleanFalse:
+                _json += "false";
+                return true;
+
+            case SolType::BooleanTrue:
+                _json += "true";
+                return true;
+
+            case SolType::Integer: {
+                SolInteger value;
+                if (!detail::DecodeInteger(_r, value)) {
+                    return false;
+                }
+                AppendInteger(_json, value);
+                return true;
+            }
+
+            case SolType::Double: {
+                double value;
+                if (!detail::DecodeDouble(_r, value, SolType::Double)) {
+                    return false;
+                }
+                AppendDouble(_json, value);
+                return true;
+            }
+
+            case SolType::String: {
+                bool empty;
+                std::string_view value;
+                if (!_skipper.SkipString(empty, &value)) {
+                    return false;
+                }
+                AppendJsonString(_json, value);
+                return true;
+            }
+
+            case SolType::XmlDoc:
+            case SolType::Xml:
+            case SolType::Binary: {
+                if (!_skipper.SkipObjRef(len, inlined)) {
+                    return false;
+                }
+                if (!inlined) {
+                    return Ref(len);
+                }
+                if (!_skipper.SkipPayload(len, type)) {
+                    return false;
+                }
+                _skipper.AddObject(marker);
+
+                const uint8_t* payload = _r.data + _r.index - len;
+                if (type == SolType::Binary) {
+                    _json += "{\"$binary\":\"";
+                    AppendBase64(_json, payload, len);
+                    _json += "\"}";
+                }
+                else {
+                    _json += type == SolType::Xml ? "{\"$xml\":" : "{\"$xmldoc\":";
+                    AppendJsonString(_json, std::string_view(reinterpret_cast<const char*>(payload), len));
+                    _json.push_back('}');
+                }
+                return true;
+            }
+
+            case SolType::Date: {
+                if (!_skipper.SkipObjRef(len, inlined)) {
+                    return false;
+                }
+                if (!inlined) {
+                    return Ref(len);
+                }
+                double value;
+                if (!detail::DecodeDouble(_r, value, SolType::Double)) {
+                    return false;
+                }
+                _skipper.AddObject(marker);
+
+                _json += "{\"$date\":";
+                AppendDouble(_json, value);
+                _json.push_back('}');
+                return true;
+            }
+
+            case SolType::Array:
+            case SolType::Object:
+            case SolType::Dictionary:
+                break;
+
+            default:
+                return _r.Fail(SolErrorCode::UnknownType, _r.index - 1, static_cast<int>(type));
+            }
+
+            size_t start = _r.index;
+            SolInteger ref;
+            if (!detail::DecodeInteger(_r, ref, true)) {
+                return false;
+            }
+
+            if ((ref & 1) == 0) {
+                return _skipper.CheckRef(ref >> 1, _skipper.table.objects, start) && Ref(ref >> 1);
+            }
+
+            if (type == SolType::Array) {
+                uint32_t count = ref >> 1;
+                if (!_skipper.CheckCount(count, 1, type)) {
+                    return false;
+                }
+                _skipper.AddObject(marker);
+
+                // the first key tells whether the array has an associative part
+                bool empty;
+                std::string_view key;
+                if (!_skipper.SkipString(empty, &key)) {
+                    return false;
+                }
+                if (empty) {
+                    _json.push_back('[');
+                    return Push(detail::ReadFrameState::ArrayDense, false, count, 0, "]");
+                }
+
+                _json += "{\"$assoc\":{";
+                if (!Push(detail::ReadFrameState::ArrayAssoc, false, count, 0, "}}")) {
+                    return false;
+                }
+                _stack.back().key = key;
+                _stack.back().haskey = true;
+                return true;
+            }
+            else if (type == SolType::Object) {
+                size_t classindex;
+                if (!_skipper.SkipTraits(ref >> 1, start, classindex)) {
+                    return false;
+                }
+                _skipper.AddObject(marker);
+
+                auto& traits = _skipper.table.classes[classindex];
+                bool first = true;
+                _json.push_back('{');
+
+                auto& table = _skipper.table;
+                if (!table.ClassName(traits).empty()) {
+                    _json += "\"$class\":";
+                    AppendJsonString(_json, table.ClassName(traits));
+                    first = false;
+                }
+                if (traits.members != 0) {
+                    _json += first ? "\"$sealed\":[" : ",\"$sealed\":[";
+                    for (uint32_t i = 0; i < traits.members; ++i) {
+                        if (i != 0) {
+                            _json.push_back(',');
+                        }
+                        AppendJsonString(_json, table.MemberName(traits, i));
+                    }
+                    _json.push_back(']');
+                    first = false;
+                }
+                if (!traits.dynamic) {
+                    _json += first ? "\"$dynamic\":false" : ",\"$dynamic\":false";
+                    first = false;
+                }
+
+                if (!Push(detail::ReadFrameState::ObjectSealed, traits.dynamic, 0, traits.members, "}")) {
+                    return false;
+                }
+                _stack.back().first = first;
+                _stack.back().classindex = classindex;
+                return true;
+            }
+            else {
+                uint32_t count = ref >> 1;
+                uint8_t weakkeys;
+                if (!detail::DecodeByte(_r, weakkeys) || !_skipper.CheckCount(count, 2, type)) {
+                    return false;
+                }
+                _skipper.AddObject(marker);
+
+                _json += weakkeys != 0x00 ? "{\"$weakkeys\":true,\"$dictionary\":[" : "{\"$dictionary\":[";
+                return Push(detail::ReadFrameState::DictionaryKey, false, count, 0, "]}");
+            }
+        }
+
+        bool NextSolChild(JsonFrame& frame, sol::SolType& type, bool& more)
+        {
+            using namespace sol;
+
+            bool empty;
+            std::string_view key;
+            more = false;
+
+            switch (frame.state)
+            {
+            case detail::ReadFrameState::ArrayAssoc:
+                if (frame.haskey) {
+                    key = frame.key;
+                    frame.haskey = false;
+                }
+                else {
+                    if (!_skipper.SkipString(empty, &key)) {
+                        return false;
+                    }
+                    if (empty) {
+                        if (frame.remaining == 0) {
+                            return true;
+                        }
+                        _json += "},\"$array\":[";
+                        frame.state = detail::ReadFrameState::ArrayDense;
+                        frame.first = true;
+                        frame.close = "]}";
+                        --frame.remaining;
+                        Separate(frame);
+                        break;
+                    }
+                }
+                Member(frame, key, false);
+                break;
+
+            case detail::ReadFrameState::ArrayDense:
+                if (frame.remaining == 0) {
+                    return true;
+                }
+                --frame.remaining;
+                Separate(frame);
+                break;
+
+            case detail::ReadFrameState::ObjectSealed:
+                if (frame.remaining < frame.members) {
+                    Member(frame, _skipper.table.MemberName(_skipper.table.classes[frame.classindex], frame.remaining++), true);
+                    break;
+                }
+                if (!frame.flag) {
+                    return true;
+                }
+                frame.state = detail::ReadFrameState::ObjectDynamic;
+                [[fallthrough]];
+
+            case detail::ReadFrameState::ObjectDynamic:
+                if (!_skipper.SkipString(empty, &key)) {
+                    return false;
+                }
+                if (empty) {
+                    return true;
+                }
+                Member(frame, key, true);
+                break;
+
+            case detail::ReadFrameState::DictionaryKey:
+                if (!frame.first) {
+                    _json.push_back(']');
+                }
+                if (frame.remaining == 0) {
+                    return true;
+                }
+                --frame.remaining;
+                Separate(frame);
+                _json.push_back('[');
+                frame.state = detail::ReadFrameState::DictionaryValue;
+                break;
+
+            case detail::ReadFrameState::DictionaryValue:
+                _json.push_back(',');
+                frame.state = detail::ReadFrameState::DictionaryKey;
+                break;
+
+            default:
+                return true;
+            }
+
+            uint8_t marker;
+            if (!detail::DecodeByte(_r, marker)) {
+                return false;
+            }
+            type = static_cast<SolType>(marker);
+            more = true;
+            return true;
+        }
+
+        bool BeginAMF0Value(sol::AMF0Type type)
+        {
+            using namespace sol;
+
+            size_t marker = _r.index - 1;
+            size_t len;
+
+            switch (type)
+            {
+            case AMF0Type::Number: {
+                double value;
+                if (!detail::DecodeDouble(_r, value, AMF0Type::Number)) {
+                    return false;
+                }
+                AppendDouble(_json, value);
+                return true;
+            }
+
+            case AMF0Type::Boolean: {
+                bool value;
+                if (!detail::DecodeAMF0Boolean(_r, value)) {
+                    return false;
+                }
+                _json += value ? "true" : "false";
+                return true;
+            }
+
+            case AMF0Type::String:
+                if (!_skipper.SkipAMF0ShortString(len)) {
+                    return false;
+                }
+                AppendJsonString(_json, std::string_view(reinterpret_cast<const char*>(_r.data + _r.index - len), len));
+                return true;
+
+            case AMF0Type::Null:
+                _json += "null";
+                return true;
+
+            case AMF0Type::Undefined:
+                _json += "{\"$undefined\":true}";
+                return true;
+
+            case AMF0Type::Reference: {
+                size_t start = _r.index;
+                uint16_t ref;
+                return detail::DecodeBigEndian(_r, ref) && _skipper.CheckRef(ref, _skipper.table.objects, start) && Ref(ref);
+            }
+
+            case AMF0Type::Date: {
+                if (10 > _r.size - _r.index) {
+                    return _r.Truncated(AMF0Type::Date);
+                }
+                double value = codec::LoadDouble(_r.data + _r.index + 2);
+                _r.index += 10;
+
+                _json += "{\"$date\":";
+                AppendDouble(_json, value);
+                _json.push_back('}');
+                return true;
+            }
+
+            case AMF0Type::LongString:
+            case AMF0Type::XMLDoc: {
+                uint32_t value;
+                if (!detail::DecodeBigEndian(_r, value) || !_skipper.SkipPayload(value, AMF0Type::LongString)) {
+                    return false;
+                }
+                std::string_view str(reinterpret_cast<const char*>(_r.data + _r.index - value), value);
+                if (type == AMF0Type::XMLDoc) {
+                    _json += "{\"$xmldoc\":";
+                    AppendJsonString(_json, str);
+                    _json.push_back('}');
+                }
+                else {
+                    AppendJsonString(_json, str);
+                }
+                return true;
+            }
+
+            case AMF0Type::Object:
+                _skipper.AddObject(marker);
+                _json.push_back('{');
+                return Push(detail::ReadFrameState::AMF0Object, false, 0, 0, "}");
+
+            case AMF0Type::TypedObject:
+                if (!_skipper.SkipAMF0ShortString(len)) {
+                    return false;
+                }
+                _skipper.AddObject(marker);
+
+                _json.push_back('{');
+                if (len != 0) {
+                    _json += "\"$class\":";
+                    AppendJsonString(_json, std::string_view(reinterpret_cast<const char*>(_r.data + _r.index - len), len));
+                }
+                if (!Push(detail::ReadFrameState::AMF0Object, len != 0, 0, 0, "}")) {
+                    return false;
+                }
+                _stack.back().first = len == 0;
+                return true;
+
+            case AMF0Type::EcmaArray:
+            case AMF0Type::StrictArray: {
+                bool ecma = type == AMF0Type::EcmaArray;
+                uint32_t count;
+                if (!detail::DecodeBigEndian(_r, count) || !_skipper.CheckCount(count, ecma ? 3 : 1, type)) {
+                    return false;
+                }
+                _skipper.AddObject(marker);
+
+                if (ecma) {
+                    _json += "{\"$assoc\":{";
+                    return Push(detail::ReadFrameState::AMF0EcmaArray, false, count, 0, "}}");
+                }
+                _json.push_back('[');
+                return Push(detail::ReadFrameState::AMF0StrictArray, false, count, 0, "]");
+            }
+
+            case AMF0Type::MovieClip:
+            case AMF0Type::ObjectEnd:
+            case AMF0Type::Unsupported:
+            case AMF0Type::Recordset:
+                return _r.Fail(SolErrorCode::UnsupportedType, _r.index - 1, static_cast<int>(type), true);
+
+            default:
+                return _r.Fail(SolErrorCode::UnknownType, _r.index - 1, static_cast<int>(type), true);
+            }
+        }
+
+        bool NextAMF0Child(JsonFrame& frame, sol::AMF0Type& type, bool& more)
+        {
+            using namespace sol;
+
+            size_t len;
+            more = false;
+
+            switch (frame.state)
+            {
+            case detail::ReadFrameState::AMF0Object:
+            case detail::ReadFrameState::AMF0EcmaArray:
+                if (frame.state == detail::ReadFrameState::AMF0EcmaArray && frame.remaining == 0) {
+                    for (uint8_t mark : codec::AMF0_OBJECT_ENDMARK) {
+                        uint8_t read;
+                        if (!detail::DecodeByte(_r, read)) {
+                            return false;
+                        }
+                        if (read != mark) {
+                            return _r.Fail(SolErrorCode::BadFormat, _r.index - 1, static_cast<int>(AMF0Type::EcmaArray), true, read, mark);
+                        }
+                    }
+                    return true;
+                }
+
+                if (!_skipper.SkipAMF0ShortString(len)) {
+                    return false;
+                }
+                if (frame.state == detail::ReadFrameState::AMF0EcmaArray) {
+                    --frame.remaining;
+                }
+                else if (len == 0) {
+                    uint8_t marker;
+                    if (!detail::DecodeByte(_r, marker)) {
+                        return false;
+                    }
+                    if (marker != static_cast<uint8_t>(AMF0Type::ObjectEnd)) {
+                        auto objtype = frame.flag ? AMF0Type::TypedObject : AMF0Type::Object;
+                        return _r.Fail(SolErrorCode::BadFormat, _r.index - 1, static_cast<int>(objtype), true,
+                            marker, static_cast<int>(AMF0Type::ObjectEnd));
+                    }
+                    return true;
+                }
+                Member(frame, std::string_view(reinterpret_cast<const char*>(_r.data + _r.index - len), len),
+                    frame.state == detail::ReadFrameState::AMF0Object);
+                break;
+
+            case detail::ReadFrameState::AMF0StrictArray:
+                if (frame.remaining == 0) {
+                    return true;
+                }
+                --frame.remaining;
+                Separate(frame);
+                break;
+
+            default:
+                return true;
+            }
+
+            uint8_t marker;
+            if (!detail::DecodeByte(_r, marker)) {
+                return false;
+            }
+            type = static_cast<AMF0Type>(marker);
+            more = true;
+            return true;
+        }
+
+        sol::detail::Reader& _r;
+        sol::detail::Skipper _skipper;
+        std::ostream& _out;
+        std::string _json;
+        std::vector<JsonFrame> _stack;
+    };
+
+
+    [[noreturn]] void ThrowJson(const char* what, size_t offset)
+    {
+        throw std::runtime_error(utils::FormatString("%s at offset %zu", what, offset));
+    }
+
+    // the children of a JSON object or array and the containers nested in it,
+    // found ahead since AMF writes the count of a container before its children
+    struct JsonContainer
+    {
+        uint32_t count;
+        uint32_t descendants;
+    };
+
+    enum class JsonFrameState : uint8_t
+    {
+        Dense,
+        Assoc,
+        Object,
+        DictionaryKey,
+        DictionaryValue,
+        DictionaryPair,
+    };
+
+    // a container of the JSON side being read, wrapped is set if it is the value
+    // of a tag whose object is closed with it
+    struct JsonReadFrame
+    {
+        JsonFrameState state;
+        bool first;
+        bool wrapped;
+        bool pending;       // the first member's key has been read already
+        bool dynamic;
+        uint32_t remaining; // sealed members still to come
+        size_t classindex;  // in _classdefs, SIZE_MAX for anonymous classes
+    };
+
+    // reads JSON laid out as json.h describes and writes the sol file as it goes,
+    // the containers are kept on an explicit stack as the decoder keeps them
+    class JsonTranscoder
+    {
+    public:
+        JsonTranscoder(const char* data, size_t size, std::ostream& out, const sol::SolReadOptions& options)
+            : _begin(data), _p(data), _end(data + size), _out(out), _options(options)
+        {
+            _anonymous.dynamic = true;
+        }
+
+        void TranscodeFile()
+        {
+            using namespace sol;
+
+            CountContainers();
+
+            std::streamoff start = _out.tellp();
+            if (start < 0) {
+                throw std::runtime_error("Output is not seekable");
+            }
+
+            Open('{');
+            if (!Begin('}')) {
+                ThrowJson("Expected \"data\"", Offset());
+            }
+
+            std::string solname;
+            bool hasversion = false;
+            bool hasdata = false;
+            do {
+                ReadString(_key);
+                Expect(':');
+
+                if (_key == "name" && !hasdata) {
+                    ReadString(solname);
+                }
+                else if (_key == "version" && !hasdata) {
+                    size_t offset = Offset();
+                    double version = ReadDouble();
+                    if (version != 0 && version != 3) {
+                        ThrowJson("Unsupported version", offset);
+                    }
+                    _amf0 = version == 0;
+                    hasversion = true;
+                }
+                else if (_key == "data" && hasversion && !hasdata) {
+                    detail::WriteSolHeader(_buffer, solname, _amf0 ? SolVersion::AMF0 : SolVersion::AMF3);
+                    TranscodeEntries();
+                    hasdata = true;
+                }
+                else {
+                    ThrowJson("Unexpected member", Offset());
+                }
+            } while (Next('}'));
+
+            if (!hasdata) {
+                ThrowJson("Expected \"data\"", Offset());
+            }
+            SkipSpace();
+            if (_p != _end) {
+                ThrowJson("Unexpected text after the file", Offset());
+            }
+            Flush(true);
+
+            // the chunk size is known only now
+            if (_written - 6 > UINT32_MAX) {
+                throw std::runtime_error(utils::FormatString("File too large to encode: %llu bytes", (unsigned long long)_written));
+            }
+            uint8_t chunksize[4];
+            codec::StoreBigEndian(chunksize, static_cast<uint32_t>(_written - 6));
+
+            _out.seekp(start + 2);
+            _out.write(reinterpret_cast<const char*>(chunksize), sizeof(chunksize));
+            _out.seekp(start + static_cast<std::streamoff>(_written));
+            if (!_out) {
+                throw std::runtime_error("Failed to write the output");
+            }
+        }
+
+    private:
+        size_t Offset() const
+        {
+            return _p - _begin;
+        }
+
+        void CountContainers()
+        {
+            struct OpenContainer
+            {
+                size_t index;
+                uint32_t commas;
+                bool content;
+            };
+            std::vector<OpenContainer> open;
+
+            for (const char* p = _begin; p < _end; ++p) {
+                char c = *p;
+                if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                    continue;
+                }
+                if (!open.empty() && c != '}' && c != ']') {
+                    open.back().content = true;
+                }
+
+                switch (c)
+                {
+                case '"':
+                    for (++p; p < _end && *p != '"'; ++p) {
+                        if (*p == '\\') {
+                            ++p;
+                        }
+                    }
+                    if (p >= _end) {
+                        ThrowJson("Unterminated string", _end - _begin);
+                    }
+                    break;
+
+                case '{':
+                case '[':
+                    open.push_back({ _containers.size(), 0, false });
+                    _containers.push_back({ 0, 0 });
+                    break;
+
+                case ',':
+                    if (!open.empty()) {
+                        ++open.back().commas;
+                    }
+                    break;
+
+                case '}':
+                case ']': {
+                    if (open.empty()) {
+                        ThrowJson("Unexpected close", p - _begin);
+                    }
+                    auto& container = _containers[open.back().index];
+                    container.count = open.back().content ? open.back().commas + 1 : 0;
+                    container.descendants = static_cast<uint32_t>(_containers.size() - open.back().index - 1);
+                    open.pop_back();
+                    break;
+                }
+
+                default:
+                    break;
+                }
+            }
+
+            if (!open.empty()) {
+                ThrowJson("Unterminated container", _end - _begin);
+            }
+        }
+
+        void SkipSpace()
+        {
+            while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) {
+                ++_p;
+            }
+        }
+
+        char Peek()
+        {
+            SkipSpace();
+            return _p < _end ? *_p : '\0';
+        }
+
+        void Expect(char c)
+        {
+            if (Peek() != c) {
+                ThrowJson(utils::FormatString("Expected '%c'", c).c_str(), Offset());
+            }
+            ++_p;
+        }
+
+        // every bracket is opened through here so that the counts stay in step,
+        // returns the index of the container
+        size_t Open(char c)
+        {
+            Expect(c);
+            return _next++;
+        }
+
+        // false if the container closes right away
+        bool Begin(char close)
+        {
+            if (Peek() == close) {
+                ++_p;
+                return false;
+            }
+            return true;
+        }
+
+        // true if another child follows, false if the container closes
+        bool Next(char close)
+        {
+            char c = Peek();
+            if (c == ',') {
+                ++_p;
+                return true;
+            }
+            if (c != close) {
+                ThrowJson(utils::FormatString("Expected ',' or '%c'", close).c_str(), Offset());
+            }
+            ++_p;
+            return false;
+        }
+
+        // the object of a tag ends after its value
+        void EndTag()
+        {
+            if (Peek() == ',') {
+                ThrowJson("Unexpected member after a tag", Offset());
+            }
+            Expect('}');
+        }
+
+        bool Literal(const char* word)
+        {
+            size_t len = strlen(word);
+            if (static_cast<size_t>(_end - _p) < len || memcmp(_p, word, len) != 0) {
+                return false;
+            }
+            _p += len;
+            return true;
+        }
+
+        bool ReadBoolean()
+        {
+            Peek();
+            if (Literal("true")) {
+                return true;
+            }
+            if (Literal("false")) {
+                return false;
+            }
+            ThrowJson("Expected true or false", Offset());
+        }
+
+        uint32_t ReadHex4()
+        {
+            if (_end - _p < 4) {
+                ThrowJson("Bad escape", Offset());
+            }
+            uint32_t value;
+            auto result = std::from_chars(_p, _p + 4, value, 16);
+            if (result.ec != std::errc() || result.ptr != _p + 4) {
+                ThrowJson("Bad escape", Offset());
+            }
+            _p += 4;
+            return value;
+        }
+
+        static void AppendUtf8(std::string& out, uint32_t cp)
+        {
+            if (cp < 0x80) {
+                out.push_back(static_cast<char>(cp));
+            }
+            else if (cp < 0x800) {
+                out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+            else if (cp < 0x10000) {
+                out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+            else {
+                out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+        }
+
+        void ReadString(std::string& out)
+        {
+            size_t start = Offset();
+            Expect('"');
+            out.clear();
+
+            const char* run = _p;
+            while (true) {
+                if (_p >= _end) {
+                    ThrowJson("Unterminated string", start);
+                }
+                char c = *_p;
+                if (c == '"') {
+                    break;
+                }
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    ThrowJson("Control character in string", Offset());
+                }
+                if (c != '\\') {
+                    ++_p;
+                    continue;
+                }
+
+                out.append(run, _p);
+                if (++_p >= _end) {
+                    ThrowJson("Unterminated string", start);
+                }
+                switch (*_p++)
+                {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    uint32_t cp = ReadHex4();
+                    if (cp >= 0xD800 && cp < 0xDC00) {
+                        if (_end - _p < 2 || _p[0] != '\\' || _p[1] != 'u') {
+                            ThrowJson("Unpaired surrogate", Offset());
+                        }
+                        _p += 2;
+                        uint32_t low = ReadHex4();
+                        if (low < 0xDC00 || low >= 0xE000) {
+                            ThrowJson("Unpaired surrogate", Offset());
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    else if (cp >= 0xDC80 && cp < 0xDD00) {
+                        // a byte that was not UTF-8
+                        out.push_back(static_cast<char>(cp & 0xFF));
+                        break;
+                    }
+                    else if (cp >= 0xDC00 && cp < 0xE000) {
+                        ThrowJson("Unpaired surrogate", Offset());
+                    }
+                    AppendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    ThrowJson("Bad escape", Offset() - 1);
+                }
+                run = _p;
+            }
+
+            out.append(run, _p);
+            ++_p;
+
+            if (out.size() > _options.maxstring) {
+                ThrowJson("String too long", start);
+            }
+        }
+
+        // scans a number, integer is set if it has no fraction or exponent
+        std::string_view ScanNumber(bool& integer)
+        {
+            Peek();
+            const char* start = _p;
+            integer = true;
+            while (_p < _end) {
+                char c = *_p;
+                if (c == '.' || c == 'e' || c == 'E') {
+                    integer = false;
+                }
+                else if ((c < '0' || c > '9') && c != '-' && c != '+') {
+                    break;
+                }
+                ++_p;
+            }
+            if (_p == start) {
+                ThrowJson("Unexpected character", Offset());
+            }
+            return std::string_view(start, _p - start);
+        }
+
+        double ParseDouble(std::string_view text)
+        {
+            double value;
+            auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+                ThrowJson("Bad number", Offset() - text.size());
+            }
+            return value;
+        }
+
+        // a number, or one JSON lacks in a $double tag
+        double ReadDouble()
+        {
+            if (Peek() != '{') {
+                bool integer;
+                return ParseDouble(ScanNumber(integer));
+            }
+
+            Open('{');
+            size_t offset = Offset();
+            ReadString(_key);
+            if (_key != "$double") {
+                ThrowJson("Expected \"$double\"", offset);
+            }
+            Expect(':');
+            double value = ReadDoubleName();
+            EndTag();
+            return value;
+        }
+
+        // the value of a $double tag
+        double ReadDoubleName()
+        {
+            size_t offset = Offset();
+            ReadString(_key);
+
+            if (_key == "NaN") {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            if (_key == "Infinity") {
+                return std::numeric_limits<double>::infinity();
+            }
+            if (_key == "-Infinity") {
+                return -std::numeric_limits<double>::infinity();
+            }
+            ThrowJson("Unknown $double", offset);
+        }
+
+        void ReadBase64(std::string_view text, sol::SolBinary& out, size_t offset)
+        {
+            static const auto table = [] {
+                std::array<int8_t, 256> result;
+                result.fill(-1);
+                for (int i = 0; i < 64; ++i) {
+                    result[static_cast<uint8_t>(BASE64_CHARS[i])] = static_cast<int8_t>(i);
+                }
+                return result;
+            }();
+
+            out.clear();
+            if (text.size() % 4 != 0) {
+                ThrowJson("Bad base64", offset);
+            }
+            out.reserve(text.size() / 4 * 3);
+
+            for (size_t i = 0; i < text.size(); i += 4) {
+                bool last = i + 4 == text.size();
+                size_t pad = last ? (text[i + 3] == '=') + (text[i + 2] == '=' && text[i + 3] == '=') : 0;
+
+                uint32_t n = 0;
+                for (size_t j = 0; j < 4; ++j) {
+                    int8_t v = j >= 4 - pad ? 0 : table[static_cast<uint8_t>(text[i + j])];
+                    if (v < 0) {
+                        ThrowJson("Bad base64", offset);
+                    }
+                    n = n << 6 | v;
+                }
+
+                out.push_back(static_cast<uint8_t>(n >> 16));
+                if (pad < 2) {
+                    out.push_back(static_cast<uint8_t>(n >> 8));
+                }
+                if (pad < 1) {
+                    out.push_back(static_cast<uint8_t>(n));
+                }
+            }
+        }
+
+        void Flush(bool force)
+        {
+            if (force || _buffer.size() >= FLUSH_SIZE) {
+                _out.write(reinterpret_cast<const char*>(_buffer.data()), _buffer.size());
+                if (!_out) {
+                    throw std::runtime_error("Failed to write the output");
+                }
+                _written += _buffer.size();
+                _buffer.clear();
+            }
+        }
+
+        void Marker(sol::SolType type, sol::AMF0Type amf0type)
+        {
+            _buffer.push_back(_amf0 ? static_cast<uint8_t>(amf0type) : static_cast<uint8_t>(type));
+        }
+
+        // a value that takes a slot in the object table, with the marker a reference repeats
+        void AddObject(uint8_t marker)
+        {
+            _buffer.push_back(marker);
+            _objects.push_back(marker);
+        }
+
+        void EndMark()
+        {
+            _buffer.insert(_buffer.end(), std::begin(sol::codec::AMF0_OBJECT_ENDMARK), std::end(sol::codec::AMF0_OBJECT_ENDMARK));
+        }
+
+        void Header(size_t count, const char* what)
+        {
+            if (count > sol::codec::AMF3_INLINE_MAXLEN) {
+                throw std::runtime_error(utils::FormatString("%s too long to encode: %zu bytes", what, count));
+            }
+            sol::WriteSolInteger(_buffer, static_cast<sol::SolInteger>(count << 1 | 1), true);
+        }
+
+        void WriteString(const std::string& value)
+        {
+            if (!_amf0) {
+                _buffer.push_back(static_cast<uint8_t>(sol::SolType::String));
+                sol::WriteSolString(_buffer, value, _reftable);
+            }
+            else if (value.size() > sol::codec::AMF0_SHORTSTRING_MAXLEN) {
+                _buffer.push_back(static_cast<uint8_t>(sol::AMF0Type::LongString));
+                sol::WriteAMF0LongString(_buffer, value);
+            }
+            else {
+                _buffer.push_back(static_cast<uint8_t>(sol::AMF0Type::String));
+                sol::WriteAMF0ShortString(_buffer, value);
+            }
+        }
+
+        void WriteDouble(double value)
+        {
+            Marker(sol::SolType::Double, sol::AMF0Type::Number);
+            sol::WriteSolDouble(_buffer, value);
+        }
+
+        void WriteKey(const std::string& key)
+        {
+            if (_amf0) {
+                sol::WriteAMF0ShortString(_buffer, key);
+            }
+            else {
+                sol::WriteSolString(_buffer, key, _reftable);
+            }
+        }
+
+        // a member name, with the $ of a tag taken off again
+        void UnescapeKey(size_t offset)
+        {
+            if (!_key.empty() && _key[0] == '$') {
+                if (_key.size() < 2 || _key[1] != '$') {
+                    ThrowJson("Unknown tag", offset);
+                }
+                _key.erase(0, 1);
+            }
+        }
+
+        static bool IsTag(const std::string& key)
+        {
+            return !key.empty() && key[0] == '$' && (key.size() < 2 || key[1] != '$');
+        }
+
+        void Push(JsonFrameState state, bool wrapped, bool pending = false, bool dynamic = true, uint32_t remaining = 0, size_t classindex = SIZE_MAX)
+        {
+            if (_stack.size() >= _options.maxdepth) {
+                ThrowJson("Nested deeper than maxdepth", Offset());
+            }
+            _stack.push_back({ state, true, wrapped, pending, dynamic, remaining, classindex });
+        }
+
+        void TranscodeEntries()
+        {
+            Open('{');
+            if (!Begin('}')) {
+                return;
+            }
+
+            do {
+                ReadString(_key);
+                Expect(':');
+                WriteKey(_key);
+
+                BeginValue();
+                while (!_stack.empty()) {
+                    if (NextChild(_stack.back())) {
+                        BeginValue();
+                        Flush(false);
+                        continue;
+                    }
+                    if (_stack.back().classindex != SIZE_MAX) {
+                        --_typed;
+                    }
+                    _stack.pop_back();
+                }
+
+                _buffer.push_back(0x00);
+                Flush(false);
+            } while (Next('}'));
+        }
+
+        void BeginValue()
+        {
+            using namespace sol;
+
+            size_t offset = Offset();
+            switch (Peek())
+            {
+            case '[': {
+                uint32_t count = _containers[Open('[')].count;
+                if (_amf0) {
+                    AddObject(static_cast<uint8_t>(AMF0Type::StrictArray));
+                    codec::AppendBigEndian(_buffer, count);
+                }
+                else {
+                    AddObject(static_cast<uint8_t>(SolType::Array));
+                    Header(count, "Array");
+                    WriteSolString(_buffer, std::string(), _reftable);
+                }
+                Push(JsonFrameState::Dense, false);
+                return;
+            }
+
+            case '{':
+                BeginObject();
+                return;
+
+            case '"':
+                ReadString(_str);
+                WriteString(_str);
+                return;
+
+            case 't':
+            case 'f':
+                if (_amf0) {
+                    _buffer.push_back(static_cast<uint8_t>(AMF0Type::Boolean));
+                    WriteAMF0Boolean(_buffer, ReadBoolean());
+                }
+                else {
+                    _buffer.push_back(static_cast<uint8_t>(ReadBoolean() ? SolType::BooleanTrue : SolType::BooleanFalse));
+                }
+                return;
+
+            case 'n':
+                if (!Literal("null")) {
+                    ThrowJson("Unexpected character", offset);
+                }
+                Marker(SolType::Null, AMF0Type::Null);
+                return;
+
+            default:
+                break;
+            }
+
+            bool integer;
+            std::string_view text = ScanNumber(integer);
+            if (integer && !_amf0) {
+                int64_t value;
+                auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+                if (result.ec == std::errc() && result.ptr == text.data() + text.size()
+                    && value >= -0x10000000 && value <= 0x0FFFFFFF) {
+                    _buffer.push_back(static_cast<uint8_t>(SolType::Integer));
+                    WriteSolInteger(_buffer, static_cast<SolInteger>(value));
+                    return;
+                }
+            }
+            WriteDouble(ParseDouble(text));
+        }
+
+        void BeginObject()
+        {
+            using namespace sol;
+
+            size_t index = Open('{');
+            if (!Begin('}')) {
+                if (_amf0) {
+                    AddObject(static_cast<uint8_t>(AMF0Type::Object));
+                    EndMark();
+                }
+                else {
+                    AddObject(static_cast<uint8_t>(SolType::Object));
+                    WriteSolTraits(_buffer, _anonymous, _reftable);
+                    WriteSolString(_buffer, std::string(), _reftable);
+                }
+                return;
+            }
+
+            size_t offset = Offset();
+            ReadString(_key);
+            Expect(':');
+
+            if (!IsTag(_key)) {
+                if (_amf0) {
+                    AddObject(static_cast<uint8_t>(AMF0Type::Object));
+                }
+                else {
+                    AddObject(static_cast<uint8_t>(SolType::Object));
+                    WriteSolTraits(_buffer, _anonymous, _reftable);
+                }
+                Push(JsonFrameState::Object, false, true);
+                return;
+            }
+
+            if (_key == "$undefined") {
+                if (!ReadBoolean()) {
+                    ThrowJson("Expected true", offset);
+                }
+                Marker(SolType::Undefined, AMF0Type::Undefined);
+                EndTag();
+            }
+            else if (_key == "$double") {
+                WriteDouble(ReadDoubleName());
+                EndTag();
+            }
+            else if (_key == "$date") {
+                double value = ReadDouble();
+                if (_amf0) {
+                    _buffer.push_back(static_cast<uint8_t>(AMF0Type::Date));
+                    WriteAMF0Date(_buffer, value);
+                }
+                else {
+                    AddObject(static_cast<uint8_t>(SolType::Date));
+                    WriteSolDate(_buffer, value, _reftable);
+                }
+                EndTag();
+            }
+            else if (_key == "$xml" || _key == "$xmldoc") {
+                bool xmldoc = _key == "$xmldoc";
+                ReadString(_str);
+                if (_amf0) {
+                    _buffer.push_back(static_cast<uint8_t>(AMF0Type::XMLDoc));
+                    WriteAMF0XmlDoc(_buffer, _str);
+                }
+                else {
+                    SolType type = xmldoc ? SolType::XmlDoc : SolType::Xml;
+                    AddObject(static_cast<uint8_t>(type));
+                    WriteSolXml(_buffer, _str, _reftable, type);
+                }
+                EndTag();
+            }
+            else if (_key == "$binary") {
+                if (_amf0) {
+                    ThrowJson("AMF0 has no byte arrays", offset);
+                }
+                size_t start = Offset();
+                ReadString(_str);
+                ReadBase64(_str, _binary, start);
+                AddObject(static_cast<uint8_t>(SolType::Binary));
+                WriteSolBinary(_buffer, _binary, _reftable);
+                EndTag();
+            }
+            else if (_key == "$ref") {
+                size_t start = Offset();
+                bool integer;
+                std::string_view text = ScanNumber(integer);
+                uint64_t ref;
+                auto result = std::from_chars(text.data(), text.data() + text.size(), ref);
+                if (!integer || result.ec != std::errc() || result.ptr != text.data() + text.size() || ref >= _objects.size()) {
+                    ThrowJson("Bad object reference", start);
+                }
+                if (_amf0) {
+                    if (ref > UINT16_MAX) {
+                        ThrowJson("Bad object reference", start);
+                    }
+                    _buffer.push_back(static_cast<uint8_t>(AMF0Type::Reference));
+                    codec::AppendBigEndian(_buffer, static_cast<uint16_t>(ref));
+                }
+                else {
+                    _buffer.push_back(_objects[ref]);
+                    WriteSolInteger(_buffer, static_cast<SolInteger>(ref << 1), true);
+                }
+                EndTag();
+            }
+            else if (_key == "$assoc") {
+                BeginAssoc(index, offset);
+            }
+            else if (_key == "$weakkeys" || _key == "$dictionary") {
+                BeginDictionary(offset);
+            }
+            else if (_key == "$class" || _key == "$sealed" || _key == "$dynamic") {
+                BeginTypedObject();
+            }
+            else {
+                ThrowJson("Unknown tag", offset);
+            }
+        }
+
+        // "$assoc": has been read, index is the container of the array
+        void BeginAssoc(size_t index, size_t offset)
+        {
+            using namespace sol;
+
+            if (Peek() != '{') {
+                ThrowJson("Expected '{'", Offset());
+            }
+            size_t assoc = _next;
+
+            // the dense values follow the associative ones in "$array"
+            uint32_t dense = 0;
+            if (_containers[index].count == 2) {
+                size_t array = assoc + _containers[assoc].descendants + 1;
+                if (array >= _containers.size()) {
+                    ThrowJson("Expected \"$array\"", offset);
+                }
+                dense = _containers[array].count;
+            }
+
+            if (_amf0) {
+                if (_containers[index].count != 1) {
+                    ThrowJson("AMF0 arrays are either associative or dense", offset);
+                }
+                AddObject(static_cast<uint8_t>(AMF0Type::EcmaArray));
+                codec::AppendBigEndian(_buffer, _containers[assoc].count);
+            }
+            else {
+                AddObject(static_cast<uint8_t>(SolType::Array));
+                Header(dense, "Array");
+            }
+
+            Open('{');
+            Push(JsonFrameState::Assoc, true);
+        }
+
+        void BeginDictionary(size_t offset)
+        {
+            using namespace sol;
+
+            if (_amf0) {
+                ThrowJson("AMF0 has no dictionaries", offset);
+            }
+
+            bool weakkeys = false;
+            if (_key == "$weakkeys") {
+                weakkeys = ReadBoolean();
+                if (!Next('}')) {
+                    ThrowJson("Expected \"$dictionary\"", Offset());
+                }
+                size_t start = Offset();
+                ReadString(_key);
+                if (_key != "$dictionary") {
+                    ThrowJson("Expected \"$dictionary\"", start);
+                }
+                Expect(':');
+            }
+
+            if (Peek() != '[') {
+                ThrowJson("Expected '['", Offset());
+            }
+            uint32_t count = _containers[_next].count;
+
+            AddObject(static_cast<uint8_t>(SolType::Dictionary));
+            Header(count, "Dictionary");
+            _buffer.push_back(weakkeys ? 0x01 : 0x00);
+
+            Open('[');
+            Push(JsonFrameState::DictionaryKey, true);
+        }
+
+        // the tags of a typed or sealed object, the first one's key has been read
+        void BeginTypedObject()
+        {
+            using namespace sol;
+
+            if (_typed == _classdefs.size()) {
+                _classdefs.emplace_back();
+            }
+            size_t classindex = _typed++;
+            SolClassDef& classdef = _classdefs[classindex];
+            classdef.name.clear();
+            classdef.members.clear();
+            classdef.dynamic = true;
+
+            bool more = true;
+            if (_key == "$class") {
+                ReadString(classdef.name);
+                more = NextKey();
+            }
+            if (more && _key == "$sealed") {
+                Open('[');
+                if (Begin(']')) {
+                    do {
+                        classdef.members.emplace_back();
+                        ReadString(classdef.members.back());
+                    } while (Next(']'));
+                }
+                more = NextKey();
+            }
+            if (more && _key == "$dynamic") {
+                classdef.dynamic = ReadBoolean();
+                more = NextKey();
+            }
+
+            if (_amf0) {
+                if (classdef.name.empty()) {
+                    AddObject(static_cast<uint8_t>(AMF0Type::Object));
+                }
+                else {
+                    AddObject(static_cast<uint8_t>(AMF0Type::TypedObject));
+                    WriteAMF0ShortString(_buffer, classdef.name);
+                }
+                classdef.members.clear();
+                classdef.dynamic = true;
+            }
+            else {
+                AddObject(static_cast<uint8_t>(SolType::Object));
+                WriteSolTraits(_buffer, classdef, _reftable);
+            }
+
+            if (!more) {
+                // nothing but tags, the object closed with them
+                if (!classdef.members.empty()) {
+                    ThrowJson("Sealed member missing", Offset());
+                }
+                if (_amf0) {
+                    EndMark();
+                }
+                else if (classdef.dynamic) {
+                    WriteSolString(_buffer, std::string(), _reftable);
+                }
+                --_typed;
+                return;
+            }
+            Push(JsonFrameState::Object, false, true, classdef.dynamic, static_cast<uint32_t>(classdef.members.size()), classindex);
+        }
+
+        // reads the next key of an object and its colon, false if the object closes
+        bool NextKey()
+        {
+            if (!Next('}')) {
+                return false;
+            }
+            ReadString(_key);
+            Expect(':');
+            return true;
+        }
+
+        // moves to the next child of frame and writes what goes before it, or closes
+        // the frame and returns false
+        bool NextChild(JsonReadFrame& frame)
+        {
+            using namespace sol;
+
+            switch (frame.state)
+            {
+            case JsonFrameState::Dense: {
+                bool more = frame.first ? Begin(']') : Next(']');
+                frame.first = false;
+                if (!more && frame.wrapped) {
+                    EndTag();
+                }
+                return more;
+            }
+
+            case JsonFrameState::Assoc: {
+                bool more = frame.first ? Begin('}') : Next('}');
+                frame.first = false;
+                if (more) {
+                    size_t offset = Offset();
+                    ReadString(_key);
+                    Expect(':');
+                    // an empty key ends the associative values
+                    if (_key.empty()) {
+                        ThrowJson("Empty key in an array", offset);
+                    }
+                    WriteKey(_key);
+                    return true;
+                }
+
+                if (_amf0) {
+                    EndMark();
+                    EndTag();
+                    return false;
+                }
+                WriteSolString(_buffer, std::string(), _reftable);
+
+                if (!Next('}')) {
+                    return false;
+                }
+                size_t offset = Offset();
+                ReadString(_key);
+                if (_key != "$array") {
+                    ThrowJson("Expected \"$array\"", offset);
+                }
+                Expect(':');
+                Open('[');
+                frame.state = JsonFrameState::Dense;
+                frame.first = true;
+                return NextChild(frame);
+            }
+
+            case JsonFrameState::Object: {
+                bool more;
+                size_t offset = Offset();
+                // the first key is read with the tags before the frame is pushed
+                if (frame.pending) {
+                    frame.pending = false;
+                    more = true;
+                }
+                else {
+                    more = NextKey();
+                }
+
+                if (!more) {
+                    if (frame.remaining != 0) {
+                        ThrowJson("Sealed member missing", offset);
+                    }
+                    if (_amf0) {
+                        EndMark();
+                    }
+                    else if (frame.dynamic) {
+                        WriteSolString(_buffer, std::string(), _reftable);
+                    }
+                    return false;
+                }
+
+                UnescapeKey(offset);
+                if (frame.remaining != 0) {
+                    auto& members = _classdefs[frame.classindex].members;
+                    if (_key != members[members.size() - frame.remaining]) {
+                        ThrowJson("Sealed members out of order", offset);
+                    }
+                    --frame.remaining;
+                    return true;
+                }
+
+                if (!frame.dynamic) {
+                    ThrowJson("Member of a sealed object that is not in its traits", offset);
+                }
+                if (_key.empty()) {
+                    ThrowJson("Empty key in an object", offset);
+                }
+                WriteKey(_key);
+                return true;
+            }
+
+            case JsonFrameState::DictionaryPair:
+                Expect(']');
+                frame.state = JsonFrameState::DictionaryKey;
+                [[fallthrough]];
+
+            case JsonFrameState::DictionaryKey: {
+                bool more = frame.first ? Begin(']') : Next(']');
+                frame.first = false;
+                if (!more) {
+                    EndTag();
+                    return false;
+                }
+                if (Peek() != '[' || _containers[_next].count != 2) {
+                    ThrowJson("Expected a [key,value] pair", Offset());
+                }
+                Open('[');
+                frame.state = JsonFrameState::DictionaryValue;
+                return true;
+            }
+
+            case JsonFrameState::DictionaryValue:
+                Expect(',');
+                frame.state = JsonFrameState::DictionaryPair;
+                return true;
+
+            default:
+                return false;
+            }
+        }
+
+        const char* _begin;
+        const char* _p;
+        const char* _end;
+        std::ostream& _out;
+        const sol::SolReadOptions& _options;
+        bool _amf0 = false;
+
+        std::vector<JsonContainer> _containers;
+        size_t _next = 0;
+
+        std::vector<uint8_t> _buffer;
+        uint64_t _written = 0;
+        sol::SolWriteRefTable _reftable;
+        // the marker of every value in the object table, a reference repeats it
+        std::vector<uint8_t> _objects;
+
+        std::vector<JsonReadFrame> _stack;
+        // the traits of the typed objects open, reused so that they are only allocated once
+        std::vector<sol::SolClassDef> _classdefs;
+        size_t _typed = 0;
+        sol::SolClassDef _anonymous;
+
+        std::string _key;
+        std::string _str;
+        sol::SolBinary _binary;
+    };
+}
+
+
+bool sol::TranscodeSolToJson(const uint8_t* data, size_t size, std::ostream& out, SolError& error, const SolReadOptions& options)
+{
+    SOL_TRACE_SCOPE("transcode sol to json");
+    error = SolError();
+
+    detail::Reader r{ data, size, 0, error, options };
+    JsonEmitter emitter(r, out);
+    bool ok = emitter.EmitFile();
+    emitter.Flush(true);
+
+    if (ok && !out) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
+    }
+    return ok;
+}
+
+bool sol::TranscodeSolFileToJson(const std::string& path, std::ostream& out, SolError& error, const SolReadOptions& options)
+{
+    error = SolError();
+
+    utils::MappedFile filecontent;
+    if (!filecontent.open(path)) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
+    }
+    return TranscodeSolToJson(filecontent.data(), filecontent.size(), out, error, options);
+}
+
+bool sol::TranscodeJsonToSol(const char* data, size_t size, std::ostream& out, std::string& errmsg, const SolReadOptions& options)
+{
+    SOL_TRACE_SCOPE("transcode json to sol");
+    try {
+        JsonTranscoder transcoder(data, size, out, options);
+        transcoder.TranscodeFile();
+        errmsg.clear();
+        return true;
+    }
+    catch (const std::exception& e) {
+        errmsg = e.what();
+        return false;
+    }
+}
+
+bool sol::TranscodeJsonFileToSol(const std::string& jsonpath, const std::string& path, std::string& errmsg, const SolReadOptions& options)
+{
+    utils::MappedFile json;
+    if (!json.open(jsonpath)) {
+        errmsg = "Failed to read file: " + jsonpath;
+        return false;
+    }
+
+    bool ok;
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            errmsg = "Failed to open file: " + path;
+            return false;
+        }
+        ok = TranscodeJsonToSol(reinterpret_cast<const char*>(json.data()), json.size(), file, errmsg, options);
+    }
+
+    if (!ok) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+    return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include "sol.h"
+#include <iosfwd>
+
+// a sol file as JSON, transcoded in one pass in either direction without building
+// the values, only the reference tables and a frame per open container are kept
+//
+//   {"name":"solname","version":3,"data":{
+//   "key":value,
+//   ...
+//   }}
+//
+// the entries are in file order, values are written so that a file transcoded back
+// from the JSON reads as the same values, types and classes:
+//
+//   null, true, false       as they are
+//   integer                 a number without a fraction or exponent
+//   double, AMF0 number     a number with one, 1.0 rather than 1, or {"$double":"NaN"}
+//                           with "Infinity" or "-Infinity" for the values JSON lacks
+//   string                  a string, bytes that are not UTF-8 as \udc80 to \udcff
+//   undefined               {"$undefined":true}
+//   xmldoc, xml             {"$xmldoc":"..."}, {"$xml":"..."}
+//   date                    {"$date":milliseconds since 1970}
+//   binary                  {"$binary":"base64"}
+//   array                   [...] without associative values, otherwise
+//                           {"$assoc":{...},"$array":[...]}, "$array" left out if empty
+//   object                  {"name":value,...}, a name starting with $ gets another $,
+//                           a typed or sealed object starts with "$class":"name",
+//                           "$sealed":["member",...] and "$dynamic":false where they
+//                           apply, in that order, the sealed values come first
+//   dictionary              {"$weakkeys":true,"$dictionary":[[key,value],...]},
+//                           "$weakkeys" left out if false
+//   object reference        {"$ref":index}, the index in the file's object table
+//
+// the timezone of AMF0 dates is dropped, as the reader drops it
+namespace sol
+{
+    // writes the file in data to out as JSON, returns false with error set as
+    // ValidateSolData would, maxnodes and maxbytes are not applied since no values
+    // are built, out then ends with the JSON written up to the error
+    bool TranscodeSolToJson(const uint8_t* data, size_t size, std::ostream& out, SolError& error, const SolReadOptions& options = SolReadOptions());
+
+    bool TranscodeSolFileToJson(const std::string& path, std::ostream& out, SolError& error, const SolReadOptions& options = SolReadOptions());
+
+    // writes the JSON in data to out as a sol file, out has to be seekable since the
+    // header is finished last, returns false with errmsg set if the JSON is not laid
+    // out as above, is nested deeper than maxdepth, or holds a value the version it
+    // names cannot hold
+    bool TranscodeJsonToSol(const char* data, size_t size, std::ostream& out, std::string& errmsg, const SolReadOptions& options = SolReadOptions());
+
+    // as above, the file at path is removed again if the JSON cannot be transcoded
+    bool TranscodeJsonFileToSol(const std::string& jsonpath, const std::string& path, std::string& errmsg, const SolReadOptions& options = SolReadOptions());
+}
+
+#endif // !__JSON_H__
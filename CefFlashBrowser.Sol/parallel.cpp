@@ -0,0 +1,265 @@
+#include "encoder.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+
+namespace
+{
+    using sol::detail::WritePlan;
+
+    // strings and classes of one entry in the order the AMF3 writers meet them,
+    // gathered without knowing what the entries before it added, a class is
+    // followed by its name and members, which only count if the class is new
+    struct EntryRefs
+    {
+        struct Ref
+        {
+            const std::string* value;
+            size_t classstrs;
+            bool isclass;
+        };
+
+        std::vector<Ref> refs;
+        std::unordered_set<std::string_view> strings;
+        std::unordered_set<std::string> classes;
+
+        void String(const std::string& value)
+        {
+            if (!value.empty() && strings.insert(value).second) {
+                refs.push_back({ &value, 0, false });
+            }
+        }
+
+        void Traits(const sol::SolClassDef& classdef)
+        {
+            auto [it, added] = classes.insert(sol::detail::GetClassDefUniqueStr(classdef));
+
+            if (added) {
+                refs.push_back({ &*it, classdef.members.size() + 1, true });
+                refs.push_back({ &classdef.name, 0, false });
+                for (auto& member : classdef.members) {
+                    refs.push_back({ &member, 0, false });
+                }
+            }
+        }
+
+        void Object(const sol::SolObject& value)
+        {
+            Traits(value.classdef);
+
+            if (value.classdef.members.empty()) {
+                if (value.classdef.dynamic) {
+                    for (auto& [key, val] : value.props) {
+                        String(key);
+                        Value(val);
+                    }
+                }
+                return;
+            }
+
+            // sealed members in traits order, then dynamic properties, as WriteSolObject does
+            auto& members = value.classdef.members;
+            for (auto& member : members) {
+                auto it = value.props.find(member);
+                if (it != value.props.end()) {
+                    Value(it->second);
+                }
+            }
+            if (value.classdef.dynamic) {
+                for (auto& [key, val] : value.props) {
+                    if (std::find(members.begin(), members.end(), key) == members.end()) {
+                        String(key);
+                        Value(val);
+                    }
+                }
+            }
+        }
+
+        void Value(const sol::SolValue& value)
+        {
+            using namespace sol;
+
+            switch (value.type)
+            {
+            case SolType::String:
+                String(value.get<SolString>());
+                break;
+
+            case SolType::Array: {
+                auto& arr = value.get<SolArray>();
+                for (auto& [key, val] : arr.assoc) {
+                    String(key);
+                    Value(val);
+                }
+                for (auto& val : arr.dense) {
+                    Value(val);
+                }
+                break;
+            }
+
+            case SolType::Object:
+                Object(value.get<SolObject>());
+                break;
+
+            case SolType::Dictionary:
+                for (auto& [key, val] : value.get<SolDictionary>().entries()) {
+                    Value(key);
+                    Value(val);
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    };
+
+    // runs work(i) for every i below count, rethrows the exception of the lowest
+    // failing index so that the error is the one writing in order would report
+    template <typename TWork>
+    void ForEachParallel(size_t count, unsigned threads, TWork&& work)
+    {
+        std::atomic<size_t> next{ 0 };
+        std::exception_ptr error;
+        size_t errorindex = SIZE_MAX;
+        std::mutex errorlock;
+
+        auto run = [&]() {
+            for (size_t i; (i = next++) < count;) {
+                try {
+                    work(i);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> guard(errorlock);
+                    if (i < errorindex) {
+                        errorindex = i;
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; ++i) {
+            workers.emplace_back(run);
+        }
+        run();
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+
+void sol::detail::WriteSolEntriesParallel(std::vector<uint8_t>& buffer, const SolFile& file,
+    const std::unordered_set<const SolValue*>& written, SolWriteRefTable& reftable, unsigned threads)
+{
+    std::vector<const std::pair<const std::string, SolValue>*> entries;
+
+    for (auto& pair : file.data) {
+        if (!written.count(&pair.second)) {
+            entries.push_back(&pair);
+        }
+    }
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, entries.size()));
+
+    if (threads <= 1) {
+        for (auto pair : entries) {
+            WriteSolEntry(buffer, file.version, pair->first, pair->second, reftable);
+        }
+        return;
+    }
+
+    // AMF3 entries share the string and class tables, each entry lists what it may add,
+    // then the lists are merged in order to give every index and the table sizes each
+    // entry starts from, entries are numbered from 1 so that what the entries written
+    // before added counts as earlier than all of them
+    WritePlan plan;
+    std::vector<std::pair<int, int>> bases(entries.size(), { reftable.strcount, reftable.classcount });
+
+    if (file.version == SolVersion::AMF3) {
+        std::vector<EntryRefs> entryrefs(entries.size());
+
+        ForEachParallel(entries.size(), threads, [&](size_t i) {
+            entryrefs[i].String(entries[i]->first);
+            entryrefs[i].Value(entries[i]->second);
+            entryrefs[i].strings.clear();
+        });
+
+        for (auto& [str, index] : reftable.strpool) {
+            plan.strings.emplace(str, WritePlan::Ref{ index, 0 });
+        }
+        for (auto& [classid, index] : reftable.classpool) {
+            plan.classes.emplace(classid, WritePlan::Ref{ index, 0 });
+        }
+
+        int strcount = reftable.strcount;
+        int classcount = reftable.classcount;
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            bases[i] = { strcount, classcount };
+            auto& refs = entryrefs[i].refs;
+
+            for (size_t j = 0; j < refs.size(); ++j) {
+                const std::string& value = *refs[j].value;
+
+                if (refs[j].isclass) {
+                    if (plan.classes.emplace(value, WritePlan::Ref{ classcount, i + 1 }).second) {
+                        ++classcount;
+                    }
+                    else {
+                        j += refs[j].classstrs;
+                    }
+                }
+                else if (!value.empty() && plan.strings.emplace(value, WritePlan::Ref{ strcount, i + 1 }).second) {
+                    ++strcount;
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> parts(entries.size());
+
+    // each entry is counted apart and the counts are added up in order
+    std::vector<SolStats> partstats(reftable.stats ? entries.size() : 0);
+
+    ForEachParallel(entries.size(), threads, [&](size_t i) {
+        SolWriteRefTable local;
+        local.strcount = bases[i].first;
+        local.classcount = bases[i].second;
+        local.plan = &plan;
+        local.entry = i + 1;
+        local.stats = reftable.stats ? &partstats[i] : nullptr;
+        WriteSolEntry(parts[i], file.version, entries[i]->first, entries[i]->second, local);
+
+        if (local.stats) {
+            local.stats->allocations += local.strpool.size() + local.classpool.size();
+        }
+    });
+
+    for (auto& stats : partstats) {
+        reftable.stats->add(stats);
+    }
+
+    size_t total = buffer.size();
+    for (auto& part : parts) {
+        total += part.size();
+    }
+    buffer.reserve(total);
+
+    for (auto& part : parts) {
+        buffer.insert(buffer.end(), part.begin(), part.end());
+    }
+}
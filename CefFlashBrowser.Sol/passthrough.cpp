@@ -0,0 +1,452 @@
+#include "encoder.h"
+#include "codec.h"
+#include "decoder.h"
+
+
+namespace
+{
+    // a copied entry adds to the reader's tables whatever it adds inline,
+    // even a string the tables already hold
+    void AddRef(sol::SolWriteRefTable& reftable, std::map<std::string, int>& pool, int& count, const std::string& id)
+    {
+        if (sol::detail::GetRefIndex(pool, count, id, reftable.spare) >= 0) {
+            ++count;
+        }
+    }
+
+    void RegisterRawSpan(const sol::SolRawFile& raw, const sol::SolRawSpan& span, sol::SolWriteRefTable& reftable)
+    {
+        for (size_t i = span.strbegin; i < span.strend; ++i) {
+            AddRef(reftable, reftable.strpool, reftable.strcount, raw.strings[i]);
+        }
+        for (size_t i = span.classbegin; i < span.classend; ++i) {
+            sol::detail::GetClassDefUniqueStr(raw.classes[i], reftable.classid);
+            AddRef(reftable, reftable.classpool, reftable.classcount, reftable.classid);
+        }
+        reftable.objcount += static_cast<int>(span.objend - span.objbegin);
+    }
+
+    // copies a span that follows references once the output no longer matches the
+    // file it was read from, bytes are copied in runs and only the references are
+    // written again, strings and classes by content, objects relative to the span
+    struct RawRewriter
+    {
+        std::vector<uint8_t>& buffer;
+        const sol::SolRawFile& raw;
+        const sol::SolRawSpan& span;
+        sol::SolWriteRefTable& reftable;
+        size_t objbase;
+        size_t pos = 0;
+        size_t flushed = 0;
+
+        void Flush(size_t upto)
+        {
+            buffer.insert(buffer.end(), raw.bytes.begin() + flushed, raw.bytes.begin() + upto);
+            flushed = upto;
+        }
+
+        uint32_t ReadU29()
+        {
+            uint32_t value = 0;
+            pos += sol::codec::DecodeU29(raw.bytes.data() + pos, raw.bytes.size() - pos, value);
+            return value;
+        }
+
+        template <typename T>
+        T ReadBigEndian()
+        {
+            T value = sol::codec::LoadBigEndian<T>(raw.bytes.data() + pos);
+            pos += sizeof(T);
+            return value;
+        }
+
+        size_t MapObjRef(size_t ref) const
+        {
+            return objbase + (ref - span.objbegin);
+        }
+
+        std::string String()
+        {
+            size_t start = pos;
+            uint32_t ref = ReadU29();
+
+            if ((ref & 1) == 0) {
+                const std::string& value = raw.strings[ref >> 1];
+                Flush(start);
+                sol::WriteSolString(buffer, value, reftable);
+                flushed = pos;
+                return value;
+            }
+
+            size_t len = ref >> 1;
+            std::string value(reinterpret_cast<const char*>(raw.bytes.data() + pos), len);
+            pos += len;
+            if (len != 0) {
+                AddRef(reftable, reftable.strpool, reftable.strcount, value);
+            }
+            return value;
+        }
+
+        sol::SolType Marker()
+        {
+            return static_cast<sol::SolType>(raw.bytes[pos++]);
+        }
+
+        void Object(size_t start, uint32_t classref)
+        {
+            sol::SolClassDef inlinedef;
+            const sol::SolClassDef* classdef = &inlinedef;
+
+            if ((classref & 1) == 0) {
+                classdef = &raw.classes[classref >> 1];
+                Flush(start);
+                sol::WriteSolTraits(buffer, *classdef, reftable);
+                flushed = pos;
+            }
+            else {
+                inlinedef.dynamic = (classref >> 2) & 1;
+                inlinedef.name = String();
+                for (uint32_t i = 0, n = classref >> 3; i < n; ++i) {
+                    inlinedef.members.push_back(String());
+                }
+                sol::detail::GetClassDefUniqueStr(inlinedef, reftable.classid);
+                AddRef(reftable, reftable.classpool, reftable.classcount, reftable.classid);
+            }
+
+            for (size_t i = 0; i < classdef->members.size(); ++i) {
+                Value(Marker());
+            }
+            if (classdef->dynamic) {
+                while (!String().empty()) {
+                    Value(Marker());
+                }
+            }
+        }
+
+        void Value(sol::SolType type)
+        {
+            using namespace sol;
+
+            switch (type)
+            {
+            case SolType::Integer:
+                ReadU29();
+                return;
+
+            case SolType::Double:
+                pos += 8;
+                return;
+
+            case SolType::String:
+                String();
+                return;
+
+            case SolType::XmlDoc:
+            case SolType::Xml:
+            case SolType::Binary:
+            case SolType::Date:
+            case SolType::Array:
+            case SolType::Object:
+            case SolType::Dictionary:
+                break;
+
+            default:
+                return;
+            }
+
+            size_t start = pos;
+            uint32_t ref = ReadU29();
+
+            if ((ref & 1) == 0) {
+                Flush(start);
+                codec::AppendU29(buffer, static_cast<uint32_t>(MapObjRef(ref >> 1) << 1));
+                flushed = pos;
+                return;
+            }
+
+            ++reftable.objcount;
+
+            switch (type)
+            {
+            case SolType::Date:
+                pos += 8;
+                break;
+
+            case SolType::Array:
+                while (!String().empty()) {
+                    Value(Marker());
+                }
+                for (uint32_t i = 0, n = ref >> 1; i < n; ++i) {
+                    Value(Marker());
+                }
+                break;
+
+            case SolType::Object:
+                Object(start, ref >> 1);
+                break;
+
+            case SolType::Dictionary:
+                ++pos; // weak keys
+                for (uint32_t i = 0, n = ref >> 1; i < n; ++i) {
+                    Value(Marker());
+                    Value(Marker());
+                }
+                break;
+
+            default:
+                pos += ref >> 1;
+                break;
+            }
+        }
+
+        void SkipAMF0ShortString()
+        {
+            pos += ReadBigEndian<uint16_t>();
+        }
+
+        void AMF0Value(sol::AMF0Type type)
+        {
+            using namespace sol;
+
+            switch (type)
+            {
+            case AMF0Type::Number:
+                pos += 8;
+                break;
+
+            case AMF0Type::Boolean:
+                pos += 1;
+                break;
+
+            case AMF0Type::String:
+                SkipAMF0ShortString();
+                break;
+
+            case AMF0Type::Date:
+                pos += 10;
+                break;
+
+            case AMF0Type::LongString:
+            case AMF0Type::XMLDoc:
+                pos += ReadBigEndian<uint32_t>();
+                break;
+
+            case AMF0Type::Reference: {
+                size_t start = pos;
+                uint16_t ref = ReadBigEndian<uint16_t>();
+                Flush(start);
+                codec::AppendBigEndian(buffer, static_cast<uint16_t>(MapObjRef(ref)));
+                flushed = pos;
+                break;
+            }
+
+            case AMF0Type::TypedObject:
+                SkipAMF0ShortString();
+                [[fallthrough]];
+
+            case AMF0Type::Object:
+                ++reftable.objcount;
+                while (true) {
+                    uint16_t len = ReadBigEndian<uint16_t>();
+                    pos += len;
+                    if (len == 0) {
+                        ++pos; // object end
+                        break;
+                    }
+                    AMF0Value(static_cast<AMF0Type>(raw.bytes[pos++]));
+                }
+                break;
+
+            case AMF0Type::EcmaArray: {
+                ++reftable.objcount;
+                uint32_t count = ReadBigEndian<uint32_t>();
+                for (uint32_t i = 0; i < count; ++i) {
+                    SkipAMF0ShortString();
+                    AMF0Value(static_cast<AMF0Type>(raw.bytes[pos++]));
+                }
+                pos += sizeof(codec::AMF0_OBJECT_ENDMARK);
+                break;
+            }
+
+            case AMF0Type::StrictArray: {
+                ++reftable.objcount;
+                uint32_t count = ReadBigEndian<uint32_t>();
+                for (uint32_t i = 0; i < count; ++i) {
+                    AMF0Value(static_cast<AMF0Type>(raw.bytes[pos++]));
+                }
+                break;
+            }
+
+            default:
+                break;
+            }
+        }
+
+        void Entry()
+        {
+            pos = flushed = span.begin;
+
+            if (raw.version == sol::SolVersion::AMF0) {
+                SkipAMF0ShortString();
+                AMF0Value(static_cast<sol::AMF0Type>(raw.bytes[pos++]));
+            }
+            else {
+                String();
+                Value(Marker());
+            }
+            Flush(span.end);
+        }
+
+        void Subtree(uint8_t marker)
+        {
+            pos = flushed = span.begin;
+
+            if (raw.version == sol::SolVersion::AMF0) {
+                AMF0Value(static_cast<sol::AMF0Type>(marker));
+            }
+            else {
+                Value(static_cast<sol::SolType>(marker));
+            }
+            Flush(span.end);
+        }
+    };
+
+    // whether a span can be copied with its references written again
+    bool CanRewrite(const sol::SolRawFile& raw, const sol::SolRawSpan& span, const sol::SolWriteRefTable& reftable)
+    {
+        // a copy of an object outside the span cannot be told apart from the original any more
+        if (span.external) {
+            return false;
+        }
+        // AMF0 references are 16 bit
+        return raw.version != sol::SolVersion::AMF0
+            || reftable.objcount + (span.objend - span.objbegin) <= 0x10000;
+    }
+
+    void CountCopied(sol::SolWriteRefTable& reftable, size_t bytes)
+    {
+        if (reftable.stats) {
+            reftable.stats->copied += bytes;
+        }
+    }
+
+    // copies an entry, verbatim while the output still holds the same reference
+    // tables as the file, returns false if the entry has to be encoded again
+    bool CopyRawEntry(std::vector<uint8_t>& buffer, const sol::SolRawFile& raw, const sol::SolRawEntry& entry,
+        sol::SolWriteRefTable& reftable, bool aligned)
+    {
+        size_t start = buffer.size();
+
+        if (aligned || !entry.refs) {
+            buffer.insert(buffer.end(), raw.bytes.begin() + entry.begin, raw.bytes.begin() + entry.end);
+            RegisterRawSpan(raw, entry, reftable);
+        }
+        else if (CanRewrite(raw, entry, reftable)) {
+            RawRewriter rewriter{ buffer, raw, entry, reftable, static_cast<size_t>(reftable.objcount) };
+            rewriter.Entry();
+        }
+        else {
+            return false;
+        }
+
+        CountCopied(reftable, buffer.size() - start);
+        return true;
+    }
+}
+
+
+bool sol::detail::CopyRawSubtree(std::vector<uint8_t>& buffer, const SolValue& value, uint8_t marker, SolWriteRefTable& reftable)
+{
+    RawSubtreeCopy& copy = *reftable.raw;
+
+    // the entry itself was found changed, and deeper containers are not kept
+    if (copy.depth == 0 || copy.depth > RAW_SUBTREE_DEPTH
+        || (value.type != SolType::Array && value.type != SolType::Object && value.type != SolType::Dictionary)) {
+        return false;
+    }
+
+    const SolRawFile& raw = copy.raw;
+    size_t hash = SolValueHash()(value);
+
+    auto it = std::lower_bound(raw.subtrees.begin(), raw.subtrees.end(), hash,
+        [](const SolRawSubtree& subtree, size_t hash) { return subtree.hash < hash; });
+
+    // any container read with the same value will do, it need not be the one edited,
+    // the hash only finds the candidates and the digest tells if the value is the same
+    std::array<uint8_t, 32> digest;
+    bool digested = false;
+
+    for (; it != raw.subtrees.end() && it->hash == hash; ++it) {
+        if (it->marker != marker) {
+            continue;
+        }
+        if (!digested) {
+            digest = SolValueDigest()(value);
+            digested = true;
+        }
+        if (it->digest != digest) {
+            continue;
+        }
+
+        size_t start = buffer.size();
+
+        if (!it->refs) {
+            buffer.insert(buffer.end(), raw.bytes.begin() + it->begin, raw.bytes.begin() + it->end);
+            RegisterRawSpan(raw, *it, reftable);
+        }
+        else if (CanRewrite(raw, *it, reftable)) {
+            RawRewriter rewriter{ buffer, raw, *it, reftable, static_cast<size_t>(reftable.objcount) };
+            rewriter.Subtree(marker);
+        }
+        else {
+            continue;
+        }
+
+        CountCopied(reftable, buffer.size() - start);
+        return true;
+    }
+    return false;
+}
+
+std::unordered_set<const sol::SolValue*> sol::detail::WriteRawEntries(std::vector<uint8_t>& buffer, const SolFile& file, SolWriteRefTable& reftable)
+{
+    std::unordered_set<const SolValue*> written;
+
+    if (!file.raw || file.raw->version != file.version) {
+        return written;
+    }
+
+    // the output holds the same tables as the file until an entry is left out or encoded
+    bool aligned = true;
+
+    for (auto& entry : file.raw->entries) {
+        auto it = file.data.find(entry.key);
+
+        // removed, or a key read twice, which the reader keeps the last value of
+        if (it == file.data.end() || !written.insert(&it->second).second) {
+            aligned = false;
+            continue;
+        }
+
+        // values with equal hashes may still differ, equal digests say they do not
+        if (SolValueHash()(it->second) == entry.hash && SolValueDigest()(it->second) == entry.digest
+            && CopyRawEntry(buffer, *file.raw, entry, reftable, aligned)) {
+            continue;
+        }
+
+        // encoded in its place, copying what did not change in it
+        aligned = false;
+
+        RawSubtreeCopy copy{ *file.raw };
+        reftable.raw = &copy;
+        try {
+            WriteSolEntry(buffer, file.version, entry.key, it->second, reftable);
+        }
+        catch (...) {
+            reftable.raw = nullptr;
+            throw;
+        }
+        reftable.raw = nullptr;
+    }
+    return written;
+}
@@ -0,0 +1,342 @@
+#include "push.h"
+#include "decoder.h"
+
+
+namespace
+{
+    enum class PushPhase : uint8_t
+    {
+        Header,
+        Key,
+        Value,
+        End,
+        Done,
+        Failed,
+    };
+
+    // everything a unit of work may change before it runs out of input,
+    // frames below the top one are not touched until the top one completes
+    struct Checkpoint
+    {
+        size_t index;
+        size_t strpool;
+        size_t objpool;
+        size_t classpool;
+        size_t objcost;
+        sol::detail::ReadCost spent;
+        sol::detail::ReadFrameState state = {};
+        uint32_t remaining = 0;
+    };
+}
+
+
+struct sol::SolPushParser::State
+{
+    SolReadOptions options;
+    SolError error;
+    detail::Reader r{ nullptr, 0, 0, error, options };
+
+    // bytes of an unfinished unit, base is the file offset of the first one
+    std::vector<uint8_t> buffer;
+    size_t base = 0;
+
+    PushPhase phase = PushPhase::Header;
+    bool eof = false;
+    uint32_t chunksize = 0;
+
+    SolFile file;
+    SolRefTable reftable;
+    detail::ReadStack stack;
+    std::string key;
+
+    explicit State(const SolReadOptions& options)
+        : options(options)
+    {
+    }
+
+    Checkpoint Save() const
+    {
+        Checkpoint cp{ r.index, reftable.strpool.size(), reftable.objpool.size(),
+            reftable.classpool.size(), r.objcost.size(), r.spent };
+        if (!stack.empty()) {
+            cp.state = stack.back().state;
+            cp.remaining = stack.back().remaining;
+        }
+        return cp;
+    }
+
+    void Restore(const Checkpoint& cp)
+    {
+        r.index = cp.index;
+        reftable.strpool.resize(cp.strpool);
+        reftable.objpool.resize(cp.objpool);
+        reftable.classpool.resize(cp.classpool);
+        r.objcost.resize(cp.objcost);
+        r.spent = cp.spent;
+        if (!stack.empty()) {
+            stack.back().state = cp.state;
+            stack.back().remaining = cp.remaining;
+        }
+        error = SolError();
+    }
+
+    // whether a failed unit may still succeed once more input arrives,
+    // a count is checked against the input at hand, so it may be too large for now
+    bool NeedMore() const
+    {
+        return !eof && (error.code == SolErrorCode::EndedImproperly
+            || error.code == SolErrorCode::CountTooLarge);
+    }
+
+    bool Begin(uint8_t marker, SolValue& out)
+    {
+        return file.version == SolVersion::AMF0
+            ? detail::BeginAMF0Value(r, reftable, static_cast<AMF0Type>(marker), out, stack)
+            : detail::BeginSolValue(r, reftable, static_cast<SolType>(marker), out, stack);
+    }
+
+    bool Next(detail::ReadFrame& frame, uint8_t& marker, bool& more)
+    {
+        if (file.version == SolVersion::AMF0) {
+            AMF0Type type = AMF0Type::Undefined;
+            bool ok = detail::NextAMF0Child(r, frame, type, more);
+            marker = static_cast<uint8_t>(type);
+            return ok;
+        }
+        else {
+            SolType type = SolType::Undefined;
+            bool ok = detail::NextSolChild(r, reftable, frame, type, more);
+            marker = static_cast<uint8_t>(type);
+            return ok;
+        }
+    }
+
+    bool CheckChunkSize()
+    {
+        size_t total = base + r.size;
+        if (chunksize != total - 6) {
+            r.Fail(SolErrorCode::ChunkSizeMismatch, 2, -1, false, chunksize, static_cast<int64_t>(total - 6));
+            phase = PushPhase::Failed;
+            file.errmsg = error.message();
+            return false;
+        }
+        return true;
+    }
+
+    void Publish(SolValue&& value, const EntryHandler& onentry)
+    {
+        SolValue& entry = file.data[key];
+        entry = std::move(value);
+        if (onentry) {
+            onentry(key, entry);
+        }
+        phase = PushPhase::End;
+    }
+
+    // decodes one unit: the file header, a top level key with its value or the
+    // first frame of it, one child of the container on top of the stack, or the
+    // end mark of an entry, returns false if it has to wait or has failed
+    bool Step(const EntryHandler& onentry)
+    {
+        SolValue value;
+        uint8_t marker;
+
+        switch (phase)
+        {
+        case PushPhase::Header:
+            if (r.size - r.index < codec::SOL_HEADER_MINSIZE) {
+                return eof
+                    ? r.Fail(SolErrorCode::FileTooSmall, 0)
+                    : r.Truncated();
+            }
+            // at the end the buffer holds the whole file, otherwise finish checks the size
+            if (!detail::DecodeSolHeader(r, file, chunksize, eof)) {
+                return false;
+            }
+            phase = PushPhase::Key;
+            return true;
+
+        case PushPhase::Key: {
+            if (r.index == r.size) {
+                if (eof) {
+                    phase = PushPhase::Done;
+                }
+                return false;
+            }
+            bool ok = file.version == SolVersion::AMF0
+                ? detail::DecodeAMF0ShortString(r, key)
+                : detail::DecodeString(r, reftable, key);
+            if (!ok || !detail::DecodeByte(r, marker) || !Begin(marker, value)) {
+                return false;
+            }
+            if (stack.empty()) {
+                Publish(std::move(value), onentry);
+            }
+            else {
+                phase = PushPhase::Value;
+            }
+            return true;
+        }
+
+        case PushPhase::Value: {
+            size_t depth = stack.size();
+            bool more;
+            if (!Next(stack.back(), marker, more)) {
+                return false;
+            }
+            if (more) {
+                if (!Begin(marker, value)) {
+                    return false;
+                }
+                if (stack.size() == depth) {
+                    detail::AttachChild(stack.back(), std::move(value));
+                }
+                return true;
+            }
+
+            detail::CompleteFrame(r, reftable, stack.back());
+            value = std::move(stack.back().value);
+            stack.pop_back();
+
+            if (stack.empty()) {
+                Publish(std::move(value), onentry);
+            }
+            else {
+                detail::AttachChild(stack.back(), std::move(value));
+            }
+            return true;
+        }
+
+        case PushPhase::End:
+            if (!detail::DecodeByte(r, marker)) {
+                return false;
+            }
+            if (marker != 0x00) {
+                return r.Fail(SolErrorCode::EndRequired, r.index - 1, -1, false, marker, 0);
+            }
+            phase = PushPhase::Key;
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    void Run(const uint8_t* data, size_t size, const EntryHandler& onentry)
+    {
+        r.data = data;
+        r.size = size;
+        r.index = 0;
+
+        while (true) {
+            Checkpoint cp = Save();
+            if (Step(onentry)) {
+                continue;
+            }
+            if (!error.failed()) {
+                break;
+            }
+            if (NeedMore()) {
+                Restore(cp);
+
+                // a unit may not hold back more input than it would be allowed to allocate
+                if (r.size - r.index > options.maxbytes) {
+                    r.Fail(SolErrorCode::TooManyBytes, r.index, -1, false,
+                        static_cast<int64_t>(r.size - r.index), static_cast<int64_t>(options.maxbytes));
+                }
+                else {
+                    break;
+                }
+            }
+            if (phase != PushPhase::Failed) {
+                // error offsets are relative to data, report them as file offsets
+                error.offset += base;
+                phase = PushPhase::Failed;
+                file.errmsg = error.message();
+            }
+            break;
+        }
+    }
+};
+
+
+sol::SolPushParser::SolPushParser(const SolReadOptions& options)
+    : _state(std::make_unique<State>(options))
+{
+}
+
+sol::SolPushParser::~SolPushParser() = default;
+
+bool sol::SolPushParser::feed(const uint8_t* data, size_t size)
+{
+    State& s = *_state;
+
+    if (s.phase == PushPhase::Done || s.phase == PushPhase::Failed || s.eof) {
+        return s.phase != PushPhase::Failed;
+    }
+
+    if (s.buffer.empty()) {
+        // nothing held back, decode straight from the caller's bytes and keep the rest
+        s.Run(data, size, onentry);
+        if (s.phase != PushPhase::Failed) {
+            s.buffer.assign(data + s.r.index, data + size);
+        }
+    }
+    else {
+        s.buffer.insert(s.buffer.end(), data, data + size);
+        s.Run(s.buffer.data(), s.buffer.size(), onentry);
+        if (s.phase != PushPhase::Failed) {
+            s.buffer.erase(s.buffer.begin(), s.buffer.begin() + s.r.index);
+        }
+    }
+
+    if (s.phase == PushPhase::Failed) {
+        return false;
+    }
+    s.base += s.r.index;
+    return true;
+}
+
+bool sol::SolPushParser::finish()
+{
+    State& s = *_state;
+
+    if (s.phase == PushPhase::Done || s.phase == PushPhase::Failed || s.eof) {
+        return s.phase == PushPhase::Done;
+    }
+    s.eof = true;
+
+    // the whole file readers check the chunk size before any entry,
+    // report the same error for a file cut short
+    s.r.size = s.buffer.size();
+    if (s.phase != PushPhase::Header && !s.CheckChunkSize()) {
+        return false;
+    }
+
+    s.Run(s.buffer.data(), s.buffer.size(), onentry);
+    if (s.phase != PushPhase::Failed) {
+        s.base += s.r.index;
+        s.buffer.clear();
+    }
+    return s.phase == PushPhase::Done;
+}
+
+bool sol::SolPushParser::done() const
+{
+    return _state->phase == PushPhase::Done;
+}
+
+bool sol::SolPushParser::failed() const
+{
+    return _state->phase == PushPhase::Failed;
+}
+
+const sol::SolError& sol::SolPushParser::error() const
+{
+    return _state->error;
+}
+
+sol::SolFile& sol::SolPushParser::file()
+{
+    return _state->file;
+}
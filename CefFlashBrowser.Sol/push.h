@@ -0,0 +1,49 @@
+#ifndef __PUSH_H__
+#define __PUSH_H__
+
+#include "sol.h"
+#include <memory>
+#include <functional>
+
+namespace sol
+{
+    // decodes a sol file from bytes as they arrive, the input may be split anywhere,
+    // a value cut off by the end of a chunk waits for the rest instead of being
+    // decoded again from the start of the file, the chunk size can only be checked
+    // once the input ends, so a file with more than one error in its header may
+    // report a different one first than ReadSolFile does
+    class SolPushParser
+    {
+    public:
+        explicit SolPushParser(const SolReadOptions& options = SolReadOptions());
+        ~SolPushParser();
+
+        SolPushParser(const SolPushParser&) = delete;
+        SolPushParser& operator=(const SolPushParser&) = delete;
+
+        // decodes as much of the input as possible, the rest is kept until the
+        // next call, returns false once the input is known to be invalid
+        bool feed(const uint8_t* data, size_t size);
+
+        // marks the end of the input, returns false if the file is incomplete or invalid
+        bool finish();
+
+        bool done() const;
+        bool failed() const;
+        const SolError& error() const;
+
+        // the entries decoded so far, errmsg is set on failure
+        SolFile& file();
+
+        using EntryHandler = std::function<void(const std::string& key, const SolValue& value)>;
+
+        // called for each top level entry as soon as it is complete
+        EntryHandler onentry;
+
+    private:
+        struct State;
+        std::unique_ptr<State> _state;
+    };
+}
+
+#endif // !__PUSH_H__
@@ -0,0 +1,554 @@
+#include "query.h"
+#include "bind.h"
+#include "trace.h"
+#include "utils.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+    using sol::SolPath;
+    using sol::SolPathKey;
+    using sol::SolQueryOp;
+    using sol::SolQueryStep;
+    using sol::SolQueryStepKind;
+    using sol::SolType;
+    using sol::SolValue;
+    using sol::detail::BindFrame;
+    using sol::detail::BindReader;
+
+    class QueryParser
+    {
+    public:
+        explicit QueryParser(const std::string& text)
+            : _text(text)
+        {
+        }
+
+        std::vector<SolQueryStep> Parse()
+        {
+            std::vector<SolQueryStep> steps;
+
+            // the first step has no dot before it
+            steps.push_back(Accept('[') ? Bracket() : Member());
+
+            while (_pos < _text.size()) {
+                if (Accept('.')) {
+                    steps.push_back(Member());
+                }
+                else if (Accept('[')) {
+                    steps.push_back(Bracket());
+                }
+                else {
+                    Fail("'.' or '[' expected");
+                }
+            }
+            return steps;
+        }
+
+    private:
+        [[noreturn]] void Fail(const char* what) const
+        {
+            throw std::runtime_error(utils::FormatString("Bad query at %zu: %s", _pos, what));
+        }
+
+        bool Accept(char c)
+        {
+            if (_pos < _text.size() && _text[_pos] == c) {
+                ++_pos;
+                return true;
+            }
+            return false;
+        }
+
+        void SkipSpaces()
+        {
+            while (_pos < _text.size() && std::isspace(static_cast<unsigned char>(_text[_pos]))) {
+                ++_pos;
+            }
+        }
+
+        static bool IsNameChar(char c)
+        {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || static_cast<unsigned char>(c) >= 0x80;
+        }
+
+        std::string Name()
+        {
+            size_t start = _pos;
+            if (_pos < _text.size() && std::isdigit(static_cast<unsigned char>(_text[_pos]))) {
+                Fail("a key expected, an index is written as [n]");
+            }
+            while (_pos < _text.size() && IsNameChar(_text[_pos])) {
+                ++_pos;
+            }
+            if (_pos == start) {
+                Fail("a key expected");
+            }
+            return _text.substr(start, _pos - start);
+        }
+
+        std::string Quoted()
+        {
+            char quote = _text[_pos++];
+            std::string result;
+
+            while (_pos < _text.size() && _text[_pos] != quote) {
+                char c = _text[_pos++];
+                if (c == '\\' && _pos < _text.size()) {
+                    c = _text[_pos++];
+                    c = c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c;
+                }
+                result.push_back(c);
+            }
+            if (!Accept(quote)) {
+                Fail("unterminated string");
+            }
+            return result;
+        }
+
+        bool AtQuote() const
+        {
+            return _pos < _text.size() && (_text[_pos] == '"' || _text[_pos] == '\'');
+        }
+
+        bool AtDigit() const
+        {
+            return _pos < _text.size() && std::isdigit(static_cast<unsigned char>(_text[_pos]));
+        }
+
+        size_t Index()
+        {
+            size_t index = 0;
+            while (AtDigit()) {
+                if (index > (SIZE_MAX - 9) / 10) {
+                    Fail("index too large");
+                }
+                index = index * 10 + (_text[_pos++] - '0');
+            }
+            return index;
+        }
+
+        SolQueryStep Member()
+        {
+            SolQueryStep step;
+            if (Accept('*')) {
+                step.kind = SolQueryStepKind::Wildcard;
+            }
+            else {
+                step.kind = SolQueryStepKind::Key;
+                step.key = Name();
+            }
+            return step;
+        }
+
+        // what follows a [ up to and including the ]
+        SolQueryStep Bracket()
+        {
+            SolQueryStep step;
+            SkipSpaces();
+
+            if (Accept('*')) {
+                step.kind = SolQueryStepKind::Wildcard;
+            }
+            else if (AtDigit()) {
+                step.kind = SolQueryStepKind::Index;
+                step.index = Index();
+            }
+            else if (AtQuote()) {
+                step.kind = SolQueryStepKind::Key;
+                step.key = Quoted();
+            }
+            else if (Accept('?')) {
+                step.kind = SolQueryStepKind::Filter;
+                SkipSpaces();
+                step.path = RelativePath();
+                SkipSpaces();
+                if (_pos < _text.size() && _text[_pos] != ']') {
+                    step.op = Op();
+                    SkipSpaces();
+                    step.operand = Literal();
+                }
+            }
+            else {
+                Fail("'*', an index, a quoted key or '?' expected");
+            }
+
+            SkipSpaces();
+            if (!Accept(']')) {
+                Fail("']' expected");
+            }
+            return step;
+        }
+
+        // the path of a filter, from the child it tests
+        SolPath RelativePath()
+        {
+            SolPath path;
+            if (!Accept('@')) {
+                path.push_back(Name());
+            }
+
+            for (;;) {
+                if (Accept('.')) {
+                    path.push_back(Name());
+                }
+                else if (Accept('[')) {
+                    if (AtDigit()) {
+                        path.push_back(Index());
+                    }
+                    else if (AtQuote()) {
+                        path.push_back(Quoted());
+                    }
+                    else {
+                        Fail("an index or a quoted key expected");
+                    }
+                    if (!Accept(']')) {
+                        Fail("']' expected");
+                    }
+                }
+                else {
+                    return path;
+                }
+            }
+        }
+
+        SolQueryOp Op()
+        {
+            static const std::pair<const char*, SolQueryOp> ops[] = {
+                { "==", SolQueryOp::Equal },
+                { "!=", SolQueryOp::NotEqual },
+                { "<=", SolQueryOp::LessEqual },
+                { ">=", SolQueryOp::GreaterEqual },
+                { "<", SolQueryOp::Less },
+                { ">", SolQueryOp::Greater },
+            };
+
+            for (auto& [text, op] : ops) {
+                if (_text.compare(_pos, std::strlen(text), text) == 0) {
+                    _pos += std::strlen(text);
+                    return op;
+                }
+            }
+            Fail("a comparison expected");
+        }
+
+        SolValue Literal()
+        {
+            if (AtQuote()) {
+                return Quoted();
+            }
+
+            static const std::pair<const char*, bool> words[] = { { "true", true }, { "false", false } };
+            for (auto& [text, value] : words) {
+                if (_text.compare(_pos, std::strlen(text), text) == 0) {
+                    _pos += std::strlen(text);
+                    return value;
+                }
+            }
+            if (_text.compare(_pos, 4, "null") == 0) {
+                _pos += 4;
+                return nullptr;
+            }
+
+            const char* start = _text.c_str() + _pos;
+            char* end;
+            double value = std::strtod(start, &end);
+            if (end == start) {
+                Fail("a number, a string, true, false or null expected");
+            }
+            _pos += end - start;
+            return value;
+        }
+
+        const std::string& _text;
+        size_t _pos = 0;
+    };
+
+
+    // the key of an ecma array entry as a dense index, flash writes arrays that way in AMF0
+    bool ParseIndex(std::string_view key, size_t& index)
+    {
+        if (key.empty() || key.size() > 9 || (key[0] == '0' && key.size() > 1)) {
+            return false;
+        }
+
+        index = 0;
+        for (char c : key) {
+            if (c < '0' || c > '9') {
+                return false;
+            }
+            index = index * 10 + (c - '0');
+        }
+        return true;
+    }
+
+    bool MatchesIndex(size_t want, std::string_view key, size_t index, bool dense)
+    {
+        return dense ? index == want : ParseIndex(key, index) && index == want;
+    }
+
+    bool MatchesKey(const SolPathKey& want, std::string_view key, size_t index, bool dense)
+    {
+        auto name = std::get_if<std::string>(&want);
+        return name ? !dense && key == *name : MatchesIndex(std::get<size_t>(want), key, index, dense);
+    }
+
+    bool Matches(const SolQueryStep& step, std::string_view key, size_t index, bool dense)
+    {
+        switch (step.kind)
+        {
+        case SolQueryStepKind::Key:
+            return !dense && key == step.key;
+
+        case SolQueryStepKind::Index:
+            return MatchesIndex(step.index, key, index, dense);
+
+        default:
+            return true;
+        }
+    }
+
+    bool Compare(const SolValue& value, SolQueryOp op, const SolValue& operand)
+    {
+        if (op == SolQueryOp::Exists) {
+            return value.type != SolType::Null && value.type != SolType::Undefined && value.type != SolType::BooleanFalse;
+        }
+
+        int order;
+        bool number = value.type == SolType::Integer || value.type == SolType::Double;
+
+        if (number && operand.type == SolType::Double) {
+            double left = value.type == SolType::Integer ? value.get<sol::SolInteger>() : value.get<sol::SolDouble>();
+            double right = operand.get<sol::SolDouble>();
+            if (left != left || right != right) {
+                return op == SolQueryOp::NotEqual;
+            }
+            order = left < right ? -1 : left > right ? 1 : 0;
+        }
+        else if (value.type == SolType::String && operand.type == SolType::String) {
+            int result = value.get<sol::SolString>().compare(operand.get<sol::SolString>());
+            order = result < 0 ? -1 : result > 0 ? 1 : 0;
+        }
+        else {
+            // booleans carry their value in the type
+            bool same = value.type == operand.type
+                || (operand.type == SolType::Null && value.type == SolType::Undefined);
+            bool comparable = operand.type == SolType::Null || operand.type == SolType::BooleanFalse || operand.type == SolType::BooleanTrue;
+            same = same && comparable;
+            return op == SolQueryOp::Equal ? same : op == SolQueryOp::NotEqual && !same;
+        }
+
+        switch (op)
+        {
+        case SolQueryOp::Equal: return order == 0;
+        case SolQueryOp::NotEqual: return order != 0;
+        case SolQueryOp::Less: return order < 0;
+        case SolQueryOp::LessEqual: return order <= 0;
+        case SolQueryOp::Greater: return order > 0;
+        case SolQueryOp::GreaterEqual: return order >= 0;
+        default: return false;
+        }
+    }
+
+    // reads the value at the path of a filter below the value after marker, everything
+    // else is skipped, holds is false if there is no value there
+    bool Test(BindReader& br, const SolQueryStep& filter, size_t depth, uint8_t marker, bool& holds)
+    {
+        holds = false;
+
+        if (depth == filter.path.size()) {
+            if (br.IsContainer(marker)) {
+                holds = filter.op == SolQueryOp::Exists || filter.op == SolQueryOp::NotEqual;
+                return br.Skip(marker);
+            }
+            SolValue value;
+            if (!br.ReadValue(marker, value)) {
+                return false;
+            }
+            holds = Compare(value, filter.op, filter.operand);
+            return true;
+        }
+
+        if (!br.IsContainer(marker)) {
+            return br.Skip(marker);
+        }
+
+        BindFrame frame;
+        if (!br.BeginChildren(marker, frame)) {
+            return false;
+        }
+
+        bool found = false;
+        for (;;) {
+            std::string_view key;
+            size_t index;
+            bool dense;
+            bool more;
+            if (!br.NextChild(frame, key, index, dense, marker, more)) {
+                return false;
+            }
+            if (!more) {
+                return true;
+            }
+
+            if (!found && MatchesKey(filter.path[depth], key, index, dense)) {
+                found = true;
+                if (!Test(br, filter, depth + 1, marker, holds)) {
+                    return false;
+                }
+            }
+            else if (!br.Skip(marker)) {
+                return false;
+            }
+        }
+    }
+
+    struct QueryState
+    {
+        BindReader& br;
+        const std::vector<SolQueryStep>& steps;
+        bool values;
+        std::vector<sol::SolQueryMatch>& matches;
+
+        std::string key;
+        SolPath path;
+
+        QueryState(BindReader& br, const std::vector<SolQueryStep>& steps, bool values, std::vector<sol::SolQueryMatch>& matches)
+            : br(br), steps(steps), values(values), matches(matches)
+        {
+        }
+    };
+
+    bool Visit(QueryState& q, size_t step, uint8_t marker);
+
+    // a child of a value that matched the step before, or an entry for the first step
+    bool VisitChild(QueryState& q, size_t step, std::string_view key, size_t index, bool dense, uint8_t marker)
+    {
+        auto& current = q.steps[step];
+        if (!Matches(current, key, index, dense)) {
+            return q.br.Skip(marker);
+        }
+
+        // the child is read once for the filter, and again from its marker if it holds
+        if (current.kind == SolQueryStepKind::Filter) {
+            auto mark = q.br.Mark();
+            bool holds;
+            if (!Test(q.br, current, 0, marker, holds)) {
+                return false;
+            }
+            if (!holds) {
+                return true;
+            }
+            q.br.Rewind(mark);
+        }
+
+        if (step == 0) {
+            q.key.assign(key);
+        }
+        else if (dense) {
+            q.path.push_back(index);
+        }
+        else {
+            q.path.push_back(std::string(key));
+        }
+
+        bool result = Visit(q, step + 1, marker);
+        if (step != 0) {
+            q.path.pop_back();
+        }
+        return result;
+    }
+
+    bool Visit(QueryState& q, size_t step, uint8_t marker)
+    {
+        if (step == q.steps.size()) {
+            sol::SolQueryMatch match{ q.key, q.path, q.br.offset(), SolValue() };
+            if (q.values ? !q.br.ReadValue(marker, match.value) : !q.br.Skip(marker)) {
+                return false;
+            }
+            q.matches.push_back(std::move(match));
+            return true;
+        }
+
+        // values that are not containers have nothing to match further steps
+        if (!q.br.IsContainer(marker)) {
+            return q.br.Skip(marker);
+        }
+
+        BindFrame frame;
+        if (!q.br.BeginChildren(marker, frame)) {
+            return false;
+        }
+
+        for (;;) {
+            std::string_view key;
+            size_t index;
+            bool dense;
+            bool more;
+            if (!q.br.NextChild(frame, key, index, dense, marker, more)) {
+                return false;
+            }
+            if (!more) {
+                return true;
+            }
+            if (!VisitChild(q, step, key, index, dense, marker)) {
+                return false;
+            }
+        }
+    }
+}
+
+
+sol::SolQuery::SolQuery(const std::string& expression)
+    : _expression(expression)
+{
+    _steps = QueryParser(_expression).Parse();
+}
+
+bool sol::QuerySolData(const uint8_t* data, size_t size, const SolQuery& query, bool values,
+    std::vector<SolQueryMatch>& matches, SolError& error, const SolReadOptions& options)
+{
+    SOL_TRACE_SCOPE("query sol data");
+    error = SolError();
+
+    detail::Reader r{ data, size, 0, error, options };
+    detail::BindReader br(r);
+
+    std::string_view solname;
+    SolVersion version;
+    if (!br.ReadHeader(solname, version)) {
+        return false;
+    }
+
+    QueryState q{ br, query.steps(), values, matches };
+    for (;;) {
+        std::string_view key;
+        uint8_t marker;
+        bool more;
+        if (!br.NextEntry(key, marker, more)) {
+            return false;
+        }
+        if (!more) {
+            return true;
+        }
+        if (!VisitChild(q, 0, key, 0, false, marker) || !br.EndEntry()) {
+            return false;
+        }
+    }
+}
+
+bool sol::QuerySolFile(const std::string& path, const SolQuery& query, bool values,
+    std::vector<SolQueryMatch>& matches, SolError& error, const SolReadOptions& options)
+{
+    error = SolError();
+
+    utils::MappedFile filecontent;
+    if (!filecontent.open(path)) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
+    }
+    return QuerySolData(filecontent.data(), filecontent.size(), query, values, matches, error, options);
+}
@@ -0,0 +1,92 @@
+#ifndef __QUERY_H__
+#define __QUERY_H__
+
+#include "sol.h"
+#include "tree.h"
+
+// paths to values, evaluated on the encoded bytes of a file, so that a value is found
+// without reading the ones beside it into memory, a query is a top level entry key
+// followed by steps into it:
+//
+//   player.inventory[3].name       a key, as an identifier or quoted as ["a key"]
+//   player.inventory[*].name       every child, also written as player.*
+//   items[?level >= 3].name        the children whose value at a relative path compares
+//   items[?equipped]               the children with a value there that is not null,
+//                                  undefined or false
+//   scores[?@ > 100]               @ stands for the child itself
+//
+// an index matches dense elements and keys that are the number, as AMF0 arrays have,
+// a filter compares numbers with numbers and strings with strings, anything else is
+// only equal to the same boolean or null
+namespace sol
+{
+    enum class SolQueryStepKind
+    {
+        Key,
+        Index,
+        Wildcard,
+        Filter,
+    };
+
+
+    enum class SolQueryOp
+    {
+        Exists,
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+    };
+
+
+    struct SolQueryStep
+    {
+        SolQueryStepKind kind;
+        std::string key;
+        size_t index = 0;
+
+        // what a filter compares
+        SolPath path;
+        SolQueryOp op = SolQueryOp::Exists;
+        SolValue operand;
+    };
+
+
+    class SolQuery
+    {
+    public:
+        // throws std::runtime_error naming the position of the first mistake
+        explicit SolQuery(const std::string& expression);
+
+        const std::string& expression() const { return _expression; }
+        const std::vector<SolQueryStep>& steps() const { return _steps; }
+
+    private:
+        std::string _expression;
+        std::vector<SolQueryStep> _steps;
+    };
+
+
+    struct SolQueryMatch
+    {
+        std::string key;        // the top level entry
+        SolPath path;           // below it, FormatSolPath shows both
+        size_t offset;          // of the type marker, in the referenced bytes if the path goes through a reference
+        SolValue value;         // set if values are asked for
+    };
+
+
+    // appends the matches in the order they are encoded, only the entries and children
+    // along the steps are looked into and everything else is skipped, values reads the
+    // values matched, otherwise matches give their offsets only, returns false with
+    // error set if what was read does not decode
+    bool QuerySolData(const uint8_t* data, size_t size, const SolQuery& query, bool values,
+        std::vector<SolQueryMatch>& matches, SolError& error, const SolReadOptions& options = SolReadOptions());
+
+    bool QuerySolFile(const std::string& path, const SolQuery& query, bool values,
+        std::vector<SolQueryMatch>& matches, SolError& error, const SolReadOptions& options = SolReadOptions());
+}
+
+#endif // !__QUERY_H__
@@ -0,0 +1,706 @@
+#ifndef __SKIPPER_H__
+#define __SKIPPER_H__
+
+#include "decoder.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+// walks encoded values without building them, shared by the validator and the typed bindings
+namespace sol::detail
+{
+    struct ClassTraits
+    {
+        uint32_t members;
+        bool dynamic;
+        size_t names;       // where the class name is in SkipTable::names, the members follow it
+    };
+
+    // the decoder's ReadFrame without the value, children are skipped as they are read
+    struct SkipFrame
+    {
+        ReadFrameState state;
+        bool flag;          // dynamic class for AMF3 objects, typed object for AMF0
+        uint32_t remaining;
+        uint32_t members;
+    };
+
+    // sizes of the reference tables the decoder would have built so far, with record
+    // set the strings and class names are kept as views of the input, and objects as
+    // the offsets of their type markers, so that a reference can be read again, those
+    // grow with the input, classes grows only with class definitions, up to maxclasses
+    struct SkipTable
+    {
+        size_t strings = 0;
+        size_t objects = 0;
+        std::vector<ClassTraits> classes;
+
+        bool record = false;
+        std::vector<std::string_view> strpool;
+        std::vector<std::string_view> names;    // of every class, one after another
+        std::vector<size_t> objpool;
+
+        std::string_view ClassName(const ClassTraits& traits) const
+        {
+            return names[traits.names];
+        }
+
+        std::string_view MemberName(const ClassTraits& traits, size_t i) const
+        {
+            return names[traits.names + 1 + i];
+        }
+
+        // forgets the classes from count on, with their names
+        void DropClasses(size_t count)
+        {
+            if (count < classes.size()) {
+                if (record) {
+                    names.resize(classes[count].names);
+                }
+                classes.resize(count);
+            }
+        }
+    };
+
+    // traits tables start with room for this many classes, most files have fewer
+    constexpr size_t SKIP_CLASSES_RESERVE = 64;
+
+    struct Skipper
+    {
+        Reader& r;
+        SkipTable table;
+        std::vector<SkipFrame> stack;
+        uint32_t depth = 0;     // containers open around the value being skipped
+
+        // if set, the objects some reference is followed to are marked in it
+        std::vector<bool>* referenced = nullptr;
+
+        // the stack is allocated once and never grows, a frame is pushed for a marker
+        // read after the value began, so there can be no more of them than bytes
+        explicit Skipper(Reader& r) : r(r)
+        {
+            stack.reserve(std::min<size_t>(r.options.maxdepth, r.size));
+            table.classes.reserve(std::min<size_t>(r.options.maxclasses, SKIP_CLASSES_RESERVE));
+        }
+
+        bool CheckRef(size_t ref, size_t count, size_t offset)
+        {
+            return ref < count
+                || r.Fail(sol::SolErrorCode::BadReference, offset, -1, false, static_cast<int64_t>(ref));
+        }
+
+        bool CheckObjRef(size_t ref, size_t offset)
+        {
+            if (!CheckRef(ref, table.objects, offset)) {
+                return false;
+            }
+            if (referenced) {
+                if (referenced->size() <= ref) {
+                    referenced->resize(ref + 1);
+                }
+                (*referenced)[ref] = true;
+            }
+            return true;
+        }
+
+        template <typename TType>
+        bool CheckCount(uint64_t count, size_t minsize, TType type)
+        {
+            return count <= (r.size - r.index) / minsize
+                || r.Fail(sol::SolErrorCode::CountTooLarge, r.index, static_cast<int>(type),
+                    std::is_same_v<TType, sol::AMF0Type>, static_cast<int64_t>(count));
+        }
+
+        template <typename TType>
+        bool SkipFixed(size_t len, TType type)
+        {
+            if (len > r.size - r.index) {
+                return r.Truncated(type);
+            }
+            r.index += len;
+            return true;
+        }
+
+        // skips len bytes of string, xml or binary data
+        template <typename TType>
+        bool SkipPayload(size_t len, TType type)
+        {
+            if (len > r.size - r.index) {
+                return r.Truncated(type);
+            }
+            if (len > r.options.maxstring) {
+                return r.Fail(sol::SolErrorCode::StringTooLong, r.index, static_cast<int>(type),
+                    std::is_same_v<TType, sol::AMF0Type>, static_cast<int64_t>(len), r.options.maxstring);
+            }
+            r.index += len;
+            return true;
+        }
+
+        bool Push(ReadFrameState state, bool flag, uint32_t remaining, uint32_t members)
+        {
+            if (depth + stack.size() >= r.options.maxdepth || stack.size() == stack.capacity()) {
+                return r.Fail(sol::SolErrorCode::MaxDepthExceeded, r.index, -1, false, 0, r.options.maxdepth);
+            }
+            stack.push_back({ state, flag, remaining, members });
+            return true;
+        }
+
+        // a child of the top frame is complete, a dictionary alternates keys and values
+        void Attach()
+        {
+            SkipFrame& frame = stack.back();
+            if (frame.state == ReadFrameState::DictionaryKey) {
+                frame.state = ReadFrameState::DictionaryValue;
+            }
+            else if (frame.state == ReadFrameState::DictionaryValue) {
+                frame.state = ReadFrameState::DictionaryKey;
+            }
+        }
+
+        void AddObject(size_t marker)
+        {
+            ++table.objects;
+            if (table.record) {
+                table.objpool.push_back(marker);
+            }
+        }
+
+        // value is set only if the table is recorded
+        bool SkipString(bool& empty, std::string_view* value = nullptr)
+        {
+            size_t start = r.index;
+            sol::SolInteger ref;
+            if (!sol::detail::DecodeInteger(r, ref, true)) {
+                return false;
+            }
+
+            // only non-empty strings are pooled, so a reference is never empty
+            empty = false;
+            if ((ref & 1) == 0) {
+                if (!CheckRef(ref >> 1, table.strings, start)) {
+                    return false;
+                }
+                if (value && table.record) {
+                    *value = table.strpool[ref >> 1];
+                }
+                return true;
+            }
+
+            size_t len = ref >> 1;
+            if (!SkipPayload(len, sol::SolType::String)) {
+                return false;
+            }
+            if (len != 0) {
+                ++table.strings;
+                if (table.record) {
+                    table.strpool.emplace_back(reinterpret_cast<const char*>(r.data + r.index - len), len);
+                }
+            }
+            if (value && table.record) {
+                *value = std::string_view(reinterpret_cast<const char*>(r.data + r.index - len), len);
+            }
+            empty = len == 0;
+            return true;
+        }
+
+        // xml, binary and date share the object reference table
+        bool SkipObjRef(size_t& len, bool& inlined)
+        {
+            size_t start = r.index;
+            sol::SolInteger ref;
+            if (!sol::detail::DecodeInteger(r, ref, true)) {
+                return false;
+            }
+
+            inlined = (ref & 1) != 0;
+            len = ref >> 1;
+            return inlined || CheckObjRef(len, start);
+        }
+
+        // the traits of an AMF3 object, classref is its header without the inline bit,
+        // classindex is set to the index of the traits in the table
+        bool SkipTraits(uint32_t classref, size_t start, size_t& classindex)
+        {
+            using namespace sol;
+
+            if ((classref & 1) == 0) {
+                classindex = classref >> 1;
+                return CheckRef(classindex, table.classes.size(), start);
+            }
+            if ((classref >> 1) & 1) {
+                return r.Fail(SolErrorCode::Externalizable, start, static_cast<int>(SolType::Object));
+            }
+
+            ClassTraits traits;
+            traits.dynamic = (classref >> 2) & 1;
+            traits.members = classref >> 3;
+            traits.names = table.names.size();
+
+            bool empty;
+            std::string_view name;
+            if (!SkipString(empty, &name) || !CheckCount(traits.members, 1, SolType::Object)) {
+                return false;
+            }
+            if (table.record) {
+                table.names.push_back(name);
+            }
+            for (uint32_t i = 0; i < traits.members; ++i) {
+                if (!SkipString(empty, &name)) {
+                    return false;
+                }
+                if (table.record) {
+                    table.names.push_back(name);
+                }
+            }
+
+            if (table.classes.size() >= r.options.maxclasses) {
+                return r.Fail(SolErrorCode::TooManyClasses, start, static_cast<int>(SolType::Object), false,
+                    static_cast<int64_t>(table.classes.size() + 1), r.options.maxclasses);
+            }
+            classindex = table.classes.size();
+            table.classes.push_back(traits);
+            return true;
+        }
+
+        bool BeginSolValue(sol::SolType type)
+        {
+            using namespace sol;
+
+            size_t marker = r.index - 1;
+            size_t len;
+            bool inlined;
+
+            switch (type)
+            {
+            case SolType::Undefined:
+            case SolType::Null:
+            case SolType::BooleanFalse:
+            case SolType::BooleanTrue:
+                return true;
+
+            case SolType::Integer: {
+                SolInteger result;
+                return detail::DecodeInteger(r, result);
+            }
+
+            case SolType::Double:
+                return SkipFixed(8, SolType::Double);
+
+            case SolType::String: {
+                bool empty;
+                return SkipString(empty);
+            }
+
+            case SolType::XmlDoc:
+            case SolType::Xml:
+            case SolType::Binary:
+                if (!SkipObjRef(len, inlined)) {
+                    return false;
+                }
+                if (inlined) {
+                    if (!SkipPayload(len, type)) {
+                        return false;
+                    }
+                    AddObject(marker);
+                }
+                return true;
+
+            case SolType::Date:
+                if (!SkipObjRef(len, inlined)) {
+                    return false;
+                }
+                if (inlined) {
+                    if (!SkipFixed(8, SolType::Double)) {
+                        return false;
+                    }
+                    AddObject(marker);
+                }
+                return true;
+
+            case SolType::Array:
+            case SolType::Object:
+            case SolType::Dictionary:
+                break;
+
+            default:
+                return r.Fail(SolErrorCode::UnknownType, r.index - 1, static_cast<int>(type));
+            }
+
+            size_t start = r.index;
+            SolInteger ref;
+            if (!detail::DecodeInteger(r, ref, true)) {
+                return false;
+            }
+
+            if ((ref & 1) == 0) {
+                return CheckObjRef(ref >> 1, start);
+            }
+
+            if (type == SolType::Array) {
+                uint32_t count = ref >> 1;
+                if (!CheckCount(count, 1, type)) {
+                    return false;
+                }
+                AddObject(marker);
+                return Push(ReadFrameState::ArrayAssoc, false, count, 0);
+            }
+            else if (type == SolType::Object) {
+                size_t classindex;
+                if (!SkipTraits(ref >> 1, start, classindex)) {
+                    return false;
+                }
+                auto& traits = table.classes[classindex];
+
+                AddObject(marker);
+                return Push(ReadFrameState::ObjectSealed, traits.dynamic, 0, traits.members);
+            }
+            else {
+                uint32_t count = ref >> 1;
+                uint8_t weakkeys;
+                if (!detail::DecodeByte(r, weakkeys) || !CheckCount(count, 2, type)) {
+                    return false;
+                }
+                AddObject(marker);
+                return Push(ReadFrameState::DictionaryKey, false, count, 0);
+            }
+        }
+
+        bool NextSolChild(SkipFrame& frame, sol::SolType& type, bool& more)
+        {
+            bool empty;
+            more = false;
+
+            switch (frame.state)
+            {
+            case ReadFrameState::ArrayAssoc:
+                if (!SkipString(empty)) {
+                    return false;
+                }
+                if (!empty) {
+                    break;
+                }
+                frame.state = ReadFrameState::ArrayDense;
+                [[fallthrough]];
+
+            case ReadFrameState::ArrayDense:
+            case ReadFrameState::DictionaryKey:
+                if (frame.remaining == 0) {
+                    return true;
+                }
+                --frame.remaining;
+                break;
+
+            case ReadFrameState::ObjectSealed:
+                if (frame.remaining < frame.members) {
+                    ++frame.remaining;
+                    break;
+                }
+                if (!frame.flag) {
+                    return true;
+                }
+                frame.state = ReadFrameState::ObjectDynamic;
+                [[fallthrough]];
+
+            case ReadFrameState::ObjectDynamic:
+                if (!SkipString(empty)) {
+                    return false;
+                }
+                if (empty) {
+                    return true;
+                }
+                break;
+
+            case ReadFrameState::DictionaryValue:
+                break;
+
+            default:
+                return true;
+            }
+
+            uint8_t marker;
+            if (!sol::detail::DecodeByte(r, marker)) {
+                return false;
+            }
+            type = static_cast<sol::SolType>(marker);
+            more = true;
+            return true;
+        }
+
+        bool SkipAMF0ShortString(size_t& len)
+        {
+            uint16_t value;
+            if (!sol::detail::DecodeBigEndian(r, value)) {
+                return false;
+            }
+            len = value;
+            return SkipPayload(len, sol::AMF0Type::String);
+        }
+
+        bool BeginAMF0Value(sol::AMF0Type type)
+        {
+            using namespace sol;
+
+            size_t marker = r.index - 1;
+            size_t len;
+
+            switch (type)
+            {
+            case AMF0Type::Number:
+                return SkipFixed(8, AMF0Type::Number);
+
+            case AMF0Type::Boolean:
+                return SkipFixed(1, AMF0Type::Boolean);
+
+            case AMF0Type::String:
+                return SkipAMF0ShortString(len);
+
+            case AMF0Type::Null:
+            case AMF0Type::Undefined:
+                return true;
+
+            case AMF0Type::Reference: {
+                size_t start = r.index;
+                uint16_t ref;
+                return detail::DecodeBigEndian(r, ref) && CheckObjRef(ref, start);
+            }
+
+            case AMF0Type::Date:
+                return SkipFixed(10, AMF0Type::Date);
+
+            case AMF0Type::LongString:
+            case AMF0Type::XMLDoc: {
+                uint32_t value;
+                return detail::DecodeBigEndian(r, value) && SkipPayload(value, AMF0Type::LongString);
+            }
+
+            case AMF0Type::Object:
+                AddObject(marker);
+                return Push(ReadFrameState::AMF0Object, false, 0, 0);
+
+            case AMF0Type::TypedObject:
+                if (!SkipAMF0ShortString(len)) {
+                    return false;
+                }
+                AddObject(marker);
+                return Push(ReadFrameState::AMF0Object, len != 0, 0, 0);
+
+            case AMF0Type::EcmaArray:
+            case AMF0Type::StrictArray: {
+                // each ecma entry takes at least a key length and a type marker
+                bool ecma = type == AMF0Type::EcmaArray;
+                uint32_t count;
+                if (!detail::DecodeBigEndian(r, count) || !CheckCount(count, ecma ? 3 : 1, type)) {
+                    return false;
+                }
+                AddObject(marker);
+                return Push(ecma ? ReadFrameState::AMF0EcmaArray : ReadFrameState::AMF0StrictArray, false, count, 0);
+            }
+
+            case AMF0Type::MovieClip:
+            case AMF0Type::ObjectEnd:
+            case AMF0Type::Unsupported:
+            case AMF0Type::Recordset:
+                return r.Fail(SolErrorCode::UnsupportedType, r.index - 1, static_cast<int>(type), true);
+
+            default:
+                return r.Fail(SolErrorCode::UnknownType, r.index - 1, static_cast<int>(type), true);
+            }
+        }
+
+        bool NextAMF0Child(SkipFrame& frame, sol::AMF0Type& type, bool& more)
+        {
+            using namespace sol;
+
+            size_t len;
+            more = false;
+
+            switch (frame.state)
+            {
+            case ReadFrameState::AMF0Object: {
+                if (!SkipAMF0ShortString(len)) {
+                    return false;
+                }
+                if (len != 0) {
+                    break;
+                }
+                uint8_t marker;
+                if (!detail::DecodeByte(r, marker)) {
+                    return false;
+                }
+                if (marker != static_cast<uint8_t>(AMF0Type::ObjectEnd)) {
+                    auto objtype = frame.flag ? AMF0Type::TypedObject : AMF0Type::Object;
+                    return r.Fail(SolErrorCode::BadFormat, r.index - 1, static_cast<int>(objtype), true,
+                        marker, static_cast<int>(AMF0Type::ObjectEnd));
+                }
+                return true;
+            }
+
+            case ReadFrameState::AMF0EcmaArray:
+                if (frame.remaining > 0) {
+                    --frame.remaining;
+                    if (!SkipAMF0ShortString(len)) {
+                        return false;
+                    }
+                    break;
+                }
+                for (uint8_t mark : codec::AMF0_OBJECT_ENDMARK) {
+                    uint8_t read;
+                    if (!detail::DecodeByte(r, read)) {
+                        return false;
+                    }
+                    if (read != mark) {
+                        return r.Fail(SolErrorCode::BadFormat, r.index - 1, static_cast<int>(AMF0Type::EcmaArray), true, read, mark);
+                    }
+                }
+                return true;
+
+            case ReadFrameState::AMF0StrictArray:
+                if (frame.remaining == 0) {
+                    return true;
+                }
+                --frame.remaining;
+                break;
+
+            default:
+                return true;
+            }
+
+            uint8_t marker;
+            if (!detail::DecodeByte(r, marker)) {
+                return false;
+            }
+            type = static_cast<AMF0Type>(marker);
+            more = true;
+            return true;
+        }
+
+        template <typename TType, typename TBegin, typename TNext>
+        bool SkipWithStack(TType type, TBegin&& begin, TNext&& next)
+        {
+            bool more;
+
+            if (!begin(type)) {
+                return false;
+            }
+
+            while (!stack.empty()) {
+                if (!next(stack.back(), type, more)) {
+                    return false;
+                }
+                if (more) {
+                    size_t depth = stack.size();
+                    if (!begin(type)) {
+                        return false;
+                    }
+                    if (stack.size() == depth) {
+                        Attach();
+                    }
+                    continue;
+                }
+
+                stack.pop_back();
+                if (!stack.empty()) {
+                    Attach();
+                }
+            }
+            return true;
+        }
+
+        bool SkipValue(sol::SolType type)
+        {
+            return SkipWithStack(type,
+                [this](sol::SolType type) { return BeginSolValue(type); },
+                [this](SkipFrame& frame, sol::SolType& type, bool& more) { return NextSolChild(frame, type, more); });
+        }
+
+        bool SkipAMF0Value(sol::AMF0Type type)
+        {
+            return SkipWithStack(type,
+                [this](sol::AMF0Type type) { return BeginAMF0Value(type); },
+                [this](SkipFrame& frame, sol::AMF0Type& type, bool& more) { return NextAMF0Child(frame, type, more); });
+        }
+
+        // the checks of DecodeSolFile up to the first entry, in the same order
+        bool SkipSolHeader(std::string_view& solname, sol::SolVersion& version)
+        {
+            using namespace sol;
+
+            if (r.size < codec::SOL_HEADER_MINSIZE) {
+                return r.Fail(SolErrorCode::FileTooSmall, 0);
+            }
+
+            if (memcmp(r.data, codec::SOL_MAGIC, 2) != 0) {
+                return r.Fail(SolErrorCode::MagicMismatch, 0);
+            }
+            r.index += 2;
+
+            uint32_t chunksize;
+            if (!detail::DecodeBigEndian(r, chunksize)) {
+                return false;
+            }
+            if (chunksize != r.size - 6) {
+                return r.Fail(SolErrorCode::ChunkSizeMismatch, 2, -1, false, chunksize, static_cast<int64_t>(r.size - 6));
+            }
+
+            if (memcmp(r.data + r.index, codec::SOL_CONSTANT, 10) != 0) {
+                return r.Fail(SolErrorCode::ConstantMismatch, r.index);
+            }
+            r.index += 10;
+
+            size_t len;
+            uint32_t value;
+            if (!SkipAMF0ShortString(len) || !detail::DecodeBigEndian(r, value)) {
+                return false;
+            }
+            solname = std::string_view(reinterpret_cast<const char*>(r.data + r.index - 4 - len), len);
+
+            if (value != static_cast<uint32_t>(SolVersion::AMF0) && value != static_cast<uint32_t>(SolVersion::AMF3)) {
+                return r.Fail(SolErrorCode::UnsupportedVersion, r.index - 4, -1, false, value);
+            }
+            version = static_cast<SolVersion>(value);
+            return true;
+        }
+
+        // the same checks and in the same order as DecodeSolFile
+        bool SkipSolFile()
+        {
+            using namespace sol;
+
+            std::string_view solname;
+            SolVersion version;
+            if (!SkipSolHeader(solname, version)) {
+                return false;
+            }
+
+            bool amf0 = version == SolVersion::AMF0;
+            size_t len;
+            uint8_t marker;
+
+            while (r.index < r.size) {
+                if (amf0) {
+                    if (!SkipAMF0ShortString(len) || !detail::DecodeByte(r, marker)
+                        || !SkipAMF0Value(static_cast<AMF0Type>(marker))) {
+                        return false;
+                    }
+                }
+                else {
+                    bool empty;
+                    if (!SkipString(empty) || !detail::DecodeByte(r, marker)
+                        || !SkipValue(static_cast<SolType>(marker))) {
+                        return false;
+                    }
+                }
+
+                if (!detail::DecodeByte(r, marker)) {
+                    return false;
+                }
+                if (marker != 0x00) {
+                    return r.Fail(SolErrorCode::EndRequired, r.index - 1, -1, false, marker, 0);
+                }
+            }
+            return true;
+        }
+    };
+}
+
+#endif // !__SKIPPER_H__
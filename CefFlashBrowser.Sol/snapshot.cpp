@@ -0,0 +1,400 @@
+#include "snapshot.h"
+#include "codec.h"
+#include "skipper.h"
+#include "trace.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+
+namespace
+{
+    // an entry is cut inside only once the chunk is this long, and always at this length
+    const size_t CHUNK_MINSIZE = 512;
+    const size_t CHUNK_MAXSIZE = 64 * 1024;
+
+    // past the minimum, about one value end in this many ends a chunk
+    const uint32_t CHUNK_SPREAD = 8;
+
+    // the bytes before a value end that decide whether it ends a chunk
+    const size_t CHUNK_WINDOW = 16;
+
+    const char HISTORY_MAGIC[] = "SOLH";
+
+    // a history starts with the magic and the name, then a record per snapshot:
+    // time, size and chunk count, then the hash and size of each chunk
+    const size_t RECORD_HEADER_SIZE = 8 + 8 + 4;
+    const size_t RECORD_CHUNK_SIZE = sizeof(sol::SolChunkHash) + 4;
+
+
+    class SolChunker
+    {
+    public:
+        SolChunker(sol::detail::Reader& r, std::vector<size_t>& ends)
+            : _r(r), _skipper{ r }, _ends(ends)
+        {
+        }
+
+        // the walk of Skipper::SkipSolFile, with a cut after each value
+        bool ChunkFile()
+        {
+            using namespace sol;
+
+            std::string_view solname;
+            SolVersion version;
+            if (!_skipper.SkipSolHeader(solname, version)) {
+                return false;
+            }
+            Cut(true);
+
+            bool amf0 = version == SolVersion::AMF0;
+            size_t len;
+            uint8_t marker;
+
+            while (_r.index < _r.size) {
+                if (amf0) {
+                    if (!_skipper.SkipAMF0ShortString(len) || !detail::DecodeByte(_r, marker)
+                        || !SkipEntryValue(static_cast<AMF0Type>(marker),
+                            [this](AMF0Type type) { return _skipper.BeginAMF0Value(type); },
+                            [this](detail::SkipFrame& frame, AMF0Type& type, bool& more) { return _skipper.NextAMF0Child(frame, type, more); })) {
+                        return false;
+                    }
+                }
+                else {
+                    bool empty;
+                    if (!_skipper.SkipString(empty) || !detail::DecodeByte(_r, marker)
+                        || !SkipEntryValue(static_cast<SolType>(marker),
+                            [this](SolType type) { return _skipper.BeginSolValue(type); },
+                            [this](detail::SkipFrame& frame, SolType& type, bool& more) { return _skipper.NextSolChild(frame, type, more); })) {
+                        return false;
+                    }
+                }
+
+                if (!detail::DecodeByte(_r, marker)) {
+                    return false;
+                }
+                if (marker != 0x00) {
+                    return _r.Fail(SolErrorCode::EndRequired, _r.index - 1, -1, false, marker, 0);
+                }
+                Cut(true);
+            }
+            return true;
+        }
+
+    private:
+        // Skipper::SkipWithStack, a value inside the entry may end a chunk when it ends
+        template <typename TType, typename TBegin, typename TNext>
+        bool SkipEntryValue(TType type, TBegin&& begin, TNext&& next)
+        {
+            bool more;
+
+            if (!begin(type)) {
+                return false;
+            }
+
+            auto& stack = _skipper.stack;
+            while (!stack.empty()) {
+                if (!next(stack.back(), type, more)) {
+                    return false;
+                }
+                if (more) {
+                    size_t depth = stack.size();
+                    if (!begin(type)) {
+                        return false;
+                    }
+                    if (stack.size() == depth) {
+                        _skipper.Attach();
+                        Cut(false);
+                    }
+                    continue;
+                }
+
+                stack.pop_back();
+                if (!stack.empty()) {
+                    _skipper.Attach();
+                    Cut(false);
+                }
+            }
+            return true;
+        }
+
+        void Cut(bool always)
+        {
+            size_t len = _r.index - _start;
+            if (len == 0) {
+                return;
+            }
+            if (!always && len < CHUNK_MAXSIZE && (len < CHUNK_MINSIZE || WindowHash() % CHUNK_SPREAD != 0)) {
+                return;
+            }
+            _ends.push_back(_r.index);
+            _start = _r.index;
+        }
+
+        // FNV-1a
+        uint32_t WindowHash() const
+        {
+            uint32_t hash = 2166136261u;
+            for (size_t i = _r.index - CHUNK_WINDOW; i < _r.index; ++i) {
+                hash = (hash ^ _r.data[i]) * 16777619u;
+            }
+            return hash;
+        }
+
+        sol::detail::Reader& _r;
+        sol::detail::Skipper _skipper;
+        std::vector<size_t>& _ends;
+        size_t _start = 0;
+    };
+
+
+    // returns the length of the records read whole, a record cut short by a failed
+    // append is left out, name and snapshots are set if given
+    size_t ReadHistory(const std::string& path, std::string* name, std::vector<sol::SolSnapshot>* snapshots)
+    {
+        using namespace sol;
+
+        utils::MappedFile file;
+        if (!file.open(path) || file.size() < 8 || std::memcmp(file.data(), HISTORY_MAGIC, 4) != 0) {
+            return 0;
+        }
+
+        const uint8_t* data = file.data();
+        size_t size = file.size();
+        size_t namelen = codec::LoadBigEndian<uint32_t>(data + 4);
+        if (namelen > size - 8) {
+            return 0;
+        }
+        if (name) {
+            name->assign(reinterpret_cast<const char*>(data + 8), namelen);
+        }
+
+        size_t index = 8 + namelen;
+        for (uint64_t id = 1; size - index >= RECORD_HEADER_SIZE; ++id) {
+            uint32_t count = codec::LoadBigEndian<uint32_t>(data + index + 16);
+            if (count > (size - index - RECORD_HEADER_SIZE) / RECORD_CHUNK_SIZE) {
+                break;
+            }
+
+            if (snapshots) {
+                SolSnapshot snapshot;
+                snapshot.id = id;
+                snapshot.time = static_cast<int64_t>(codec::LoadBigEndian<uint64_t>(data + index));
+                snapshot.size = codec::LoadBigEndian<uint64_t>(data + index + 8);
+                snapshot.chunks.resize(count);
+
+                const uint8_t* p = data + index + RECORD_HEADER_SIZE;
+                for (auto& chunk : snapshot.chunks) {
+                    std::memcpy(chunk.hash.data(), p, chunk.hash.size());
+                    chunk.size = codec::LoadBigEndian<uint32_t>(p + chunk.hash.size());
+                    p += RECORD_CHUNK_SIZE;
+                }
+                snapshots->push_back(std::move(snapshot));
+            }
+            index += RECORD_HEADER_SIZE + count * RECORD_CHUNK_SIZE;
+        }
+        return index;
+    }
+
+    // written aside and renamed, so that a chunk is there whole or not at all
+    bool WriteChunk(const std::string& path, const uint8_t* data, size_t size)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            if (!file.write(reinterpret_cast<const char*>(data), size) || !file.flush()) {
+                return false;
+            }
+        }
+        std::filesystem::rename(temp, path, ec);
+        return !ec;
+    }
+}
+
+
+bool sol::ChunkSolData(const uint8_t* data, size_t size, std::vector<size_t>& ends, SolError& error, const SolReadOptions& options)
+{
+    SOL_TRACE_SCOPE("chunk sol data");
+    error = SolError();
+    ends.clear();
+
+    detail::Reader r{ data, size, 0, error, options };
+    return SolChunker(r, ends).ChunkFile();
+}
+
+sol::SolSnapshotStore::SolSnapshotStore(std::string root)
+    : _root(std::move(root))
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(_root) / "chunks", ec);
+    std::filesystem::create_directories(std::filesystem::path(_root) / "history", ec);
+    if (ec) {
+        throw std::runtime_error("Failed to create directory");
+    }
+}
+
+bool sol::SolSnapshotStore::take(const std::string& name, const uint8_t* data, size_t size, SolSnapshotInfo& info,
+    std::string& errmsg, const SolReadOptions& options)
+{
+    SOL_TRACE_SCOPE("take snapshot");
+
+    std::vector<size_t> ends;
+    SolError error;
+    if (!ChunkSolData(data, size, ends, error, options)) {
+        errmsg = error.message();
+        return false;
+    }
+
+    info = SolSnapshotInfo();
+    info.chunks = ends.size();
+
+    std::vector<uint8_t> record;
+    record.reserve(RECORD_HEADER_SIZE + ends.size() * RECORD_CHUNK_SIZE);
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    codec::AppendBigEndian(record, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()));
+    codec::AppendBigEndian(record, static_cast<uint64_t>(size));
+    codec::AppendBigEndian(record, static_cast<uint32_t>(ends.size()));
+
+    // chunks go first, a snapshot is never recorded before all of its chunks are there
+    size_t begin = 0;
+    for (size_t end : ends) {
+        SolChunkHash hash = utils::Sha256::Hash(data + begin, end - begin);
+        std::string path = ChunkPath(hash);
+
+        std::error_code ec;
+        if (!std::filesystem::exists(path, ec)) {
+            if (!WriteChunk(path, data + begin, end - begin)) {
+                errmsg = "Failed to write chunk";
+                return false;
+            }
+            ++info.newchunks;
+            info.newbytes += end - begin;
+        }
+
+        record.insert(record.end(), hash.begin(), hash.end());
+        codec::AppendBigEndian(record, static_cast<uint32_t>(end - begin));
+        begin = end;
+    }
+
+    std::string path = HistoryPath(name);
+    std::vector<SolSnapshot> snapshots;
+    size_t valid = ReadHistory(path, nullptr, &snapshots);
+
+    std::error_code ec;
+    if (valid == 0) {
+        std::vector<uint8_t> header(HISTORY_MAGIC, HISTORY_MAGIC + 4);
+        codec::AppendBigEndian(header, static_cast<uint32_t>(name.size()));
+        header.insert(header.end(), name.begin(), name.end());
+        record.insert(record.begin(), header.begin(), header.end());
+        std::filesystem::remove(path, ec);
+    }
+    else if (std::filesystem::file_size(path, ec) != valid) {
+        std::filesystem::resize_file(path, valid, ec);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    if (ec || !file.write(reinterpret_cast<const char*>(record.data()), record.size()) || !file.flush()) {
+        errmsg = "Failed to write history";
+        return false;
+    }
+
+    info.id = snapshots.size() + 1;
+    errmsg.clear();
+    return true;
+}
+
+bool sol::SolSnapshotStore::take(const std::string& name, const std::string& path, SolSnapshotInfo& info,
+    std::string& errmsg, const SolReadOptions& options)
+{
+    utils::MappedFile file;
+    if (!file.open(path)) {
+        errmsg = "Failed to read file";
+        return false;
+    }
+    return take(name, file.data(), file.size(), info, errmsg, options);
+}
+
+std::vector<std::string> sol::SolSnapshotStore::names() const
+{
+    std::vector<std::string> result;
+
+    std::error_code ec;
+    for (auto& item : std::filesystem::directory_iterator(std::filesystem::path(_root) / "history", ec)) {
+        std::string name;
+        if (item.path().extension() == ".log" && ReadHistory(item.path().string(), &name, nullptr) != 0) {
+            result.push_back(std::move(name));
+        }
+    }
+    return result;
+}
+
+std::vector<sol::SolSnapshot> sol::SolSnapshotStore::history(const std::string& name) const
+{
+    std::vector<SolSnapshot> result;
+    ReadHistory(HistoryPath(name), nullptr, &result);
+    return result;
+}
+
+bool sol::SolSnapshotStore::restore(const std::string& name, uint64_t id, std::vector<uint8_t>& data, std::string& errmsg) const
+{
+    SOL_TRACE_SCOPE("restore snapshot");
+
+    std::vector<SolSnapshot> snapshots = history(name);
+    if (id == 0 || id > snapshots.size()) {
+        errmsg = utils::FormatString("No snapshot %llu of %s", static_cast<unsigned long long>(id), name.c_str());
+        return false;
+    }
+
+    const SolSnapshot& snapshot = snapshots[id - 1];
+    data.clear();
+    data.reserve(snapshot.size);
+
+    utils::MappedFile file;
+    for (auto& chunk : snapshot.chunks) {
+        std::string hex = utils::ToHexString(chunk.hash.data(), chunk.hash.size());
+        if (!file.open(ChunkPath(chunk.hash))) {
+            errmsg = utils::FormatString("Chunk %s is missing", hex.c_str());
+            return false;
+        }
+        if (file.size() != chunk.size || utils::Sha256::Hash(file.data(), file.size()) != chunk.hash) {
+            errmsg = utils::FormatString("Chunk %s is damaged", hex.c_str());
+            return false;
+        }
+        data.insert(data.end(), file.data(), file.data() + file.size());
+    }
+
+    errmsg.clear();
+    return true;
+}
+
+bool sol::SolSnapshotStore::restore(const std::string& name, uint64_t id, const std::string& path, std::string& errmsg) const
+{
+    std::vector<uint8_t> data;
+    if (!restore(name, id, data, errmsg)) {
+        return false;
+    }
+
+    try {
+        utils::WriteFile(path, data);
+    }
+    catch (const std::exception& e) {
+        errmsg = e.what();
+        return false;
+    }
+    return true;
+}
+
+std::string sol::SolSnapshotStore::ChunkPath(const SolChunkHash& hash) const
+{
+    std::string hex = utils::ToHexString(hash.data(), hash.size());
+    return (std::filesystem::path(_root) / "chunks" / hex.substr(0, 2) / hex.substr(2)).string();
+}
+
+std::string sol::SolSnapshotStore::HistoryPath(const std::string& name) const
+{
+    SolChunkHash hash = utils::Sha256::Hash(name.data(), name.size());
+    return (std::filesystem::path(_root) / "history" / (utils::ToHexString(hash.data(), hash.size()) + ".log")).string();
+}
@@ -0,0 +1,90 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "sol.h"
+#include "utils.h"
+
+// every version of a set of sol files kept in one directory, each version as a list
+// of chunks stored once by the SHA-256 of their bytes:
+//
+//   root/chunks/ab/cdef...      a chunk, named by its hash in hex
+//   root/history/0123....log    the snapshots of one name, named by the hash of it
+//
+// chunks follow the structure of the file, the header is one and each top-level entry
+// ends one, larger entries are cut further at the ends of values inside them, chosen by
+// the bytes just before each end, so that the values after an edit are cut as they were
+// however far the edit moved them, and their chunks are found in the store again
+namespace sol
+{
+    using SolChunkHash = utils::Sha256::Digest;
+
+    struct SolChunkRef
+    {
+        SolChunkHash hash;
+        uint32_t size;
+    };
+
+
+    struct SolSnapshot
+    {
+        uint64_t id;            // counts up from 1 for each name
+        int64_t time;           // milliseconds since 1970
+        uint64_t size;
+        std::vector<SolChunkRef> chunks;
+    };
+
+
+    // what taking a snapshot stored
+    struct SolSnapshotInfo
+    {
+        uint64_t id = 0;
+        size_t chunks = 0;
+        size_t newchunks = 0;
+        uint64_t newbytes = 0;
+    };
+
+
+    // the end offsets of the chunks of the file in data, in order, the last one is
+    // size, returns false with error set as ValidateSolData would
+    bool ChunkSolData(const uint8_t* data, size_t size, std::vector<size_t>& ends, SolError& error, const SolReadOptions& options = SolReadOptions());
+
+
+    // one writer at a time, readers may share the directory with it, since chunks are
+    // written before the snapshots that use them and a snapshot is appended whole
+    class SolSnapshotStore
+    {
+    public:
+        // root is created if it does not exist
+        explicit SolSnapshotStore(std::string root);
+
+        const std::string& root() const { return _root; }
+
+        // stores the chunks of the file not in the store yet and adds a snapshot of it
+        // to the history of name, returns false with errmsg set if it is not a sol file
+        bool take(const std::string& name, const uint8_t* data, size_t size, SolSnapshotInfo& info, std::string& errmsg,
+            const SolReadOptions& options = SolReadOptions());
+
+        bool take(const std::string& name, const std::string& path, SolSnapshotInfo& info, std::string& errmsg,
+            const SolReadOptions& options = SolReadOptions());
+
+        // the names that have snapshots, in no particular order
+        std::vector<std::string> names() const;
+
+        // the snapshots of name, oldest first, empty if there are none
+        std::vector<SolSnapshot> history(const std::string& name) const;
+
+        // the bytes of a snapshot as they were taken, returns false with errmsg set if
+        // there is no such snapshot, or a chunk of it is missing or is not what it was
+        bool restore(const std::string& name, uint64_t id, std::vector<uint8_t>& data, std::string& errmsg) const;
+
+        bool restore(const std::string& name, uint64_t id, const std::string& path, std::string& errmsg) const;
+
+    private:
+        std::string ChunkPath(const SolChunkHash& hash) const;
+        std::string HistoryPath(const std::string& name) const;
+
+        std::string _root;
+    };
+}
+
+#endif // !__SNAPSHOT_H__
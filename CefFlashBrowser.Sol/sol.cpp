@@ -1,579 +1,711 @@
 #include "sol.h"
+#include "codec.h"
+#include "decoder.h"
+#include "encoder.h"
+#include "hash.h"
+#include "stats.h"
+#include "trace.h"
 #include "utils.h"
-#include <sstream>
-
-
-constexpr uint8_t SOL_MAGIC[] = { 0x00, 0xBF };
-constexpr uint8_t SOL_CONSTANT[] = { 0x54, 0x43, 0x53, 0x4F, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00 };
-
-constexpr uint16_t AMF0_SHORTSTRING_MAXLEN = 0xFFFF;
-constexpr uint8_t AMF0_OBJECT_ENDMARK[] = { 0x00, 0x00, 0x09 };
+#include "visit.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
 
 
 namespace
 {
-    [[noreturn]] void ThrowFileEndedImproperly()
-    {
-        throw std::runtime_error(
-            "File ended improperly");
-    }
-
-    [[noreturn]] void ThrowFileEndedImproperlyOnReadingType(sol::SolType type)
+    [[noreturn]] void ThrowUnsupportedVersion(sol::SolVersion version)
     {
         throw std::runtime_error(utils::FormatString(
-            "File ended improperly on reading type %d", static_cast<int>(type)));
+            "Unsupported version: %d", static_cast<int>(version)));
     }
 
-    [[noreturn]] void ThrowFileEndedImproperlyOnReadingType(sol::AMF0Type type)
+    [[noreturn]] void ThrowTooLong(const char* what, size_t len)
     {
         throw std::runtime_error(utils::FormatString(
-            "File ended improperly on reading AMF0 type %d", static_cast<int>(type)));
-    }
-
-    [[noreturn]] void ThrowUnknownType(sol::SolType type, int index = -1)
-    {
-        if (index < 0) {
-            throw std::runtime_error(utils::FormatString(
-                "Unknown type %d", static_cast<int>(type)));
-        }
-        else {
-            throw std::runtime_error(utils::FormatString(
-                "Unknown type %d at index %d", static_cast<int>(type), index));
-        }
-    }
-
-    [[noreturn]] void ThrowUnknownType(sol::AMF0Type type, int index = -1)
-    {
-        if (index < 0) {
-            throw std::runtime_error(utils::FormatString(
-                "Unknown AMF0 type %d", static_cast<int>(type)));
-        }
-        else {
-            throw std::runtime_error(utils::FormatString(
-                "Unknown AMF0 type %d at index %d", static_cast<int>(type), index));
-        }
+            "%s too long to encode: %zu bytes", what, len));
     }
 
-    [[noreturn]] void ThrowBadFormatOfType(sol::SolType type, int index, int read, int desire)
+    [[noreturn]] void ThrowUnsupportedType(sol::AMF0Type type)
     {
         throw std::runtime_error(utils::FormatString(
-            "Bad format of type %d at index %d: read %d, desire %d", static_cast<int>(type), index, read, desire));
+            "Unsupported AMF0 type: %d", static_cast<int>(type)));
     }
 
-    [[noreturn]] void ThrowBadFormatOfType(sol::AMF0Type type, int index, int read, int desire)
+    [[noreturn]] void ThrowNotMember(const sol::SolClassDef& classdef, const std::string& key)
     {
         throw std::runtime_error(utils::FormatString(
-            "Bad format of AMF0 type %d at index %d: read %d, desire %d", static_cast<int>(type), index, read, desire));
+            "Property %s is not a member of sealed class %s", key.c_str(), classdef.name.c_str()));
     }
 
-    [[noreturn]] void ThrowEndRequired(int index, int read, int desire = 0)
+    [[noreturn]] void ThrowMissingMember(const sol::SolClassDef& classdef, const std::string& member)
     {
         throw std::runtime_error(utils::FormatString(
-            "End required at index %d: read %d, desire %d", index, read, desire));
+            "Member %s of class %s has no value", member.c_str(), classdef.name.c_str()));
     }
 
-    [[noreturn]] void ThrowUnsupportedVersion(sol::SolVersion version)
+    // a NaN key is the same key as a NaN with the same bits, see detail::SameKey
+    bool SameKey(const sol::SolValue& left, const sol::SolValue& right)
     {
-        throw std::runtime_error(utils::FormatString(
-            "Unsupported version: %d", static_cast<int>(version)));
+        return sol::detail::SameKey(left, right, std::equal_to<sol::SolValue>());
     }
 
-    [[noreturn]] void ThrowUnsupportedType(sol::AMF0Type type)
+    void DigestSize(utils::Sha256& sha, uint64_t size)
     {
-        throw std::runtime_error(utils::FormatString(
-            "Unsupported AMF0 type: %d", static_cast<int>(type)));
+        uint8_t bytes[8];
+        sol::codec::StoreBigEndian(bytes, size);
+        sha.update(bytes, sizeof(bytes));
     }
 
-    template <typename T>
-    void CheckRefIndex(const std::vector<T>& pool, int index)
+    void DigestBytes(utils::Sha256& sha, const void* data, size_t size)
     {
-        if (index >= pool.size()) {
-            throw std::runtime_error(utils::FormatString(
-                "Reference index %d not found", index));
-        }
+        DigestSize(sha, size);
+        sha.update(data, size);
     }
 
-    std::string GetClassDefUniqueStr(const sol::SolClassDef& classdef)
+    // feeds the value to sha so that two values give the same bytes only if they
+    // are the same, every string and container is preceded by its length
+    void DigestSolValue(utils::Sha256& sha, const sol::SolValue& value)
     {
-        std::stringstream ss;
-        ss << classdef.name << ';'
-            << classdef.dynamic << ';'
-            << classdef.externalizable << ';';
-        for (const auto& member : classdef.members) {
-            ss << member << ';';
-        }
-        return ss.str();
-    }
+        using namespace sol;
 
-    int GetRefIndex(std::map<std::string, int>& pool, const std::string& id)
-    {
-        if (pool.count(id)) {
-            return pool[id];
-        }
-        else {
-            pool[id] = static_cast<int>(pool.size());
-            return -1;
+        uint8_t type = static_cast<uint8_t>(value.type);
+        sha.update(&type, 1);
+
+        if (!IsKnownType(value.type)) {
+            return;
         }
-    }
 
-    uint8_t ReadByte(uint8_t* data, int size, int& index)
-    {
-        return index >= size
-            ? throw std::runtime_error("File ended improperly on reading byte")
-            : data[index++];
+        VisitSolValue(value, [&](auto def, auto& v) {
+            using TStorage = typename decltype(def)::storage;
+
+            if constexpr (std::is_same_v<TStorage, SolNull> || std::is_same_v<TStorage, SolBoolean>) {
+                // the type alone tells the value
+            }
+            else if constexpr (std::is_same_v<TStorage, SolInteger>) {
+                DigestSize(sha, static_cast<uint32_t>(v));
+            }
+            else if constexpr (std::is_same_v<TStorage, SolDouble>) {
+                uint64_t bits;
+                std::memcpy(&bits, &v, sizeof(bits));
+                DigestSize(sha, bits);
+            }
+            else if constexpr (std::is_same_v<TStorage, SolString>) {
+                DigestBytes(sha, v.data(), v.size());
+            }
+            else if constexpr (std::is_same_v<TStorage, SolBinary>) {
+                DigestBytes(sha, v.data(), v.size());
+            }
+            else if constexpr (std::is_same_v<TStorage, SolArray>) {
+                DigestSize(sha, v.assoc.size());
+                for (auto& [key, val] : v.assoc) {
+                    DigestBytes(sha, key.data(), key.size());
+                    DigestSolValue(sha, val);
+                }
+                DigestSize(sha, v.dense.size());
+                for (auto& val : v.dense) {
+                    DigestSolValue(sha, val);
+                }
+            }
+            else if constexpr (std::is_same_v<TStorage, SolObject>) {
+                DigestBytes(sha, v.classdef.name.data(), v.classdef.name.size());
+                DigestSize(sha, (v.classdef.dynamic ? 1 : 0) | (v.classdef.externalizable ? 2 : 0));
+                DigestSize(sha, v.classdef.members.size());
+                for (auto& member : v.classdef.members) {
+                    DigestBytes(sha, member.data(), member.size());
+                }
+                DigestSize(sha, v.props.size());
+                for (auto& [key, val] : v.props) {
+                    DigestBytes(sha, key.data(), key.size());
+                    DigestSolValue(sha, val);
+                }
+            }
+            else if constexpr (std::is_same_v<TStorage, SolDictionary>) {
+                // entry order does not take part in equality, so each entry is
+                // digested on its own and the digests are fed in sorted
+                std::vector<utils::Sha256::Digest> entries;
+                entries.reserve(v.size());
+                for (auto& [key, val] : v.entries()) {
+                    utils::Sha256 entry;
+                    DigestSolValue(entry, key);
+                    DigestSolValue(entry, val);
+                    entries.push_back(entry.finish());
+                }
+                std::sort(entries.begin(), entries.end());
+
+                DigestSize(sha, v.weakkeys ? 1 : 0);
+                DigestSize(sha, entries.size());
+                for (auto& entry : entries) {
+                    sha.update(entry.data(), entry.size());
+                }
+            }
+            else {
+                static_assert(detail::DependentFalse<TStorage>, "SolValueDigest does not handle this storage");
+            }
+        });
     }
 
-    template <typename T>
-    std::enable_if_t<std::is_integral_v<T>, T> ReadBigEndian(uint8_t* data, int size, int& index)
+    // U29 header of an inline AMF3 value: the length with the low bit set
+    sol::SolInteger InlineHeader(size_t len, const char* what)
     {
-        if (index + sizeof(T) > size) {
-            throw std::runtime_error(utils::FormatString(
-                "File ended improperly on reading %c%d", std::is_unsigned_v<T> ? 'u' : 'i', sizeof(T) * 8));
-        }
-        else {
-            T result = utils::FromBigEndian(*reinterpret_cast<T*>(data + index));
-            index += sizeof(T);
-            return result;
+        if (len > sol::codec::AMF3_INLINE_MAXLEN) {
+            ThrowTooLong(what, len);
         }
+        return static_cast<sol::SolInteger>(len << 1 | 1);
     }
 
-    template <typename T>
-    std::enable_if_t<std::is_integral_v<T>, void> WriteBigEndian(std::vector<uint8_t>& buffer, T value)
+    const sol::SolReadOptions DEFAULT_READ_OPTIONS{};
+
+    // runs a non-throwing decoder for the throwing public readers
+    template <typename TDecode>
+    void DecodeOrThrow(const uint8_t* data, size_t size, size_t& index, const sol::SolReadOptions& options, TDecode&& decode)
     {
-        T tmp = utils::ToBigEndian(value);
-        buffer.insert(buffer.end(), reinterpret_cast<uint8_t*>(&tmp), reinterpret_cast<uint8_t*>(&tmp) + sizeof(T));
+        sol::SolError error;
+        sol::detail::Reader r{ data, size, index, error, options };
+
+        if (!decode(r)) {
+            throw std::runtime_error(error.message());
+        }
+        index = r.index;
     }
 }
 
 
-bool sol::IsKnownType(SolType type)
+void sol::detail::ThrowUnknownType(SolType type)
 {
-    switch (type)
-    {
-    case SolType::Undefined:
-    case SolType::Null:
-    case SolType::BooleanFalse:
-    case SolType::BooleanTrue:
-    case SolType::Integer:
-    case SolType::Double:
-    case SolType::String:
-    case SolType::XmlDoc:
-    case SolType::Date:
-    case SolType::Array:
-    case SolType::Object:
-    case SolType::Xml:
-    case SolType::Binary:
-        return true;
-    default:
-        return false;
-    }
+    throw std::runtime_error(utils::FormatString(
+        "Unknown type %d", static_cast<int>(type)));
 }
 
-bool sol::ReadSolFile(SolFile& file)
+void sol::detail::ThrowUnknownType(AMF0Type type)
 {
-    try {
-        std::vector<uint8_t> filecontent = utils::ReadFile(file.path);
-
-        uint8_t* data = filecontent.data();
-        int size = (int)filecontent.size();
-        int index = 0;
+    throw std::runtime_error(utils::FormatString(
+        "Unknown AMF0 type %d", static_cast<int>(type)));
+}
 
-        if (size < 18) {
-            file.errmsg = "File too small";
-            return false;
-        }
+std::string sol::detail::GetClassDefUniqueStr(const SolClassDef& classdef)
+{
+    std::string id;
+    GetClassDefUniqueStr(classdef, id);
+    return id;
+}
 
-        if (memcmp(data, SOL_MAGIC, 2) != 0) {
-            file.errmsg = "File magic mismatch";
-            return false;
-        }
-        index += 2;
+void sol::detail::GetClassDefUniqueStr(const SolClassDef& classdef, std::string& id)
+{
+    // built for every object written, so without a stringstream
+    id.clear();
+    id.reserve(classdef.name.size() + 5 + classdef.members.size() * 8);
+    id.append(classdef.name).push_back(';');
+    id.append(classdef.dynamic ? "1;" : "0;");
+    id.append(classdef.externalizable ? "1;" : "0;");
+    for (const auto& member : classdef.members) {
+        id.append(member).push_back(';');
+    }
+}
 
-        uint32_t chunksize =
-            ReadBigEndian<uint32_t>(data, size, index);
+int sol::detail::GetRefIndex(std::map<std::string, int>& pool, int& count, const std::string& id,
+    std::vector<std::map<std::string, int>::node_type>& spare)
+{
+    auto it = pool.lower_bound(id);
+    if (it != pool.end() && it->first == id) {
+        return it->second;
+    }
 
-        if (chunksize != size - 6) {
-            file.errmsg = "Chunk size mismatch";
-            return false;
-        }
+    if (spare.empty()) {
+        pool.emplace_hint(it, id, count);
+    }
+    else {
+        auto node = std::move(spare.back());
+        spare.pop_back();
+        node.key() = id;
+        node.mapped() = count;
+        pool.insert(it, std::move(node));
+    }
+    ++count;
+    return -1;
+}
 
-        if (memcmp(data + index, SOL_CONSTANT, 10) != 0) {
-            file.errmsg = "File constant mismatch";
-            return false;
+void sol::SolWriteRefTable::clear()
+{
+    for (auto* pool : { &strpool, &classpool }) {
+        while (!pool->empty()) {
+            spare.push_back(pool->extract(pool->begin()));
         }
-        index += 10;
+    }
+    strcount = 0;
+    classcount = 0;
+    objcount = 0;
+    plan = nullptr;
+    entry = 0;
+    raw = nullptr;
+    stats = nullptr;
+    statbytes = 0;
+    statdepth = 0;
+    statcapacity = 0;
+    statsizes = nullptr;
+}
 
-        file.solname = ReadAMF0ShortString(data, size, index);
-        file.version = static_cast<SolVersion>(ReadBigEndian<uint32_t>(data, size, index));
 
-        std::string key;
-        SolRefTable reftable;
+size_t sol::SolValueHash::operator()(const SolValue& value) const
+{
+    return detail::HashSolValue<SolArray, SolObject, SolDictionary>(value, *this);
+}
 
-        switch (file.version)
-        {
-        case SolVersion::AMF0: {
-            while (index < size) {
-                key = ReadAMF0ShortString(data, size, index);
+std::array<uint8_t, 32> sol::SolValueDigest::operator()(const SolValue& value) const
+{
+    utils::Sha256 sha;
+    DigestSolValue(sha, value);
+    return sha.finish();
+}
 
-                AMF0Type type = ReadAMF0Type(data, size, index);
-                file.data[key] = ReadAMF0Value(data, size, index, reftable, type);
+bool sol::operator==(const SolValue& left, const SolValue& right)
+{
+    return left.type == right.type && left.value == right.value;
+}
 
-                if (ReadByte(data, size, index) != 0x00) {
-                    ThrowEndRequired(index, data[index - 1]);
-                }
-            }
-            return true;
-        }
+bool sol::operator==(const SolArray& left, const SolArray& right)
+{
+    return left.dense == right.dense && left.assoc == right.assoc;
+}
 
-        case SolVersion::AMF3: {
-            while (index < size) {
-                key = ReadSolString(data, size, index, reftable);
+bool sol::operator==(const SolClassDef& left, const SolClassDef& right)
+{
+    return left.dynamic == right.dynamic
+        && left.externalizable == right.externalizable
+        && left.name == right.name
+        && left.members == right.members;
+}
 
-                SolType type = ReadSolType(data, size, index);
-                file.data[key] = ReadSolValue(data, size, index, reftable, type);
+bool sol::operator==(const SolObject& left, const SolObject& right)
+{
+    return left.classdef == right.classdef && left.props == right.props;
+}
 
-                if (ReadByte(data, size, index) != 0x00) {
-                    ThrowEndRequired(index, data[index - 1]);
-                }
-            }
-            return true;
+bool sol::operator==(const SolDictionary& left, const SolDictionary& right)
+{
+    if (left.weakkeys != right.weakkeys || left.size() != right.size()) {
+        return false;
+    }
+    for (auto& [key, val] : left.entries()) {
+        auto found = right.find(key);
+        if (found == nullptr || *found != val) {
+            return false;
         }
+    }
+    return true;
+}
 
-        default: {
-            ThrowUnsupportedVersion(file.version);
-        }
+const sol::SolValue* sol::SolDictionary::find(const SolValue& key) const
+{
+    auto range = _index.equal_range(SolValueHash()(key));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (SameKey(_entries[it->second].first, key)) {
+            return &_entries[it->second].second;
         }
     }
-    catch (const std::exception& e) {
-        file.errmsg = e.what();
-        return false;
-    }
+    return nullptr;
 }
 
-sol::SolType sol::ReadSolType(uint8_t* data, int size, int& index)
+sol::SolValue* sol::SolDictionary::find(const SolValue& key)
 {
-    return index >= size
-        ? throw std::runtime_error("File ended improperly, type expected")
-        : static_cast<SolType>(data[index++]);
+    return const_cast<SolValue*>(static_cast<const SolDictionary*>(this)->find(key));
 }
 
-sol::SolInteger sol::ReadSolInteger(uint8_t* data, int size, int& index, bool unsign)
+sol::SolValue& sol::SolDictionary::operator[](const SolValue& key)
 {
-    int32_t result = 0;
-
-    int i = 0;
-    for (; i < 3; ++i) {
-        if (index + i >= size) {
-            ThrowFileEndedImproperlyOnReadingType(SolType::Integer);
+    size_t hash = SolValueHash()(key);
+    auto range = _index.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (SameKey(_entries[it->second].first, key)) {
+            return _entries[it->second].second;
         }
-        result = result << 7 | (data[index + i] & 0x7F);
-        if (!(data[index + i] & 0x80)) break;
     }
+    _index.emplace(hash, _entries.size());
+    _entries.emplace_back(key, SolValue(SolType::Undefined, nullptr));
+    return _entries.back().second;
+}
 
-    if (i == 3) {
-        if (index + i >= size) {
-            ThrowFileEndedImproperlyOnReadingType(SolType::Integer);
+bool sol::SolDictionary::erase(const SolValue& key)
+{
+    auto range = _index.equal_range(SolValueHash()(key));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (!SameKey(_entries[it->second].first, key)) {
+            continue;
         }
-        result = result << 8 | data[index + i];
-    }
-
-    if (result >= 0x10000000 && !unsign) {
-        result -= 0x20000000;
+        size_t pos = it->second;
+        size_t last = _entries.size() - 1;
+        _index.erase(it);
+
+        // the last entry moves into the gap, and only its index entry has to follow
+        if (pos != last) {
+            auto moved = _index.equal_range(SolValueHash()(_entries[last].first));
+            for (auto m = moved.first; m != moved.second; ++m) {
+                if (m->second == last) {
+                    m->second = pos;
+                    break;
+                }
+            }
+            _entries[pos] = std::move(_entries[last]);
+        }
+        _entries.pop_back();
+        return true;
     }
+    return false;
+}
 
-    index += i + 1;
-    return result;
+void sol::SolDictionary::reserve(size_t count)
+{
+    _entries.reserve(count);
+    _index.reserve(count);
 }
 
-sol::SolDouble sol::ReadSolDouble(uint8_t* data, int size, int& index)
+void sol::SolDictionary::clear()
 {
-    if (index + 8 > size) {
-        ThrowFileEndedImproperlyOnReadingType(SolType::Double);
-    }
-    uint64_t tmp = ReadBigEndian<uint64_t>(data, size, index);
-    return *reinterpret_cast<double*>(&tmp);
+    _entries.clear();
+    _index.clear();
 }
 
-sol::SolString sol::ReadSolString(uint8_t* data, int size, int& index, SolRefTable& reftable)
+std::string sol::SolError::message() const
 {
-    int ref = ReadSolInteger(data, size, index, true);
+    const char* kind = amf0 ? "AMF0 type" : "type";
 
-    if ((ref & 1) == 0) {
-        CheckRefIndex(reftable.strpool, ref >> 1);
-        return reftable.strpool[ref >> 1];
-    }
+    switch (code)
+    {
+    case SolErrorCode::None:
+        return std::string();
 
-    int len = ref >> 1;
+    case SolErrorCode::IOFailed:
+        return "Failed to read file";
 
-    if (index + len > size) {
-        ThrowFileEndedImproperlyOnReadingType(SolType::String);
-    }
+    case SolErrorCode::FileTooSmall:
+        return "File too small";
 
-    if (len == 0) {
-        return std::string();
-    }
+    case SolErrorCode::MagicMismatch:
+        return "File magic mismatch";
 
-    std::string result(data + index, data + index + len);
-    index += len;
+    case SolErrorCode::ChunkSizeMismatch:
+        return "Chunk size mismatch";
 
-    reftable.strpool.push_back(result);
-    return result;
-}
+    case SolErrorCode::ConstantMismatch:
+        return "File constant mismatch";
 
-sol::SolValue sol::ReadSolXml(uint8_t* data, int size, int& index, SolRefTable& reftable, SolType xmltype)
-{
-    int ref = ReadSolInteger(data, size, index, true);
+    case SolErrorCode::UnsupportedVersion:
+        return utils::FormatString("Unsupported version: %lld", static_cast<long long>(read));
 
-    if ((ref & 1) == 0) {
-        CheckRefIndex(reftable.objpool, ref >> 1);
-        return reftable.objpool[ref >> 1];
-    }
+    case SolErrorCode::EndedImproperly:
+        return type < 0
+            ? utils::FormatString("File ended improperly at index %zu", offset)
+            : utils::FormatString("File ended improperly on reading %s %d at index %zu", kind, type, offset);
 
-    int len = ref >> 1;
+    case SolErrorCode::UnknownType:
+        return utils::FormatString("Unknown %s %d at index %zu", kind, type, offset);
 
-    if (index + len > size) {
-        ThrowFileEndedImproperlyOnReadingType(xmltype);
-    }
+    case SolErrorCode::UnsupportedType:
+        return utils::FormatString("Unsupported %s %d at index %zu", kind, type, offset);
 
-    SolValue result(xmltype, std::string(data + index, data + index + len));
-    index += len;
+    case SolErrorCode::BadFormat:
+        return utils::FormatString("Bad format of %s %d at index %zu: read %lld, desire %lld",
+            kind, type, offset, static_cast<long long>(read), static_cast<long long>(desire));
 
-    reftable.objpool.push_back(result);
-    return result;
-}
+    case SolErrorCode::EndRequired:
+        return utils::FormatString("End required at index %zu: read %lld, desire %lld",
+            offset, static_cast<long long>(read), static_cast<long long>(desire));
 
-sol::SolBinary sol::ReadSolBinary(uint8_t* data, int size, int& index, SolRefTable& reftable)
-{
-    int ref = ReadSolInteger(data, size, index, true);
+    case SolErrorCode::BadReference:
+        return utils::FormatString("Reference index %lld not found at index %zu", static_cast<long long>(read), offset);
 
-    if ((ref & 1) == 0) {
-        CheckRefIndex(reftable.objpool, ref >> 1);
-        return reftable.objpool[ref >> 1].get<SolBinary>();
-    }
+    case SolErrorCode::MaxDepthExceeded:
+        return utils::FormatString("Max depth %lld exceeded at index %zu", static_cast<long long>(desire), offset);
 
-    int len = ref >> 1;
+    case SolErrorCode::Externalizable:
+        return "Externalizable class is not supported";
 
-    if (index + len > size) {
-        ThrowFileEndedImproperlyOnReadingType(SolType::Binary);
-    }
+    case SolErrorCode::CountTooLarge:
+        return utils::FormatString("Count %lld of %s %d exceeds the remaining input at index %zu",
+            static_cast<long long>(read), kind, type, offset);
 
-    std::vector<uint8_t> result(data + index, data + index + len);
-    index += len;
+    case SolErrorCode::StringTooLong:
+        return utils::FormatString("Length %lld of %s %d exceeds the limit %lld at index %zu",
+            static_cast<long long>(read), kind, type, static_cast<long long>(desire), offset);
 
-    reftable.objpool.push_back(result);
-    return result;
+    case SolErrorCode::TooManyNodes:
+        return utils::FormatString("Node limit %lld exceeded at index %zu", static_cast<long long>(desire), offset);
+
+    case SolErrorCode::TooManyBytes:
+        return utils::FormatString("Allocation limit %lld bytes exceeded at index %zu", static_cast<long long>(desire), offset);
+
+    case SolErrorCode::TooManyClasses:
+        return utils::FormatString("Class limit %lld exceeded at index %zu", static_cast<long long>(desire), offset);
+
+    case SolErrorCode::TypeMismatch:
+        return utils::FormatString("Unexpected %s %d for the bound field at index %zu", kind, type, offset);
+
+    default:
+        return utils::FormatString("Unknown error %d", static_cast<int>(code));
+    }
 }
 
-sol::SolValue sol::ReadSolDate(uint8_t* data, int size, int& index, SolRefTable& reftable)
+bool sol::TryReadSolFile(SolFile& file, SolError& error, const SolReadOptions& options)
 {
-    int ref = ReadSolInteger(data, size, index, true);
+    SOL_TRACE_SCOPE("read sol file");
+    error = SolError();
 
-    if ((ref & 1) == 0) {
-        CheckRefIndex(reftable.objpool, ref >> 1);
-        return reftable.objpool[ref >> 1];
+    utils::MappedFile filecontent;
+    bool opened;
+    {
+        SOL_TRACE_SCOPE("read file");
+        detail::StatTimer timer(options.stats, &SolStats::iotime);
+        opened = filecontent.open(file.path);
+    }
+    if (!opened) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
     }
 
-    SolValue result(SolType::Date, ReadSolDouble(data, size, index));
-    reftable.objpool.push_back(result);
-    return result;
+    return TryReadSolData(filecontent.data(), filecontent.size(), file, error, options);
 }
 
-sol::SolArray sol::ReadSolArray(uint8_t* data, int size, int& index, SolRefTable& reftable)
+bool sol::TryReadSolData(const uint8_t* data, size_t size, SolFile& file, SolError& error, const SolReadOptions& options)
 {
-    int ref = ReadSolInteger(data, size, index, true);
+    error = SolError();
 
-    if ((ref & 1) == 0) {
-        CheckRefIndex(reftable.objpool, ref >> 1);
-        return reftable.objpool[ref >> 1].get<SolArray>();
+    SOL_TRACE_SCOPE("decode file");
+    detail::StatTimer timer(options.stats, &SolStats::decodetime);
+    SolRefTable reftable;
+    detail::Reader r{ data, size, 0, error, options };
+    return detail::DecodeSolFile(r, file, reftable);
+}
+
+bool sol::ReadSolFile(SolFile& file, const SolReadOptions& options)
+{
+    try {
+        SolError error;
+        if (TryReadSolFile(file, error, options)) {
+            return true;
+        }
+        file.errmsg = error.message();
+        return false;
     }
+    catch (const std::exception& e) {
+        file.errmsg = e.what();
+        return false;
+    }
+}
 
-    int len = ref >> 1;
+sol::SolReadOptions sol::SolReadOptions::Untrusted()
+{
+    SolReadOptions options;
+    options.maxdepth = 256;
+    options.maxnodes = 4 * 1024 * 1024;
+    options.maxbytes = 256 * 1024 * 1024;
+    options.maxstring = 64 * 1024 * 1024;
+    options.maxclasses = 4096;
+    return options;
+}
 
-    SolArray result;
-    result.dense.reserve(len);
+sol::SolType sol::ReadSolType(const uint8_t* data, size_t size, size_t& index)
+{
+    return index >= size
+        ? throw std::runtime_error("File ended improperly, type expected")
+        : static_cast<SolType>(data[index++]);
+}
 
-    std::string name;
-    while (!(name = ReadSolString(data, size, index, reftable)).empty()) {
-        SolType type = ReadSolType(data, size, index);
-        result.assoc[name] = ReadSolValue(data, size, index, reftable, type);
-    }
+sol::SolInteger sol::ReadSolInteger(const uint8_t* data, size_t size, size_t& index, bool unsign)
+{
+    SolInteger result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeInteger(r, result, unsign); });
+    return result;
+}
 
-    for (int i = 0; i < len; ++i) {
-        SolType type = ReadSolType(data, size, index);
-        result.dense.push_back(ReadSolValue(data, size, index, reftable, type));
-    }
+sol::SolDouble sol::ReadSolDouble(const uint8_t* data, size_t size, size_t& index)
+{
+    SolDouble result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeDouble(r, result, SolType::Double); });
+    return result;
+}
 
-    reftable.objpool.push_back(result);
+sol::SolString sol::ReadSolString(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
+{
+    SolString result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeString(r, reftable, result); });
     return result;
 }
 
-sol::SolObject sol::ReadSolObject(uint8_t* data, int size, int& index, SolRefTable& reftable)
+sol::SolValue sol::ReadSolXml(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable, SolType xmltype)
 {
-    int ref = ReadSolInteger(data, size, index, true);
+    SolValue result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeXml(r, reftable, xmltype, result); });
+    return result;
+}
 
-    if ((ref & 1) == 0) {
-        CheckRefIndex(reftable.objpool, ref >> 1);
-        return reftable.objpool[ref >> 1].get<SolObject>();
-    }
+sol::SolBinary sol::ReadSolBinary(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
+{
+    SolValue result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeBinary(r, reftable, result); });
+    return std::move(result.get<SolBinary>());
+}
 
-    SolObject result;
-    int classref = ref >> 1;
+sol::SolValue sol::ReadSolDate(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
+{
+    SolValue result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeDate(r, reftable, result); });
+    return result;
+}
 
-    if ((classref & 1) == 0) {
-        int classindex = classref >> 1;
-        CheckRefIndex(reftable.classpool, classindex);
-        result.classdef = reftable.classpool[classindex];
-    }
-    else {
-        result.classdef.externalizable = (classref >> 1) & 1;
-        result.classdef.dynamic = (classref >> 2) & 1;
+sol::SolArray sol::ReadSolArray(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
+{
+    return std::move(ReadSolValue(data, size, index, reftable, SolType::Array).get<SolArray>());
+}
 
-        int membernum = classref >> 3;
-        result.classdef.members.reserve(membernum);
+sol::SolObject sol::ReadSolObject(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
+{
+    return std::move(ReadSolValue(data, size, index, reftable, SolType::Object).get<SolObject>());
+}
 
-        if (result.classdef.externalizable) {
-            throw std::runtime_error("Externalizable class is not supported");
-        }
+sol::SolDictionary sol::ReadSolDictionary(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
+{
+    return std::move(ReadSolValue(data, size, index, reftable, SolType::Dictionary).get<SolDictionary>());
+}
 
-        result.classdef.name = ReadSolString(data, size, index, reftable);
+sol::SolValue sol::ReadSolValue(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable, SolType type, const SolReadOptions& options)
+{
+    SolValue result;
+    DecodeOrThrow(data, size, index, options,
+        [&](detail::Reader& r) { return DecodeValue(r, reftable, type, result); });
+    return result;
+}
 
-        for (int i = 0; i < membernum; ++i) {
-            result.classdef.members.push_back(ReadSolString(data, size, index, reftable));
-        }
+void sol::detail::WriteSolEntry(std::vector<uint8_t>& buffer, SolVersion version, const std::string& key, const SolValue& value, SolWriteRefTable& reftable)
+{
+    SOL_TRACE_SPAN(span, "encode entry");
+    SOL_TRACE_NOTE(span, key);
 
-        reftable.classpool.push_back(result.classdef);
+    switch (version)
+    {
+    case SolVersion::AMF0: {
+        // key
+        WriteAMF0ShortString(buffer, key);
+        // value
+        AMF0Type type = GetAMF0Type(value);
+        WriteAMF0Type(buffer, type);
+        WriteAMF0Value(buffer, value, type, reftable);
+        break;
     }
 
-    for (auto& member : result.classdef.members) {
-        SolType type = ReadSolType(data, size, index);
-        result.props[member] = ReadSolValue(data, size, index, reftable, type);
+    case SolVersion::AMF3: {
+        // key
+        WriteSolString(buffer, key, reftable);
+        // value
+        WriteSolType(buffer, value.type);
+        WriteSolValue(buffer, value, reftable);
+        break;
     }
 
-    if (result.classdef.dynamic) {
-        std::string key;
-        while (!(key = ReadSolString(data, size, index, reftable)).empty()) {
-            SolType type = ReadSolType(data, size, index);
-            result.props[key] = ReadSolValue(data, size, index, reftable, type);
-        }
+    default: {
+        ThrowUnsupportedVersion(version);
+    }
     }
 
-    reftable.objpool.push_back(result);
-    return result;
+    // end
+    buffer.push_back(0x00);
 }
 
-sol::SolValue sol::ReadSolValue(uint8_t* data, int size, int& index, SolRefTable& reftable, SolType type)
+void sol::detail::WriteSolHeader(std::vector<uint8_t>& buffer, const std::string& solname, SolVersion version)
 {
-    switch (type)
-    {
-    case SolType::Undefined:
-        return SolValue(SolType::Undefined, nullptr);
-
-    case SolType::Null:
-        return nullptr;
-
-    case SolType::BooleanFalse:
-        return false;
-
-    case SolType::BooleanTrue:
-        return true;
-
-    case SolType::Integer:
-        return ReadSolInteger(data, size, index);
-
-    case SolType::Double:
-        return ReadSolDouble(data, size, index);
-
-    case SolType::String:
-        return ReadSolString(data, size, index, reftable);
-
-    case SolType::XmlDoc:
-        return ReadSolXml(data, size, index, reftable, sol::SolType::XmlDoc);
+    if (version != SolVersion::AMF0 && version != SolVersion::AMF3) {
+        ThrowUnsupportedVersion(version);
+    }
 
-    case SolType::Date:
-        return ReadSolDate(data, size, index, reftable);
+    buffer.reserve(1024 * 100); // 100 KB
 
-    case SolType::Array:
-        return ReadSolArray(data, size, index, reftable);
+    // magic
+    buffer.insert(buffer.end(), std::begin(codec::SOL_MAGIC), std::end(codec::SOL_MAGIC));
 
-    case SolType::Object:
-        return ReadSolObject(data, size, index, reftable);
+    // chunk size, to be filled later
+    buffer.insert(buffer.end(), 4, 0);
 
-    case SolType::Xml:
-        return ReadSolXml(data, size, index, reftable, SolType::Xml);
+    // constant
+    buffer.insert(buffer.end(), std::begin(codec::SOL_CONSTANT), std::end(codec::SOL_CONSTANT));
 
-    case SolType::Binary:
-        return ReadSolBinary(data, size, index, reftable);
+    // sol name
+    WriteAMF0ShortString(buffer, solname);
 
-    default:
-        ThrowUnknownType(type, index - 1);
-    }
+    // version
+    codec::AppendBigEndian(buffer, (uint32_t)version);
 }
 
-bool sol::WriteSolFile(SolFile& file)
+void sol::detail::FinishSolFile(std::vector<uint8_t>& buffer, const std::string& path)
 {
-    try {
-        std::vector<uint8_t> buffer;
-        buffer.reserve(1024 * 100); // 100 KB
-
-        // magic
-        buffer.insert(buffer.end(), std::begin(SOL_MAGIC), std::end(SOL_MAGIC));
-
-        // chunk size, to be filled later
-        buffer.insert(buffer.end(), 4, 0);
+    // fill chunk size
+    if (buffer.size() - 6 > UINT32_MAX) {
+        ThrowTooLong("File", buffer.size());
+    }
+    codec::StoreBigEndian(buffer.data() + 2, (uint32_t)(buffer.size() - 6));
 
-        // constant
-        buffer.insert(buffer.end(), std::begin(SOL_CONSTANT), std::end(SOL_CONSTANT));
+    // write to file
+    utils::WriteFile(path, buffer);
+}
 
-        // sol name
-        WriteAMF0ShortString(buffer, file.solname);
+void sol::detail::WriteSolFile(std::vector<uint8_t>& buffer, SolWriteRefTable& reftable, const SolFile& file, const SolWriteOptions& options)
+{
+    SolStats* stats = options.stats;
+    size_t spare = reftable.spare.size();
 
-        // version
-        WriteBigEndian(buffer, (uint32_t)file.version);
+    {
+        SOL_TRACE_SCOPE("encode file");
+        StatTimer timer(stats, &SolStats::encodetime);
+        reftable.stats = stats;
+        reftable.statcapacity = buffer.capacity();
 
-        // ref table
-        SolWriteRefTable reftable;
+        WriteSolHeader(buffer, file.solname, file.version);
 
-        // encode data
-        switch (file.version)
+        // entries read with keepraw are written in the order they were read, those
+        // left unchanged copied instead of encoded
+        std::unordered_set<const SolValue*> written;
         {
-        case SolVersion::AMF0: {
-            for (auto& [key, value] : file.data) {
-                // key
-                WriteAMF0ShortString(buffer, key);
-                // value
-                AMF0Type type = GetAMF0Type(value);
-                WriteAMF0Type(buffer, type);
-                WriteAMF0Value(buffer, value, type, reftable);
-                // end
-                buffer.push_back(0x00);
-            }
-            break;
+            SOL_TRACE_SCOPE("write raw entries");
+            written = WriteRawEntries(buffer, file, reftable);
         }
 
-        case SolVersion::AMF3: {
+        // encode data
+        if (options.threads != 1) {
+            WriteSolEntriesParallel(buffer, file, written, reftable, options.threads);
+        }
+        else {
             for (auto& [key, value] : file.data) {
-                // key
-                WriteSolString(buffer, key, reftable);
-                // value
-                WriteSolType(buffer, value.type);
-                WriteSolValue(buffer, value, reftable);
-                // end
-                buffer.push_back(0x00);
+                if (!written.count(&value)) {
+                    WriteSolEntry(buffer, file.version, key, value, reftable);
+                }
             }
-            break;
         }
+    }
 
-        default: {
-            ThrowUnsupportedVersion(file.version);
-        }
-        }
+    if (stats) {
+        // the table nodes that were not taken from spare, and the header reserve
+        stats->version = file.version;
+        stats->bytes += buffer.size();
+        stats->allocations += reftable.strpool.size() + reftable.classpool.size() - (spare - reftable.spare.size());
+        stats->allocations += buffer.capacity() != reftable.statcapacity ? 1 : 0;
+    }
 
-        // fill chunk size
-        uint32_t chunksize = utils::ToBigEndian((uint32_t)buffer.size() - 6);
-        std::copy_n(reinterpret_cast<uint8_t*>(&chunksize), 4, buffer.begin() + 2);
+    SOL_TRACE_SCOPE("write file");
+    StatTimer timer(stats, &SolStats::iotime);
+    FinishSolFile(buffer, file.path);
+}
 
-        // write to file
-        utils::WriteFile(file.path, buffer);
+bool sol::WriteSolFile(SolFile& file, const SolWriteOptions& options)
+{
+    SOL_TRACE_SCOPE("write sol file");
+    try {
+        std::vector<uint8_t> buffer;
+        SolWriteRefTable reftable;
+        detail::WriteSolFile(buffer, reftable, file, options);
         return true;
     }
     catch (const std::exception& e) {
@@ -593,30 +725,12 @@ void sol::WriteSolInteger(std::vector<uint8_t>& buffer, SolInteger value, bool u
         value += 0x20000000;
     }
 
-    if (value < 0x80) {
-        buffer.push_back(value);
-    }
-    else if (value < 0x4000) {
-        buffer.push_back((value >> 7) | 0x80);
-        buffer.push_back(value & 0x7F);
-    }
-    else if (value < 0x200000) {
-        buffer.push_back((value >> 14) | 0x80);
-        buffer.push_back((value >> 7) | 0x80);
-        buffer.push_back(value & 0x7F);
-    }
-    else {
-        buffer.push_back((value >> 22) | 0x80);
-        buffer.push_back((value >> 15) | 0x80);
-        buffer.push_back((value >> 8) | 0x80);
-        buffer.push_back(value & 0xFF);
-    }
+    codec::AppendU29(buffer, static_cast<uint32_t>(value));
 }
 
 void sol::WriteSolDouble(std::vector<uint8_t>& buffer, SolDouble value)
 {
-    uint64_t tmp = utils::ToBigEndian(*reinterpret_cast<uint64_t*>(&value));
-    buffer.insert(buffer.end(), reinterpret_cast<uint8_t*>(&tmp), reinterpret_cast<uint8_t*>(&tmp) + 8);
+    codec::AppendDouble(buffer, value);
 }
 
 void sol::WriteSolString(std::vector<uint8_t>& buffer, const SolString& value, SolWriteRefTable& reftable)
@@ -626,42 +740,45 @@ void sol::WriteSolString(std::vector<uint8_t>& buffer, const SolString& value, S
         return;
     }
 
-    int ref = GetRefIndex(reftable.strpool, value);
+    int ref = reftable.plan ? detail::GetPlannedRef(reftable.plan->strings, value, reftable.entry) : -1;
 
+    if (ref < 0) {
+        ref = detail::GetRefIndex(reftable.strpool, reftable.strcount, value, reftable.spare);
+    }
     if (ref >= 0) {
+        if (reftable.stats) {
+            ++reftable.stats->strrefs;
+        }
         WriteSolInteger(buffer, ref << 1, true);
         return;
     }
 
-    int len = (int)value.size();
-    WriteSolInteger(buffer, (len << 1) | 1, true);
-    buffer.insert(buffer.end(), value.begin(), value.end());
+    codec::AppendU29Bytes(buffer, InlineHeader(value.size(), "String"), value.data(), value.size());
 }
 
-void sol::WriteSolXml(std::vector<uint8_t>& buffer, const SolString& value, SolWriteRefTable& reftable, SolType xmltype)
+void sol::WriteSolXml(std::vector<uint8_t>& buffer, const SolString& value, SolWriteRefTable& reftable, SolType /*xmltype*/)
 {
-    int len = (int)value.size();
-    WriteSolInteger(buffer, (len << 1) | 1, true);
-    buffer.insert(buffer.end(), value.begin(), value.end());
+    ++reftable.objcount;
+    codec::AppendU29Bytes(buffer, InlineHeader(value.size(), "Xml"), value.data(), value.size());
 }
 
 void sol::WriteSolBinary(std::vector<uint8_t>& buffer, const SolBinary& value, SolWriteRefTable& reftable)
 {
-    int len = (int)value.size();
-    WriteSolInteger(buffer, (len << 1) | 1, true);
-    buffer.insert(buffer.end(), value.begin(), value.end());
+    ++reftable.objcount;
+    codec::AppendU29Bytes(buffer, InlineHeader(value.size(), "Binary"), value.data(), value.size());
 }
 
 void sol::WriteSolDate(std::vector<uint8_t>& buffer, SolDouble value, SolWriteRefTable& reftable)
 {
+    ++reftable.objcount;
     WriteSolInteger(buffer, 1, true);
     WriteSolDouble(buffer, value);
 }
 
 void sol::WriteSolArray(std::vector<uint8_t>& buffer, const SolArray& value, SolWriteRefTable& reftable)
 {
-    int len = (int)value.dense.size();
-    WriteSolInteger(buffer, (len << 1) | 1, true);
+    ++reftable.objcount;
+    WriteSolInteger(buffer, InlineHeader(value.dense.size(), "Array"), true);
 
     for (auto& [key, val] : value.assoc) {
         WriteSolString(buffer, key, reftable);
@@ -677,356 +794,252 @@ void sol::WriteSolArray(std::vector<uint8_t>& buffer, const SolArray& value, Sol
     }
 }
 
-void sol::WriteSolObject(std::vector<uint8_t>& buffer, const SolObject& value, SolWriteRefTable& reftable)
+void sol::WriteSolTraits(std::vector<uint8_t>& buffer, const SolClassDef& classdef, SolWriteRefTable& reftable)
 {
-    if (value.classdef.externalizable) {
+    if (classdef.externalizable) {
         throw std::runtime_error("Externalizable class is not supported");
     }
 
-    auto classid = GetClassDefUniqueStr(value.classdef);
-    int classindex = GetRefIndex(reftable.classpool, classid);
+    detail::GetClassDefUniqueStr(classdef, reftable.classid);
+    int classindex = reftable.plan ? detail::GetPlannedRef(reftable.plan->classes, reftable.classid, reftable.entry) : -1;
+
+    if (classindex < 0) {
+        classindex = detail::GetRefIndex(reftable.classpool, reftable.classcount, reftable.classid, reftable.spare);
+    }
 
     if (classindex >= 0) {
+        if (reftable.stats) {
+            ++reftable.stats->classrefs;
+        }
         int classref = classindex << 1;
         WriteSolInteger(buffer, (classref << 1) | 1, true);
     }
     else {
-        int classref = (int)value.classdef.members.size();
-        classref = (classref << 1) | !!(int)value.classdef.dynamic;
-        classref = (classref << 1) | !!(int)value.classdef.externalizable;
+        int classref = (int)classdef.members.size();
+        classref = (classref << 1) | !!(int)classdef.dynamic;
+        classref = (classref << 1) | !!(int)classdef.externalizable;
         classref = (classref << 1) | 1;
 
         WriteSolInteger(buffer, (classref << 1) | 1, true);
-        WriteSolString(buffer, value.classdef.name, reftable);
+        WriteSolString(buffer, classdef.name, reftable);
 
-        for (auto& member : value.classdef.members) {
+        for (auto& member : classdef.members) {
             WriteSolString(buffer, member, reftable);
         }
     }
+}
 
-    std::map<std::string, const SolValue*> members;
-    std::map<std::string, const SolValue*> dynamicprops;
+void sol::WriteSolObject(std::vector<uint8_t>& buffer, const SolObject& value, SolWriteRefTable& reftable)
+{
+    auto& members = value.classdef.members;
 
-    for (auto& member : value.classdef.members) {
-        members[member] = value.props.count(member) ? &value.props.at(member) : nullptr;
-    }
-    for (auto& [key, val] : value.props) {
-        if (!members.count(key)) {
-            dynamicprops[key] = &val;
+    // a sealed object has no place for a property its traits do not name
+    if (!value.classdef.dynamic && value.props.size() > members.size()) {
+        for (auto& [key, val] : value.props) {
+            if (std::find(members.begin(), members.end(), key) == members.end()) {
+                ThrowNotMember(value.classdef, key);
+            }
         }
     }
 
-    for (auto& [member, val] : members) {
-        WriteSolType(buffer, val ? val->type : SolType::Undefined);
-        WriteSolValue(buffer, val ? *val : SolValue(SolType::Undefined, nullptr), reftable);
+    ++reftable.objcount;
+    WriteSolTraits(buffer, value.classdef, reftable);
+
+    // sealed values go in the order of the traits, the reader pairs them by position
+    for (auto& member : members) {
+        auto it = value.props.find(member);
+        if (it == value.props.end()) {
+            ThrowMissingMember(value.classdef, member);
+        }
+        WriteSolType(buffer, it->second.type);
+        WriteSolValue(buffer, it->second, reftable);
     }
     if (value.classdef.dynamic) {
-        for (auto& [key, val] : dynamicprops) {
-            WriteSolString(buffer, key, reftable);
-            WriteSolType(buffer, val->type);
-            WriteSolValue(buffer, *val, reftable);
+        for (auto& [key, val] : value.props) {
+            if (std::find(members.begin(), members.end(), key) == members.end()) {
+                WriteSolString(buffer, key, reftable);
+                WriteSolType(buffer, val.type);
+                WriteSolValue(buffer, val, reftable);
+            }
         }
-    }
 
-    WriteSolString(buffer, std::string(), reftable);
+        // only dynamic properties end with an empty key
+        WriteSolString(buffer, std::string(), reftable);
+    }
 }
 
-void sol::WriteSolValue(std::vector<uint8_t>& buffer, const SolValue& value, SolWriteRefTable& reftable)
+void sol::WriteSolDictionary(std::vector<uint8_t>& buffer, const SolDictionary& value, SolWriteRefTable& reftable)
 {
-    switch (value.type)
-    {
-    case SolType::Undefined:
-    case SolType::Null:
-    case SolType::BooleanFalse:
-    case SolType::BooleanTrue:
-        // nothing to write
-        break;
-
-    case SolType::Integer:
-        WriteSolInteger(buffer, value.get<SolInteger>());
-        break;
-
-    case SolType::Double:
-        WriteSolDouble(buffer, value.get<SolDouble>());
-        break;
-
-    case SolType::String:
-        WriteSolString(buffer, value.get<SolString>(), reftable);
-        break;
-
-    case SolType::XmlDoc:
-    case SolType::Xml:
-        WriteSolXml(buffer, value.get<SolString>(), reftable, value.type);
-        break;
-
-    case SolType::Date:
-        WriteSolDate(buffer, value.get<SolDouble>(), reftable);
-        break;
-
-    case SolType::Array:
-        WriteSolArray(buffer, value.get<SolArray>(), reftable);
-        break;
-
-    case SolType::Object:
-        WriteSolObject(buffer, value.get<SolObject>(), reftable);
-        break;
-
-    case SolType::Binary:
-        WriteSolBinary(buffer, value.get<SolBinary>(), reftable);
-        break;
+    ++reftable.objcount;
+    WriteSolInteger(buffer, InlineHeader(value.size(), "Dictionary"), true);
+    buffer.push_back(value.weakkeys ? 0x01 : 0x00);
 
-    default:
-        ThrowUnknownType(value.type);
+    for (auto& [key, val] : value.entries()) {
+        WriteSolType(buffer, key.type);
+        WriteSolValue(buffer, key, reftable);
+        WriteSolType(buffer, val.type);
+        WriteSolValue(buffer, val, reftable);
     }
 }
 
-sol::AMF0Type sol::GetAMF0Type(const SolValue& value)
+void sol::WriteSolValue(std::vector<uint8_t>& buffer, const SolValue& value, SolWriteRefTable& reftable)
 {
-    switch (value.type)
-    {
-    case SolType::Undefined:
-        return AMF0Type::Undefined;
-
-    case SolType::Null:
-        return AMF0Type::Null;
-
-    case SolType::BooleanFalse:
-    case SolType::BooleanTrue:
-        return AMF0Type::Boolean;
-
-    case SolType::Integer:
-    case SolType::Double:
-        return AMF0Type::Number;
-
-    case SolType::String:
-        return value.get<SolString>().size() > AMF0_SHORTSTRING_MAXLEN
-            ? AMF0Type::LongString : AMF0Type::String;
-
-    case SolType::XmlDoc:
-    case SolType::Xml:
-        return AMF0Type::XMLDoc;
+    detail::WriteStatScope scope(buffer, reftable, static_cast<uint8_t>(value.type), value);
+    detail::RawSubtreeScope raw(buffer, reftable, static_cast<uint8_t>(value.type), value);
+    if (raw.copied()) {
+        return;
+    }
 
-    case SolType::Date:
-        return AMF0Type::Date;
+    VisitSolValue(value, [&](auto def, auto& v) {
+        constexpr SolType type = decltype(def)::type;
 
-    case SolType::Array:
-        return value.get<SolArray>().assoc.empty()
-            ? AMF0Type::StrictArray : AMF0Type::EcmaArray;
+        if constexpr (type == SolType::Undefined || type == SolType::Null
+            || type == SolType::BooleanFalse || type == SolType::BooleanTrue) {
+            // nothing to write
+        }
+        else if constexpr (type == SolType::Integer) {
+            WriteSolInteger(buffer, v);
+        }
+        else if constexpr (type == SolType::Double) {
+            WriteSolDouble(buffer, v);
+        }
+        else if constexpr (type == SolType::String) {
+            WriteSolString(buffer, v, reftable);
+        }
+        else if constexpr (type == SolType::XmlDoc || type == SolType::Xml) {
+            WriteSolXml(buffer, v, reftable, type);
+        }
+        else if constexpr (type == SolType::Date) {
+            WriteSolDate(buffer, v, reftable);
+        }
+        else if constexpr (type == SolType::Array) {
+            WriteSolArray(buffer, v, reftable);
+        }
+        else if constexpr (type == SolType::Object) {
+            WriteSolObject(buffer, v, reftable);
+        }
+        else if constexpr (type == SolType::Binary) {
+            WriteSolBinary(buffer, v, reftable);
+        }
+        else if constexpr (type == SolType::Dictionary) {
+            WriteSolDictionary(buffer, v, reftable);
+        }
+        else {
+            static_assert(detail::DependentFalse<decltype(def)>, "WriteSolValue does not handle this type");
+        }
+    });
+}
 
-    case SolType::Object:
-        return value.get<SolObject>().classdef.name.empty()
-            ? AMF0Type::Object : AMF0Type::TypedObject;
+sol::AMF0Type sol::GetAMF0Type(const SolValue& value)
+{
+    return VisitSolValue(value, [&](auto def, auto& v) -> AMF0Type {
+        using TDef = decltype(def);
 
-    default:
-        throw std::runtime_error(utils::FormatString(
-            "Unable to convert type %d to AMF0 type", static_cast<int>(value.type)));
-    }
+        if constexpr (TDef::amf0 == AMF0Type::Unsupported) {
+            throw std::runtime_error(utils::FormatString(
+                "Unable to convert type %d to AMF0 type", static_cast<int>(TDef::type)));
+        }
+        else if constexpr (TDef::amf0 == AMF0Type::String) {
+            return v.size() > codec::AMF0_SHORTSTRING_MAXLEN ? AMF0Type::LongString : AMF0Type::String;
+        }
+        else if constexpr (TDef::amf0 == AMF0Type::StrictArray) {
+            return v.assoc.empty() ? AMF0Type::StrictArray : AMF0Type::EcmaArray;
+        }
+        else if constexpr (TDef::amf0 == AMF0Type::Object) {
+            return v.classdef.name.empty() ? AMF0Type::Object : AMF0Type::TypedObject;
+        }
+        else {
+            return TDef::amf0;
+        }
+    });
 }
 
-sol::AMF0Type sol::ReadAMF0Type(uint8_t* data, int size, int& index)
+sol::AMF0Type sol::ReadAMF0Type(const uint8_t* data, size_t size, size_t& index)
 {
     return index >= size
         ? throw std::runtime_error("File ended improperly, AMF0 type expected")
         : static_cast<AMF0Type>(data[index++]);
 }
 
-sol::SolDouble sol::ReadAMF0Number(uint8_t* data, int size, int& index)
+sol::SolDouble sol::ReadAMF0Number(const uint8_t* data, size_t size, size_t& index)
 {
-    if (index + 8 > size) {
-        ThrowFileEndedImproperlyOnReadingType(AMF0Type::Number);
-    }
-    uint64_t tmp = ReadBigEndian<uint64_t>(data, size, index);
-    return *reinterpret_cast<double*>(&tmp);
+    SolDouble result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeDouble(r, result, AMF0Type::Number); });
+    return result;
 }
 
-sol::SolBoolean sol::ReadAMF0Boolean(uint8_t* data, int size, int& index)
+sol::SolBoolean sol::ReadAMF0Boolean(const uint8_t* data, size_t size, size_t& index)
 {
-    if (index >= size) {
-        ThrowFileEndedImproperlyOnReadingType(AMF0Type::Boolean);
-    }
-    return data[index++] != 0x00;
+    SolBoolean result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeAMF0Boolean(r, result); });
+    return result;
 }
 
-sol::SolString sol::ReadAMF0ShortString(uint8_t* data, int size, int& index)
+sol::SolString sol::ReadAMF0ShortString(const uint8_t* data, size_t size, size_t& index)
 {
-    uint16_t len = ReadBigEndian<uint16_t>(data, size, index);
-
-    if (index + len > size) {
-        ThrowFileEndedImproperlyOnReadingType(AMF0Type::String);
-    }
-    if (len == 0) {
-        return std::string();
-    }
-
-    std::string result(data + index, data + index + len);
-    index += len;
+    SolString result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeAMF0ShortString(r, result); });
     return result;
 }
 
-sol::SolString sol::ReadAMF0LongString(uint8_t* data, int size, int& index)
+sol::SolString sol::ReadAMF0LongString(const uint8_t* data, size_t size, size_t& index)
 {
-    int len = (int)ReadBigEndian<uint32_t>(data, size, index);
-
-    if (index + len > size) {
-        ThrowFileEndedImproperlyOnReadingType(AMF0Type::LongString);
-    }
-    if (len == 0) {
-        return std::string();
-    }
-
-    std::string result(data + index, data + index + len);
-    index += len;
+    SolString result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeAMF0LongString(r, result); });
     return result;
 }
 
-sol::SolValue sol::ReadAMF0XmlDoc(uint8_t* data, int size, int& index)
+sol::SolValue sol::ReadAMF0XmlDoc(const uint8_t* data, size_t size, size_t& index)
 {
     return SolValue(SolType::XmlDoc, ReadAMF0LongString(data, size, index));
 }
 
-sol::SolValue sol::ReadAMF0Date(uint8_t* data, int size, int& index)
+sol::SolValue sol::ReadAMF0Date(const uint8_t* data, size_t size, size_t& index)
 {
-    int16_t zone = ReadBigEndian<int16_t>(data, size, index); // unused
-    return SolValue(SolType::Date, ReadAMF0Number(data, size, index));
+    SolValue result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeAMF0Date(r, result); });
+    return result;
 }
 
-sol::SolValue sol::ReadAMF0Reference(uint8_t* data, int size, int& index, SolRefTable& reftable)
+sol::SolValue sol::ReadAMF0Reference(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
 {
-    uint16_t ref = ReadBigEndian<uint16_t>(data, size, index);
-    CheckRefIndex(reftable.objpool, ref);
-    return reftable.objpool[ref];
+    SolValue result;
+    DecodeOrThrow(data, size, index, DEFAULT_READ_OPTIONS,
+        [&](detail::Reader& r) { return DecodeAMF0Reference(r, reftable, result); });
+    return result;
 }
 
-sol::SolArray sol::ReadAMF0EcmaArray(uint8_t* data, int size, int& index, SolRefTable& reftable)
+sol::SolArray sol::ReadAMF0EcmaArray(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
 {
-    uint32_t len = ReadBigEndian<uint32_t>(data, size, index);
-
-    SolArray result;
-    std::string key;
-
-    for (uint32_t i = 0; i < len; ++i) {
-        key = ReadAMF0ShortString(data, size, index);
-        AMF0Type type = ReadAMF0Type(data, size, index);
-        result.assoc[key] = ReadAMF0Value(data, size, index, reftable, type);
-    }
-
-    for (int i = 0; i < sizeof(AMF0_OBJECT_ENDMARK); ++i) {
-        if (ReadByte(data, size, index) != AMF0_OBJECT_ENDMARK[i]) {
-            ThrowBadFormatOfType(AMF0Type::EcmaArray, index - 1, data[index - 1], AMF0_OBJECT_ENDMARK[i]);
-        }
-    }
-
-    reftable.objpool.push_back(result);
-    return result;
+    return std::move(ReadAMF0Value(data, size, index, reftable, AMF0Type::EcmaArray).get<SolArray>());
 }
 
-sol::SolArray sol::ReadAMF0StrictArray(uint8_t* data, int size, int& index, SolRefTable& reftable)
+sol::SolArray sol::ReadAMF0StrictArray(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
 {
-    uint32_t len = ReadBigEndian<uint32_t>(data, size, index);
-
-    SolArray result;
-    result.dense.reserve(len);
-
-    for (uint32_t i = 0; i < len; ++i) {
-        AMF0Type type = ReadAMF0Type(data, size, index);
-        result.dense.push_back(ReadAMF0Value(data, size, index, reftable, type));
-    }
-
-    reftable.objpool.push_back(result);
-    return result;
+    return std::move(ReadAMF0Value(data, size, index, reftable, AMF0Type::StrictArray).get<SolArray>());
 }
 
-sol::SolObject sol::ReadAMF0Object(uint8_t* data, int size, int& index, SolRefTable& reftable)
+sol::SolObject sol::ReadAMF0Object(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
 {
-    SolObject result;
-    std::string key;
-
-    while (!(key = ReadAMF0ShortString(data, size, index)).empty()) {
-        AMF0Type type = ReadAMF0Type(data, size, index);
-        result.props[key] = ReadAMF0Value(data, size, index, reftable, type);
-    }
-
-    if (ReadAMF0Type(data, size, index) != AMF0Type::ObjectEnd) {
-        ThrowBadFormatOfType(AMF0Type::Object, index - 1, data[index], (int)AMF0Type::ObjectEnd);
-    }
-
-    reftable.objpool.push_back(result);
-    return result;
+    return std::move(ReadAMF0Value(data, size, index, reftable, AMF0Type::Object).get<SolObject>());
 }
 
-sol::SolValue sol::ReadAMF0TypedObject(uint8_t* data, int size, int& index, SolRefTable& reftable)
+sol::SolValue sol::ReadAMF0TypedObject(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable)
 {
-    SolObject result;
-    std::string key;
-
-    std::string classname = ReadAMF0ShortString(data, size, index);
-    result.classdef.name = classname;
-
-    while (!(key = ReadAMF0ShortString(data, size, index)).empty()) {
-        AMF0Type type = ReadAMF0Type(data, size, index);
-        result.props[key] = ReadAMF0Value(data, size, index, reftable, type);
-    }
-
-    if (ReadAMF0Type(data, size, index) != AMF0Type::ObjectEnd) {
-        ThrowBadFormatOfType(AMF0Type::TypedObject, index - 1, data[index], static_cast<int>(AMF0Type::ObjectEnd));
-    }
-
-    reftable.objpool.push_back(result);
-    return result;
+    return ReadAMF0Value(data, size, index, reftable, AMF0Type::TypedObject);
 }
 
-sol::SolValue sol::ReadAMF0Value(uint8_t* data, int size, int& index, SolRefTable& reftable, AMF0Type type)
+sol::SolValue sol::ReadAMF0Value(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable, AMF0Type type, const SolReadOptions& options)
 {
-    switch (type)
-    {
-    case AMF0Type::Number:
-        return ReadAMF0Number(data, size, index);
-
-    case AMF0Type::Boolean:
-        return ReadAMF0Boolean(data, size, index);
-
-    case AMF0Type::String:
-        return ReadAMF0ShortString(data, size, index);
-
-    case AMF0Type::Object:
-        return ReadAMF0Object(data, size, index, reftable);
-
-    case AMF0Type::Null:
-        return nullptr;
-
-    case AMF0Type::Undefined:
-        return SolValue(SolType::Undefined, nullptr);
-
-    case AMF0Type::Reference:
-        return ReadAMF0Reference(data, size, index, reftable);
-
-    case AMF0Type::EcmaArray:
-        return ReadAMF0EcmaArray(data, size, index, reftable);
-
-    case AMF0Type::StrictArray:
-        return ReadAMF0StrictArray(data, size, index, reftable);
-
-    case AMF0Type::Date:
-        return ReadAMF0Date(data, size, index);
-
-    case AMF0Type::LongString:
-        return ReadAMF0LongString(data, size, index);
-
-    case AMF0Type::XMLDoc:
-        return ReadAMF0XmlDoc(data, size, index);
-
-    case AMF0Type::TypedObject:
-        return ReadAMF0TypedObject(data, size, index, reftable);
-
-    case AMF0Type::MovieClip:
-    case AMF0Type::ObjectEnd:
-    case AMF0Type::Unsupported:
-    case AMF0Type::Recordset:
-        ThrowUnsupportedType(type);
-
-    default:
-        ThrowUnknownType(type);
-    }
+    SolValue result;
+    DecodeOrThrow(data, size, index, options,
+        [&](detail::Reader& r) { return DecodeAMF0Value(r, reftable, type, result); });
+    return result;
 }
 
 void sol::WriteAMF0Type(std::vector<uint8_t>& buffer, AMF0Type type)
@@ -1046,17 +1059,18 @@ void sol::WriteAMF0Boolean(std::vector<uint8_t>& buffer, SolBoolean value)
 
 void sol::WriteAMF0ShortString(std::vector<uint8_t>& buffer, const SolString& value)
 {
-    if (value.size() > AMF0_SHORTSTRING_MAXLEN) {
+    if (value.size() > codec::AMF0_SHORTSTRING_MAXLEN) {
         throw std::runtime_error("String too long for AMF0 short string");
     }
-    WriteBigEndian(buffer, (uint16_t)value.size());
-    buffer.insert(buffer.end(), value.begin(), value.end());
+    codec::AppendBigEndianBytes(buffer, (uint16_t)value.size(), value.data(), value.size());
 }
 
 void sol::WriteAMF0LongString(std::vector<uint8_t>& buffer, const SolString& value)
 {
-    WriteBigEndian(buffer, (uint32_t)value.size());
-    buffer.insert(buffer.end(), value.begin(), value.end());
+    if (value.size() > codec::AMF0_LONGSTRING_MAXLEN) {
+        ThrowTooLong("AMF0 long string", value.size());
+    }
+    codec::AppendBigEndianBytes(buffer, (uint32_t)value.size(), value.data(), value.size());
 }
 
 void sol::WriteAMF0XmlDoc(std::vector<uint8_t>& buffer, const SolString& value)
@@ -1066,13 +1080,15 @@ void sol::WriteAMF0XmlDoc(std::vector<uint8_t>& buffer, const SolString& value)
 
 void sol::WriteAMF0Date(std::vector<uint8_t>& buffer, SolDouble value)
 {
-    WriteBigEndian(buffer, (int16_t)0); // timezone
-    WriteAMF0Number(buffer, value);
+    uint8_t tmp[10] = {}; // timezone, then the timestamp
+    codec::StoreDouble(tmp + 2, value);
+    buffer.insert(buffer.end(), std::begin(tmp), std::end(tmp));
 }
 
 void sol::WriteAMF0EcmaArray(std::vector<uint8_t>& buffer, const SolArray& value, SolWriteRefTable& reftable)
 {
-    WriteBigEndian(buffer, (uint32_t)value.assoc.size());
+    ++reftable.objcount;
+    codec::AppendBigEndian(buffer, (uint32_t)value.assoc.size());
 
     for (auto& [key, val] : value.assoc) {
         AMF0Type type = GetAMF0Type(val);
@@ -1081,12 +1097,13 @@ void sol::WriteAMF0EcmaArray(std::vector<uint8_t>& buffer, const SolArray& value
         WriteAMF0Value(buffer, val, type, reftable);
     }
 
-    buffer.insert(buffer.end(), std::begin(AMF0_OBJECT_ENDMARK), std::end(AMF0_OBJECT_ENDMARK));
+    buffer.insert(buffer.end(), std::begin(codec::AMF0_OBJECT_ENDMARK), std::end(codec::AMF0_OBJECT_ENDMARK));
 }
 
 void sol::WriteAMF0StrictArray(std::vector<uint8_t>& buffer, const SolArray& value, SolWriteRefTable& reftable)
 {
-    WriteBigEndian(buffer, (uint32_t)value.dense.size());
+    ++reftable.objcount;
+    codec::AppendBigEndian(buffer, (uint32_t)value.dense.size());
 
     for (auto& val : value.dense) {
         AMF0Type type = GetAMF0Type(val);
@@ -1097,6 +1114,7 @@ void sol::WriteAMF0StrictArray(std::vector<uint8_t>& buffer, const SolArray& val
 
 void sol::WriteAMF0Object(std::vector<uint8_t>& buffer, const SolObject& value, SolWriteRefTable& reftable)
 {
+    ++reftable.objcount;
     for (auto& [key, val] : value.props) {
         AMF0Type type = GetAMF0Type(val);
         WriteAMF0ShortString(buffer, key);
@@ -1104,11 +1122,12 @@ void sol::WriteAMF0Object(std::vector<uint8_t>& buffer, const SolObject& value,
         WriteAMF0Value(buffer, val, type, reftable);
     }
 
-    buffer.insert(buffer.end(), std::begin(AMF0_OBJECT_ENDMARK), std::end(AMF0_OBJECT_ENDMARK));
+    buffer.insert(buffer.end(), std::begin(codec::AMF0_OBJECT_ENDMARK), std::end(codec::AMF0_OBJECT_ENDMARK));
 }
 
 void sol::WriteAMF0TypedObject(std::vector<uint8_t>& buffer, const SolObject& value, SolWriteRefTable& reftable)
 {
+    ++reftable.objcount;
     WriteAMF0ShortString(buffer, value.classdef.name);
 
     for (auto& [key, val] : value.props) {
@@ -1118,67 +1137,60 @@ void sol::WriteAMF0TypedObject(std::vector<uint8_t>& buffer, const SolObject& va
         WriteAMF0Value(buffer, val, type, reftable);
     }
 
-    buffer.insert(buffer.end(), std::begin(AMF0_OBJECT_ENDMARK), std::end(AMF0_OBJECT_ENDMARK));
+    buffer.insert(buffer.end(), std::begin(codec::AMF0_OBJECT_ENDMARK), std::end(codec::AMF0_OBJECT_ENDMARK));
 }
 
 void sol::WriteAMF0Value(std::vector<uint8_t>& buffer, const SolValue& value, AMF0Type type, SolWriteRefTable& reftable)
 {
-    switch (type)
-    {
-    case AMF0Type::Number:
-        WriteAMF0Number(buffer, value.type == SolType::Integer
-            ? (SolDouble)value.get<SolInteger>() : value.get<SolDouble>());
-        break;
-
-    case AMF0Type::Boolean:
-        WriteAMF0Boolean(buffer, value.get<SolBoolean>());
-        break;
-
-    case AMF0Type::String:
-        WriteAMF0ShortString(buffer, value.get<SolString>());
-        break;
-
-    case AMF0Type::Object:
-        WriteAMF0Object(buffer, value.get<SolObject>(), reftable);
-        break;
-
-    case AMF0Type::Null:
-    case AMF0Type::Undefined:
-        // nothing to write
-        break;
-
-    case AMF0Type::EcmaArray:
-        WriteAMF0EcmaArray(buffer, value.get<SolArray>(), reftable);
-        break;
-
-    case AMF0Type::StrictArray:
-        WriteAMF0StrictArray(buffer, value.get<SolArray>(), reftable);
-        break;
-
-    case AMF0Type::Date:
-        WriteAMF0Date(buffer, value.get<SolDouble>());
-        break;
-
-    case AMF0Type::LongString:
-        WriteAMF0LongString(buffer, value.get<SolString>());
-        break;
-
-    case AMF0Type::XMLDoc:
-        WriteAMF0XmlDoc(buffer, value.get<SolString>());
-        break;
-
-    case AMF0Type::TypedObject:
-        WriteAMF0TypedObject(buffer, value.get<SolObject>(), reftable);
-        break;
+    detail::WriteStatScope scope(buffer, reftable, static_cast<uint8_t>(type), value);
+    detail::RawSubtreeScope raw(buffer, reftable, static_cast<uint8_t>(type), value);
+    if (raw.copied()) {
+        return;
+    }
 
-    case AMF0Type::MovieClip:
-    case AMF0Type::Reference:
-    case AMF0Type::ObjectEnd:
-    case AMF0Type::Unsupported:
-    case AMF0Type::Recordset:
-        ThrowUnsupportedType(type);
+    VisitAMF0Type(type, [&](auto def) {
+        using TStorage = typename decltype(def)::storage;
+        constexpr AMF0Type amf0 = decltype(def)::amf0;
 
-    default:
-        ThrowUnknownType(type);
-    }
+        if constexpr (std::is_void_v<TStorage>) {
+            ThrowUnsupportedType(type);
+        }
+        else if constexpr (amf0 == AMF0Type::Number) {
+            WriteAMF0Number(buffer, value.type == SolType::Integer
+                ? (SolDouble)value.get<SolInteger>() : value.get<SolDouble>());
+        }
+        else if constexpr (std::is_same_v<TStorage, SolNull>) {
+            // nothing to write
+        }
+        else if constexpr (amf0 == AMF0Type::Boolean) {
+            WriteAMF0Boolean(buffer, value.get<SolBoolean>());
+        }
+        else if constexpr (amf0 == AMF0Type::String) {
+            WriteAMF0ShortString(buffer, value.get<SolString>());
+        }
+        else if constexpr (amf0 == AMF0Type::LongString) {
+            WriteAMF0LongString(buffer, value.get<SolString>());
+        }
+        else if constexpr (amf0 == AMF0Type::XMLDoc) {
+            WriteAMF0XmlDoc(buffer, value.get<SolString>());
+        }
+        else if constexpr (amf0 == AMF0Type::Date) {
+            WriteAMF0Date(buffer, value.get<SolDouble>());
+        }
+        else if constexpr (amf0 == AMF0Type::EcmaArray) {
+            WriteAMF0EcmaArray(buffer, value.get<SolArray>(), reftable);
+        }
+        else if constexpr (amf0 == AMF0Type::StrictArray) {
+            WriteAMF0StrictArray(buffer, value.get<SolArray>(), reftable);
+        }
+        else if constexpr (amf0 == AMF0Type::Object) {
+            WriteAMF0Object(buffer, value.get<SolObject>(), reftable);
+        }
+        else if constexpr (amf0 == AMF0Type::TypedObject) {
+            WriteAMF0TypedObject(buffer, value.get<SolObject>(), reftable);
+        }
+        else {
+            static_assert(detail::DependentFalse<decltype(def)>, "WriteAMF0Value does not handle this type");
+        }
+    });
 }
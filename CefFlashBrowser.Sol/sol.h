@@ -1,66 +1,28 @@
 #ifndef __SOL_H__
 #define __SOL_H__
 
+#include <array>
 #include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <stdexcept>
 #include <type_traits>
+#include "types.h"
 
 namespace sol
 {
-    struct SolValue;
-    struct SolArray;
-    struct SolObject;
-
-    using SolNull = std::nullptr_t;
-    using SolBoolean = bool;
-    using SolInteger = int32_t;
-    using SolDouble = double;
-    using SolString = std::string;
-    using SolBinary = std::vector<uint8_t>;
-
-
-    enum class SolType : uint8_t
+    namespace detail
     {
-        Undefined = 0x00,
-        Null = 0x01,
-        BooleanFalse = 0x02,
-        BooleanTrue = 0x03,
-        Integer = 0x04,
-        Double = 0x05,
-        String = 0x06,
-        XmlDoc = 0x07,
-        Date = 0x08,
-        Array = 0x09,
-        Object = 0x0A,
-        Xml = 0x0B,
-        Binary = 0x0C,
-    };
+        struct WritePlan;
+        struct RawSubtreeCopy;
+    }
 
-
-    enum class AMF0Type : uint8_t
-    {
-        Number = 0x00,
-        Boolean = 0x01,
-        String = 0x02,
-        Object = 0x03,
-        MovieClip = 0x04,
-        Null = 0x05,
-        Undefined = 0x06,
-        Reference = 0x07,
-        EcmaArray = 0x08,
-        ObjectEnd = 0x09,
-        StrictArray = 0x0A,
-        Date = 0x0B,
-        LongString = 0x0C,
-        Unsupported = 0x0D,
-        Recordset = 0x0E,
-        XMLDoc = 0x0F,
-        TypedObject = 0x10
-    };
+    struct SolStats;
 
 
     enum class SolVersion : uint32_t
@@ -79,8 +41,8 @@ namespace sol
 
     struct SolClassDef
     {
-        bool dynamic;
-        bool externalizable;
+        bool dynamic = false;
+        bool externalizable = false;
         std::string name;
         std::vector<std::string> members;
     };
@@ -93,10 +55,35 @@ namespace sol
     };
 
 
+    struct SolDictionary
+    {
+        bool weakkeys = false;
+
+        size_t size() const { return _entries.size(); }
+        bool empty() const { return _entries.empty(); }
+        const std::vector<std::pair<SolValue, SolValue>>& entries() const { return _entries; }
+
+        const SolValue* find(const SolValue& key) const;
+        SolValue* find(const SolValue& key);
+        SolValue& operator[](const SolValue& key);
+
+        // constant time, the last entry takes the place of the one erased
+        bool erase(const SolValue& key);
+        void reserve(size_t count);
+        void clear();
+
+    private:
+        // entries keep their insertion order so that a dictionary is written back
+        // the way it was read, the index maps key hashes to positions in _entries
+        std::vector<std::pair<SolValue, SolValue>> _entries;
+        std::unordered_multimap<size_t, size_t> _index;
+    };
+
+
     struct SolValue
     {
         SolType type;
-        std::variant<SolNull, SolBoolean, SolInteger, SolDouble, SolString, SolArray, SolObject, SolBinary> value;
+        std::variant<SolNull, SolBoolean, SolInteger, SolDouble, SolString, SolArray, SolObject, SolBinary, SolDictionary> value;
 
         SolValue(SolNull = nullptr) : type(SolType::Null), value(nullptr) {}
         SolValue(SolBoolean v) : type(v ? SolType::BooleanTrue : SolType::BooleanFalse), value(v) {}
@@ -106,10 +93,20 @@ namespace sol
         SolValue(const SolArray& v) : type(SolType::Array), value(v) {}
         SolValue(const SolObject& v) : type(SolType::Object), value(v) {}
         SolValue(const SolBinary& v) : type(SolType::Binary), value(v) {}
-        SolValue(const SolValue& v) : type(v.type), value(v.value) {}
+        SolValue(const SolDictionary& v) : type(SolType::Dictionary), value(v) {}
+        SolValue(SolString&& v) : type(SolType::String), value(std::move(v)) {}
+        SolValue(SolArray&& v) : type(SolType::Array), value(std::move(v)) {}
+        SolValue(SolObject&& v) : type(SolType::Object), value(std::move(v)) {}
+        SolValue(SolBinary&& v) : type(SolType::Binary), value(std::move(v)) {}
+        SolValue(SolDictionary&& v) : type(SolType::Dictionary), value(std::move(v)) {}
+
+        SolValue(const SolValue&) = default;
+        SolValue(SolValue&&) = default;
+        SolValue& operator=(const SolValue&) = default;
+        SolValue& operator=(SolValue&&) = default;
 
         template <typename T>
-        SolValue(SolType t, const T& v) : type(t), value(v) {}
+        SolValue(SolType t, T&& v) : type(t), value(std::forward<T>(v)) {}
 
         template <typename T>
         const T& get() const { return std::get<T>(value); }
@@ -118,35 +115,79 @@ namespace sol
         T& get() { return std::get<T>(value); }
 
         template <typename T>
-        bool is() const
-        {
-            switch (type)
-            {
-            case SolType::Undefined:
-            case SolType::Null:
-                return std::is_same_v<T, SolNull>;
-            case SolType::BooleanFalse:
-            case SolType::BooleanTrue:
-                return std::is_same_v<T, SolBoolean>;
-            case SolType::Integer:
-                return std::is_same_v<T, SolInteger>;
-            case SolType::Double:
-            case SolType::Date:
-                return std::is_same_v<T, SolDouble>;
-            case SolType::String:
-            case SolType::XmlDoc:
-            case SolType::Xml:
-                return std::is_same_v<T, SolString>;
-            case SolType::Array:
-                return std::is_same_v<T, SolArray>;
-            case SolType::Object:
-                return std::is_same_v<T, SolObject>;
-            case SolType::Binary:
-                return std::is_same_v<T, SolBinary>;
-            default:
-                return false;
-            }
-        }
+        bool is() const { return detail::SOL_STORAGE_TABLE<T>[static_cast<uint8_t>(type)]; }
+    };
+
+
+    struct SolValueHash
+    {
+        size_t operator()(const SolValue& value) const;
+    };
+
+
+    // SHA-256 of the value with every length spelled out and doubles by their bits,
+    // values with the same digest are equal, which a SolValueHash cannot promise
+    struct SolValueDigest
+    {
+        std::array<uint8_t, 32> operator()(const SolValue& value) const;
+    };
+
+
+    bool operator==(const SolValue& left, const SolValue& right);
+    bool operator==(const SolArray& left, const SolArray& right);
+    bool operator==(const SolClassDef& left, const SolClassDef& right);
+    bool operator==(const SolObject& left, const SolObject& right);
+    bool operator==(const SolDictionary& left, const SolDictionary& right);
+
+    inline bool operator!=(const SolValue& left, const SolValue& right) { return !(left == right); }
+    inline bool operator!=(const SolArray& left, const SolArray& right) { return !(left == right); }
+    inline bool operator!=(const SolClassDef& left, const SolClassDef& right) { return !(left == right); }
+    inline bool operator!=(const SolObject& left, const SolObject& right) { return !(left == right); }
+    inline bool operator!=(const SolDictionary& left, const SolDictionary& right) { return !(left == right); }
+
+
+    // bytes of a file read with keepraw and the reference table entries they added
+    struct SolRawSpan
+    {
+        size_t begin;
+        size_t end;
+        size_t strbegin;
+        size_t strend;
+        size_t classbegin;
+        size_t classend;
+        size_t objbegin;
+        size_t objend;
+        size_t hash;        // SolValueHash of the value read
+        std::array<uint8_t, 32> digest;     // and its SolValueDigest, to confirm a hash match
+        bool refs;          // whether the span follows any reference
+        bool external;      // whether it refers to an object outside it
+    };
+
+
+    // a top level entry as it was encoded, the key through the end mark
+    struct SolRawEntry : SolRawSpan
+    {
+        std::string key;
+    };
+
+
+    // a container within an entry as it was encoded, from just after its marker
+    struct SolRawSubtree : SolRawSpan
+    {
+        uint8_t marker;     // the SolType, or the AMF0Type in an AMF0 file
+    };
+
+
+    // the encoded file kept by the reader, so that entries and the containers in them
+    // left unchanged can be copied back instead of encoded again
+    struct SolRawFile
+    {
+        SolVersion version;
+        std::vector<uint8_t> bytes;
+        std::vector<SolRawEntry> entries;       // in file order
+        std::vector<SolRawSubtree> subtrees;    // the larger containers near the top of the entries, by hash
+        std::vector<std::string> strings;       // the AMF3 reference tables of the whole file
+        std::vector<SolClassDef> classes;
     };
 
 
@@ -157,11 +198,88 @@ namespace sol
         std::string solname;
         SolVersion version;
         std::map<std::string, SolValue> data;
+        std::shared_ptr<const SolRawFile> raw;  // set if read with keepraw
 
         bool valid() const { return errmsg.empty(); }
     };
 
 
+    struct SolReadOptions
+    {
+        // containers nested deeper than this are rejected
+        uint32_t maxdepth = 1024;
+        // values decoded, references count the values they copy
+        uint64_t maxnodes = UINT64_MAX;
+        // string, binary and container storage, approximate
+        uint64_t maxbytes = UINT64_MAX;
+        uint32_t maxstring = UINT32_MAX;
+        // AMF3 class definitions, every inline traits header adds one
+        uint32_t maxclasses = 65536;
+        // keep the encoded entries in SolFile::raw for WriteSolFile to copy, each entry
+        // and the larger containers near its top are hashed and digested once more to
+        // tell later whether they changed
+        bool keepraw = false;
+        // counts what the read does if set, see stats.h
+        SolStats* stats = nullptr;
+
+        // limits for files that did not come from the flash player
+        static SolReadOptions Untrusted();
+    };
+
+
+    struct SolWriteOptions
+    {
+        // threads encoding top level entries, 0 uses one per core, the output is the
+        // same for any count, entries read with keepraw are written on the calling
+        // thread in the order they were read, and only the others in parallel
+        unsigned threads = 1;
+        // counts what the write does if set, see stats.h
+        SolStats* stats = nullptr;
+    };
+
+
+    enum class SolErrorCode : uint8_t
+    {
+        None,
+        IOFailed,
+        FileTooSmall,
+        MagicMismatch,
+        ChunkSizeMismatch,
+        ConstantMismatch,
+        UnsupportedVersion,
+        EndedImproperly,
+        UnknownType,
+        UnsupportedType,
+        BadFormat,
+        EndRequired,
+        BadReference,
+        MaxDepthExceeded,
+        Externalizable,
+        CountTooLarge,
+        StringTooLong,
+        TooManyNodes,
+        TooManyBytes,
+        TypeMismatch,
+        TooManyClasses,
+    };
+
+
+    struct SolError
+    {
+        SolErrorCode code = SolErrorCode::None;
+        size_t offset = 0;
+        int type = -1;      // SolType or AMF0Type being read, -1 if none
+        bool amf0 = false;  // whether type is an AMF0Type
+        int64_t read = 0;
+        int64_t desire = 0;
+
+        bool failed() const { return code != SolErrorCode::None; }
+
+        // formatted on request so that scanning many broken files stays cheap
+        std::string message() const;
+    };
+
+
     struct SolRefTable
     {
         std::vector<std::string> strpool;
@@ -175,35 +293,70 @@ namespace sol
         std::map<std::string, int> strpool;
         //std::map<std::string, int> objpool; // not supported
         std::map<std::string, int> classpool;
+
+        // entries in the reader's tables, a copied entry may add a string twice
+        int strcount = 0;
+        int classcount = 0;
+        int objcount = 0;
+
+        // set while entries are encoded in parallel, strings and classes
+        // added by an entry before this one are looked up in the plan
+        const detail::WritePlan* plan = nullptr;
+        size_t entry = 0;
+
+        // set while an entry read with keepraw is encoded again, see CopyRawSubtree
+        detail::RawSubtreeCopy* raw = nullptr;
+
+        // the id of the class being looked up, and the pool nodes left by clear,
+        // so that a table reused for many files only allocates for longer strings
+        std::string classid;
+        std::vector<std::map<std::string, int>::node_type> spare;
+
+        // set while a write is counted, with the bytes of the values counted so far,
+        // the depth of the value being written and the capacity of the buffer
+        SolStats* stats = nullptr;
+        uint64_t statbytes = 0;
+        uint32_t statdepth = 0;
+        size_t statcapacity = 0;
+        // if set along with stats, the bytes each value takes, its marker included
+        std::unordered_map<const SolValue*, uint64_t>* statsizes = nullptr;
+
+        // empties the table for the next file, keeping what it has allocated
+        void clear();
     };
 
 
-    bool IsKnownType(SolType type);
+    bool ReadSolFile(SolFile& file, const SolReadOptions& options = SolReadOptions());
+
+    bool TryReadSolFile(SolFile& file, SolError& error, const SolReadOptions& options = SolReadOptions());
 
-    bool ReadSolFile(SolFile& file);
+    // as TryReadSolFile, from a file already in memory, file.path is left as it is
+    bool TryReadSolData(const uint8_t* data, size_t size, SolFile& file, SolError& error, const SolReadOptions& options = SolReadOptions());
 
-    SolType ReadSolType(uint8_t* data, int size, int& index);
+    SolType ReadSolType(const uint8_t* data, size_t size, size_t& index);
 
-    SolInteger ReadSolInteger(uint8_t* data, int size, int& index, bool unsign = false);
+    SolInteger ReadSolInteger(const uint8_t* data, size_t size, size_t& index, bool unsign = false);
 
-    SolDouble ReadSolDouble(uint8_t* data, int size, int& index);
+    SolDouble ReadSolDouble(const uint8_t* data, size_t size, size_t& index);
 
-    SolString ReadSolString(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolString ReadSolString(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolValue ReadSolXml(uint8_t* data, int size, int& index, SolRefTable& reftable, SolType xmltype);
+    SolValue ReadSolXml(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable, SolType xmltype);
 
-    SolBinary ReadSolBinary(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolBinary ReadSolBinary(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolValue ReadSolDate(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolValue ReadSolDate(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolArray ReadSolArray(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolArray ReadSolArray(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolObject ReadSolObject(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolObject ReadSolObject(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolValue ReadSolValue(uint8_t* data, int size, int& index, SolRefTable& reftable, SolType type);
+    SolDictionary ReadSolDictionary(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
+    SolValue ReadSolValue(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable, SolType type, const SolReadOptions& options = SolReadOptions());
 
-    bool WriteSolFile(SolFile& file);
+
+    bool WriteSolFile(SolFile& file, const SolWriteOptions& options = SolWriteOptions());
 
     void WriteSolType(std::vector<uint8_t>& buffer, SolType type);
 
@@ -221,38 +374,44 @@ namespace sol
 
     void WriteSolArray(std::vector<uint8_t>& buffer, const SolArray& value, SolWriteRefTable& reftable);
 
+    void WriteSolTraits(std::vector<uint8_t>& buffer, const SolClassDef& classdef, SolWriteRefTable& reftable);
+
+    // throws if a sealed member has no value, or a non-dynamic object has a property
+    // that is not a sealed member, rather than write a file that reads differently
     void WriteSolObject(std::vector<uint8_t>& buffer, const SolObject& value, SolWriteRefTable& reftable);
 
+    void WriteSolDictionary(std::vector<uint8_t>& buffer, const SolDictionary& value, SolWriteRefTable& reftable);
+
     void WriteSolValue(std::vector<uint8_t>& buffer, const SolValue& value, SolWriteRefTable& reftable);
 
 
     AMF0Type GetAMF0Type(const SolValue& value);
 
-    AMF0Type ReadAMF0Type(uint8_t* data, int size, int& index);
+    AMF0Type ReadAMF0Type(const uint8_t* data, size_t size, size_t& index);
 
-    SolDouble ReadAMF0Number(uint8_t* data, int size, int& index);
+    SolDouble ReadAMF0Number(const uint8_t* data, size_t size, size_t& index);
 
-    SolBoolean ReadAMF0Boolean(uint8_t* data, int size, int& index);
+    SolBoolean ReadAMF0Boolean(const uint8_t* data, size_t size, size_t& index);
 
-    SolString ReadAMF0ShortString(uint8_t* data, int size, int& index);
+    SolString ReadAMF0ShortString(const uint8_t* data, size_t size, size_t& index);
 
-    SolString ReadAMF0LongString(uint8_t* data, int size, int& index);
+    SolString ReadAMF0LongString(const uint8_t* data, size_t size, size_t& index);
 
-    SolValue ReadAMF0XmlDoc(uint8_t* data, int size, int& index);
+    SolValue ReadAMF0XmlDoc(const uint8_t* data, size_t size, size_t& index);
 
-    SolValue ReadAMF0Date(uint8_t* data, int size, int& index);
+    SolValue ReadAMF0Date(const uint8_t* data, size_t size, size_t& index);
 
-    SolValue ReadAMF0Reference(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolValue ReadAMF0Reference(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolArray ReadAMF0EcmaArray(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolArray ReadAMF0EcmaArray(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolArray ReadAMF0StrictArray(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolArray ReadAMF0StrictArray(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolObject ReadAMF0Object(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolObject ReadAMF0Object(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolValue ReadAMF0TypedObject(uint8_t* data, int size, int& index, SolRefTable& reftable);
+    SolValue ReadAMF0TypedObject(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable);
 
-    SolValue ReadAMF0Value(uint8_t* data, int size, int& index, SolRefTable& reftable, AMF0Type type);
+    SolValue ReadAMF0Value(const uint8_t* data, size_t size, size_t& index, SolRefTable& reftable, AMF0Type type, const SolReadOptions& options = SolReadOptions());
 
 
     void WriteAMF0Type(std::vector<uint8_t>& buffer, AMF0Type type);
@@ -0,0 +1,154 @@
+#include "stats.h"
+#include "utils.h"
+#include <algorithm>
+
+
+namespace
+{
+    // strings this short are kept inside the string object
+    const size_t SSO_CAPACITY = std::string().capacity();
+}
+
+
+void sol::SolStats::add(const SolStats& other)
+{
+    version = other.version;
+    bytes += other.bytes;
+
+    for (size_t i = 0; i < types.size(); ++i) {
+        types[i].nodes += other.types[i].nodes;
+        types[i].bytes += other.types[i].bytes;
+    }
+
+    strrefs += other.strrefs;
+    classrefs += other.classrefs;
+    objrefs += other.objrefs;
+    copied += other.copied;
+    allocations += other.allocations;
+    maxdepth = std::max(maxdepth, other.maxdepth);
+
+    iotime += other.iotime;
+    decodetime += other.decodetime;
+    encodetime += other.encodetime;
+    marshaltime += other.marshaltime;
+}
+
+std::string sol::SolStats::report() const
+{
+    std::string result = utils::FormatString("%s, %llu bytes, max depth %u\n",
+        version == SolVersion::AMF0 ? "AMF0" : "AMF3", (unsigned long long)bytes, maxdepth);
+
+    result += utils::FormatString("references: %llu strings, %llu classes, %llu objects\n",
+        (unsigned long long)strrefs, (unsigned long long)classrefs, (unsigned long long)objrefs);
+    result += utils::FormatString("allocations: %llu, copied %llu bytes\n",
+        (unsigned long long)allocations, (unsigned long long)copied);
+    result += utils::FormatString("time: io %.3f ms, decode %.3f ms, encode %.3f ms, marshal %.3f ms\n",
+        iotime * 1e3, decodetime * 1e3, encodetime * 1e3, marshaltime * 1e3);
+
+    for (size_t i = 0; i < types.size(); ++i) {
+        if (types[i].nodes == 0) {
+            continue;
+        }
+        const char* name = version == SolVersion::AMF0
+            ? GetTypeName(static_cast<AMF0Type>(i)) : GetTypeName(static_cast<SolType>(i));
+        result += utils::FormatString("  %-12s %10llu nodes %12llu bytes\n",
+            name, (unsigned long long)types[i].nodes, (unsigned long long)types[i].bytes);
+    }
+    return result;
+}
+
+const char* sol::GetTypeName(SolType type)
+{
+    switch (type)
+    {
+    case SolType::Undefined: return "undefined";
+    case SolType::Null: return "null";
+    case SolType::BooleanFalse: return "false";
+    case SolType::BooleanTrue: return "true";
+    case SolType::Integer: return "integer";
+    case SolType::Double: return "double";
+    case SolType::String: return "string";
+    case SolType::XmlDoc: return "xmldoc";
+    case SolType::Date: return "date";
+    case SolType::Array: return "array";
+    case SolType::Object: return "object";
+    case SolType::Xml: return "xml";
+    case SolType::Binary: return "binary";
+    case SolType::Dictionary: return "dictionary";
+    default: return "unknown";
+    }
+}
+
+const char* sol::GetTypeName(AMF0Type type)
+{
+    switch (type)
+    {
+    case AMF0Type::Number: return "number";
+    case AMF0Type::Boolean: return "boolean";
+    case AMF0Type::String: return "string";
+    case AMF0Type::Object: return "object";
+    case AMF0Type::MovieClip: return "movieclip";
+    case AMF0Type::Null: return "null";
+    case AMF0Type::Undefined: return "undefined";
+    case AMF0Type::Reference: return "reference";
+    case AMF0Type::EcmaArray: return "ecmaarray";
+    case AMF0Type::ObjectEnd: return "objectend";
+    case AMF0Type::StrictArray: return "strictarray";
+    case AMF0Type::Date: return "date";
+    case AMF0Type::LongString: return "longstring";
+    case AMF0Type::Unsupported: return "unsupported";
+    case AMF0Type::Recordset: return "recordset";
+    case AMF0Type::XMLDoc: return "xmldoc";
+    case AMF0Type::TypedObject: return "typedobject";
+    default: return "unknown";
+    }
+}
+
+uint64_t sol::detail::HeapBlocks(const std::string& str)
+{
+    return str.size() > SSO_CAPACITY ? 1 : 0;
+}
+
+uint64_t sol::detail::HeapBlocks(const SolValue& value)
+{
+    // a map or index node per member, and the storage of vectors and long strings
+    switch (value.type)
+    {
+    case SolType::String:
+    case SolType::XmlDoc:
+    case SolType::Xml:
+        return HeapBlocks(value.get<SolString>());
+
+    case SolType::Binary:
+        return value.get<SolBinary>().empty() ? 0 : 1;
+
+    case SolType::Array: {
+        auto& arr = value.get<SolArray>();
+        uint64_t blocks = arr.dense.capacity() ? 1 : 0;
+        for (auto& [key, val] : arr.assoc) {
+            blocks += 1 + HeapBlocks(key);
+        }
+        return blocks;
+    }
+
+    case SolType::Object: {
+        auto& obj = value.get<SolObject>();
+        uint64_t blocks = HeapBlocks(obj.classdef.name) + (obj.classdef.members.capacity() ? 1 : 0);
+        for (auto& member : obj.classdef.members) {
+            blocks += HeapBlocks(member);
+        }
+        for (auto& [key, val] : obj.props) {
+            blocks += 1 + HeapBlocks(key);
+        }
+        return blocks;
+    }
+
+    case SolType::Dictionary: {
+        auto& dict = value.get<SolDictionary>();
+        return dict.empty() ? 0 : 2 + dict.size();
+    }
+
+    default:
+        return 0;
+    }
+}
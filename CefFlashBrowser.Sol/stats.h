@@ -0,0 +1,100 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "sol.h"
+#include <array>
+#include <chrono>
+
+namespace sol
+{
+    struct SolTypeStats
+    {
+        uint64_t nodes = 0;
+        // the marker and the value, a container's with its keys and end mark
+        // but without the values of its members
+        uint64_t bytes = 0;
+    };
+
+
+    // what reading or writing a file did, filled in if SolReadOptions::stats or
+    // SolWriteOptions::stats points to it, counts are added to what is already there
+    struct SolStats
+    {
+        // of the last file counted, types holds AMF0Type markers for AMF0 files
+        SolVersion version = SolVersion::AMF3;
+        uint64_t bytes = 0;
+        std::array<SolTypeStats, 256> types{};
+
+        // values written as references to earlier ones
+        uint64_t strrefs = 0;
+        uint64_t classrefs = 0;
+        uint64_t objrefs = 0;
+
+        // bytes of the entries and containers a write copied from SolFile::raw instead of encoding them
+        uint64_t copied = 0;
+
+        // heap blocks of the values read, or of the output buffer and reference
+        // tables written, approximate
+        uint64_t allocations = 0;
+        uint32_t maxdepth = 0;
+
+        // seconds spent on reading or writing the file, decoding, encoding, and
+        // converting from or to managed values in the C++/CLI wrappers
+        double iotime = 0;
+        double decodetime = 0;
+        double encodetime = 0;
+        double marshaltime = 0;
+
+        void clear() { *this = SolStats(); }
+
+        // adds the counts of other, the version is taken from it
+        void add(const SolStats& other);
+
+        // a line per counter and per type seen
+        std::string report() const;
+    };
+
+
+    const char* GetTypeName(SolType type);
+
+    const char* GetTypeName(AMF0Type type);
+}
+
+
+namespace sol::detail
+{
+    // adds the time from construction to destruction to a field of stats, if it is set
+    class StatTimer
+    {
+    public:
+        StatTimer(SolStats* stats, double SolStats::* field)
+            : _stats(stats), _field(field)
+        {
+            if (_stats) {
+                _start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~StatTimer()
+        {
+            if (_stats) {
+                _stats->*_field += std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+            }
+        }
+
+        StatTimer(const StatTimer&) = delete;
+        StatTimer& operator=(const StatTimer&) = delete;
+
+    private:
+        SolStats* _stats;
+        double SolStats::* _field;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    // heap blocks a value holds itself, its members are not counted
+    uint64_t HeapBlocks(const SolValue& value);
+
+    uint64_t HeapBlocks(const std::string& str);
+}
+
+#endif // !__STATS_H__
@@ -0,0 +1,103 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include "../sol.h"
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+// every test is a program that runs its checks and returns sol::test::Result() from main,
+// a failed check prints where it is and the test goes on, so one run shows every failure
+#define SOL_CHECK(cond) \
+    ((cond) ? (void)0 : sol::test::Fail(__FILE__, __LINE__, #cond))
+
+namespace sol::test
+{
+    inline int& Failures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline void Fail(const char* file, int line, const char* cond)
+    {
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, cond);
+        ++Failures();
+    }
+
+    inline int Result()
+    {
+        if (Failures() != 0) {
+            std::fprintf(stderr, "%d checks failed\n", Failures());
+            return 1;
+        }
+        return 0;
+    }
+
+    // a path in a directory of its own under the system temporary directory,
+    // emptied on the first call of each run
+    inline std::string TempPath(const std::string& name)
+    {
+        static const std::filesystem::path dir = [] {
+            auto path = std::filesystem::temp_directory_path() / "soltest";
+            std::filesystem::remove_all(path);
+            std::filesystem::create_directories(path);
+            return path;
+        }();
+        return (dir / name).string();
+    }
+
+    // a file with a value of every type the version can write, nested and at the top level
+    inline SolFile SampleFile(SolVersion version, const std::string& path)
+    {
+        bool amf3 = version == SolVersion::AMF3;
+
+        SolFile file;
+        file.path = path;
+        file.solname = "sample";
+        file.version = version;
+
+        SolArray list;
+        list.dense.emplace_back(1.5);
+        list.dense.emplace_back(std::string("x"));
+        list.dense.emplace_back(true);
+
+        SolObject player;
+        player.classdef.dynamic = amf3;
+        player.props["name"] = SolValue(std::string("hero"));
+        player.props["level"] = amf3 ? SolValue(SolInteger(12)) : SolValue(12.0);
+        player.props["items"] = SolValue(list);
+
+        file.data["player"] = SolValue(player);
+        file.data["date"] = SolValue(SolType::Date, 1234.0);
+        file.data["xml"] = SolValue(SolType::XmlDoc, std::string("<a/>"));
+        file.data["null"] = SolValue(nullptr);
+        file.data["undefined"] = SolValue(SolType::Undefined, nullptr);
+        file.data["text"] = SolValue(std::string("hero"));
+
+        if (amf3) {
+            SolObject point;
+            point.classdef.name = "Point";
+            point.classdef.members = { "y", "x" };
+            point.props["x"] = SolValue(SolInteger(3));
+            point.props["y"] = SolValue(-0.5);
+
+            SolArray mixed = list;
+            mixed.assoc["key"] = SolValue(std::string("value"));
+
+            SolDictionary dict;
+            dict[SolValue(SolInteger(1))] = SolValue(std::string("one"));
+            dict[SolValue(player)] = SolValue(2.0);
+            dict[SolValue(std::string("k"))] = SolValue(list);
+
+            file.data["point"] = SolValue(point);
+            file.data["binary"] = SolValue(SolBinary{ 1, 2, 3 });
+            file.data["negative"] = SolValue(SolInteger(-5));
+            file.data["mixed"] = SolValue(mixed);
+            file.data["dict"] = SolValue(dict);
+        }
+        return file;
+    }
+}
+
+#endif // !__CHECK_H__
@@ -0,0 +1,147 @@
+#include "check.h"
+#include "../archive.h"
+#include <filesystem>
+#include <random>
+
+
+namespace
+{
+    using namespace sol;
+    namespace fs = std::filesystem;
+
+    using Files = std::vector<std::pair<std::string, std::vector<uint8_t>>>;
+
+    // random and repetitive bytes, an empty file, a few large enough for several
+    // blocks, in nested directories, and a file that is not a sol file to be left out
+    Files MakeFiles(const std::string& dir, std::mt19937& rng)
+    {
+        Files files;
+        for (int i = 0; i < 24; ++i) {
+            size_t size = i == 0 ? 0 : i % 7 == 0 ? 150000 + rng() % 50000 : rng() % 5000;
+            std::vector<uint8_t> data(size);
+            for (size_t k = 0; k < size; ++k) {
+                data[k] = i % 3 == 0 ? static_cast<uint8_t>(rng()) : static_cast<uint8_t>("abcabcabdxyz"[(k / 3 + (rng() % 50 == 0)) % 12]);
+            }
+            std::string name = (i % 4 == 0 ? "sub/" : i % 5 == 0 ? "sub/deeper/" : "") + std::to_string(i) + (i == 1 ? ".SOL" : ".sol");
+            fs::create_directories(fs::path(dir) / fs::path(name).parent_path());
+            utils::WriteFile((fs::path(dir) / name).string(), data);
+            files.emplace_back(name, std::move(data));
+        }
+
+        SolFile sample = test::SampleFile(SolVersion::AMF3, (fs::path(dir) / "sample.sol").string());
+        SOL_CHECK(WriteSolFile(sample));
+        files.emplace_back("sample.sol", utils::ReadFile(sample.path));
+
+        utils::WriteFile((fs::path(dir) / "skip.txt").string(), { 1, 2 });
+        return files;
+    }
+
+    void TestPack(const std::string& dir, const Files& files)
+    {
+        auto path = test::TempPath("archive.solpack");
+        auto out = test::TempPath("archive-out");
+
+        for (bool compress : { true, false }) {
+            for (unsigned threads : { 1u, 4u }) {
+                SolArchiveOptions options;
+                options.compress = compress;
+                options.threads = threads;
+                std::string errmsg;
+                SOL_CHECK(PackSolDirectory(dir, path, errmsg, options));
+
+                SolArchive archive;
+                SOL_CHECK(archive.open(path, errmsg));
+                SOL_CHECK(archive.members().size() == files.size());
+                for (size_t i = 1; i < archive.members().size(); ++i) {
+                    SOL_CHECK(archive.members()[i - 1].name < archive.members()[i].name);
+                }
+                for (auto& [name, data] : files) {
+                    auto member = archive.find(name);
+                    std::vector<uint8_t> read;
+                    SOL_CHECK(member && archive.read(*member, read, errmsg) && read == data);
+                }
+                SOL_CHECK(!archive.find("none.sol") && !archive.find("skip.txt"));
+
+                fs::remove_all(out);
+                SOL_CHECK(archive.extract(out, errmsg, threads));
+                for (auto& [name, data] : files) {
+                    SOL_CHECK(utils::ReadFile((fs::path(out) / name).string()) == data);
+                }
+            }
+        }
+    }
+
+    void TestDamage(const std::string& dir, std::mt19937& rng)
+    {
+        auto path = test::TempPath("archive.solpack");
+        auto damaged = test::TempPath("archive-damaged.solpack");
+        std::string errmsg;
+        SOL_CHECK(PackSolDirectory(dir, path, errmsg));
+        auto good = utils::ReadFile(path);
+
+        // a damaged member fails alone, the others still read
+        SolArchive archive;
+        SOL_CHECK(archive.open(path, errmsg));
+        auto bytes = good;
+        bytes[archive.find("2.sol")->offset + 3] ^= 0x10;
+        utils::WriteFile(damaged, bytes);
+
+        SolArchive partly;
+        std::vector<uint8_t> read;
+        SOL_CHECK(partly.open(damaged, errmsg));
+        SOL_CHECK(!partly.read(*partly.find("2.sol"), read, errmsg) && !errmsg.empty());
+        SOL_CHECK(partly.read(*partly.find("3.sol"), read, errmsg));
+        SOL_CHECK(!partly.extract(test::TempPath("archive-damaged"), errmsg));
+
+        // a damaged index fails to open
+        bytes = good;
+        bytes[bytes.size() - 40] ^= 1;
+        utils::WriteFile(damaged, bytes);
+        SolArchive broken;
+        SOL_CHECK(!broken.open(damaged, errmsg) && !errmsg.empty());
+
+        // random damage anywhere past the header is found or harmless, never a crash
+        for (int i = 0; i < 100; ++i) {
+            bytes = good;
+            for (int flips = 1 + rng() % 8; flips > 0; --flips) {
+                bytes[56 + rng() % (bytes.size() - 56)] = static_cast<uint8_t>(rng());
+            }
+            utils::WriteFile(damaged, bytes);
+            SolArchive fuzzed;
+            if (fuzzed.open(damaged, errmsg)) {
+                for (auto& member : fuzzed.members()) {
+                    fuzzed.read(member, read, errmsg);
+                }
+            }
+        }
+    }
+
+    void TestNames(const std::string& dir)
+    {
+        auto path = test::TempPath("archive-names.solpack");
+        auto sample = (fs::path(dir) / "sample.sol").string();
+        std::string errmsg;
+
+        SOL_CHECK(!PackSolArchive(path, { { "../x.sol", sample } }, errmsg));
+        SOL_CHECK(!PackSolArchive(path, { { "/x.sol", sample } }, errmsg));
+        SOL_CHECK(!PackSolArchive(path, { { "x.sol", sample }, { "x.sol", sample } }, errmsg));
+        SOL_CHECK(!PackSolArchive(path, { { "x.sol", sample }, { "y.sol", (fs::path(dir) / "none.sol").string() } }, errmsg));
+        SOL_CHECK(!fs::exists(path));
+
+        SolArchive empty;
+        SOL_CHECK(PackSolArchive(path, {}, errmsg));
+        SOL_CHECK(empty.open(path, errmsg) && empty.members().empty());
+    }
+}
+
+
+int main()
+{
+    std::mt19937 rng(1);
+    auto dir = test::TempPath("archive-files");
+    auto files = MakeFiles(dir, rng);
+    TestPack(dir, files);
+    TestDamage(dir, rng);
+    TestNames(dir);
+    return test::Result();
+}
@@ -0,0 +1,151 @@
+#include "check.h"
+#include "../bench/generator.h"
+#include "../diff.h"
+#include "../utils.h"
+#include <cmath>
+#include <stdexcept>
+
+
+namespace
+{
+    using namespace sol;
+
+    bool Same(const SolFile& left, const SolFile& right)
+    {
+        return DiffSolFiles(left, right).empty();
+    }
+
+    SolFile Read(const std::string& path)
+    {
+        SolFile file;
+        file.path = path;
+        SOL_CHECK(ReadSolFile(file));
+        return file;
+    }
+
+    // every way of diffing from and patching it leads to to
+    void TestPair(const std::string& frompath, const std::string& topath)
+    {
+        SolFile from = Read(frompath), to = Read(topath);
+
+        SolPatch patch = DiffSolFiles(from, to);
+        SOL_CHECK(patch.empty() == Same(from, to));
+        SolFile patched = from;
+        ApplySolPatch(patched, patch);
+        SOL_CHECK(Same(patched, to));
+
+        SolTree fromtree(from), totree(to);
+        SolPatch treepatch = DiffSolTrees(fromtree, totree);
+        SOL_CHECK(treepatch.changes.size() == patch.changes.size());
+        // trees have no header
+        SolFile stored = to;
+        ApplySolPatch(fromtree, treepatch).store(stored);
+        SOL_CHECK(Same(stored, to));
+
+        // the entries with the same bytes are skipped, the rest is the same
+        SolPatch datapatch;
+        SolError error;
+        SOL_CHECK(DiffSolFilePaths(frompath, topath, datapatch, error));
+        SOL_CHECK(datapatch.changes.size() <= patch.changes.size());
+        patched = from;
+        ApplySolPatch(patched, datapatch);
+        SOL_CHECK(Same(patched, to));
+
+        auto patchpath = test::TempPath("diff.solpatch");
+        auto outpath = test::TempPath("diff-out.sol");
+        std::string errmsg;
+        SolPatch loaded;
+        SOL_CHECK(SaveSolPatch(datapatch, patchpath, errmsg));
+        SOL_CHECK(LoadSolPatch(patchpath, loaded, errmsg));
+        SOL_CHECK(loaded.changes.size() == datapatch.changes.size());
+        SOL_CHECK(loaded.hasname == datapatch.hasname && loaded.hasversion == datapatch.hasversion);
+        SOL_CHECK(PatchSolFile(frompath, loaded, outpath, errmsg));
+        SOL_CHECK(Same(Read(outpath), to));
+    }
+
+    std::vector<std::string> MakeFiles()
+    {
+        std::vector<std::string> paths;
+        auto add = [&](SolFile file) {
+            file.path = test::TempPath(utils::FormatString("diff-%zu.sol", paths.size()));
+            SOL_CHECK(WriteSolFile(file));
+            paths.push_back(file.path);
+        };
+
+        for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+            SolFile sample = test::SampleFile(version, std::string());
+            add(sample);
+
+            // edits at every depth, dense values added and removed at the end
+            SolFile edited = sample;
+            auto& player = std::get<SolObject>(edited.data["player"].value);
+            auto& items = std::get<SolArray>(player.props["items"].value);
+            items.dense.pop_back();
+            items.dense[0] = SolValue(-0.0);
+            player.props["guild"] = SolValue(std::string("new"));
+            edited.data.erase("text");
+            edited.data["added"] = SolValue(std::nan(""));
+            edited.solname = "edited";
+            add(edited);
+
+            SolFile longer = sample;
+            auto& more = std::get<SolArray>(std::get<SolObject>(longer.data["player"].value).props["items"].value);
+            for (int i = 0; i < 4; ++i) {
+                more.dense.emplace_back(SolDouble(i));
+            }
+            add(longer);
+
+            bench::SolCorpusShape shape;
+            shape.version = version;
+            shape.entries = 5;
+            auto path = test::TempPath(utils::FormatString("diff-%zu.sol", paths.size()));
+            utils::WriteFile(path, bench::GenerateSolData(shape));
+            paths.push_back(path);
+        }
+        return paths;
+    }
+
+    void TestValues()
+    {
+        SolFile from;
+        from.solname = "values";
+        from.version = SolVersion::AMF3;
+        from.data["nan"] = SolValue(std::nan(""));
+        from.data["zero"] = SolValue(0.0);
+
+        // NaN is not a change, -0 is one
+        SolFile to = from;
+        to.data["zero"] = SolValue(-0.0);
+        SolPatch patch = DiffSolFiles(from, to);
+        SOL_CHECK(patch.changes.size() == 1 && patch.changes[0].key == "zero");
+        SOL_CHECK(patch.changes[0].kind == SolChangeKind::Change);
+
+        // a patch applied twice does not apply the second time
+        SolFile empty = from;
+        empty.data.clear();
+        SolFile patched = from;
+        patch = DiffSolFiles(from, empty);
+        ApplySolPatch(patched, patch);
+        bool thrown = false;
+        try {
+            ApplySolPatch(patched, patch);
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        SOL_CHECK(thrown);
+    }
+}
+
+
+int main()
+{
+    auto paths = MakeFiles();
+    for (auto& from : paths) {
+        for (auto& to : paths) {
+            TestPair(from, to);
+        }
+    }
+    TestValues();
+    return test::Result();
+}
@@ -0,0 +1,166 @@
+#include "check.h"
+#include "../bench/generator.h"
+#include "../json.h"
+#include "../utils.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+
+namespace
+{
+    using namespace sol;
+
+    std::string ToJson(const std::string& path)
+    {
+        std::ostringstream out;
+        SolError error;
+        SOL_CHECK(TranscodeSolFileToJson(path, out, error));
+        return out.str();
+    }
+
+    // sol to JSON and back reads as the same values, and gives the same JSON again
+    void TestRoundTrip(const std::string& path, bool samevalues)
+    {
+        auto json = ToJson(path);
+        auto jsonpath = test::TempPath("json.json");
+        std::ofstream(jsonpath, std::ios::binary) << json;
+
+        auto copy = test::TempPath("json-copy.sol");
+        std::string errmsg;
+        SOL_CHECK(TranscodeJsonFileToSol(jsonpath, copy, errmsg) && errmsg.empty());
+
+        SolFile original, read;
+        original.path = path;
+        read.path = copy;
+        SOL_CHECK(ReadSolFile(original) && ReadSolFile(read));
+        SOL_CHECK(read.solname == original.solname && read.version == original.version);
+        if (samevalues) {
+            SOL_CHECK(read.data == original.data);
+        }
+        SOL_CHECK(ToJson(copy) == json);
+    }
+
+    // the values JSON has no literal for, and the names and bytes it needs escaped
+    SolFile EdgeFile(SolVersion version, const std::string& path)
+    {
+        SolFile file = test::SampleFile(version, path);
+        file.data["infinity"] = SolValue(-INFINITY);
+        file.data["negzero"] = SolValue(-0.0);
+        file.data["tenth"] = SolValue(0.1);
+        file.data["bad\xff utf8 \x01\"\\"] = SolValue(std::string("a\xc3\x28 b\xed\xa0\x80 \xe2\x82\xac \x80"));
+        file.data["long"] = SolValue(std::string(70000, 'q'));
+
+        SolObject dollars;
+        dollars.classdef.dynamic = version == SolVersion::AMF3;
+        dollars.props["$dollar"] = SolValue(std::string("$x"));
+        dollars.props["$$two"] = SolValue(1.0);
+        file.data["dollars"] = SolValue(dollars);
+
+        if (version == SolVersion::AMF3) {
+            SolObject sealed;
+            sealed.classdef.name = "com.example.Point";
+            sealed.classdef.members = { "x", "$z" };
+            sealed.props["x"] = SolValue(SolInteger(-268435456));
+            sealed.props["$z"] = SolValue(268435456.0);
+            file.data["sealed"] = SolValue(sealed);
+
+            SolDictionary weak;
+            weak.weakkeys = true;
+            weak[SolValue(sealed)] = SolValue(SolBinary{});
+            weak[SolValue(SolType::Date, 5.0)] = SolValue(SolBinary{ 0, 255 });
+            file.data["weak"] = SolValue(weak);
+
+            SolValue deep = SolValue(SolArray());
+            for (int i = 0; i < 100; ++i) {
+                SolArray outer;
+                outer.dense.push_back(std::move(deep));
+                deep = SolValue(std::move(outer));
+            }
+            file.data["deep"] = deep;
+        }
+        else {
+            SolObject typed;
+            typed.classdef.name = "com.example.Point";
+            typed.props["x"] = SolValue(1.0);
+            file.data["typed"] = SolValue(typed);
+        }
+        return file;
+    }
+
+    void TestLayout()
+    {
+        SolFile file;
+        file.path = test::TempPath("json-layout.sol");
+        file.solname = "tiny";
+        file.version = SolVersion::AMF3;
+        file.data["a"] = SolValue(SolInteger(1));
+        file.data["b"] = SolValue(1.0);
+        file.data["c"] = SolValue(std::string("$x\""));
+        file.data["d"] = SolValue(SolArray{ {}, { SolValue(true) } });
+        file.data["u"] = SolValue(SolType::Undefined, nullptr);
+        SOL_CHECK(WriteSolFile(file));
+
+        SOL_CHECK(ToJson(file.path) ==
+            "{\"name\":\"tiny\",\"version\":3,\"data\":{\n"
+            "\"a\":1,\n"
+            "\"b\":1.0,\n"
+            "\"c\":\"$x\\\"\",\n"
+            "\"d\":[true],\n"
+            "\"u\":{\"$undefined\":true}\n"
+            "}}\n");
+    }
+
+    void TestMalformed()
+    {
+        const char* inputs[] = {
+            "",
+            "{",
+            "[]",
+            "{\"name\":\"x\",\"version\":3,\"data\":{\"a\":[1,}}",
+            "{\"name\":\"x\",\"version\":3,\"data\":{\"a\":{\"$ref\":0}}}",
+            // AMF0 has no byte arrays
+            "{\"name\":\"x\",\"version\":0,\"data\":{\"a\":{\"$binary\":\"AA==\"}}}",
+        };
+        for (auto input : inputs) {
+            std::stringstream out;
+            std::string errmsg;
+            SOL_CHECK(!TranscodeJsonToSol(input, std::strlen(input), out, errmsg) && !errmsg.empty());
+        }
+
+        // and a file that fails to transcode is not left behind
+        auto jsonpath = test::TempPath("json-bad.json");
+        auto path = test::TempPath("json-bad.sol");
+        std::ofstream(jsonpath, std::ios::binary) << inputs[3];
+        std::string errmsg;
+        SOL_CHECK(!TranscodeJsonFileToSol(jsonpath, path, errmsg) && !std::ifstream(path).good());
+    }
+}
+
+
+int main()
+{
+    for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+        auto path = test::TempPath("json-edge.sol");
+        SolFile file = EdgeFile(version, path);
+        SOL_CHECK(WriteSolFile(file));
+        TestRoundTrip(path, true);
+
+        // a NaN reads back, but never compares equal
+        file.data["nan"] = SolValue(std::nan(""));
+        SOL_CHECK(WriteSolFile(file));
+        TestRoundTrip(path, false);
+
+        // with object references, which are written as {"$ref":index}
+        bench::SolCorpusShape shape;
+        shape.version = version;
+        shape.refdensity = 0.2;
+        path = test::TempPath("json-generated.sol");
+        utils::WriteFile(path, bench::GenerateSolData(shape));
+        TestRoundTrip(path, true);
+    }
+    TestLayout();
+    TestMalformed();
+    return test::Result();
+}
@@ -0,0 +1,72 @@
+#include "check.h"
+#include "../bench/generator.h"
+#include "../utils.h"
+
+
+namespace
+{
+    using namespace sol;
+
+    std::vector<uint8_t> Write(SolFile file, unsigned threads)
+    {
+        file.path = test::TempPath(utils::FormatString("parallel-%u.sol", threads));
+        SolWriteOptions options;
+        options.threads = threads;
+        SOL_CHECK(WriteSolFile(file, options));
+        return utils::ReadFile(file.path);
+    }
+
+    // the output is the same for any number of threads, keepraw entries included
+    void TestSameAsSerial(const SolFile& file)
+    {
+        auto serial = Write(file, 1);
+        for (unsigned threads : { 0u, 2u, 3u, 8u, 64u }) {
+            SOL_CHECK(Write(file, threads) == serial);
+        }
+
+        SolFile read;
+        read.path = test::TempPath("parallel-read.sol");
+        utils::WriteFile(read.path, serial);
+        SolReadOptions options;
+        options.keepraw = true;
+        SOL_CHECK(ReadSolFile(read, options));
+        SOL_CHECK(read.data == file.data);
+
+        // some entries copied back, the others encoded on the workers
+        size_t index = 0;
+        for (auto& [key, value] : read.data) {
+            if (index++ % 2 == 0) {
+                value = SolValue(std::string("changed ") + key);
+            }
+        }
+        auto mixed = Write(read, 1);
+        for (unsigned threads : { 0u, 2u, 8u }) {
+            SOL_CHECK(Write(read, threads) == mixed);
+        }
+    }
+}
+
+
+int main()
+{
+    for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+        TestSameAsSerial(test::SampleFile(version, std::string()));
+
+        // many entries sharing strings and classes, which the workers number as the serial writer does
+        bench::SolCorpusShape shape;
+        shape.version = version;
+        shape.entries = 40;
+        shape.depth = 3;
+        shape.fanout = 6;
+        shape.stringreuse = 0.8;
+        shape.classes = 5;
+        shape.refdensity = 0;
+
+        auto bytes = bench::GenerateSolData(shape);
+        SolFile generated;
+        SolError error;
+        SOL_CHECK(TryReadSolData(bytes.data(), bytes.size(), generated, error));
+        TestSameAsSerial(generated);
+    }
+    return sol::test::Result();
+}
@@ -0,0 +1,143 @@
+#include "check.h"
+#include "../bench/generator.h"
+#include "../utils.h"
+#include <algorithm>
+
+
+namespace
+{
+    using namespace sol;
+
+    SolFile ReadRaw(const std::string& path)
+    {
+        SolFile file;
+        file.path = path;
+        SolReadOptions options;
+        options.keepraw = true;
+        SOL_CHECK(ReadSolFile(file, options) && file.raw);
+        return file;
+    }
+
+    SolFile Reread(const std::string& path)
+    {
+        SolFile file;
+        file.path = path;
+        SOL_CHECK(ReadSolFile(file));
+        return file;
+    }
+
+    // an unedited file is copied back byte for byte, and every edit reads back as made
+    void TestSaves(const std::string& path)
+    {
+        SolFile original = ReadRaw(path);
+        if (!original.raw) {
+            return;
+        }
+
+        SolFile unedited = original;
+        unedited.path = test::TempPath("passthrough-out.sol");
+        SOL_CHECK(WriteSolFile(unedited));
+        SOL_CHECK(utils::ReadFile(unedited.path) == utils::ReadFile(path));
+
+        for (auto& entry : original.raw->entries) {
+            for (int edit = 0; edit < 3; ++edit) {
+                SolFile edited = original;
+                edited.path = test::TempPath("passthrough-out.sol");
+
+                if (edit == 0) {
+                    edited.data.erase(entry.key);
+                }
+                else if (edit == 1) {
+                    edited.data[entry.key] = SolValue(std::string("changed"));
+                }
+                else {
+                    edited.data["added"] = SolValue(1.0);
+                }
+                SOL_CHECK(WriteSolFile(edited));
+                SOL_CHECK(Reread(edited.path).data == edited.data);
+            }
+        }
+    }
+
+    // an edited entry or container whose hash matches the one read must still be written
+    void TestCollisions()
+    {
+        auto path = test::TempPath("passthrough-collide.sol");
+        SolFile file;
+        file.path = path;
+        file.solname = "collide";
+        file.version = SolVersion::AMF3;
+
+        // two containers large enough to be kept as subtrees
+        SolArray big, other;
+        for (int i = 0; i < 64; ++i) {
+            big.dense.emplace_back(utils::FormatString("item %d", i));
+            other.dense.emplace_back(SolDouble(i) / 3);
+        }
+        SolArray root;
+        root.dense.emplace_back(big);
+        root.dense.emplace_back(other);
+        file.data["root"] = SolValue(root);
+        file.data["text"] = SolValue(std::string("hero"));
+        SOL_CHECK(WriteSolFile(file));
+
+        SolFile edited = ReadRaw(path);
+        if (!edited.raw) {
+            return;
+        }
+        auto raw = std::const_pointer_cast<SolRawFile>(edited.raw);
+        edited.path = test::TempPath("passthrough-collide-out.sol");
+
+        // the edited entry takes the hash the old one had
+        edited.data["text"] = SolValue(std::string("villain"));
+        for (auto& entry : raw->entries) {
+            if (entry.key == "text") {
+                entry.hash = SolValueHash()(edited.data["text"]);
+            }
+        }
+
+        // and the edited container the hash of the one it replaces
+        auto& dense = std::get<SolArray>(edited.data["root"].value).dense;
+        auto& changed = std::get<SolArray>(dense[0].value);
+        size_t oldhash = SolValueHash()(SolValue(big));
+        changed.dense[5] = SolValue(std::string("edited"));
+
+        bool found = false;
+        for (auto& subtree : raw->subtrees) {
+            if (subtree.hash == oldhash) {
+                subtree.hash = SolValueHash()(dense[0]);
+                found = true;
+            }
+        }
+        SOL_CHECK(found);
+        std::sort(raw->subtrees.begin(), raw->subtrees.end(),
+            [](const SolRawSubtree& a, const SolRawSubtree& b) { return a.hash < b.hash; });
+
+        SOL_CHECK(WriteSolFile(edited));
+        SOL_CHECK(Reread(edited.path).data == edited.data);
+    }
+}
+
+
+int main()
+{
+    for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+        auto path = test::TempPath(version == SolVersion::AMF3 ? "passthrough-amf3.sol" : "passthrough-amf0.sol");
+        SolFile sample = test::SampleFile(version, path);
+        SOL_CHECK(WriteSolFile(sample));
+        TestSaves(path);
+
+        // with references and nesting WriteSolFile does not produce
+        bench::SolCorpusShape shape;
+        shape.version = version;
+        shape.entries = 6;
+        shape.depth = 3;
+        shape.fanout = 5;
+        shape.refdensity = 0.1;
+        path = test::TempPath("passthrough-generated.sol");
+        utils::WriteFile(path, bench::GenerateSolData(shape));
+        TestSaves(path);
+    }
+    TestCollisions();
+    return test::Result();
+}
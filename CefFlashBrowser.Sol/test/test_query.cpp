@@ -0,0 +1,155 @@
+#include "check.h"
+#include "../bench/generator.h"
+#include "../query.h"
+#include "../utils.h"
+#include <functional>
+#include <stdexcept>
+
+
+namespace
+{
+    using namespace sol;
+
+    std::vector<SolQueryMatch> Query(const std::string& path, const std::string& expression, bool values = true)
+    {
+        std::vector<SolQueryMatch> matches;
+        SolError error;
+        SOL_CHECK(QuerySolFile(path, SolQuery(expression), values, matches, error));
+        return matches;
+    }
+
+    // every value is found by its own path, at the same offset with or without its value
+    void TestPaths(const std::string& path, size_t budget)
+    {
+        SolFile file;
+        file.path = path;
+        SOL_CHECK(ReadSolFile(file));
+
+        auto entries = Query(path, "*");
+        SOL_CHECK(entries.size() == file.data.size());
+        for (auto& match : entries) {
+            SOL_CHECK(file.data.count(match.key) && match.value == file.data[match.key]);
+        }
+
+        std::function<void(const std::string&, SolPath&, const SolValue&)> walk = [&](const std::string& key, SolPath& steps, const SolValue& value) {
+            if (budget == 0) {
+                return;
+            }
+            --budget;
+
+            auto expression = FormatSolPath(key, steps);
+            auto matches = Query(path, expression);
+            bool found = false;
+            for (auto& match : matches) {
+                found = found || (match.path == steps && match.value == value);
+            }
+            SOL_CHECK(found);
+
+            auto offsets = Query(path, expression, false);
+            SOL_CHECK(offsets.size() == matches.size());
+            for (size_t i = 0; i < offsets.size() && i < matches.size(); ++i) {
+                SOL_CHECK(offsets[i].offset == matches[i].offset);
+            }
+
+            size_t children = 0;
+            if (value.type == SolType::Object) {
+                for (auto& [name, child] : value.get<SolObject>().props) {
+                    ++children;
+                    steps.emplace_back(name);
+                    walk(key, steps, child);
+                    steps.pop_back();
+                }
+            }
+            else if (value.type == SolType::Array) {
+                auto& arr = value.get<SolArray>();
+                children = arr.assoc.size() + arr.dense.size();
+                for (auto& [name, child] : arr.assoc) {
+                    steps.emplace_back(name);
+                    walk(key, steps, child);
+                    steps.pop_back();
+                }
+                for (size_t i = 0; i < arr.dense.size(); ++i) {
+                    steps.emplace_back(std::in_place_type<size_t>, i);
+                    walk(key, steps, arr.dense[i]);
+                    steps.pop_back();
+                }
+            }
+            else {
+                return;
+            }
+            SOL_CHECK(Query(path, expression + "[*]").size() == children);
+        };
+
+        for (auto& [key, value] : file.data) {
+            SolPath steps;
+            walk(key, steps, value);
+        }
+    }
+
+    void TestFilters(const std::string& path)
+    {
+        auto first = Query(path, "player.items[0]");
+        SOL_CHECK(first.size() == 1 && first[0].value == SolValue(1.5));
+
+        auto text = Query(path, "player.items[?@ == 'x']");
+        SOL_CHECK(text.size() == 1 && text[0].path == SolPath({ std::string("items"), size_t(1) }));
+        SOL_CHECK(Query(path, "player.items[?@ > 1]").size() == 1);
+        SOL_CHECK(Query(path, "player.items[?@ == true]").size() == 1);
+        SOL_CHECK(Query(path, "player.items[?@ != true]").size() == 2);
+
+        auto level = Query(path, "[?name == \"hero\"].level");
+        SOL_CHECK(level.size() == 1 && level[0].key == "player");
+        SOL_CHECK(Query(path, "*[?@ == \"hero\"]").size() == 1);
+        SOL_CHECK(Query(path, "[?level >= 12]").size() == 1 && Query(path, "[?level > 12]").empty());
+        SOL_CHECK(Query(path, "[?items[2]]").size() == 1 && Query(path, "[?items[5]]").empty());
+        SOL_CHECK(Query(path, "*[?@ == null]").empty());
+
+        SOL_CHECK(Query(path, "null").size() == 1 && Query(path, "missing").empty());
+        SOL_CHECK(Query(path, "text.x").empty() && Query(path, "player.items.x").empty());
+        SOL_CHECK(Query(path, "[ 'player' ][ \"items\" ][ * ]").size() == 3);
+    }
+
+    void TestParse()
+    {
+        const char* expressions[] = { "", ".", "a.", "a[", "a[1", "a[?]", "a[?x ==]", "a[?x = 1]", "a['x", "a..b", "1a", "a[x]", "a b" };
+        for (auto expression : expressions) {
+            bool thrown = false;
+            try {
+                SolQuery query(expression);
+            }
+            catch (const std::runtime_error&) {
+                thrown = true;
+            }
+            SOL_CHECK(thrown);
+        }
+
+        SolQuery query("items[?level >= 3].name");
+        SOL_CHECK(query.steps().size() == 3);
+        SOL_CHECK(query.steps()[1].kind == SolQueryStepKind::Filter && query.steps()[1].op == SolQueryOp::GreaterEqual);
+    }
+}
+
+
+int main()
+{
+    for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+        auto path = test::TempPath("query-sample.sol");
+        SolFile sample = test::SampleFile(version, path);
+        SOL_CHECK(WriteSolFile(sample));
+        TestPaths(path, 300);
+        TestFilters(path);
+
+        // through object and string references
+        bench::SolCorpusShape shape;
+        shape.version = version;
+        shape.entries = 4;
+        shape.depth = 3;
+        shape.fanout = 4;
+        shape.refdensity = 0.2;
+        path = test::TempPath("query-generated.sol");
+        utils::WriteFile(path, bench::GenerateSolData(shape));
+        TestPaths(path, 300);
+    }
+    TestParse();
+    return test::Result();
+}
@@ -0,0 +1,104 @@
+#include "check.h"
+#include "../utils.h"
+#include <stdexcept>
+
+
+namespace
+{
+    using namespace sol;
+
+    void TestRoundTrip(SolVersion version)
+    {
+        auto path = test::TempPath(version == SolVersion::AMF3 ? "reader-amf3.sol" : "reader-amf0.sol");
+        SolFile file = test::SampleFile(version, path);
+        SOL_CHECK(WriteSolFile(file));
+
+        SolFile read;
+        read.path = path;
+        SOL_CHECK(ReadSolFile(read));
+        SOL_CHECK(read.solname == file.solname && read.version == version);
+        SOL_CHECK(read.data == file.data);
+
+        // from memory, the bytes ReadSolFile saw
+        auto bytes = utils::ReadFile(path);
+        SolFile frommemory;
+        SolError error;
+        SOL_CHECK(TryReadSolData(bytes.data(), bytes.size(), frommemory, error));
+        SOL_CHECK(frommemory.data == file.data);
+
+        // every shorter prefix fails without reading past its end
+        for (size_t size = 0; size < bytes.size(); ++size) {
+            std::vector<uint8_t> prefix(bytes.begin(), bytes.begin() + size);
+            SolFile truncated;
+            SolError failed;
+            SOL_CHECK(!TryReadSolData(prefix.data(), prefix.size(), truncated, failed) && failed.failed());
+        }
+    }
+
+    void TestLengthPastEnd()
+    {
+        // a length near 4 GB must not wrap the bounds check around
+        const uint8_t longstring[] = { 0xFF, 0xFF, 0xFF, 0xFF, 'a' };
+        size_t index = 0;
+        bool thrown = false;
+        try {
+            ReadAMF0LongString(longstring, sizeof(longstring), index);
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        SOL_CHECK(thrown);
+
+        // and neither must an offset at the very end
+        index = sizeof(longstring);
+        thrown = false;
+        try {
+            ReadAMF0LongString(longstring, sizeof(longstring), index);
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        SOL_CHECK(thrown);
+    }
+
+    void TestMappedFile()
+    {
+        // files of 16 MB and more are mapped rather than read into a buffer
+        auto path = test::TempPath("reader-mapped.sol");
+        SolFile file;
+        file.path = path;
+        file.solname = "mapped";
+        file.version = SolVersion::AMF3;
+
+        SolBinary blob(17 << 20);
+        for (size_t i = 0; i < blob.size(); ++i) {
+            blob[i] = static_cast<uint8_t>(i * 31);
+        }
+        file.data["blob"] = SolValue(std::move(blob));
+        file.data["after"] = SolValue(std::string("end"));
+        SOL_CHECK(WriteSolFile(file));
+
+        utils::MappedFile mapped;
+        SOL_CHECK(mapped.open(path));
+        SOL_CHECK(mapped.size() > (16 << 20));
+        SOL_CHECK(mapped.data() != nullptr && mapped.data()[0] == 0x00 && mapped.data()[1] == 0xBF);
+
+        SolFile read;
+        read.path = path;
+        SOL_CHECK(ReadSolFile(read));
+        SOL_CHECK(read.data == file.data);
+
+        utils::MappedFile missing;
+        SOL_CHECK(!missing.open(test::TempPath("no-such-file.sol")));
+    }
+}
+
+
+int main()
+{
+    TestRoundTrip(sol::SolVersion::AMF0);
+    TestRoundTrip(sol::SolVersion::AMF3);
+    TestLengthPastEnd();
+    TestMappedFile();
+    return sol::test::Result();
+}
@@ -0,0 +1,135 @@
+#include "check.h"
+#include "../bench/generator.h"
+#include "../snapshot.h"
+#include "../validate.h"
+#include <filesystem>
+
+
+namespace
+{
+    using namespace sol;
+
+    std::vector<uint8_t> Bytes(SolFile file)
+    {
+        file.path = test::TempPath("snapshot-file.sol");
+        SOL_CHECK(WriteSolFile(file));
+        return utils::ReadFile(file.path);
+    }
+
+    // a long array of objects, with one of them changed or one inserted
+    SolFile Items(SolVersion version, int insertat, int changeat)
+    {
+        SolFile file;
+        file.solname = "items";
+        file.version = version;
+
+        SolArray items;
+        for (int i = 0; i < 3000; ++i) {
+            SolObject item;
+            item.classdef.dynamic = version == SolVersion::AMF3;
+            if (i == insertat) {
+                item.props["id"] = SolValue(-1.0);
+                items.dense.emplace_back(item);
+            }
+            item.props["id"] = SolValue(SolDouble(i == changeat ? 99999 : i));
+            item.props["score"] = SolValue(i * 3.5);
+            items.dense.emplace_back(std::move(item));
+        }
+        file.data["items"] = SolValue(std::move(items));
+        file.data["tail"] = SolValue(2.0);
+        return file;
+    }
+
+    // the chunks cover the file in order, and fail where the validator fails
+    void TestChunks(const std::vector<uint8_t>& data)
+    {
+        std::vector<size_t> ends;
+        SolError error, validated;
+        bool chunked = ChunkSolData(data.data(), data.size(), ends, error);
+        SOL_CHECK(chunked == ValidateSolData(data.data(), data.size(), validated));
+        if (!chunked) {
+            SOL_CHECK(error.code == validated.code && error.offset == validated.offset);
+            return;
+        }
+        SOL_CHECK(!ends.empty() && ends.back() == data.size());
+        for (size_t i = 1; i < ends.size(); ++i) {
+            SOL_CHECK(ends[i] > ends[i - 1]);
+        }
+    }
+
+    void TestStore()
+    {
+        SolSnapshotStore store(test::TempPath("snapshots"));
+        std::string errmsg;
+
+        for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+            auto original = Bytes(Items(version, -1, -1));
+            auto changed = Bytes(Items(version, -1, 1500));
+            auto inserted = Bytes(Items(version, 700, -1));
+            TestChunks(original);
+            TestChunks(std::vector<uint8_t>(original.begin(), original.end() - 7));
+
+            SolSnapshotInfo first, change, insert, again;
+            SOL_CHECK(store.take("items", original.data(), original.size(), first, errmsg));
+            SOL_CHECK(store.take("items", changed.data(), changed.size(), change, errmsg));
+            SOL_CHECK(store.take("items", inserted.data(), inserted.size(), insert, errmsg));
+            SOL_CHECK(store.take("items", original.data(), original.size(), again, errmsg));
+
+            // an edit stores the chunks around it, not the file again
+            SOL_CHECK(first.newchunks == first.chunks && first.newbytes <= original.size());
+            SOL_CHECK(change.newbytes * 10 < changed.size());
+            SOL_CHECK(insert.newbytes * 10 < inserted.size());
+            SOL_CHECK(again.newchunks == 0 && again.newbytes == 0);
+
+            std::vector<uint8_t> restored;
+            SOL_CHECK(store.restore("items", first.id, restored, errmsg) && restored == original);
+            SOL_CHECK(store.restore("items", change.id, restored, errmsg) && restored == changed);
+            SOL_CHECK(store.restore("items", insert.id, restored, errmsg) && restored == inserted);
+        }
+
+        auto history = store.history("items");
+        SOL_CHECK(history.size() == 8);
+        for (size_t i = 0; i < history.size(); ++i) {
+            SOL_CHECK(history[i].id == i + 1);
+        }
+        SOL_CHECK(store.names() == std::vector<std::string>{ "items" });
+
+        std::vector<uint8_t> restored;
+        SOL_CHECK(!store.restore("items", 9, restored, errmsg) && !errmsg.empty());
+        SOL_CHECK(!store.restore("none", 1, restored, errmsg));
+        SolSnapshotInfo info;
+        SOL_CHECK(!store.take("items", restored.data(), 0, info, errmsg));
+
+        // a damaged chunk is found out rather than restored
+        auto hex = utils::ToHexString(history[0].chunks[1].hash.data(), history[0].chunks[1].hash.size());
+        auto chunkpath = (std::filesystem::path(store.root()) / "chunks" / hex.substr(0, 2) / hex.substr(2)).string();
+        auto chunk = utils::ReadFile(chunkpath);
+        chunk[0] ^= 1;
+        utils::WriteFile(chunkpath, chunk);
+        SOL_CHECK(!store.restore("items", 1, restored, errmsg) && !errmsg.empty());
+
+        // a snapshot cut short by a crash is dropped, and the ids go on after the others
+        auto namehash = utils::Sha256::Hash("items", 5);
+        auto logpath = std::filesystem::path(store.root()) / "history" / (utils::ToHexString(namehash.data(), namehash.size()) + ".log");
+        std::filesystem::resize_file(logpath, std::filesystem::file_size(logpath) - 5);
+        SOL_CHECK(store.history("items").size() == 7);
+
+        auto sample = Bytes(test::SampleFile(SolVersion::AMF3, std::string()));
+        SOL_CHECK(store.take("items", sample.data(), sample.size(), info, errmsg) && info.id == 8);
+        SOL_CHECK(store.restore("items", info.id, restored, errmsg) && restored == sample);
+    }
+}
+
+
+int main()
+{
+    for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+        TestChunks(Bytes(test::SampleFile(version, std::string())));
+
+        bench::SolCorpusShape shape;
+        shape.version = version;
+        TestChunks(bench::GenerateSolData(shape));
+    }
+    TestStore();
+    return test::Result();
+}
@@ -0,0 +1,144 @@
+#include "check.h"
+#include "../tree.h"
+#include <cmath>
+
+
+namespace
+{
+    using namespace sol;
+
+    SolFile Store(const SolTree& tree)
+    {
+        SolFile file;
+        tree.store(file);
+        return file;
+    }
+
+    // a node keeps the hash of the value it holds, however it was built
+    void TestHashes(const SolFile& file)
+    {
+        SolTree tree(file);
+        for (auto& [key, value] : file.data) {
+            auto node = tree.get(key);
+            SOL_CHECK(node && SolNodeHash()(*node) == SolValueHash()(value));
+            SOL_CHECK(EqualsSolValue(*node, value));
+            SOL_CHECK(ToSolValue(*node) == value);
+        }
+        SOL_CHECK(Store(tree).data == file.data);
+
+        SolArray list;
+        list.dense.emplace_back(SolInteger(1));
+        list.assoc["name"] = SolValue(std::string("a"));
+        auto node = MakeSolNode(SolValue(list));
+
+        node = SetSolChild(node, size_t(0), MakeSolNode(SolValue(SolInteger(2))));
+        list.dense[0] = SolValue(SolInteger(2));
+        SOL_CHECK(node->hash == SolValueHash()(SolValue(list)) && EqualsSolValue(*node, SolValue(list)));
+
+        node = SetSolChild(node, size_t(1), MakeSolNode(SolValue(true)));
+        list.dense.emplace_back(true);
+        SOL_CHECK(node->hash == SolValueHash()(SolValue(list)) && EqualsSolValue(*node, SolValue(list)));
+
+        node = SetSolChild(node, std::string("name"), nullptr);
+        list.assoc.erase("name");
+        SOL_CHECK(node->hash == SolValueHash()(SolValue(list)) && EqualsSolValue(*node, SolValue(list)));
+        SOL_CHECK(!EqualsSolValue(*node, SolValue(SolArray())));
+
+        // an unchanged NaN is the same value, so Commit does not take it for an edit
+        SolValue nan(std::nan(""));
+        SOL_CHECK(EqualsSolValue(*MakeSolNode(nan), nan));
+        SOL_CHECK(!EqualsSolValue(*MakeSolNode(SolValue(0.0)), SolValue(SolInteger(0))));
+    }
+
+    void TestDictionary()
+    {
+        SolDictionary dict;
+        for (int i = 0; i < 100; ++i) {
+            dict[SolValue(SolInteger(i))] = SolValue(SolInteger(i * 2));
+        }
+        dict[SolValue(std::nan(""))] = SolValue(std::string("nan"));
+        auto node = MakeSolNode(SolValue(dict));
+        auto& nodes = node->get<SolNodeDictionary>();
+
+        auto key = MakeSolNode(SolValue(SolInteger(7)));
+        auto removed = nodes.set(key, nullptr);
+        dict.erase(SolValue(SolInteger(7)));
+        SOL_CHECK(removed.size() == dict.size() && !removed.find(*key));
+        for (auto& [k, v] : dict.entries()) {
+            auto found = removed.find(k);
+            SOL_CHECK(found && EqualsSolValue(**found, v));
+        }
+
+        auto replaced = removed.set(MakeSolNode(SolValue(SolInteger(8))), MakeSolNode(SolValue(std::string("eight"))));
+        SOL_CHECK(replaced.size() == removed.size());
+        SOL_CHECK(EqualsSolValue(**replaced.find(SolValue(SolInteger(8))), SolValue(std::string("eight"))));
+
+        auto added = replaced.set(key, MakeSolNode(SolValue(false)));
+        SOL_CHECK(added.size() == nodes.size() && EqualsSolValue(**added.find(*key), SolValue(false)));
+
+        // the dictionary it came from is left as it was
+        SOL_CHECK(nodes.size() == 101 && EqualsSolValue(**nodes.find(*key), SolValue(SolInteger(14))));
+        SOL_CHECK(nodes.find(SolValue(std::nan(""))) != nullptr);
+    }
+
+    // every snapshot reads back as it was committed, and shares what it did not change
+    void TestHistory(const SolFile& file)
+    {
+        std::vector<SolFile> states{ file };
+        SolHistory history{ SolTree(file) };
+
+        SolTree tree = history.current();
+        tree = tree.set("text", MakeSolNode(SolValue(std::string("villain"))));
+        history.commit(tree);
+        states.push_back(Store(tree));
+
+        tree = tree.set("player", SolPath{ std::string("items"), size_t(1) }, MakeSolNode(SolValue(SolInteger(9))));
+        history.commit(tree);
+        states.push_back(Store(tree));
+
+        tree = tree.erase("date");
+        history.commit(tree);
+        states.push_back(Store(tree));
+
+        SOL_CHECK(history.size() == states.size());
+        SOL_CHECK(history.current().get("null") == tree.get("null"));
+
+        for (size_t i = states.size() - 1; i > 0; --i) {
+            SOL_CHECK(Store(history.current()).data == states[i].data);
+            SOL_CHECK(history.undo());
+        }
+        SOL_CHECK(Store(history.current()).data == file.data);
+        SOL_CHECK(!history.canundo() && !history.undo());
+
+        for (size_t i = 1; i < states.size(); ++i) {
+            SOL_CHECK(history.redo());
+            SOL_CHECK(Store(history.current()).data == states[i].data);
+        }
+        SOL_CHECK(!history.canredo() && !history.redo());
+
+        // a commit after an undo drops the snapshots that could be redone
+        SOL_CHECK(history.undo() && history.undo());
+        history.commit(history.current().erase("xml"));
+        SOL_CHECK(!history.canredo() && history.size() == 3);
+        SOL_CHECK(!history.current().get("xml") && history.current().get("date"));
+
+        // an edit below an entry copies only the nodes along its path
+        SolTree before(file);
+        SolTree after = before.set("player", SolPath{ std::string("name") }, MakeSolNode(SolValue(std::string("zed"))));
+        SOL_CHECK(after.get("text") == before.get("text"));
+        SOL_CHECK(after.get("player") != before.get("player"));
+        SOL_CHECK(after.get("player", { std::string("items") }) == before.get("player", { std::string("items") }));
+    }
+}
+
+
+int main()
+{
+    for (auto version : { SolVersion::AMF0, SolVersion::AMF3 }) {
+        SolFile file = test::SampleFile(version, std::string());
+        TestHashes(file);
+        TestHistory(file);
+    }
+    TestDictionary();
+    return test::Result();
+}
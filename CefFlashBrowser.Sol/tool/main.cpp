@@ -0,0 +1,877 @@
+#include "../archive.h"
+#include "../bench/suite.h"
+#include "../context.h"
+#include "../diff.h"
+#include "../footprint.h"
+#include "../json.h"
+#include "../query.h"
+#include "../snapshot.h"
+#include "../stats.h"
+#include "../trace.h"
+#include "../tracker.h"
+#include "../utils.h"
+#include "../validate.h"
+#include "../visit.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+
+namespace
+{
+    void Usage()
+    {
+        std::cerr <<
+            "usage: soltool dump [--untrusted] [--stats] [--trace FILE] FILE\n"
+            "       soltool validate [--untrusted] [--jobs N] PATH...\n"
+            "       soltool convert [--untrusted] [--stats] [--trace FILE] [--amf0 | --amf3] [--threads N] INPUT OUTPUT\n"
+            "       soltool stat [--untrusted] [--jobs N] [--trace FILE] PATH...\n"
+            "       soltool footprint [--untrusted] [--sort retained | encoded | duplicated] [--top N] [--minbytes N] FILE\n"
+            "       soltool tojson [--untrusted] [--trace FILE] INPUT [OUTPUT]\n"
+            "       soltool fromjson [--untrusted] [--trace FILE] INPUT OUTPUT\n"
+            "       soltool diff [--untrusted] [--trace FILE] FROM TO [PATCH]\n"
+            "       soltool patch [--untrusted] [--trace FILE] INPUT PATCH OUTPUT\n"
+            "       soltool query [--untrusted] [--offsets] [--trace FILE] FILE QUERY\n"
+            "       soltool snapshot [--untrusted] [--trace FILE] STORE NAME FILE\n"
+            "       soltool history STORE [NAME]\n"
+            "       soltool restore [--trace FILE] STORE NAME ID OUTPUT\n"
+            "       soltool pack [--jobs N] [--nocompress] [--trace FILE] DIR ARCHIVE\n"
+            "       soltool unpack [--jobs N] [--trace FILE] ARCHIVE DIR\n"
+            "       soltool list ARCHIVE\n"
+            "       soltool watch [--untrusted] [--interval MS] DIR\n"
+            "       soltool bench [--filter TEXT] [--mintime SECONDS] [--dir PATH] [--out FILE]\n"
+            "\n"
+            "a PATH that is a directory stands for every .sol file below it, --jobs 0 uses one\n"
+            "worker per core, --stats prints what reading and writing did to stderr, --trace\n"
+            "saves the spans recorded as Chrome trace-event JSON if soltool was built with SOL_TRACE,\n"
+            "footprint lists the --top values, 20 by default and all of them for 0, that take the\n"
+            "most memory once read or bytes once written, tojson writes to stdout without OUTPUT,\n"
+            "diff lists the changes from FROM to TO, saves them to PATCH if given, and exits\n"
+            "with 1 if there are any, query prints the values at the paths QUERY matches, such\n"
+            "as player.items[?count > 1].name, or with --offsets where they are encoded,\n"
+            "snapshot adds FILE to the history of NAME in the snapshot store at STORE, history\n"
+            "lists the snapshots of NAME or the names in the store,\n"
+            "pack puts the .sol files below DIR in one archive, which unpack writes out again,\n"
+            "watch looks at DIR every --interval, 1000 by default, and lists the files changed\n";
+    }
+
+    struct Arguments
+    {
+        std::vector<std::string> paths;
+        sol::SolReadOptions readoptions;
+        unsigned jobs = 0;
+        unsigned threads = 1;
+        bool hasversion = false;
+        sol::SolVersion version = sol::SolVersion::AMF3;
+        sol::SolFootprintOptions footprintoptions;
+        size_t top = 20;
+        unsigned interval = 1000;
+        sol::bench::SolBenchOptions benchoptions;
+        const char* out = nullptr;
+        const char* trace = nullptr;
+        bool stats = false;
+        bool compress = true;
+        bool offsets = false;
+    };
+
+    // returns false on an option the command does not take
+    bool ParseArguments(int argc, char* argv[], const char* options, Arguments& args)
+    {
+        auto takes = [&](const char* option) {
+            return std::strstr(options, option) != nullptr;
+        };
+
+        for (int i = 2; i < argc; ++i) {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            if (arg[0] != '-') {
+                args.paths.push_back(arg);
+                continue;
+            }
+            if (!takes(arg)) {
+                return false;
+            }
+            if (std::strcmp(arg, "--untrusted") == 0) {
+                args.readoptions = sol::SolReadOptions::Untrusted();
+                continue;
+            }
+            if (std::strcmp(arg, "--stats") == 0) {
+                args.stats = true;
+                continue;
+            }
+            if (std::strcmp(arg, "--nocompress") == 0) {
+                args.compress = false;
+                continue;
+            }
+            if (std::strcmp(arg, "--offsets") == 0) {
+                args.offsets = true;
+                continue;
+            }
+            if (std::strcmp(arg, "--amf0") == 0 || std::strcmp(arg, "--amf3") == 0) {
+                args.hasversion = true;
+                args.version = arg[5] == '0' ? sol::SolVersion::AMF0 : sol::SolVersion::AMF3;
+                continue;
+            }
+            if (value == nullptr) {
+                return false;
+            }
+            ++i;
+
+            if (std::strcmp(arg, "--jobs") == 0) args.jobs = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--threads") == 0) args.threads = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--filter") == 0) args.benchoptions.filter = value;
+            else if (std::strcmp(arg, "--mintime") == 0) args.benchoptions.mintime = std::strtod(value, nullptr);
+            else if (std::strcmp(arg, "--dir") == 0) args.benchoptions.dir = value;
+            else if (std::strcmp(arg, "--out") == 0) args.out = value;
+            else if (std::strcmp(arg, "--trace") == 0) args.trace = value;
+            else if (std::strcmp(arg, "--interval") == 0) args.interval = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--top") == 0) args.top = std::strtoul(value, nullptr, 10);
+            else if (std::strcmp(arg, "--minbytes") == 0) args.footprintoptions.minbytes = std::strtoull(value, nullptr, 10);
+            else if (std::strcmp(arg, "--sort") == 0 && std::strcmp(value, "retained") == 0) args.footprintoptions.order = sol::SolFootprintOrder::Retained;
+            else if (std::strcmp(arg, "--sort") == 0 && std::strcmp(value, "encoded") == 0) args.footprintoptions.order = sol::SolFootprintOrder::Encoded;
+            else if (std::strcmp(arg, "--sort") == 0 && std::strcmp(value, "duplicated") == 0) args.footprintoptions.order = sol::SolFootprintOrder::Duplicated;
+            else return false;
+        }
+        return true;
+    }
+
+    // directories are expanded to the .sol files below them, in path order
+    std::vector<std::string> CollectFiles(const std::vector<std::string>& paths)
+    {
+        std::vector<std::string> files;
+
+        for (auto& path : paths) {
+            if (!std::filesystem::is_directory(path)) {
+                files.push_back(path);
+                continue;
+            }
+
+            std::vector<std::string> found;
+            for (auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+                std::string ext = entry.path().extension().string();
+                std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+                if (entry.is_regular_file() && ext == ".sol") {
+                    found.push_back(entry.path().string());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+        return files;
+    }
+
+    // calls work(state, index) for every index below count on jobs threads, each
+    // thread has a TState of its own, such as a reader context, for all its files
+    template <typename TState, typename TWork>
+    void ForEachFile(size_t count, unsigned jobs, TWork&& work)
+    {
+        if (jobs == 0) {
+            jobs = std::max(1u, std::thread::hardware_concurrency());
+        }
+        jobs = static_cast<unsigned>(std::min<size_t>(jobs, count));
+
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            TState state;
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+                work(state, i);
+            }
+        };
+
+        if (jobs <= 1) {
+            worker();
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < jobs; ++i) {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    const char* VersionName(sol::SolVersion version)
+    {
+        return version == sol::SolVersion::AMF0 ? "AMF0" : "AMF3";
+    }
+
+    void AppendQuoted(std::string& out, const std::string& str)
+    {
+        out.push_back('"');
+        for (unsigned char c : str) {
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) out += utils::FormatString("\\x%02x", c);
+                else out.push_back(static_cast<char>(c));
+            }
+        }
+        out.push_back('"');
+    }
+
+    void DumpValue(std::string& out, const sol::SolValue& value, int indent);
+
+    void DumpLine(std::string& out, int indent, const std::string& label, const sol::SolValue& value)
+    {
+        out.append(indent * 2, ' ');
+        out += label;
+        out += ": ";
+        DumpValue(out, value, indent);
+    }
+
+    // one line for scalars, containers follow with their members indented below
+    void DumpValue(std::string& out, const sol::SolValue& value, int indent)
+    {
+        using sol::SolType;
+
+        switch (value.type)
+        {
+        case SolType::Integer:
+            out += utils::FormatString("%d\n", value.get<sol::SolInteger>());
+            return;
+
+        case SolType::Double:
+            out += utils::FormatString("%.17g\n", value.get<sol::SolDouble>());
+            return;
+
+        case SolType::Date:
+            out += utils::FormatString("date %.17g\n", value.get<sol::SolDouble>());
+            return;
+
+        case SolType::String:
+        case SolType::XmlDoc:
+        case SolType::Xml:
+            if (value.type != SolType::String) {
+                out += sol::GetTypeName(value.type);
+                out.push_back(' ');
+            }
+            AppendQuoted(out, value.get<sol::SolString>());
+            out.push_back('\n');
+            return;
+
+        case SolType::Binary: {
+            auto& bytes = value.get<sol::SolBinary>();
+            out += utils::FormatString("binary %zu bytes", bytes.size());
+            for (size_t i = 0; i < bytes.size() && i < 32; ++i) {
+                out += utils::FormatString(i ? " %02x" : ": %02x", bytes[i]);
+            }
+            out += bytes.size() > 32 ? " ...\n" : "\n";
+            return;
+        }
+
+        case SolType::Array: {
+            auto& arr = value.get<sol::SolArray>();
+            out += utils::FormatString("array %zu dense, %zu assoc\n", arr.dense.size(), arr.assoc.size());
+            for (size_t i = 0; i < arr.dense.size(); ++i) {
+                DumpLine(out, indent + 1, utils::FormatString("[%zu]", i), arr.dense[i]);
+            }
+            for (auto& [key, item] : arr.assoc) {
+                DumpLine(out, indent + 1, key, item);
+            }
+            return;
+        }
+
+        case SolType::Object: {
+            auto& obj = value.get<sol::SolObject>();
+            out += "object";
+            if (!obj.classdef.name.empty()) {
+                out.push_back(' ');
+                out += obj.classdef.name;
+            }
+            out += obj.classdef.dynamic ? " dynamic" : "";
+            out += obj.classdef.externalizable ? " externalizable" : "";
+            out.push_back('\n');
+            for (auto& [key, item] : obj.props) {
+                DumpLine(out, indent + 1, key, item);
+            }
+            return;
+        }
+
+        case SolType::Dictionary: {
+            auto& dict = value.get<sol::SolDictionary>();
+            out += utils::FormatString("dictionary %zu entries%s\n", dict.size(), dict.weakkeys ? " weakkeys" : "");
+            for (auto& [key, item] : dict.entries()) {
+                DumpLine(out, indent + 1, "key", key);
+                DumpLine(out, indent + 2, "value", item);
+            }
+            return;
+        }
+
+        default:
+            out += sol::GetTypeName(value.type);
+            out.push_back('\n');
+            return;
+        }
+    }
+
+    int Dump(const Arguments& args)
+    {
+        if (args.paths.size() != 1) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolFile file;
+        sol::SolError error;
+        sol::SolStats stats;
+        sol::SolReadOptions options = args.readoptions;
+        options.stats = args.stats ? &stats : nullptr;
+        file.path = args.paths[0];
+        if (!sol::TryReadSolFile(file, error, options)) {
+            std::cerr << file.path << ": " << error.message() << "\n";
+            return 1;
+        }
+        if (args.stats) {
+            std::cerr << "read: " << stats.report();
+        }
+
+        std::string out = utils::FormatString("name: %s\nversion: %s\nentries: %zu\n",
+            file.solname.c_str(), VersionName(file.version), file.data.size());
+        for (auto& [key, value] : file.data) {
+            DumpLine(out, 0, key, value);
+        }
+        std::cout << out;
+        return 0;
+    }
+
+    // only the grammar is checked, no values are built
+    int Validate(const Arguments& args)
+    {
+        std::vector<std::string> files = CollectFiles(args.paths);
+        std::vector<sol::SolError> errors(files.size());
+
+        struct NoState {};
+        ForEachFile<NoState>(files.size(), args.jobs, [&](NoState&, size_t i) {
+            sol::ValidateSolFile(files[i], errors[i], args.readoptions);
+        });
+
+        size_t invalid = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (errors[i].failed()) {
+                std::cout << files[i] << ": " << errors[i].message() << "\n";
+                ++invalid;
+            }
+        }
+        std::cout << files.size() << " files, " << invalid << " invalid\n";
+        return invalid ? 1 : 0;
+    }
+
+    // entries are copied from the input where the version stays the same
+    int Convert(const Arguments& args)
+    {
+        if (args.paths.size() != 2) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolFile file;
+        sol::SolError error;
+        sol::SolStats readstats;
+        sol::SolReadOptions options = args.readoptions;
+        options.keepraw = true;
+        options.stats = args.stats ? &readstats : nullptr;
+        file.path = args.paths[0];
+        if (!sol::TryReadSolFile(file, error, options)) {
+            std::cerr << file.path << ": " << error.message() << "\n";
+            return 1;
+        }
+
+        sol::SolStats writestats;
+        sol::SolWriteOptions writeoptions;
+        writeoptions.threads = args.threads;
+        writeoptions.stats = args.stats ? &writestats : nullptr;
+        file.path = args.paths[1];
+        if (args.hasversion) {
+            file.version = args.version;
+        }
+        if (!sol::WriteSolFile(file, writeoptions)) {
+            std::cerr << file.path << ": " << file.errmsg << "\n";
+            return 1;
+        }
+        if (args.stats) {
+            std::cerr << "read: " << readstats.report() << "write: " << writestats.report();
+        }
+        return 0;
+    }
+
+    struct FileStat
+    {
+        std::string errmsg;
+        sol::SolVersion version = sol::SolVersion::AMF0;
+        uint64_t bytes = 0;
+        uint64_t entries = 0;
+        uint64_t nodes = 0;
+        uint64_t strbytes = 0;  // strings and xml
+        uint64_t binbytes = 0;
+        uint64_t types[256] = {};
+    };
+
+    int Stat(const Arguments& args)
+    {
+        std::vector<std::string> files = CollectFiles(args.paths);
+        std::vector<FileStat> stats(files.size());
+
+        ForEachFile<sol::SolReaderContext>(files.size(), args.jobs, [&](sol::SolReaderContext& reader, size_t i) {
+            FileStat& stat = stats[i];
+            sol::SolFile file;
+            sol::SolError error;
+            file.path = files[i];
+
+            std::error_code ec;
+            stat.bytes = std::filesystem::file_size(files[i], ec);
+            if (!reader.tryread(file, error, args.readoptions)) {
+                stat.errmsg = error.message();
+                return;
+            }
+
+            stat.version = file.version;
+            stat.entries = file.data.size();
+            for (auto& [key, value] : file.data) {
+                sol::WalkSolValue(value, [&](const sol::SolValue& item) {
+                    ++stat.nodes;
+                    ++stat.types[static_cast<uint8_t>(item.type)];
+                    if (item.is<sol::SolString>()) stat.strbytes += item.get<sol::SolString>().size();
+                    else if (item.is<sol::SolBinary>()) stat.binbytes += item.get<sol::SolBinary>().size();
+                });
+            }
+        });
+
+        FileStat total;
+        size_t invalid = 0;
+        std::string out;
+
+        for (size_t i = 0; i < files.size(); ++i) {
+            const FileStat& stat = stats[i];
+            if (!stat.errmsg.empty()) {
+                out += files[i] + ": " + stat.errmsg + "\n";
+                ++invalid;
+                continue;
+            }
+            out += utils::FormatString("%s: %s, %llu bytes, %llu entries, %llu nodes\n", files[i].c_str(),
+                VersionName(stat.version), (unsigned long long)stat.bytes, (unsigned long long)stat.entries,
+                (unsigned long long)stat.nodes);
+
+            total.bytes += stat.bytes;
+            total.entries += stat.entries;
+            total.nodes += stat.nodes;
+            total.strbytes += stat.strbytes;
+            total.binbytes += stat.binbytes;
+            for (size_t t = 0; t < 256; ++t) {
+                total.types[t] += stat.types[t];
+            }
+        }
+
+        out += utils::FormatString("\n%zu files, %zu invalid, %llu bytes, %llu entries, %llu nodes\n",
+            files.size(), invalid, (unsigned long long)total.bytes, (unsigned long long)total.entries,
+            (unsigned long long)total.nodes);
+        out += utils::FormatString("string bytes %llu, binary bytes %llu\n",
+            (unsigned long long)total.strbytes, (unsigned long long)total.binbytes);
+        for (size_t t = 0; t < 256; ++t) {
+            if (total.types[t]) {
+                out += utils::FormatString("  %-12s %llu\n", sol::GetTypeName(static_cast<sol::SolType>(t)),
+                    (unsigned long long)total.types[t]);
+            }
+        }
+        std::cout << out;
+        return invalid ? 1 : 0;
+    }
+
+    int Footprint(const Arguments& args)
+    {
+        if (args.paths.size() != 1) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolFile file;
+        sol::SolError error;
+        file.path = args.paths[0];
+        if (!sol::TryReadSolFile(file, error, args.readoptions)) {
+            std::cerr << file.path << ": " << error.message() << "\n";
+            return 1;
+        }
+
+        sol::SolFootprintOptions options = args.footprintoptions;
+        options.limit = args.top != 0 ? args.top : SIZE_MAX;
+        std::cout << sol::GetSolFootprint(file, options).report();
+        return 0;
+    }
+
+    // streamed both ways, the layout is described in json.h
+    int ToJson(const Arguments& args)
+    {
+        if (args.paths.size() != 1 && args.paths.size() != 2) {
+            Usage();
+            return 2;
+        }
+
+        std::ofstream file;
+        if (args.paths.size() == 2) {
+            file.open(args.paths[1], std::ios::binary);
+            if (!file.is_open()) {
+                std::cerr << "Failed to open " << args.paths[1] << "\n";
+                return 1;
+            }
+        }
+
+        sol::SolError error;
+        if (!sol::TranscodeSolFileToJson(args.paths[0], file.is_open() ? file : std::cout, error, args.readoptions)) {
+            std::cerr << args.paths[0] << ": " << error.message() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    int FromJson(const Arguments& args)
+    {
+        if (args.paths.size() != 2) {
+            Usage();
+            return 2;
+        }
+
+        std::string errmsg;
+        if (!sol::TranscodeJsonFileToSol(args.paths[0], args.paths[1], errmsg, args.readoptions)) {
+            std::cerr << args.paths[0] << ": " << errmsg << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    int Diff(const Arguments& args)
+    {
+        if (args.paths.size() != 2 && args.paths.size() != 3) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolPatch patch;
+        sol::SolError error;
+        if (!sol::DiffSolFilePaths(args.paths[0], args.paths[1], patch, error, args.readoptions)) {
+            std::cerr << error.message() << "\n";
+            return 2;
+        }
+
+        std::string errmsg;
+        if (args.paths.size() == 3 && !sol::SaveSolPatch(patch, args.paths[2], errmsg)) {
+            std::cerr << args.paths[2] << ": " << errmsg << "\n";
+            return 2;
+        }
+
+        std::cout << patch.report();
+        return patch.empty() ? 0 : 1;
+    }
+
+    int Patch(const Arguments& args)
+    {
+        if (args.paths.size() != 3) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolPatch patch;
+        std::string errmsg;
+        if (!sol::LoadSolPatch(args.paths[1], patch, errmsg)) {
+            std::cerr << args.paths[1] << ": " << errmsg << "\n";
+            return 1;
+        }
+        if (!sol::PatchSolFile(args.paths[0], patch, args.paths[2], errmsg, args.readoptions)) {
+            std::cerr << args.paths[0] << ": " << errmsg << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // only the entries and children along the query are looked into
+    int Query(const Arguments& args)
+    {
+        if (args.paths.size() != 2) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolQuery query(args.paths[1]);
+        std::vector<sol::SolQueryMatch> matches;
+        sol::SolError error;
+        if (!sol::QuerySolFile(args.paths[0], query, !args.offsets, matches, error, args.readoptions)) {
+            std::cerr << args.paths[0] << ": " << error.message() << "\n";
+            return 1;
+        }
+
+        std::string out;
+        for (auto& match : matches) {
+            std::string path = sol::FormatSolPath(match.key, match.path);
+            if (args.offsets) {
+                out += utils::FormatString("%10zu  %s\n", match.offset, path.c_str());
+            }
+            else {
+                DumpLine(out, 0, path, match.value);
+            }
+        }
+        std::cout << out;
+        return 0;
+    }
+
+    int Snapshot(const Arguments& args)
+    {
+        if (args.paths.size() != 3) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolSnapshotStore store(args.paths[0]);
+        sol::SolSnapshotInfo info;
+        std::string errmsg;
+        if (!store.take(args.paths[1], args.paths[2], info, errmsg, args.readoptions)) {
+            std::cerr << args.paths[2] << ": " << errmsg << "\n";
+            return 1;
+        }
+
+        std::cout << utils::FormatString("snapshot %llu: %zu chunks, %zu new, %llu bytes stored\n",
+            static_cast<unsigned long long>(info.id), info.chunks, info.newchunks, static_cast<unsigned long long>(info.newbytes));
+        return 0;
+    }
+
+    int History(const Arguments& args)
+    {
+        if (args.paths.size() != 1 && args.paths.size() != 2) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolSnapshotStore store(args.paths[0]);
+        if (args.paths.size() == 1) {
+            auto names = store.names();
+            std::sort(names.begin(), names.end());
+            for (auto& name : names) {
+                std::cout << name << "\n";
+            }
+            return 0;
+        }
+
+        for (auto& snapshot : store.history(args.paths[1])) {
+            std::time_t time = static_cast<std::time_t>(snapshot.time / 1000);
+            char text[32] = "";
+            if (std::tm* local = std::localtime(&time)) {
+                std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", local);
+            }
+            std::cout << utils::FormatString("%6llu  %s  %10llu bytes  %zu chunks\n", static_cast<unsigned long long>(snapshot.id),
+                text, static_cast<unsigned long long>(snapshot.size), snapshot.chunks.size());
+        }
+        return 0;
+    }
+
+    int Restore(const Arguments& args)
+    {
+        if (args.paths.size() != 4) {
+            Usage();
+            return 2;
+        }
+
+        char* end;
+        unsigned long long id = std::strtoull(args.paths[2].c_str(), &end, 10);
+        if (*end != '\0') {
+            Usage();
+            return 2;
+        }
+
+        sol::SolSnapshotStore store(args.paths[0]);
+        std::string errmsg;
+        if (!store.restore(args.paths[1], id, args.paths[3], errmsg)) {
+            std::cerr << errmsg << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    int Pack(const Arguments& args)
+    {
+        if (args.paths.size() != 2) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolArchiveOptions options;
+        options.compress = args.compress;
+        options.threads = args.jobs;
+
+        std::string errmsg;
+        if (!sol::PackSolDirectory(args.paths[0], args.paths[1], errmsg, options)) {
+            std::cerr << args.paths[1] << ": " << errmsg << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    int Unpack(const Arguments& args)
+    {
+        if (args.paths.size() != 2) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolArchive archive;
+        std::string errmsg;
+        if (!archive.open(args.paths[0], errmsg) || !archive.extract(args.paths[1], errmsg, args.jobs)) {
+            std::cerr << args.paths[0] << ": " << errmsg << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    int List(const Arguments& args)
+    {
+        if (args.paths.size() != 1) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolArchive archive;
+        std::string errmsg;
+        if (!archive.open(args.paths[0], errmsg)) {
+            std::cerr << args.paths[0] << ": " << errmsg << "\n";
+            return 1;
+        }
+
+        for (auto& member : archive.members()) {
+            std::cout << utils::FormatString("%10llu %10llu  %s\n", static_cast<unsigned long long>(member.size),
+                static_cast<unsigned long long>(member.stored), member.name.c_str());
+        }
+        return 0;
+    }
+
+    // runs until interrupted, soltool has no watcher of its own, so the whole directory
+    // is scanned each time, which reads only the files whose size or write time changed
+    int Watch(const Arguments& args)
+    {
+        if (args.paths.size() != 1 || !std::filesystem::is_directory(args.paths[0])) {
+            Usage();
+            return 2;
+        }
+
+        sol::SolTrackerOptions options;
+        options.readoptions = args.readoptions;
+        sol::SolChangeTracker tracker(args.paths[0], options);
+
+        std::cout << utils::FormatString("%zu files\n", tracker.scan().size());
+        std::cout.flush();
+
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::max(1u, args.interval)));
+
+            for (auto& change : tracker.scan()) {
+                if (change.kind == sol::SolFileChangeKind::Removed) {
+                    std::cout << "removed   " << change.path << "\n";
+                    continue;
+                }
+                std::cout << (change.kind == sol::SolFileChangeKind::Added ? "added     " : "modified  ") << change.path
+                    << utils::FormatString("  %llu bytes", static_cast<unsigned long long>(change.size));
+                if (change.valid) {
+                    std::cout << "  " << VersionName(change.version) << " " << change.solname << "\n";
+                }
+                else {
+                    std::cout << "  invalid: " << change.errmsg << "\n";
+                }
+            }
+            std::cout.flush();
+        }
+    }
+
+    // the suite of solbench, without allocation counts
+    int Bench(const Arguments& args)
+    {
+        std::ofstream file;
+        if (args.out) {
+            file.open(args.out, std::ios::app);
+            if (!file.is_open()) {
+                std::cerr << "Failed to open " << args.out << "\n";
+                return 1;
+            }
+        }
+
+        sol::bench::RunBenchmarks(args.benchoptions, [&](const sol::bench::SolBenchResult& result) {
+            if (file.is_open()) {
+                file << sol::bench::ToJson(result) << "\n";
+            }
+            std::cout << utils::FormatString("%-32s %10.3f ms %9.1f MB/s %12.0f nodes/s\n",
+                result.name.c_str(), result.seconds * 1e3, result.mbps(), result.nodesps());
+            std::cout.flush();
+        });
+        return 0;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    struct Command
+    {
+        const char* name;
+        const char* options;
+        int (*run)(const Arguments&);
+    };
+
+    static const Command commands[] = {
+        { "dump", "--untrusted --stats --trace", Dump },
+        { "validate", "--untrusted --jobs", Validate },
+        { "convert", "--untrusted --stats --trace --amf0 --amf3 --threads", Convert },
+        { "stat", "--untrusted --jobs --trace", Stat },
+        { "footprint", "--untrusted --sort --top --minbytes", Footprint },
+        { "tojson", "--untrusted --trace", ToJson },
+        { "fromjson", "--untrusted --trace", FromJson },
+        { "diff", "--untrusted --trace", Diff },
+        { "patch", "--untrusted --trace", Patch },
+        { "query", "--untrusted --offsets --trace", Query },
+        { "snapshot", "--untrusted --trace", Snapshot },
+        { "history", "", History },
+        { "restore", "--trace", Restore },
+        { "pack", "--jobs --nocompress --trace", Pack },
+        { "unpack", "--jobs --trace", Unpack },
+        { "list", "", List },
+        { "watch", "--untrusted --interval", Watch },
+        { "bench", "--filter --mintime --dir --out", Bench },
+    };
+
+    try {
+        for (auto& command : commands) {
+            if (argc > 1 && std::strcmp(argv[1], command.name) == 0) {
+                Arguments args;
+                if (!ParseArguments(argc, argv, command.options, args)) {
+                    Usage();
+                    return 2;
+                }
+                if (args.trace && !sol::trace::enabled) {
+                    std::cerr << "soltool was built without SOL_TRACE, no spans are recorded\n";
+                }
+
+                int result = command.run(args);
+                if (args.trace) {
+                    sol::trace::Save(args.trace);
+                }
+                return result;
+            }
+        }
+
+        Usage();
+        return argc > 1 && (std::strcmp(argv[1], "--help") == 0 || std::strcmp(argv[1], "-h") == 0) ? 0 : 2;
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
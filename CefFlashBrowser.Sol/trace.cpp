@@ -0,0 +1,153 @@
+#include "trace.h"
+#include "utils.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace
+{
+    struct SpanRecord
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+        char note[48];
+    };
+
+    // the spans of one thread, kept by the registry after the thread ends so that
+    // they can still be saved, the lock is only contended by ToJson and Clear
+    struct ThreadSpans
+    {
+        uint32_t tid = 0;
+        std::mutex lock;
+        std::vector<SpanRecord> ring;
+        size_t count = 0;   // recorded since the last Clear, the ring holds the last of them
+    };
+
+    struct Registry
+    {
+        std::mutex lock;
+        std::vector<std::shared_ptr<ThreadSpans>> threads;
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    ThreadSpans& GetThreadSpans()
+    {
+        thread_local std::shared_ptr<ThreadSpans> spans = []() {
+            auto result = std::make_shared<ThreadSpans>();
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> guard(registry.lock);
+            result->tid = static_cast<uint32_t>(registry.threads.size() + 1);
+            registry.threads.push_back(result);
+            return result;
+        }();
+        return *spans;
+    }
+
+    void AppendEscaped(std::string& out, const char* text)
+    {
+        for (const char* p = text; *p; ++p) {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\') {
+                out.push_back('\\');
+                out.push_back(static_cast<char>(c));
+            }
+            else if (c < 0x20) {
+                out += utils::FormatString("\\u%04x", c);
+            }
+            else {
+                out.push_back(static_cast<char>(c));
+            }
+        }
+    }
+}
+
+
+uint64_t sol::trace::Now()
+{
+    using clock = std::chrono::steady_clock;
+    static const clock::time_point epoch = clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count());
+}
+
+void sol::trace::Record(const char* name, const char* note, uint64_t start, uint64_t end)
+{
+    ThreadSpans& spans = GetThreadSpans();
+    std::lock_guard<std::mutex> guard(spans.lock);
+
+    SpanRecord record{ name, start, end, {} };
+    std::strncpy(record.note, note, sizeof(record.note) - 1);
+
+    if (spans.ring.size() < SPAN_CAPACITY) {
+        spans.ring.push_back(record);
+    }
+    else {
+        spans.ring[spans.count % SPAN_CAPACITY] = record;
+    }
+    ++spans.count;
+}
+
+std::string sol::trace::ToJson()
+{
+    std::string result = "{\"traceEvents\":[";
+    bool first = true;
+
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+
+    for (auto& spans : registry.threads) {
+        std::lock_guard<std::mutex> threadguard(spans->lock);
+
+        // oldest first, the ring has wrapped if more were recorded than it holds
+        size_t size = spans->ring.size();
+        size_t oldest = spans->count > size ? spans->count % size : 0;
+
+        for (size_t i = 0; i < size; ++i) {
+            const SpanRecord& record = spans->ring[(oldest + i) % size];
+
+            result += first ? "\n" : ",\n";
+            first = false;
+
+            result += "{\"name\":\"";
+            AppendEscaped(result, record.name);
+            result += utils::FormatString("\",\"cat\":\"sol\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u",
+                record.start / 1e3, (record.end - record.start) / 1e3, spans->tid);
+
+            if (record.note[0]) {
+                result += ",\"args\":{\"note\":\"";
+                AppendEscaped(result, record.note);
+                result += "\"}";
+            }
+            result += "}";
+        }
+    }
+
+    result += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return result;
+}
+
+void sol::trace::Save(const std::string& path)
+{
+    std::string json = ToJson();
+    utils::WriteFile(path, std::vector<uint8_t>(json.begin(), json.end()));
+}
+
+void sol::trace::Clear()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+
+    for (auto& spans : registry.threads) {
+        std::lock_guard<std::mutex> threadguard(spans->lock);
+        spans->ring.clear();
+        spans->count = 0;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <cstdint>
+#include <string>
+
+// spans are recorded in debug builds, release builds define SOL_TRACE=1 to record
+// them too, otherwise the markers below compile to nothing
+#ifndef SOL_TRACE
+#ifdef _DEBUG
+#define SOL_TRACE 1
+#else
+#define SOL_TRACE 0
+#endif
+#endif
+
+#define SOL_TRACE_JOIN2(a, b) a##b
+#define SOL_TRACE_JOIN(a, b) SOL_TRACE_JOIN2(a, b)
+
+#if SOL_TRACE
+// records the time from here to the end of the enclosing scope under name, a string literal
+#define SOL_TRACE_SCOPE(name) ::sol::trace::Span SOL_TRACE_JOIN(_solspan, __LINE__)(name)
+// as above, for a span that is given a note, such as the key being decoded
+#define SOL_TRACE_SPAN(span, name) ::sol::trace::Span span(name)
+#define SOL_TRACE_NOTE(span, text) span.note(text)
+#else
+#define SOL_TRACE_SCOPE(name) ((void)0)
+#define SOL_TRACE_SPAN(span, name) ((void)0)
+#define SOL_TRACE_NOTE(span, text) ((void)0)
+#endif
+
+namespace sol::trace
+{
+    // whether this build records spans
+    constexpr bool enabled = SOL_TRACE != 0;
+
+    // each thread keeps its last SPAN_CAPACITY spans, older ones are overwritten
+    constexpr size_t SPAN_CAPACITY = 64 * 1024;
+
+    // the spans recorded so far on every thread as Chrome trace-event JSON, for
+    // chrome://tracing or Perfetto, spans still open are not included
+    std::string ToJson();
+
+    // writes ToJson to path, throws if it cannot be written
+    void Save(const std::string& path);
+
+    // drops the spans recorded so far
+    void Clear();
+
+    // nanoseconds since the first call, and a finished span of the calling thread
+    uint64_t Now();
+    void Record(const char* name, const char* note, uint64_t start, uint64_t end);
+
+
+    class Span
+    {
+    public:
+        explicit Span(const char* name) : _name(name), _start(Now()) {}
+        ~Span() { Record(_name, _note, _start, Now()); }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        // shown with the span, truncated to fit
+        void note(const std::string& text)
+        {
+            size_t len = text.size() < sizeof(_note) - 1 ? text.size() : sizeof(_note) - 1;
+            // not in the middle of a utf-8 sequence
+            while (len < text.size() && len > 0 && (static_cast<unsigned char>(text[len]) & 0xC0) == 0x80) {
+                --len;
+            }
+            text.copy(_note, len);
+            _note[len] = '\0';
+        }
+
+    private:
+        const char* _name;
+        uint64_t _start;
+        char _note[48] = {};
+    };
+}
+
+#endif // !__TRACE_H__
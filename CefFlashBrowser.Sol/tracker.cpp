@@ -0,0 +1,239 @@
+#include "tracker.h"
+#include "skipper.h"
+#include "trace.h"
+#include "validate.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+
+namespace
+{
+    // one spelling per path, without a trailing separator, so that the paths notified
+    // and the paths listed meet in the same keys
+    std::string NormalizePath(const std::string& path)
+    {
+        std::filesystem::path result = std::filesystem::path(path).lexically_normal();
+        if (!result.has_filename() && result.has_parent_path() && result.parent_path() != result.root_path()) {
+            result = result.parent_path();
+        }
+        return result.string();
+    }
+
+    bool IsSolPath(const std::filesystem::path& path)
+    {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return ext == ".sol";
+    }
+
+    bool IsBelow(const std::string& path, const std::string& dir)
+    {
+        return path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0
+            && (path[dir.size()] == '/' || path[dir.size()] == static_cast<char>(std::filesystem::path::preferred_separator));
+    }
+}
+
+
+struct sol::SolChangeTracker::State
+{
+    struct Pending
+    {
+        std::chrono::steady_clock::time_point first;
+        std::chrono::steady_clock::time_point last;
+    };
+
+    std::mutex lock;
+    std::unordered_map<std::string, Pending> pending;
+};
+
+
+sol::SolChangeTracker::SolChangeTracker(std::string root, SolTrackerOptions options)
+    : _root(NormalizePath(root)), _options(std::move(options)), _state(std::make_unique<State>())
+{
+}
+
+sol::SolChangeTracker::~SolChangeTracker() = default;
+
+void sol::SolChangeTracker::notify(const std::string& path)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::string key = NormalizePath(path);
+
+    std::lock_guard<std::mutex> guard(_state->lock);
+    auto [it, added] = _state->pending.try_emplace(std::move(key), State::Pending{ now, now });
+    it->second.last = now;
+}
+
+size_t sol::SolChangeTracker::pending() const
+{
+    std::lock_guard<std::mutex> guard(_state->lock);
+    return _state->pending.size();
+}
+
+std::vector<sol::SolFileChange> sol::SolChangeTracker::poll(std::chrono::steady_clock::time_point now)
+{
+    SOL_TRACE_SCOPE("poll sol changes");
+
+    std::vector<std::string> due;
+    {
+        std::lock_guard<std::mutex> guard(_state->lock);
+        for (auto it = _state->pending.begin(); it != _state->pending.end();) {
+            if (now - it->second.last >= _options.debounce || now - it->second.first >= _options.maxdelay) {
+                due.push_back(it->first);
+                it = _state->pending.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    std::sort(due.begin(), due.end());
+
+    std::vector<SolFileChange> changes;
+    std::vector<std::string> retry;
+    for (auto& path : due) {
+        // anything else may be a directory created, renamed or removed with files in it
+        if (!IsSolPath(path)) {
+            ScanDirectory(path, changes, retry);
+        }
+        else if (!Check(path, changes)) {
+            retry.push_back(path);
+        }
+    }
+
+    if (!retry.empty()) {
+        std::lock_guard<std::mutex> guard(_state->lock);
+        for (auto& path : retry) {
+            _state->pending.try_emplace(std::move(path), State::Pending{ now, now });
+        }
+    }
+    return changes;
+}
+
+std::vector<sol::SolFileChange> sol::SolChangeTracker::scan()
+{
+    SOL_TRACE_SCOPE("scan sol changes");
+
+    std::vector<SolFileChange> changes;
+    std::vector<std::string> retry;
+    ScanDirectory(_root, changes, retry);
+
+    if (!retry.empty()) {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> guard(_state->lock);
+        for (auto& path : retry) {
+            _state->pending.try_emplace(std::move(path), State::Pending{ now, now });
+        }
+    }
+    return changes;
+}
+
+// returns false if the file is there but cannot be read
+bool sol::SolChangeTracker::Check(const std::string& path, std::vector<SolFileChange>& changes)
+{
+    auto known = _known.find(path);
+
+    std::error_code ec;
+    bool exists = std::filesystem::is_regular_file(path, ec);
+    uint64_t size = exists ? std::filesystem::file_size(path, ec) : 0;
+    auto mtime = exists && !ec ? std::filesystem::last_write_time(path, ec) : std::filesystem::file_time_type();
+
+    if (!exists || ec) {
+        if (!exists && known != _known.end()) {
+            SolFileChange change;
+            change.kind = SolFileChangeKind::Removed;
+            change.path = path;
+            changes.push_back(std::move(change));
+            _known.erase(known);
+        }
+        return !exists;
+    }
+
+    // the same size and write time are taken to be the same bytes
+    if (known != _known.end() && known->second.size == size && known->second.mtime == mtime) {
+        return true;
+    }
+
+    utils::MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    // written again with the same bytes, as games often save what they loaded
+    auto hash = utils::Sha256::Hash(file.data(), file.size());
+    if (known != _known.end() && known->second.hash == hash) {
+        known->second.size = size;
+        known->second.mtime = mtime;
+        return true;
+    }
+
+    SolFileChange change;
+    change.kind = known != _known.end() ? SolFileChangeKind::Modified : SolFileChangeKind::Added;
+    change.path = path;
+    change.size = file.size();
+    change.mtime = mtime;
+
+    SolError headererror;
+    detail::Reader r{ file.data(), file.size(), 0, headererror, _options.readoptions };
+    detail::Skipper skipper{ r };
+    std::string_view solname;
+    if (skipper.SkipSolHeader(solname, change.version)) {
+        change.solname = solname;
+    }
+
+    SolError error;
+    if (_options.parse) {
+        auto parsed = std::make_shared<SolFile>();
+        parsed->path = path;
+        change.valid = TryReadSolData(file.data(), file.size(), *parsed, error, _options.readoptions);
+        if (change.valid) {
+            change.file = std::move(parsed);
+        }
+    }
+    else {
+        change.valid = ValidateSolData(file.data(), file.size(), error, _options.readoptions);
+    }
+    if (!change.valid) {
+        change.errmsg = error.message();
+    }
+
+    _known[path] = Known{ size, mtime, hash };
+    changes.push_back(std::move(change));
+    return true;
+}
+
+void sol::SolChangeTracker::ScanDirectory(const std::string& dir, std::vector<SolFileChange>& changes, std::vector<std::string>& retry)
+{
+    std::vector<std::string> found;
+
+    std::error_code ec;
+    if (std::filesystem::is_directory(dir, ec)) {
+        std::filesystem::recursive_directory_iterator it(dir, ec), end;
+        for (; !ec && it != end; it.increment(ec)) {
+            if (IsSolPath(it->path()) && it->is_regular_file(ec)) {
+                found.push_back(it->path().lexically_normal().string());
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+
+    for (auto& path : found) {
+        if (!Check(path, changes)) {
+            retry.push_back(path);
+        }
+    }
+
+    // what was known below dir and is not there anymore
+    std::vector<std::string> gone;
+    for (auto& [path, known] : _known) {
+        if (IsBelow(path, dir) && !std::binary_search(found.begin(), found.end(), path)) {
+            gone.push_back(path);
+        }
+    }
+    std::sort(gone.begin(), gone.end());
+
+    for (auto& path : gone) {
+        Check(path, changes);
+    }
+}
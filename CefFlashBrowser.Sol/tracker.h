@@ -0,0 +1,107 @@
+#ifndef __TRACKER_H__
+#define __TRACKER_H__
+
+#include "sol.h"
+#include "utils.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+
+namespace sol
+{
+    enum class SolFileChangeKind
+    {
+        Added,
+        Modified,
+        Removed,
+    };
+
+
+    struct SolFileChange
+    {
+        SolFileChangeKind kind;
+        std::string path;
+
+        // what the file holds now, left empty for a removed file
+        uint64_t size = 0;
+        std::filesystem::file_time_type mtime;
+        bool valid = false;
+        std::string solname;                    // set if the header could be read
+        SolVersion version = SolVersion::AMF3;
+        std::string errmsg;                     // why it is not valid
+        std::shared_ptr<const SolFile> file;    // set if valid and the tracker parses
+    };
+
+
+    struct SolTrackerOptions
+    {
+        // a file is looked at once it has not been notified for this long, so that
+        // a burst of writes is looked at once, after the last of them
+        std::chrono::milliseconds debounce{ 300 };
+
+        // and at the latest this long after the first notification, for a file that
+        // is written more often than debounce
+        std::chrono::milliseconds maxdelay{ 3000 };
+
+        // whether changed files are read into values, or only validated
+        bool parse = false;
+
+        SolReadOptions readoptions = SolReadOptions::Untrusted();
+    };
+
+
+    // keeps what the .sol files below a directory held when they were last looked at,
+    // and reports what changed in them, a file is read only if its size or write time
+    // changed, and reported only if its bytes did, so that looking costs time in the
+    // files that changed rather than in the files there are
+    class SolChangeTracker
+    {
+    public:
+        explicit SolChangeTracker(std::string root, SolTrackerOptions options = SolTrackerOptions());
+        ~SolChangeTracker();
+
+        SolChangeTracker(const SolChangeTracker&) = delete;
+        SolChangeTracker& operator=(const SolChangeTracker&) = delete;
+
+        const std::string& root() const { return _root; }
+
+        // a file or directory below root was created, written, renamed or removed,
+        // to be looked at by a later poll, this may be called from any thread
+        void notify(const std::string& path);
+
+        // the number of paths notified and not looked at yet
+        size_t pending() const;
+
+        // looks at the paths that are due, a file that cannot be read yet, such as
+        // one still being written, is looked at again after another debounce
+        std::vector<SolFileChange> poll(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+        // looks at every file below root, the first scan reports all of them as added,
+        // later ones catch up on notifications that were lost
+        std::vector<SolFileChange> scan();
+
+        // poll and scan keep what they saw, one thread at a time may call them
+
+    private:
+        struct Known
+        {
+            uint64_t size;
+            std::filesystem::file_time_type mtime;
+            utils::Sha256::Digest hash;
+        };
+
+        bool Check(const std::string& path, std::vector<SolFileChange>& changes);
+        void ScanDirectory(const std::string& dir, std::vector<SolFileChange>& changes, std::vector<std::string>& retry);
+
+        std::string _root;
+        SolTrackerOptions _options;
+        std::unordered_map<std::string, Known> _known;
+
+        // the notified paths and their lock, kept out of the header for code compiled with /clr
+        struct State;
+        std::unique_ptr<State> _state;
+    };
+}
+
+#endif // !__TRACKER_H__
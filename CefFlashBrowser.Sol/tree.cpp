@@ -0,0 +1,702 @@
+#include "tree.h"
+#include "hash.h"
+#include "utils.h"
+#include <cctype>
+#include <cstring>
+#include <functional>
+
+
+namespace
+{
+    bool SameNode(const sol::SolNodePtr& left, const sol::SolNodePtr& right)
+    {
+        if (left == right) {
+            return true;
+        }
+        return left && right && *left == *right;
+    }
+
+    bool SameChildren(const sol::SolNodeMap& left, const sol::SolNodeMap& right)
+    {
+        if (left.size() != right.size()) {
+            return false;
+        }
+        for (auto l = left.begin(), r = right.begin(); l != left.end(); ++l, ++r) {
+            if (l->first != r->first || !SameNode(l->second, r->second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a NaN key is the same key as a NaN with the same bits, see detail::SameKey
+    bool SameKey(const sol::SolNode& left, const sol::SolNode& right)
+    {
+        return sol::detail::SameKey(left, right, std::equal_to<sol::SolNode>());
+    }
+
+    bool SameKey(const sol::SolNode& left, const sol::SolValue& right)
+    {
+        return sol::detail::SameKey(left, right, sol::EqualsSolValue);
+    }
+
+    // from the hashes the children keep, so a node is hashed once, when it is built
+    size_t HashNode(const sol::SolNode& node)
+    {
+        return sol::detail::HashSolValue<sol::SolNodeArray, sol::SolNodeObject, sol::SolNodeDictionary>(
+            node, [](const sol::SolNodePtr& child) { return child->hash; });
+    }
+
+    bool SameValue(const sol::SolNodePtr& node, const sol::SolValue& value)
+    {
+        return node && sol::EqualsSolValue(*node, value);
+    }
+
+    bool SameChildren(const sol::SolNodeMap& left, const std::map<std::string, sol::SolValue>& right)
+    {
+        if (left.size() != right.size()) {
+            return false;
+        }
+        auto r = right.begin();
+        for (auto l = left.begin(); l != left.end(); ++l, ++r) {
+            if (l->first != r->first || !SameValue(l->second, r->second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::shared_ptr<sol::SolNode> MakeNode(sol::SolType type)
+    {
+        auto node = std::make_shared<sol::SolNode>();
+        node->type = type;
+        return node;
+    }
+
+    bool IsIdentifier(const std::string& name)
+    {
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+            return false;
+        }
+        for (char c : name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '$') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void AppendName(std::string& out, const std::string& name, bool first)
+    {
+        if (IsIdentifier(name)) {
+            if (!first) {
+                out.push_back('.');
+            }
+            out += name;
+            return;
+        }
+
+        out += "[\"";
+        for (char c : name) {
+            if (c == '"' || c == '\\') {
+                out.push_back('\\');
+            }
+            out.push_back(c);
+        }
+        out += "\"]";
+    }
+
+    [[noreturn]] void ThrowNoChild()
+    {
+        throw std::runtime_error("No such value in the tree");
+    }
+
+    // copies the nodes from node down to the end of path, sharing everything else
+    sol::SolNodePtr SetSolPath(const sol::SolNodePtr& node, const sol::SolPath& path, size_t index, sol::SolNodePtr child)
+    {
+        if (index == path.size()) {
+            return child;
+        }
+
+        auto inner = sol::GetSolChild(node, path[index]);
+        if (!inner && index + 1 < path.size()) {
+            ThrowNoChild();
+        }
+        return sol::SetSolChild(node, path[index], SetSolPath(inner, path, index + 1, std::move(child)));
+    }
+}
+
+
+sol::SolNodeDictionary::SolNodeDictionary(bool weakkeys, std::vector<std::pair<SolNodePtr, SolNodePtr>> entries)
+    : weakkeys(weakkeys)
+{
+    _entries.reserve(entries.size());
+    _index.reserve(entries.size());
+
+    // a repeated key keeps its first place and takes the last value, as SolDictionary does
+    for (auto& [key, val] : entries) {
+        auto range = _index.equal_range(key->hash);
+        auto it = range.first;
+
+        while (it != range.second && !SameKey(*_entries[it->second].first, *key)) {
+            ++it;
+        }
+        if (it != range.second) {
+            _entries[it->second].second = std::move(val);
+        }
+        else {
+            _index.emplace(key->hash, _entries.size());
+            _entries.emplace_back(std::move(key), std::move(val));
+        }
+    }
+}
+
+const sol::SolNodePtr* sol::SolNodeDictionary::find(const SolNode& key) const
+{
+    auto range = _index.equal_range(key.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (SameKey(*_entries[it->second].first, key)) {
+            return &_entries[it->second].second;
+        }
+    }
+    return nullptr;
+}
+
+const sol::SolNodePtr* sol::SolNodeDictionary::find(const SolValue& key) const
+{
+    auto range = _index.equal_range(SolValueHash()(key));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (SameKey(*_entries[it->second].first, key)) {
+            return &_entries[it->second].second;
+        }
+    }
+    return nullptr;
+}
+
+sol::SolNodeDictionary sol::SolNodeDictionary::set(const SolNodePtr& key, SolNodePtr value) const
+{
+    // the values are shared, only the pointers and the index are copied
+    SolNodeDictionary result = *this;
+    auto range = result._index.equal_range(key->hash);
+    auto it = range.first;
+
+    while (it != range.second && !SameKey(*result._entries[it->second].first, *key)) {
+        ++it;
+    }
+    if (it == range.second) {
+        if (value) {
+            result._index.emplace(key->hash, result._entries.size());
+            result._entries.emplace_back(key, std::move(value));
+        }
+    }
+    else if (value) {
+        result._entries[it->second].second = std::move(value);
+    }
+    else {
+        size_t pos = it->second;
+        size_t last = result._entries.size() - 1;
+        result._index.erase(it);
+
+        // the last entry moves into the gap, as in SolDictionary::erase
+        if (pos != last) {
+            auto moved = result._index.equal_range(result._entries[last].first->hash);
+            for (auto m = moved.first; m != moved.second; ++m) {
+                if (m->second == last) {
+                    m->second = pos;
+                    break;
+                }
+            }
+            result._entries[pos] = std::move(result._entries[last]);
+        }
+        result._entries.pop_back();
+    }
+    return result;
+}
+
+size_t sol::SolNodeHash::operator()(const SolNode& node) const
+{
+    return node.hash;
+}
+
+bool sol::operator==(const SolNode& left, const SolNode& right)
+{
+    if (&left == &right) {
+        return true;
+    }
+    // equal values hash equal, so this tells most unequal nodes apart at once
+    if (left.hash != right.hash || left.type != right.type || left.value.index() != right.value.index()) {
+        return false;
+    }
+
+    switch (left.type)
+    {
+    case SolType::Array: {
+        auto& l = left.get<SolNodeArray>();
+        auto& r = right.get<SolNodeArray>();
+
+        if (l.dense.size() != r.dense.size() || !SameChildren(l.assoc, r.assoc)) {
+            return false;
+        }
+        for (size_t i = 0; i < l.dense.size(); ++i) {
+            if (!SameNode(l.dense[i], r.dense[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    case SolType::Object: {
+        auto& l = left.get<SolNodeObject>();
+        auto& r = right.get<SolNodeObject>();
+        return l.classdef == r.classdef && SameChildren(l.props, r.props);
+    }
+
+    case SolType::Dictionary: {
+        auto& l = left.get<SolNodeDictionary>();
+        auto& r = right.get<SolNodeDictionary>();
+
+        if (l.weakkeys != r.weakkeys || l.size() != r.size()) {
+            return false;
+        }
+        // order does not count, as for SolDictionary, but it is usually the same
+        for (size_t i = 0; i < l.size(); ++i) {
+            auto& [key, val] = l.entries()[i];
+            auto found = SameNode(key, r.entries()[i].first) ? &r.entries()[i].second : r.find(*key);
+
+            if (!found || !SameNode(val, *found)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    default:
+        return std::visit([&](auto& l) {
+            using T = std::decay_t<decltype(l)>;
+            if constexpr (std::is_same_v<T, SolNodeArray> || std::is_same_v<T, SolNodeObject> || std::is_same_v<T, SolNodeDictionary>) {
+                return false;
+            }
+            else {
+                return l == std::get<T>(right.value);
+            }
+        }, left.value);
+    }
+}
+
+bool sol::EqualsSolValue(const SolNode& node, const SolValue& value)
+{
+    if (node.type != value.type) {
+        return false;
+    }
+
+    switch (node.type)
+    {
+    case SolType::Array: {
+        auto& l = node.get<SolNodeArray>();
+        auto r = std::get_if<SolArray>(&value.value);
+
+        if (!r || l.dense.size() != r->dense.size() || !SameChildren(l.assoc, r->assoc)) {
+            return false;
+        }
+        for (size_t i = 0; i < l.dense.size(); ++i) {
+            if (!SameValue(l.dense[i], r->dense[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    case SolType::Object: {
+        auto& l = node.get<SolNodeObject>();
+        auto r = std::get_if<SolObject>(&value.value);
+        return r && l.classdef == r->classdef && SameChildren(l.props, r->props);
+    }
+
+    case SolType::Dictionary: {
+        auto& l = node.get<SolNodeDictionary>();
+        auto r = std::get_if<SolDictionary>(&value.value);
+
+        if (!r || l.weakkeys != r->weakkeys || l.size() != r->size()) {
+            return false;
+        }
+        for (auto& [key, val] : r->entries()) {
+            auto found = l.find(key);
+            if (!found || !SameValue(*found, val)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    default:
+        return std::visit([&](auto& l) {
+            using T = std::decay_t<decltype(l)>;
+            if constexpr (std::is_same_v<T, SolNodeArray> || std::is_same_v<T, SolNodeObject> || std::is_same_v<T, SolNodeDictionary>) {
+                return false;
+            }
+            else if constexpr (std::is_same_v<T, SolDouble>) {
+                // an unchanged NaN is the same value, though it compares unequal
+                auto r = std::get_if<SolDouble>(&value.value);
+                return r && (l == *r || std::memcmp(&l, r, sizeof(double)) == 0);
+            }
+            else {
+                auto r = std::get_if<T>(&value.value);
+                return r && l == *r;
+            }
+        }, node.value);
+    }
+}
+
+sol::SolNodePtr sol::MakeSolNode(const SolValue& value)
+{
+    auto node = MakeNode(value.type);
+
+    switch (value.type)
+    {
+    case SolType::Array: {
+        auto& arr = value.get<SolArray>();
+        SolNodeArray result;
+
+        for (auto& [key, val] : arr.assoc) {
+            result.assoc.emplace_hint(result.assoc.end(), key, MakeSolNode(val));
+        }
+        result.dense.reserve(arr.dense.size());
+        for (auto& val : arr.dense) {
+            result.dense.push_back(MakeSolNode(val));
+        }
+        node->value = std::move(result);
+        break;
+    }
+
+    case SolType::Object: {
+        auto& obj = value.get<SolObject>();
+        SolNodeObject result;
+
+        result.classdef = obj.classdef;
+        for (auto& [key, val] : obj.props) {
+            result.props.emplace_hint(result.props.end(), key, MakeSolNode(val));
+        }
+        node->value = std::move(result);
+        break;
+    }
+
+    case SolType::Dictionary: {
+        auto& dict = value.get<SolDictionary>();
+        std::vector<std::pair<SolNodePtr, SolNodePtr>> entries;
+
+        entries.reserve(dict.size());
+        for (auto& [key, val] : dict.entries()) {
+            entries.emplace_back(MakeSolNode(key), MakeSolNode(val));
+        }
+        node->value = SolNodeDictionary(dict.weakkeys, std::move(entries));
+        break;
+    }
+
+    default:
+        std::visit([&](auto& v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, SolArray> || std::is_same_v<T, SolObject> || std::is_same_v<T, SolDictionary>) {
+                throw std::runtime_error("Container value with a scalar type");
+            }
+            else {
+                node->value = v;
+            }
+        }, value.value);
+        break;
+    }
+
+    node->hash = HashNode(*node);
+    return node;
+}
+
+sol::SolValue sol::ToSolValue(const SolNode& node)
+{
+    switch (node.type)
+    {
+    case SolType::Array: {
+        auto& arr = node.get<SolNodeArray>();
+        SolArray result;
+
+        for (auto& [key, val] : arr.assoc) {
+            result.assoc.emplace_hint(result.assoc.end(), key, ToSolValue(*val));
+        }
+        result.dense.reserve(arr.dense.size());
+        for (auto& val : arr.dense) {
+            result.dense.push_back(ToSolValue(*val));
+        }
+        return SolValue(std::move(result));
+    }
+
+    case SolType::Object: {
+        auto& obj = node.get<SolNodeObject>();
+        SolObject result;
+
+        result.classdef = obj.classdef;
+        for (auto& [key, val] : obj.props) {
+            result.props.emplace_hint(result.props.end(), key, ToSolValue(*val));
+        }
+        return SolValue(std::move(result));
+    }
+
+    case SolType::Dictionary: {
+        auto& dict = node.get<SolNodeDictionary>();
+        SolDictionary result;
+
+        result.weakkeys = dict.weakkeys;
+        result.reserve(dict.size());
+        for (auto& [key, val] : dict.entries()) {
+            result[ToSolValue(*key)] = ToSolValue(*val);
+        }
+        return SolValue(std::move(result));
+    }
+
+    default:
+        return std::visit([&](auto& v) -> SolValue {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, SolNodeArray> || std::is_same_v<T, SolNodeObject> || std::is_same_v<T, SolNodeDictionary>) {
+                throw std::runtime_error("Container node with a scalar type");
+            }
+            else {
+                return SolValue(node.type, v);
+            }
+        }, node.value);
+    }
+}
+
+sol::SolNodePtr sol::GetSolChild(const SolNodePtr& node, const SolPathKey& key)
+{
+    if (!node) {
+        return nullptr;
+    }
+
+    const SolNodeMap* children = nullptr;
+
+    if (node->type == SolType::Array) {
+        auto& arr = node->get<SolNodeArray>();
+        if (auto index = std::get_if<size_t>(&key)) {
+            return *index < arr.dense.size() ? arr.dense[*index] : nullptr;
+        }
+        children = &arr.assoc;
+    }
+    else if (node->type == SolType::Object) {
+        if (std::holds_alternative<size_t>(key)) {
+            return nullptr;
+        }
+        children = &node->get<SolNodeObject>().props;
+    }
+    else {
+        return nullptr;
+    }
+
+    auto it = children->find(std::get<std::string>(key));
+    return it != children->end() ? it->second : nullptr;
+}
+
+sol::SolNodePtr sol::SetSolChild(const SolNodePtr& node, const SolPathKey& key, SolNodePtr child)
+{
+    if (!node || (node->type != SolType::Array && node->type != SolType::Object)) {
+        ThrowNoChild();
+    }
+
+    // the copy shares the children, only their pointers are copied
+    auto copy = std::make_shared<SolNode>(*node);
+    SolNodeMap* children = nullptr;
+
+    if (copy->type == SolType::Array) {
+        auto& arr = std::get<SolNodeArray>(copy->value);
+
+        if (auto index = std::get_if<size_t>(&key)) {
+            if (*index > arr.dense.size() || (*index == arr.dense.size() && !child)) {
+                ThrowNoChild();
+            }
+            if (*index == arr.dense.size()) {
+                arr.dense.push_back(std::move(child));
+            }
+            else if (child) {
+                arr.dense[*index] = std::move(child);
+            }
+            else {
+                arr.dense.erase(arr.dense.begin() + *index);
+            }
+            copy->hash = HashNode(*copy);
+            return copy;
+        }
+        children = &arr.assoc;
+    }
+    else {
+        if (std::holds_alternative<size_t>(key)) {
+            ThrowNoChild();
+        }
+        children = &std::get<SolNodeObject>(copy->value).props;
+    }
+
+    auto& name = std::get<std::string>(key);
+    if (child) {
+        (*children)[name] = std::move(child);
+    }
+    else {
+        children->erase(name);
+    }
+    copy->hash = HashNode(*copy);
+    return copy;
+}
+
+sol::SolTree::SolTree()
+    : _entries(std::make_shared<const SolNodeMap>())
+{
+}
+
+sol::SolTree::SolTree(const SolFile& file)
+{
+    auto entries = std::make_shared<SolNodeMap>();
+
+    for (auto& [key, value] : file.data) {
+        entries->emplace_hint(entries->end(), key, MakeSolNode(value));
+    }
+    _entries = std::move(entries);
+}
+
+sol::SolTree::SolTree(std::shared_ptr<const SolNodeMap> entries)
+    : _entries(std::move(entries))
+{
+}
+
+std::string sol::FormatSolPath(const std::string& key, const SolPath& path)
+{
+    std::string result;
+    AppendName(result, key, true);
+
+    for (auto& step : path) {
+        if (auto name = std::get_if<std::string>(&step)) {
+            AppendName(result, *name, false);
+        }
+        else {
+            result += utils::FormatString("[%zu]", std::get<size_t>(step));
+        }
+    }
+    return result;
+}
+
+
+size_t sol::SolTree::size() const
+{
+    return _entries->size();
+}
+
+bool sol::SolTree::empty() const
+{
+    return _entries->empty();
+}
+
+const sol::SolNodeMap& sol::SolTree::entries() const
+{
+    return *_entries;
+}
+
+sol::SolNodePtr sol::SolTree::get(const std::string& key) const
+{
+    auto it = _entries->find(key);
+    return it != _entries->end() ? it->second : nullptr;
+}
+
+sol::SolNodePtr sol::SolTree::get(const std::string& key, const SolPath& path) const
+{
+    auto node = get(key);
+
+    for (auto& step : path) {
+        if (!(node = GetSolChild(node, step))) {
+            break;
+        }
+    }
+    return node;
+}
+
+sol::SolTree sol::SolTree::set(const std::string& key, SolNodePtr node) const
+{
+    auto entries = std::make_shared<SolNodeMap>(*_entries);
+
+    if (node) {
+        (*entries)[key] = std::move(node);
+    }
+    else {
+        entries->erase(key);
+    }
+    return SolTree(std::move(entries));
+}
+
+sol::SolTree sol::SolTree::set(const std::string& key, const SolPath& path, SolNodePtr node) const
+{
+    if (path.empty()) {
+        return set(key, std::move(node));
+    }
+
+    auto entry = get(key);
+    if (!entry) {
+        ThrowNoChild();
+    }
+    return set(key, SetSolPath(entry, path, 0, std::move(node)));
+}
+
+sol::SolTree sol::SolTree::erase(const std::string& key) const
+{
+    return set(key, nullptr);
+}
+
+void sol::SolTree::store(SolFile& file) const
+{
+    file.data.clear();
+
+    for (auto& [key, node] : *_entries) {
+        file.data.emplace_hint(file.data.end(), key, ToSolValue(*node));
+    }
+}
+
+sol::SolHistory::SolHistory(SolTree tree)
+    : _snapshots{ std::move(tree) }, _index(0)
+{
+}
+
+const sol::SolTree& sol::SolHistory::current() const
+{
+    return _snapshots[_index];
+}
+
+void sol::SolHistory::commit(SolTree tree)
+{
+    _snapshots.resize(_index + 1);
+    _snapshots.push_back(std::move(tree));
+    ++_index;
+}
+
+bool sol::SolHistory::canundo() const
+{
+    return _index > 0;
+}
+
+bool sol::SolHistory::canredo() const
+{
+    return _index + 1 < _snapshots.size();
+}
+
+bool sol::SolHistory::undo()
+{
+    if (!canundo()) {
+        return false;
+    }
+    --_index;
+    return true;
+}
+
+bool sol::SolHistory::redo()
+{
+    if (!canredo()) {
+        return false;
+    }
+    ++_index;
+    return true;
+}
+
+size_t sol::SolHistory::size() const
+{
+    return _snapshots.size();
+}
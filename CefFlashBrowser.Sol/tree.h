@@ -0,0 +1,170 @@
+#ifndef __TREE_H__
+#define __TREE_H__
+
+#include "sol.h"
+#include <memory>
+
+namespace sol
+{
+    struct SolNode;
+
+    // nodes are never changed once built, so holding a pointer is holding a snapshot
+    using SolNodePtr = std::shared_ptr<const SolNode>;
+    using SolNodeMap = std::map<std::string, SolNodePtr>;
+
+
+    struct SolNodeArray
+    {
+        SolNodeMap assoc;
+        std::vector<SolNodePtr> dense;
+    };
+
+
+    struct SolNodeObject
+    {
+        SolClassDef classdef;
+        SolNodeMap props;
+    };
+
+
+    struct SolNodeDictionary
+    {
+        bool weakkeys = false;
+
+        SolNodeDictionary() = default;
+        SolNodeDictionary(bool weakkeys, std::vector<std::pair<SolNodePtr, SolNodePtr>> entries);
+
+        size_t size() const { return _entries.size(); }
+        bool empty() const { return _entries.empty(); }
+        const std::vector<std::pair<SolNodePtr, SolNodePtr>>& entries() const { return _entries; }
+
+        // returns nullptr if there is no such key
+        const SolNodePtr* find(const SolNode& key) const;
+        const SolNodePtr* find(const SolValue& key) const;
+
+        // returns a copy with the value at key replaced, a null value removes the entry
+        // and the last entry takes its place, the values are shared with this one as the
+        // children of the other nodes are, and only the changed key is hashed
+        SolNodeDictionary set(const SolNodePtr& key, SolNodePtr value) const;
+
+    private:
+        // in insertion order, with the index from key hashes to positions as in SolDictionary
+        std::vector<std::pair<SolNodePtr, SolNodePtr>> _entries;
+        std::unordered_multimap<size_t, size_t> _index;
+    };
+
+
+    // an immutable SolValue, containers hold their children by shared pointer so that
+    // a changed copy of a container shares every child it did not change
+    struct SolNode
+    {
+        SolType type;
+        std::variant<SolNull, SolBoolean, SolInteger, SolDouble, SolString, SolBinary, SolNodeArray, SolNodeObject, SolNodeDictionary> value;
+
+        // the SolValueHash of the value, set by MakeSolNode and SetSolChild as the node
+        // is built from the hashes of its children, so a node is never hashed twice
+        size_t hash = 0;
+
+        template <typename T>
+        const T& get() const { return std::get<T>(value); }
+    };
+
+
+    // the SolValueHash of the value the node holds, the hash the node keeps
+    struct SolNodeHash
+    {
+        size_t operator()(const SolNode& node) const;
+    };
+
+
+    // children shared by both sides compare equal without being visited
+    bool operator==(const SolNode& left, const SolNode& right);
+    inline bool operator!=(const SolNode& left, const SolNode& right) { return !(left == right); }
+
+    // whether node holds value, without building a node for it, a NaN compares equal
+    // to a NaN with the same bits here, so that an unchanged value is always found equal
+    bool EqualsSolValue(const SolNode& node, const SolValue& value);
+
+    SolNodePtr MakeSolNode(const SolValue& value);
+
+    SolValue ToSolValue(const SolNode& node);
+
+
+    // one step into a container, a property or assoc key, or a dense index,
+    // dictionary entries are keyed by values and cannot be reached by a path
+    using SolPathKey = std::variant<std::string, size_t>;
+    using SolPath = std::vector<SolPathKey>;
+
+    // the path of a value below the top level entry key for showing to people,
+    // as key.name[2], names that are not identifiers are quoted as ["a name"]
+    std::string FormatSolPath(const std::string& key, const SolPath& path);
+
+    // returns the child at key, or nullptr if there is none
+    SolNodePtr GetSolChild(const SolNodePtr& node, const SolPathKey& key);
+
+    // returns a copy of node with the child at key replaced, a null child removes it,
+    // an index one past the dense part appends, throws if node has no such slot
+    SolNodePtr SetSolChild(const SolNodePtr& node, const SolPathKey& key, SolNodePtr child);
+
+
+    // the top level entries of a file as a persistent tree, a copy is O(1) and an edit
+    // copies only the nodes from the entry down to the changed value, a tree held by
+    // a reader never changes, so it can be read on any thread without locking
+    class SolTree
+    {
+    public:
+        SolTree();
+        explicit SolTree(const SolFile& file);
+
+        size_t size() const;
+        bool empty() const;
+        const SolNodeMap& entries() const;
+
+        // returns nullptr if there is no such value
+        SolNodePtr get(const std::string& key) const;
+        SolNodePtr get(const std::string& key, const SolPath& path) const;
+
+        // these return the changed tree and leave this one as it is,
+        // every node along path has to exist, a null node removes the value
+        SolTree set(const std::string& key, SolNodePtr node) const;
+        SolTree set(const std::string& key, const SolPath& path, SolNodePtr node) const;
+        SolTree erase(const std::string& key) const;
+
+        // replaces file.data with the values of the tree
+        void store(SolFile& file) const;
+
+    private:
+        explicit SolTree(std::shared_ptr<const SolNodeMap> entries);
+
+        std::shared_ptr<const SolNodeMap> _entries;
+    };
+
+
+    // snapshots of a tree for undo and redo, each one shares what it did not change
+    // with the others, so keeping all of them costs only the nodes that were edited
+    class SolHistory
+    {
+    public:
+        explicit SolHistory(SolTree tree = SolTree());
+
+        const SolTree& current() const;
+
+        // makes tree the current snapshot and drops the ones that could be redone
+        void commit(SolTree tree);
+
+        bool canundo() const;
+        bool canredo() const;
+
+        // return false if there is nothing to undo or redo
+        bool undo();
+        bool redo();
+
+        size_t size() const;
+
+    private:
+        std::vector<SolTree> _snapshots;
+        size_t _index;
+    };
+}
+
+#endif // !__TREE_H__
@@ -0,0 +1,269 @@
+#ifndef __TYPES_H__
+#define __TYPES_H__
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sol
+{
+    struct SolValue;
+    struct SolArray;
+    struct SolObject;
+    struct SolDictionary;
+
+    using SolNull = std::nullptr_t;
+    using SolBoolean = bool;
+    using SolInteger = int32_t;
+    using SolDouble = double;
+    using SolString = std::string;
+    using SolBinary = std::vector<uint8_t>;
+
+
+    enum class SolType : uint8_t
+    {
+        Undefined = 0x00,
+        Null = 0x01,
+        BooleanFalse = 0x02,
+        BooleanTrue = 0x03,
+        Integer = 0x04,
+        Double = 0x05,
+        String = 0x06,
+        XmlDoc = 0x07,
+        Date = 0x08,
+        Array = 0x09,
+        Object = 0x0A,
+        Xml = 0x0B,
+        Binary = 0x0C,
+        Dictionary = 0x11,
+    };
+
+
+    enum class AMF0Type : uint8_t
+    {
+        Number = 0x00,
+        Boolean = 0x01,
+        String = 0x02,
+        Object = 0x03,
+        MovieClip = 0x04,
+        Null = 0x05,
+        Undefined = 0x06,
+        Reference = 0x07,
+        EcmaArray = 0x08,
+        ObjectEnd = 0x09,
+        StrictArray = 0x0A,
+        Date = 0x0B,
+        LongString = 0x0C,
+        Unsupported = 0x0D,
+        Recordset = 0x0E,
+        XMLDoc = 0x0F,
+        TypedObject = 0x10
+    };
+
+
+    // a row of SolTypeList, storage is the alternative of SolValue::value holding the
+    // type and amf0 the AMF0 type it is written as, Unsupported if it has none
+    template <SolType TType, typename TStorage, AMF0Type TAMF0 = AMF0Type::Unsupported>
+    struct SolTypeDef
+    {
+        static constexpr SolType type = TType;
+        static constexpr SolType marker = TType;
+        static constexpr AMF0Type amf0 = TAMF0;
+        using storage = TStorage;
+    };
+
+    // every known type, IsKnownType, SolValue::is, GetAMF0Type, the writers and the
+    // visitors are generated from this list, so a new type is added here first and
+    // the compiler then points at each visitor that does not handle it
+    using SolTypeList = std::tuple<
+        SolTypeDef<SolType::Undefined, SolNull, AMF0Type::Undefined>,
+        SolTypeDef<SolType::Null, SolNull, AMF0Type::Null>,
+        SolTypeDef<SolType::BooleanFalse, SolBoolean, AMF0Type::Boolean>,
+        SolTypeDef<SolType::BooleanTrue, SolBoolean, AMF0Type::Boolean>,
+        SolTypeDef<SolType::Integer, SolInteger, AMF0Type::Number>,
+        SolTypeDef<SolType::Double, SolDouble, AMF0Type::Number>,
+        SolTypeDef<SolType::String, SolString, AMF0Type::String>,
+        SolTypeDef<SolType::XmlDoc, SolString, AMF0Type::XMLDoc>,
+        SolTypeDef<SolType::Date, SolDouble, AMF0Type::Date>,
+        SolTypeDef<SolType::Array, SolArray, AMF0Type::StrictArray>,
+        SolTypeDef<SolType::Object, SolObject, AMF0Type::Object>,
+        SolTypeDef<SolType::Xml, SolString, AMF0Type::XMLDoc>,
+        SolTypeDef<SolType::Binary, SolBinary>,
+        SolTypeDef<SolType::Dictionary, SolDictionary>>;
+
+
+    // a row of AMF0TypeList, storage is the alternative of SolValue::value a value of the
+    // type is read into and written from, void for the markers that are not values
+    template <AMF0Type TAMF0, typename TStorage = void>
+    struct AMF0TypeDef
+    {
+        static constexpr AMF0Type amf0 = TAMF0;
+        static constexpr AMF0Type marker = TAMF0;
+        using storage = TStorage;
+    };
+
+    // every AMF0 marker, IsKnownAMF0Type and the AMF0 reader and writer are generated from this list
+    using AMF0TypeList = std::tuple<
+        AMF0TypeDef<AMF0Type::Number, SolDouble>,
+        AMF0TypeDef<AMF0Type::Boolean, SolBoolean>,
+        AMF0TypeDef<AMF0Type::String, SolString>,
+        AMF0TypeDef<AMF0Type::Object, SolObject>,
+        AMF0TypeDef<AMF0Type::MovieClip>,
+        AMF0TypeDef<AMF0Type::Null, SolNull>,
+        AMF0TypeDef<AMF0Type::Undefined, SolNull>,
+        AMF0TypeDef<AMF0Type::Reference>,
+        AMF0TypeDef<AMF0Type::EcmaArray, SolArray>,
+        AMF0TypeDef<AMF0Type::ObjectEnd>,
+        AMF0TypeDef<AMF0Type::StrictArray, SolArray>,
+        AMF0TypeDef<AMF0Type::Date, SolDouble>,
+        AMF0TypeDef<AMF0Type::LongString, SolString>,
+        AMF0TypeDef<AMF0Type::Unsupported>,
+        AMF0TypeDef<AMF0Type::Recordset>,
+        AMF0TypeDef<AMF0Type::XMLDoc, SolString>,
+        AMF0TypeDef<AMF0Type::TypedObject, SolObject>>;
+}
+
+
+namespace sol::detail
+{
+    [[noreturn]] void ThrowUnknownType(sol::SolType type);
+    [[noreturn]] void ThrowUnknownType(sol::AMF0Type type);
+
+    template <typename T>
+    constexpr bool DependentFalse = false;
+
+    constexpr size_t SOL_TYPE_ROWS = std::tuple_size_v<sol::SolTypeList>;
+    constexpr size_t AMF0_TYPE_ROWS = std::tuple_size_v<sol::AMF0TypeList>;
+
+    // the row of each marker byte in TList, the size of TList if it is not a known marker
+    template <typename TList, size_t... I>
+    constexpr std::array<uint8_t, 256> MakeTypeRows(std::index_sequence<I...>)
+    {
+        std::array<uint8_t, 256> rows{};
+        for (size_t i = 0; i < rows.size(); ++i) {
+            rows[i] = static_cast<uint8_t>(sizeof...(I));
+        }
+        ((rows[static_cast<uint8_t>(std::tuple_element_t<I, TList>::marker)] = static_cast<uint8_t>(I)), ...);
+        return rows;
+    }
+
+    inline constexpr auto SOL_TYPE_ROW = MakeTypeRows<sol::SolTypeList>(std::make_index_sequence<SOL_TYPE_ROWS>());
+    inline constexpr auto AMF0_TYPE_ROW = MakeTypeRows<sol::AMF0TypeList>(std::make_index_sequence<AMF0_TYPE_ROWS>());
+
+    // whether each marker byte is a type held in TStorage
+    template <typename TStorage, size_t... I>
+    constexpr std::array<bool, 256> MakeStorageTable(std::index_sequence<I...>)
+    {
+        std::array<bool, 256> table{};
+        ((table[static_cast<uint8_t>(std::tuple_element_t<I, sol::SolTypeList>::type)]
+            = std::is_same_v<typename std::tuple_element_t<I, sol::SolTypeList>::storage, TStorage>), ...);
+        return table;
+    }
+
+    template <typename TStorage>
+    inline constexpr auto SOL_STORAGE_TABLE = MakeStorageTable<TStorage>(std::make_index_sequence<SOL_TYPE_ROWS>());
+
+    // the number of cases VisitTypeRows has, enough for either list
+    constexpr size_t TYPE_CASES = 32;
+
+    // the case label of row I of TList, past the end of TList a value no marker byte has
+    template <typename TList, size_t I>
+    constexpr int TypeCase()
+    {
+        if constexpr (I < std::tuple_size_v<TList>) {
+            return static_cast<int>(std::tuple_element_t<I, TList>::marker);
+        }
+        else {
+            return 0x100 + static_cast<int>(I);
+        }
+    }
+
+#define SOL_TYPE_CASE(I) \
+        case TypeCase<TList, I>(): \
+            if constexpr (I < std::tuple_size_v<TList>) { \
+                return visitor(std::tuple_element_t<I, TList>{}); \
+            } \
+            break
+
+    // a switch over the marker with a case for each row of TList, so every case is
+    // written once for all the visitors and the compiler still sees a plain switch
+    template <typename TList, typename TMarker, typename TVisitor>
+    decltype(auto) VisitTypeRows(TMarker marker, TVisitor& visitor)
+    {
+        static_assert(std::tuple_size_v<TList> <= TYPE_CASES, "VisitTypeRows needs a case for each row");
+
+        switch (static_cast<int>(marker))
+        {
+            SOL_TYPE_CASE(0);
+            SOL_TYPE_CASE(1);
+            SOL_TYPE_CASE(2);
+            SOL_TYPE_CASE(3);
+            SOL_TYPE_CASE(4);
+            SOL_TYPE_CASE(5);
+            SOL_TYPE_CASE(6);
+            SOL_TYPE_CASE(7);
+            SOL_TYPE_CASE(8);
+            SOL_TYPE_CASE(9);
+            SOL_TYPE_CASE(10);
+            SOL_TYPE_CASE(11);
+            SOL_TYPE_CASE(12);
+            SOL_TYPE_CASE(13);
+            SOL_TYPE_CASE(14);
+            SOL_TYPE_CASE(15);
+            SOL_TYPE_CASE(16);
+            SOL_TYPE_CASE(17);
+            SOL_TYPE_CASE(18);
+            SOL_TYPE_CASE(19);
+            SOL_TYPE_CASE(20);
+            SOL_TYPE_CASE(21);
+            SOL_TYPE_CASE(22);
+            SOL_TYPE_CASE(23);
+            SOL_TYPE_CASE(24);
+            SOL_TYPE_CASE(25);
+            SOL_TYPE_CASE(26);
+            SOL_TYPE_CASE(27);
+            SOL_TYPE_CASE(28);
+            SOL_TYPE_CASE(29);
+            SOL_TYPE_CASE(30);
+            SOL_TYPE_CASE(31);
+        }
+        ThrowUnknownType(marker);
+    }
+
+#undef SOL_TYPE_CASE
+}
+
+
+namespace sol
+{
+    constexpr bool IsKnownType(SolType type)
+    {
+        return detail::SOL_TYPE_ROW[static_cast<uint8_t>(type)] != detail::SOL_TYPE_ROWS;
+    }
+
+    constexpr bool IsKnownAMF0Type(AMF0Type type)
+    {
+        return detail::AMF0_TYPE_ROW[static_cast<uint8_t>(type)] != detail::AMF0_TYPE_ROWS;
+    }
+
+    // calls visitor(def) with the SolTypeDef of type, throws if type is not known,
+    // every call has to return the same type
+    template <typename TVisitor>
+    decltype(auto) VisitSolType(SolType type, TVisitor&& visitor)
+    {
+        return detail::VisitTypeRows<SolTypeList>(type, visitor);
+    }
+
+    // as above with the AMF0TypeDef of type
+    template <typename TVisitor>
+    decltype(auto) VisitAMF0Type(AMF0Type type, TVisitor&& visitor)
+    {
+        return detail::VisitTypeRows<AMF0TypeList>(type, visitor);
+    }
+}
+
+#endif // !__TYPES_H__
@@ -1,10 +1,37 @@
 #include "utils.h"
+#include <cstring>
 #include <fstream>
-#include <msclr/marshal.h>
-#include <msclr/marshal_cppstd.h>
 
-using namespace System;
-using namespace System::Text;
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// files smaller than this are read into memory, mapping them costs more than it saves
+constexpr size_t MAPPING_THRESHOLD = 16 * 1024 * 1024;
+
+namespace
+{
+    const uint32_t SHA256_ROUNDS[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    inline uint32_t RotateRight(uint32_t value, int bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+}
 
 std::vector<uint8_t> utils::ReadFile(const std::string& path)
 {
@@ -36,68 +63,230 @@ void utils::WriteFile(const std::string& path, const std::vector<uint8_t>& data)
     }
 }
 
-System::String^ utils::ToSystemString(const std::string& str, bool utf8)
+utils::MappedFile::MappedFile(const std::string& path)
+{
+    if (!open(path)) throw std::runtime_error("Failed to read file");
+}
+
+utils::MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool utils::MappedFile::open(const std::string& path)
 {
-    if (str.empty()) {
-        return String::Empty;
+    close();
+
+#ifdef _WIN32
+    HANDLE hfile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hfile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER filesize;
+    if (!GetFileSizeEx(hfile, &filesize)) {
+        CloseHandle(hfile);
+        return false;
     }
-    if (utf8) {
-        return gcnew String(str.c_str(), 0, (int)str.size(), Encoding::UTF8);
+    _size = static_cast<size_t>(filesize.QuadPart);
+
+    if (_size < MAPPING_THRESHOLD) {
+        _buffer.resize(_size);
+        DWORD read = 0;
+        for (size_t offset = 0; offset < _size; offset += read) {
+            size_t remaining = _size - offset;
+            DWORD chunk = static_cast<DWORD>(remaining < 0x40000000 ? remaining : 0x40000000);
+            if (!::ReadFile(hfile, _buffer.data() + offset, chunk, &read, NULL) || read == 0) {
+                CloseHandle(hfile);
+                close();
+                return false;
+            }
+        }
+        CloseHandle(hfile);
+        _data = _buffer.data();
+        return true;
     }
-    else {
-        return msclr::interop::marshal_as<String^>(str);
+
+    HANDLE hmapping = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hfile);
+    if (hmapping == NULL) {
+        _size = 0;
+        return false;
     }
-}
 
-std::string utils::ToStdString(System::String^ str, bool utf8)
-{
-    if (String::IsNullOrEmpty(str)) {
-        return std::string();
+    _data = static_cast<const uint8_t*>(MapViewOfFile(hmapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(hmapping);
+    if (_data == nullptr) {
+        _size = 0;
+        return false;
     }
-    if (utf8) {
-        array<Byte>^ bytes = Encoding::UTF8->GetBytes(str);
-        pin_ptr<Byte> pinned = &bytes[0];
-        return std::string(reinterpret_cast<const char*>(pinned), bytes->Length);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    _size = static_cast<size_t>(st.st_size);
+
+    if (_size < MAPPING_THRESHOLD) {
+        _buffer.resize(_size);
+        for (size_t offset = 0; offset < _size;) {
+            ssize_t n = ::read(fd, _buffer.data() + offset, _size - offset);
+            if (n <= 0) {
+                ::close(fd);
+                close();
+                return false;
+            }
+            offset += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        _data = _buffer.data();
+        return true;
+    }
+
+    void* addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        _size = 0;
+        return false;
     }
-    else {
-        return msclr::interop::marshal_as<std::string>(str);
+    madvise(addr, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const uint8_t*>(addr);
+#endif
+    _mapped = true;
+    return true;
+}
+
+void utils::MappedFile::close()
+{
+    if (_mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+#else
+        munmap(const_cast<uint8_t*>(_data), _size);
+#endif
     }
+    _data = nullptr;
+    _size = 0;
+    _mapped = false;
+    _buffer.clear();
+}
+
+utils::Sha256::Sha256()
+    : _state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+{
 }
 
-array<System::Byte>^ utils::ToByteArray(const std::vector<uint8_t>& vec)
+void utils::Sha256::update(const void* data, size_t size)
 {
-    int i = 0;
-    auto arr = gcnew array<Byte>((int)vec.size());
-    for (uint8_t b : vec) {
-        arr[i++] = b;
+    auto bytes = static_cast<const uint8_t*>(data);
+    _total += size;
+
+    if (_blocksize != 0) {
+        size_t len = sizeof(_block) - _blocksize;
+        if (len > size) {
+            len = size;
+        }
+        std::memcpy(_block + _blocksize, bytes, len);
+        _blocksize += len;
+        bytes += len;
+        size -= len;
+        if (_blocksize < sizeof(_block)) {
+            return;
+        }
+        transform(_block);
+        _blocksize = 0;
+    }
+
+    // whole blocks are hashed where they are
+    for (; size >= sizeof(_block); bytes += sizeof(_block), size -= sizeof(_block)) {
+        transform(bytes);
     }
-    return arr;
+    std::memcpy(_block, bytes, size);
+    _blocksize = size;
 }
 
-std::vector<uint8_t> utils::ToByteVector(array<System::Byte>^ arr)
+utils::Sha256::Digest utils::Sha256::finish()
 {
-    std::vector<uint8_t> vec;
-    vec.reserve(arr->Length);
-    for each (Byte b in arr) {
-        vec.push_back(b);
+    uint64_t bits = _total * 8;
+
+    uint8_t padding[72] = { 0x80 };
+    size_t len = (_blocksize < 56 ? 56 : 120) - _blocksize;
+    for (int i = 0; i < 8; ++i) {
+        padding[len + i] = static_cast<uint8_t>(bits >> (56 - i * 8));
+    }
+    update(padding, len + 8);
+
+    Digest result;
+    for (int i = 0; i < 8; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            result[i * 4 + k] = static_cast<uint8_t>(_state[i] >> (24 - k * 8));
+        }
     }
-    return vec;
+    return result;
 }
 
-System::DateTime utils::ToSystemDateTime(double timestamp)
+utils::Sha256::Digest utils::Sha256::Hash(const void* data, size_t size)
 {
-    DateTime utc = DateTime(1970, 1, 1, 0, 0, 0, DateTimeKind::Utc).AddMilliseconds(timestamp);
-    return utc.ToLocalTime();
+    Sha256 sha;
+    sha.update(data, size);
+    return sha.finish();
 }
 
-double utils::ToTimestamp(System::DateTime datetime)
+void utils::Sha256::transform(const uint8_t* block)
 {
-    DateTime utc = datetime.ToUniversalTime();
-    return (utc - DateTime(1970, 1, 1, 0, 0, 0, DateTimeKind::Utc)).TotalMilliseconds;
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16
+            | static_cast<uint32_t>(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+    uint32_t e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+
+    for (int i = 0; i < 64; ++i) {
+        uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + SHA256_ROUNDS[i] + w[i];
+        uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+    _state[4] += e;
+    _state[5] += f;
+    _state[6] += g;
+    _state[7] += h;
 }
 
-bool utils::IsBigEndian()
+std::string utils::ToHexString(const uint8_t* data, size_t size)
 {
-    union { uint16_t a; uint8_t b[2]; } test = { 0x1234 };
-    return test.b[0] == 0x12;
+    static const char digits[] = "0123456789abcdef";
+
+    std::string result(size * 2, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        result[i * 2] = digits[data[i] >> 4];
+        result[i * 2 + 1] = digits[data[i] & 15];
+    }
+    return result;
 }
@@ -1,6 +1,7 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include <array>
 #include <cstdint>
 #include <cstdio>
 #include <string>
@@ -14,43 +15,56 @@ namespace utils
 
     void WriteFile(const std::string& path, const std::vector<uint8_t>& data);
 
-    System::String^ ToSystemString(const std::string& str, bool utf8 = true);
-
-    std::string ToStdString(System::String^ str, bool utf8 = true);
-
-    array<System::Byte>^ ToByteArray(const std::vector<uint8_t>& vec);
+    // read-only view of a whole file, large files are memory mapped so that
+    // they are paged in on demand instead of being copied into one buffer
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // returns false instead of throwing if the file cannot be read
+        bool open(const std::string& path);
+        void close();
+
+        const uint8_t* data() const { return _data; }
+        size_t size() const { return _size; }
+
+    private:
+        const uint8_t* _data = nullptr;
+        size_t _size = 0;
+        bool _mapped = false;
+        std::vector<uint8_t> _buffer;
+    };
+
+    // SHA-256, for naming and checking content, fed in as many pieces as needed
+    class Sha256
+    {
+    public:
+        using Digest = std::array<uint8_t, 32>;
 
-    std::vector<uint8_t> ToByteVector(array<System::Byte>^ arr);
+        Sha256();
 
-    System::DateTime ToSystemDateTime(double timestamp);
+        void update(const void* data, size_t size);
+        Digest finish();
 
-    double ToTimestamp(System::DateTime datetime);
+        static Digest Hash(const void* data, size_t size);
 
-    bool IsBigEndian();
+    private:
+        void transform(const uint8_t* block);
 
+        uint32_t _state[8];
+        uint8_t _block[64];
+        size_t _blocksize = 0;
+        uint64_t _total = 0;
+    };
 
-    template <typename T>
-    std::enable_if_t<std::is_integral_v<T>, T> ReverseEndian(T value)
-    {
-        T result = 0;
-        for (size_t i = 0; i < sizeof(T); i++) {
-            result = (result << 8) | (value & 0xFF);
-            value >>= 8;
-        }
-        return result;
-    }
-
-    template <typename T>
-    std::enable_if_t<std::is_integral_v<T>, T> FromBigEndian(T value)
-    {
-        return IsBigEndian() ? value : ReverseEndian(value);
-    }
-
-    template <typename T>
-    std::enable_if_t<std::is_integral_v<T>, T> ToBigEndian(T value)
-    {
-        return IsBigEndian() ? value : ReverseEndian(value);
-    }
+    // lowercase, two digits a byte
+    std::string ToHexString(const uint8_t* data, size_t size);
 
     template <typename... Args>
     std::string FormatString(const std::string& fmt, Args... args)
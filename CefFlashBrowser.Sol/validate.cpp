@@ -0,0 +1,25 @@
+#include "validate.h"
+#include "skipper.h"
+#include "utils.h"
+
+
+bool sol::ValidateSolData(const uint8_t* data, size_t size, SolError& error, const SolReadOptions& options)
+{
+    error = SolError();
+
+    detail::Reader r{ data, size, 0, error, options };
+    detail::Skipper skipper{ r };
+    return skipper.SkipSolFile();
+}
+
+bool sol::ValidateSolFile(const std::string& path, SolError& error, const SolReadOptions& options)
+{
+    error = SolError();
+
+    utils::MappedFile filecontent;
+    if (!filecontent.open(path)) {
+        error.code = SolErrorCode::IOFailed;
+        return false;
+    }
+    return ValidateSolData(filecontent.data(), filecontent.size(), error, options);
+}
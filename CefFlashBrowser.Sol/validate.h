@@ -0,0 +1,20 @@
+#ifndef __VALIDATE_H__
+#define __VALIDATE_H__
+
+#include "sol.h"
+
+namespace sol
+{
+    // checks the AMF grammar, reference indices, end marks and the header chunk size
+    // without building any values, only reference counts, one flat table of class
+    // member counts and flags, and a frame stack allocated once for maxdepth frames
+    // are kept, the table starts with room for 64 classes and grows with each class
+    // definition up to maxclasses, nothing else is allocated, the first problem is
+    // reported as TryReadSolFile would report it, maxnodes and maxbytes are not
+    // applied since nothing is allocated for the values
+    bool ValidateSolData(const uint8_t* data, size_t size, SolError& error, const SolReadOptions& options = SolReadOptions());
+
+    bool ValidateSolFile(const std::string& path, SolError& error, const SolReadOptions& options = SolReadOptions());
+}
+
+#endif // !__VALIDATE_H__
@@ -0,0 +1,100 @@
+#ifndef __VISIT_H__
+#define __VISIT_H__
+
+#include "sol.h"
+#include <algorithm>
+
+namespace sol
+{
+    // calls visitor(def, storage) with the SolTypeDef of value.type and the alternative
+    // holding the value, which can be changed in place if value is not const
+    template <typename TVisitor>
+    decltype(auto) VisitSolValue(const SolValue& value, TVisitor&& visitor)
+    {
+        return VisitSolType(value.type, [&](auto def) -> decltype(auto) {
+            return visitor(def, std::get<typename decltype(def)::storage>(value.value));
+        });
+    }
+
+    template <typename TVisitor>
+    decltype(auto) VisitSolValue(SolValue& value, TVisitor&& visitor)
+    {
+        return VisitSolType(value.type, [&](auto def) -> decltype(auto) {
+            return visitor(def, std::get<typename decltype(def)::storage>(value.value));
+        });
+    }
+}
+
+
+namespace sol::detail
+{
+    template <typename TValue, typename TVisitor>
+    void WalkValues(TValue& root, TVisitor& visitor)
+    {
+        std::vector<TValue*> stack{ &root };
+
+        while (!stack.empty()) {
+            TValue& value = *stack.back();
+            stack.pop_back();
+            visitor(value);
+
+            // children are taken after the visit, which may have replaced them
+            size_t first = stack.size();
+
+            VisitSolValue(value, [&](auto def, auto& v) {
+                using TStorage = typename decltype(def)::storage;
+
+                if constexpr (std::is_same_v<TStorage, sol::SolArray>) {
+                    for (auto& [key, val] : v.assoc) {
+                        stack.push_back(&val);
+                    }
+                    for (auto& val : v.dense) {
+                        stack.push_back(&val);
+                    }
+                }
+                else if constexpr (std::is_same_v<TStorage, sol::SolObject>) {
+                    for (auto& [key, val] : v.props) {
+                        stack.push_back(&val);
+                    }
+                }
+                else if constexpr (std::is_same_v<TStorage, sol::SolDictionary>) {
+                    for (auto& [key, val] : v.entries()) {
+                        if constexpr (std::is_const_v<TValue>) {
+                            stack.push_back(&key);
+                            stack.push_back(&val);
+                        }
+                        else {
+                            stack.push_back(v.find(key));
+                        }
+                    }
+                }
+            });
+
+            std::reverse(stack.begin() + first, stack.end());
+        }
+    }
+}
+
+
+namespace sol
+{
+    // calls visitor(value) for value and every value inside it, each container before
+    // its children and the children in the order they are written, nothing is copied
+    // and nesting is kept on the heap, so any depth the decoder accepts can be walked
+    template <typename TVisitor>
+    void WalkSolValue(const SolValue& value, TVisitor&& visitor)
+    {
+        detail::WalkValues(value, visitor);
+    }
+
+    // as above, the visitor may change or replace each value, its children are walked
+    // as they are after the change, dictionary keys are not visited since changing one
+    // would leave it in the wrong place of the dictionary's index
+    template <typename TVisitor>
+    void WalkSolValue(SolValue& value, TVisitor&& visitor)
+    {
+        detail::WalkValues(value, visitor);
+    }
+}
+
+#endif // !__VISIT_H__
@@ -19,6 +19,7 @@ namespace CefFlashBrowser.Utils
             [typeof(byte[])] = "Binary",
             [typeof(SolXml)] = "Xml",
             [typeof(SolXmlDoc)] = "XmlDocument",
+            [typeof(SolDictionaryWrapper)] = "Dictionary",
             [typeof(SolUndefined)] = "undefined"
         };
 
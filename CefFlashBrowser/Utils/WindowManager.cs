@@ -219,7 +219,7 @@ namespace CefFlashBrowser.Utils
         {
             try
             {
-                var file = new SolFileWrapper(fileName);
+                var file = new SolFileWrapper(fileName, collectStats: false, keepRaw: true);
                 ShowSolEditorWindow(file);
             }
             catch (Exception e)
@@ -1,5 +1,6 @@
 ﻿using CefFlashBrowser.Models;
 using CefFlashBrowser.Models.Data;
+using CefFlashBrowser.Sol;
 using CefFlashBrowser.Utils;
 using SimpleMvvm;
 using SimpleMvvm.Command;
@@ -131,6 +132,7 @@ namespace CefFlashBrowser.ViewModels
 
                 if (ofd.ShowDialog() == true)
                 {
+                    SolFileWrapper.Validate(ofd.FileName);
                     File.Copy(ofd.FileName, solFile.FilePath, true);
                     WindowManager.Alert(LanguageManager.GetString("message_imported"));
                 }